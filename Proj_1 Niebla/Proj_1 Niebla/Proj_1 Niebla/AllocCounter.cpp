@@ -0,0 +1,185 @@
+#include "AllocCounter.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+using namespace std;
+
+namespace
+{
+    atomic<unsigned long long> gAllocations{ 0 };
+
+    void* CountedAllocate(size_t size)
+    {
+        gAllocations.fetch_add(1, memory_order_relaxed);
+        return malloc(size ? size : 1);
+    }
+
+#ifdef __cpp_aligned_new
+    // Over-aligned types (alignas above the default new alignment) come through here
+    void* CountedAllocate(size_t size, align_val_t alignment)
+    {
+        gAllocations.fetch_add(1, memory_order_relaxed);
+#ifdef _WIN32
+        return _aligned_malloc(size ? size : 1, (size_t)alignment);
+#else
+        void* memory = nullptr;
+        const size_t bytes = max((size_t)alignment, sizeof(void*));
+        return posix_memalign(&memory, bytes, size ? size : 1) == 0 ? memory : nullptr;
+#endif
+    }
+
+    void AlignedFree(void* memory)
+    {
+#ifdef _WIN32
+        _aligned_free(memory);
+#else
+        free(memory);
+#endif
+    }
+#endif
+}
+
+
+unsigned long long UHeapAllocationCount()
+{
+    return gAllocations.load(memory_order_relaxed);
+}
+
+
+void* operator new(size_t size)
+{
+    void* memory = CountedAllocate(size);
+    if (!memory)
+        throw bad_alloc();
+    return memory;
+}
+
+
+void* operator new[](size_t size)
+{
+    void* memory = CountedAllocate(size);
+    if (!memory)
+        throw bad_alloc();
+    return memory;
+}
+
+
+void* operator new(size_t size, const nothrow_t&) noexcept
+{
+    return CountedAllocate(size);
+}
+
+
+void* operator new[](size_t size, const nothrow_t&) noexcept
+{
+    return CountedAllocate(size);
+}
+
+
+void operator delete(void* memory) noexcept
+{
+    free(memory);
+}
+
+
+void operator delete[](void* memory) noexcept
+{
+    free(memory);
+}
+
+
+void operator delete(void* memory, size_t) noexcept
+{
+    free(memory);
+}
+
+
+void operator delete[](void* memory, size_t) noexcept
+{
+    free(memory);
+}
+
+
+void operator delete(void* memory, const nothrow_t&) noexcept
+{
+    free(memory);
+}
+
+
+void operator delete[](void* memory, const nothrow_t&) noexcept
+{
+    free(memory);
+}
+
+
+#ifdef __cpp_aligned_new
+
+void* operator new(size_t size, align_val_t alignment)
+{
+    void* memory = CountedAllocate(size, alignment);
+    if (!memory)
+        throw bad_alloc();
+    return memory;
+}
+
+
+void* operator new[](size_t size, align_val_t alignment)
+{
+    void* memory = CountedAllocate(size, alignment);
+    if (!memory)
+        throw bad_alloc();
+    return memory;
+}
+
+
+void* operator new(size_t size, align_val_t alignment, const nothrow_t&) noexcept
+{
+    return CountedAllocate(size, alignment);
+}
+
+
+void* operator new[](size_t size, align_val_t alignment, const nothrow_t&) noexcept
+{
+    return CountedAllocate(size, alignment);
+}
+
+
+void operator delete(void* memory, align_val_t) noexcept
+{
+    AlignedFree(memory);
+}
+
+
+void operator delete[](void* memory, align_val_t) noexcept
+{
+    AlignedFree(memory);
+}
+
+
+void operator delete(void* memory, size_t, align_val_t) noexcept
+{
+    AlignedFree(memory);
+}
+
+
+void operator delete[](void* memory, size_t, align_val_t) noexcept
+{
+    AlignedFree(memory);
+}
+
+
+void operator delete(void* memory, align_val_t, const nothrow_t&) noexcept
+{
+    AlignedFree(memory);
+}
+
+
+void operator delete[](void* memory, align_val_t, const nothrow_t&) noexcept
+{
+    AlignedFree(memory);
+}
+
+#endif
@@ -0,0 +1,18 @@
+///////////////////////////////////////////////////////////////////////////////
+// AllocCounter.h
+// ==============
+// Counts heap allocations made through operator new (every new expression
+// and every standard container), so benchmark runs can check that a
+// steady-state frame allocates nothing. The global operator new/delete are
+// replaced in AllocCounter.cpp, including the aligned forms when the
+// compiler has them (C++17); malloc calls made by C libraries and the GL
+// driver are not seen.
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef ALLOC_COUNTER_H
+#define ALLOC_COUNTER_H
+
+// Allocations since startup, from every thread
+unsigned long long UHeapAllocationCount();
+
+#endif
@@ -0,0 +1,428 @@
+#include "AssetPack.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+#include "Lz4.h"
+
+using namespace std;
+
+namespace
+{
+    const char MAGIC[4] = { 'N', 'P', 'A', 'K' };
+
+    // Each byte of an LZ4 block adds at most 255 bytes to a match or literal
+    // length, plus the few bytes of the shortest sequences
+    const uint64_t LZ4_MAX_EXPANSION = 255;
+    const uint64_t LZ4_EXPANSION_SLACK = 64;
+
+    uint64_t alignUp(uint64_t offset)
+    {
+        return (offset + ASSET_PACK_ALIGNMENT - 1) / ASSET_PACK_ALIGNMENT * ASSET_PACK_ALIGNMENT;
+    }
+
+    // True when [offset, offset + bytes) lies within size bytes
+    bool inside(uint64_t offset, uint64_t bytes, uint64_t size)
+    {
+        return offset <= size && bytes <= size - offset;
+    }
+
+    string normalizePath(const string& path)
+    {
+        string normalized = path;
+        replace(normalized.begin(), normalized.end(), '\\', '/');
+        return normalized;
+    }
+
+    // Pack file names also drop "." and empty segments, so "./a.npak" and "a.npak"
+    // name the same pack
+    string normalizePackPath(const string& path)
+    {
+        const string normalized = normalizePath(path);
+        string result = !normalized.empty() && normalized[0] == '/' ? "/" : "";
+        size_t begin = 0;
+        while (begin <= normalized.size())
+        {
+            size_t end = normalized.find('/', begin);
+            if (end == string::npos)
+                end = normalized.size();
+            const string segment = normalized.substr(begin, end - begin);
+            if (!segment.empty() && segment != ".")
+            {
+                if (!result.empty() && result.back() != '/')
+                    result += '/';
+                result += segment;
+            }
+            begin = end + 1;
+        }
+        return result;
+    }
+
+    bool writePadding(ofstream& file, uint64_t offset)
+    {
+        static const char zeros[ASSET_PACK_ALIGNMENT] = {};
+        return (bool)file.write(zeros, (streamsize)(alignUp(offset) - offset));
+    }
+}
+
+
+bool UParseAssetPackArgs(int argc, char* argv[], AssetPackOptions& options)
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        const char* arg = argv[i];
+        if (strcmp(arg, "--pack-lz4") == 0)
+        {
+            options.compress = true;
+            continue;
+        }
+        if (strcmp(arg, "--pack") != 0 && strcmp(arg, "--build-pack") != 0 && strcmp(arg, "--pack-add") != 0)
+            continue;
+
+        const char* value = i + 1 < argc ? argv[++i] : "";
+        if (value[0] == '\0')
+        {
+            cout << "Invalid value for " << arg << endl;
+            return false;
+        }
+        if (strcmp(arg, "--pack") == 0)
+            options.mounts.push_back(value);
+        else if (strcmp(arg, "--build-pack") == 0)
+            options.buildPath = value;
+        else
+            options.extraFiles.push_back(value);
+    }
+
+    return true;
+}
+
+
+bool UWriteAssetPack(const string& packPath, const vector<string>& files, bool compress)
+{
+    // Overwriting a mapped file would pull the data from under the mapping
+    if (UAssets().isMounted(packPath))
+    {
+        cout << "Cannot rebuild the mounted asset pack " << packPath << endl;
+        return false;
+    }
+
+    vector<string> paths;
+    for (const string& file : files)
+        paths.push_back(normalizePath(file));
+    sort(paths.begin(), paths.end());
+    paths.erase(unique(paths.begin(), paths.end()), paths.end());
+
+    AssetPackHeader header = {};
+    memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version = ASSET_PACK_VERSION;
+    header.entryCount = (uint32_t)paths.size();
+    header.entryBytes = sizeof(AssetPackEntry);
+    header.entryTableOffset = sizeof(AssetPackHeader);
+
+    string strings;
+    vector<AssetPackEntry> entries(paths.size());
+    for (size_t i = 0; i < paths.size(); ++i)
+    {
+        entries[i].path = (uint32_t)strings.size();
+        strings.append(paths[i]).push_back('\0');
+    }
+    header.stringTableOffset = header.entryTableOffset + entries.size() * sizeof(AssetPackEntry);
+    header.stringTableBytes = strings.size();
+
+    // Read (and compress) everything first, as the table precedes the data
+    vector<unique_ptr<AssetData>> assets(paths.size());
+    vector<vector<unsigned char>> compressed(paths.size());
+    uint64_t offset = header.stringTableOffset + header.stringTableBytes;
+    size_t totalBytes = 0;
+    for (size_t i = 0; i < paths.size(); ++i)
+    {
+        assets[i].reset(new AssetData);
+        if (!UAssets().read(paths[i], *assets[i]))
+        {
+            cout << "Failed to read " << paths[i] << " for asset pack " << packPath << endl;
+            return false;
+        }
+
+        AssetPackEntry& entry = entries[i];
+        entry.size = assets[i]->getSize();
+        entry.compression = ASSET_STORED;
+        entry.storedBytes = entry.size;
+        if (compress && entry.size > 0)
+        {
+            ULz4Compress(assets[i]->getData(), assets[i]->getSize(), compressed[i]);
+            if (compressed[i].size() <= entry.size - entry.size / 8)
+            {
+                entry.compression = ASSET_LZ4;
+                entry.storedBytes = compressed[i].size();
+            }
+            else
+            {
+                compressed[i].clear();
+            }
+        }
+        entry.offset = alignUp(offset);
+        offset = entry.offset + entry.storedBytes;
+        totalBytes += (size_t)entry.size;
+    }
+    header.fileBytes = offset;
+
+    ofstream file(packPath, ios::binary | ios::trunc);
+    if (!file)
+    {
+        cout << "Failed to create asset pack " << packPath << endl;
+        return false;
+    }
+
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char*>(entries.data()), (streamsize)(entries.size() * sizeof(AssetPackEntry)));
+    file.write(strings.data(), (streamsize)strings.size());
+    offset = header.stringTableOffset + header.stringTableBytes;
+    for (size_t i = 0; i < paths.size() && file; ++i)
+    {
+        writePadding(file, offset);
+        const unsigned char* data = entries[i].compression == ASSET_LZ4 ? compressed[i].data() : assets[i]->getData();
+        file.write(reinterpret_cast<const char*>(data), (streamsize)entries[i].storedBytes);
+        offset = entries[i].offset + entries[i].storedBytes;
+    }
+
+    if (!file.flush())
+    {
+        cout << "Failed to write asset pack " << packPath << endl;
+        return false;
+    }
+    cout << "INFO: Packed " << paths.size() << " assets, " << totalBytes / 1024 << " KB into "
+        << header.fileBytes / 1024 << " KB in " << packPath << endl;
+    return true;
+}
+
+
+AssetFS& UAssets()
+{
+    static AssetFS assets;
+    return assets;
+}
+
+
+void AssetData::reset()
+{
+    data = nullptr;
+    size = 0;
+    packed = false;
+    storage.clear();
+    storage.shrink_to_fit();
+    file.close();
+}
+
+
+AssetFS::~AssetFS()
+{
+    stopPrefetching();
+}
+
+
+bool AssetFS::mount(const string& packPath)
+{
+    // Named twice on the command line
+    if (isMounted(packPath))
+    {
+        cout << "INFO: Asset pack " << packPath << " is already mounted" << endl;
+        return true;
+    }
+
+    unique_ptr<Pack> pack(new Pack);
+    pack->path = packPath;
+    if (!pack->file.open(packPath))
+    {
+        cout << "Failed to map asset pack " << packPath << endl;
+        return false;
+    }
+
+    const unsigned char* data = pack->file.getData();
+    const uint64_t size = pack->file.getSize();
+    AssetPackHeader header;
+    if (size < sizeof(header))
+    {
+        cout << "Asset pack " << packPath << " is too short" << endl;
+        return false;
+    }
+    memcpy(&header, data, sizeof(header));
+
+    if (memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 || header.version != ASSET_PACK_VERSION)
+    {
+        cout << "Asset pack " << packPath << " is not a version " << ASSET_PACK_VERSION << " pack" << endl;
+        return false;
+    }
+    if (header.entryBytes < sizeof(AssetPackEntry) || header.fileBytes != size ||
+        !inside(header.entryTableOffset, (uint64_t)header.entryCount * header.entryBytes, size) ||
+        !inside(header.stringTableOffset, header.stringTableBytes, size))
+    {
+        cout << "Asset pack " << packPath << " has a corrupt header" << endl;
+        return false;
+    }
+
+    const char* strings = reinterpret_cast<const char*>(data + header.stringTableOffset);
+    vector<string> paths(header.entryCount);
+    pack->entries.resize(header.entryCount);
+    for (uint32_t i = 0; i < header.entryCount; ++i)
+    {
+        AssetPackEntry& entry = pack->entries[i];
+        memcpy(&entry, data + header.entryTableOffset + (uint64_t)i * header.entryBytes, sizeof(entry));
+
+        const bool terminated = entry.path < header.stringTableBytes &&
+            memchr(strings + entry.path, '\0', (size_t)(header.stringTableBytes - entry.path)) != nullptr;
+        // read() allocates the decompressed size up front, so it must be one the block can produce
+        const bool lz4Sized = (entry.storedBytes > 0 || entry.size == 0) &&
+            entry.size <= entry.storedBytes * LZ4_MAX_EXPANSION + LZ4_EXPANSION_SLACK;
+        const bool valid = terminated && inside(entry.offset, entry.storedBytes, size) &&
+            ((entry.compression == ASSET_STORED && entry.storedBytes == entry.size) ||
+            (entry.compression == ASSET_LZ4 && lz4Sized));
+        if (!valid)
+        {
+            cout << "Asset pack " << packPath << " has a corrupt entry " << i << endl;
+            return false;
+        }
+        paths[i] = normalizePath(strings + entry.path);
+    }
+
+    const Pack* mounted = pack.get();
+    packs.push_back(move(pack));
+    for (uint32_t i = 0; i < header.entryCount; ++i)
+        locations[paths[i]] = Location{ mounted, &mounted->entries[i] };
+
+    cout << "INFO: Mounted " << header.entryCount << " assets from " << packPath << endl;
+    return true;
+}
+
+
+void AssetFS::unmountAll()
+{
+    stopPrefetching();
+    locations.clear();
+    packs.clear();
+}
+
+
+bool AssetFS::isMounted(const string& packPath) const
+{
+    const string normalized = normalizePackPath(packPath);
+    for (const unique_ptr<Pack>& pack : packs)
+    {
+        if (normalizePackPath(pack->path) == normalized)
+            return true;
+    }
+    return false;
+}
+
+
+bool AssetFS::contains(const string& path) const
+{
+    return find(path) != nullptr;
+}
+
+
+bool AssetFS::read(const string& path, AssetData& asset)
+{
+    asset.reset();
+
+    const Location* location = find(path);
+    if (!location)
+    {
+        if (!asset.file.open(path))
+            return false;
+        // Loaders read a whole file, so have all of it read ahead
+        asset.file.prefetch(0, asset.file.getSize());
+        asset.data = asset.file.getData();
+        asset.size = asset.file.getSize();
+        looseReads++;
+        return true;
+    }
+
+    const AssetPackEntry& entry = *location->entry;
+    const unsigned char* stored = location->pack->file.getData() + entry.offset;
+    location->pack->file.prefetch((size_t)entry.offset, (size_t)entry.storedBytes);
+    if (entry.compression == ASSET_STORED)
+    {
+        asset.data = stored;
+    }
+    else
+    {
+        asset.storage.resize((size_t)entry.size);
+        if (!ULz4Decompress(stored, (size_t)entry.storedBytes, asset.storage.data(), asset.storage.size()))
+        {
+            cout << "Asset " << path << " in " << location->pack->path << " is corrupt" << endl;
+            asset.reset();
+            return false;
+        }
+        asset.data = asset.storage.data();
+    }
+    asset.size = (size_t)entry.size;
+    asset.packed = true;
+    packedReads++;
+    return true;
+}
+
+
+void AssetFS::prefetch(const string& path)
+{
+    const Location* location = find(path);
+    if (!location)
+        return;
+
+    lock_guard<mutex> lock(prefetchMutex);
+    if (!prefetchThread.joinable())
+        prefetchThread = thread(&AssetFS::prefetchLoop, this);
+    prefetchQueue.push_back(PrefetchRange{ &location->pack->file, (size_t)location->entry->offset,
+        (size_t)location->entry->storedBytes });
+    prefetchReady.notify_one();
+}
+
+
+const AssetFS::Location* AssetFS::find(const string& path) const
+{
+    if (locations.empty())
+        return nullptr;
+    auto found = locations.find(normalizePath(path));
+    return found != locations.end() ? &found->second : nullptr;
+}
+
+
+void AssetFS::prefetchLoop()
+{
+    unique_lock<mutex> lock(prefetchMutex);
+    for (;;)
+    {
+        prefetchReady.wait(lock, [this]() { return stopping || !prefetchQueue.empty(); });
+        if (stopping)
+            return;
+        const PrefetchRange range = prefetchQueue.front();
+        prefetchQueue.pop_front();
+        lock.unlock();
+
+        // The hint starts the reads; touching every page waits for them here
+        // instead of on the thread that loads the asset
+        range.file->prefetch(range.offset, range.bytes);
+        const unsigned char* data = range.file->getData() + range.offset;
+        volatile unsigned char touched = 0;
+        for (size_t i = 0; i < range.bytes; i += ASSET_PACK_ALIGNMENT)
+            touched = data[i];
+        (void)touched;
+
+        lock.lock();
+    }
+}
+
+
+void AssetFS::stopPrefetching()
+{
+    {
+        lock_guard<mutex> lock(prefetchMutex);
+        stopping = true;
+        prefetchQueue.clear();
+    }
+    prefetchReady.notify_all();
+    if (prefetchThread.joinable())
+        prefetchThread.join();
+    stopping = false;
+}
@@ -0,0 +1,194 @@
+///////////////////////////////////////////////////////////////////////////////
+// AssetPack.h
+// ===========
+// Pack files bundling the scene's assets (textures, mesh files, imported
+// models) into one memory-mapped file, and the virtual file system the
+// loaders read through. A cold start then opens one file and reads it in
+// large runs instead of opening and seeking many small ones.
+//
+// Layout (little endian, offsets from the start of the file):
+//   header        magic "NPAK", version, entry count, table offsets, file size
+//   entry table   one AssetPackEntry per file, sorted by path
+//   string table  NUL-terminated paths, '/' separated, as the loaders ask for
+//                 them ("../Includes/T_granite.png")
+//   data          each entry page-aligned, stored as is or LZ4 compressed
+//
+// Compression is per entry and only kept when it saves an eighth or more:
+// images that are already compressed are stored as is. Uncompressed entries
+// are read in place from the mapping, so a mesh file in a pack still goes
+// from the page cache straight into buffer storage; compressed ones are
+// decoded into memory the AssetData owns.
+//
+// Packs mounted later take precedence over earlier ones; paths no pack
+// holds are read from the file system. prefetch() queues entries for a
+// background thread that has the OS read them ahead (madvise WILLNEED or
+// PrefetchVirtualMemory) and touches every page, so reads by the loaders
+// that follow do not wait for the disk.
+//
+// Usage:
+//   "Proj_1 Niebla" [--pack scene.npak] [--build-pack scene.npak] [--pack-lz4]
+//                   [--pack-add file]  (extra file for --build-pack, repeatable)
+//
+//   UAssets().mount("scene.npak");
+//   UAssets().prefetch("../Includes/T_Book.png");
+//   AssetData asset;
+//   if (UAssets().read("../Includes/T_Book.png", asset))
+//       decode(asset.getData(), asset.getSize());
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef ASSET_PACK_H
+#define ASSET_PACK_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "MappedFile.h"
+
+const uint32_t ASSET_PACK_VERSION = 1;
+const uint32_t ASSET_PACK_ALIGNMENT = 4096;
+
+enum AssetCompression
+{
+    ASSET_STORED = 0,
+    ASSET_LZ4 = 1,
+};
+
+struct AssetPackOptions
+{
+    std::vector<std::string> mounts;        // packs to read assets from, in mount order
+    std::string buildPath;                  // write the scene's assets into this pack
+    std::vector<std::string> extraFiles;    // more files for the pack to hold
+    bool compress = false;                  // LZ4 the entries that shrink
+};
+
+struct AssetPackHeader
+{
+    char magic[4];              // "NPAK"
+    uint32_t version;
+    uint32_t entryCount;
+    uint32_t entryBytes;        // sizeof(AssetPackEntry) when written
+    uint64_t entryTableOffset;
+    uint64_t stringTableOffset;
+    uint64_t stringTableBytes;
+    uint64_t fileBytes;
+};
+
+struct AssetPackEntry
+{
+    uint32_t path;              // string table offset
+    uint32_t compression;       // AssetCompression
+    uint64_t offset;
+    uint64_t storedBytes;
+    uint64_t size;              // once decompressed
+};
+
+static_assert(sizeof(AssetPackHeader) == 48, "AssetPackHeader layout");
+static_assert(sizeof(AssetPackEntry) == 32, "AssetPackEntry layout");
+
+// Contents of an asset: in a pack mapping, in memory it decoded it into, or
+// in its own mapping of a loose file
+class AssetData
+{
+public:
+    AssetData() {}
+    AssetData(const AssetData&) = delete;
+    AssetData& operator=(const AssetData&) = delete;
+
+    void reset();
+
+    const unsigned char* getData() const { return data; }
+    size_t getSize() const { return size; }
+    bool isPacked() const { return packed; }
+
+private:
+    friend class AssetFS;
+
+    const unsigned char* data = nullptr;
+    size_t size = 0;
+    bool packed = false;
+    std::vector<unsigned char> storage;
+    MappedFile file;
+};
+
+class AssetFS
+{
+public:
+    AssetFS() {}
+    ~AssetFS();
+    AssetFS(const AssetFS&) = delete;
+    AssetFS& operator=(const AssetFS&) = delete;
+
+    // Validates and mounts a pack over the ones mounted before
+    bool mount(const std::string& packPath);
+    // Drops queued prefetches and unmaps every pack
+    void unmountAll();
+    bool isMounted(const std::string& packPath) const;
+
+    bool contains(const std::string& path) const;
+    // From the newest pack holding path, else from the file system; data read
+    // from a pack stays valid until the packs are unmounted
+    bool read(const std::string& path, AssetData& asset);
+    // Queues a packed asset to be read ahead on the prefetch thread; paths no
+    // pack holds are ignored
+    void prefetch(const std::string& path);
+
+    unsigned long long getPackedReads() const { return packedReads; }
+    unsigned long long getLooseReads() const { return looseReads; }
+
+private:
+    struct Pack
+    {
+        std::string path;
+        MappedFile file;
+        std::vector<AssetPackEntry> entries;
+    };
+
+    struct Location
+    {
+        const Pack* pack;
+        const AssetPackEntry* entry;
+    };
+
+    struct PrefetchRange
+    {
+        const MappedFile* file;
+        size_t offset;
+        size_t bytes;
+    };
+
+    const Location* find(const std::string& path) const;
+    void prefetchLoop();
+    void stopPrefetching();
+
+    std::vector<std::unique_ptr<Pack>> packs;
+    std::unordered_map<std::string, Location> locations;     // by normalized path
+
+    std::thread prefetchThread;
+    std::mutex prefetchMutex;
+    std::condition_variable prefetchReady;
+    std::deque<PrefetchRange> prefetchQueue;
+    bool stopping = false;
+
+    unsigned long long packedReads = 0;
+    unsigned long long looseReads = 0;
+};
+
+bool UParseAssetPackArgs(int argc, char* argv[], AssetPackOptions& options);
+
+// Writes the files (read through UAssets(), so packed ones can be repacked)
+// into a pack; duplicate paths are stored once
+bool UWriteAssetPack(const std::string& packPath, const std::vector<std::string>& files, bool compress);
+
+// The file system every loader reads through; belongs to the main thread,
+// apart from the prefetch thread it runs
+AssetFS& UAssets();
+
+#endif
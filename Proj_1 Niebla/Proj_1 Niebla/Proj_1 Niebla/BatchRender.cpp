@@ -0,0 +1,350 @@
+#include "BatchRender.h"
+
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+#ifndef _WIN32
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+namespace
+{
+    const int MAX_IMAGE_SIZE = 8192;
+
+    // Names become file names, and may come from a socket: no paths
+    bool IsSafeName(const string& name)
+    {
+        if (name.empty() || name.size() > 128 || name[0] == '.')
+            return false;
+        for (char c : name)
+        {
+            const bool ok = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9')
+                || c == '_' || c == '-' || c == '.';
+            if (!ok)
+                return false;
+        }
+        return true;
+    }
+}
+
+
+bool UParseBatchArgs(int argc, char* argv[], BatchOptions& options)
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        const char* arg = argv[i];
+        if (strncmp(arg, "--batch", 7) != 0)
+            continue;
+        if (i + 1 >= argc)
+        {
+            cout << "Missing value for " << arg << endl;
+            return false;
+        }
+
+        const char* value = argv[++i];
+        if (strcmp(arg, "--batch") == 0)
+            options.jobPath = value;
+        else if (strcmp(arg, "--batch-socket") == 0)
+            options.socketPath = value;
+        else if (strcmp(arg, "--batch-out") == 0)
+            options.outputDir = value;
+        else if (strcmp(arg, "--batch-report") == 0)
+            options.reportPath = value;
+        else if (strcmp(arg, "--batch-threads") == 0)
+        {
+            char* end = nullptr;
+            options.threads = (int)strtol(value, &end, 10);
+            if (*end != '\0' || end == value || options.threads < 0 || options.threads > MAX_BATCH_THREADS)
+            {
+                cout << "Invalid value for " << arg << endl;
+                return false;
+            }
+        }
+        else
+        {
+            cout << "Unknown option " << arg << endl;
+            return false;
+        }
+    }
+
+    options.enabled = !options.jobPath.empty() || !options.socketPath.empty();
+    return true;
+}
+
+
+bool UParseBatchJob(const string& line, BatchJob& job, string& error)
+{
+    error.clear();
+    const size_t first = line.find_first_not_of(" \t\r");
+    if (first == string::npos || line[first] == '#')
+        return false;
+
+    istringstream in(line);
+    in >> job.name >> job.width >> job.height
+        >> job.eye.x >> job.eye.y >> job.eye.z
+        >> job.target.x >> job.target.y >> job.target.z;
+    if (!in)
+    {
+        error = "expected: name width height eyeX eyeY eyeZ targetX targetY targetZ [fov]";
+        return false;
+    }
+    job.fov = 45.0f;
+    if (!(in >> job.fov))
+        job.fov = 45.0f;
+
+    if (!IsSafeName(job.name))
+        error = "name may only use letters, digits, '_', '-' and '.'";
+    else if (job.width < 1 || job.height < 1 || job.width > MAX_IMAGE_SIZE || job.height > MAX_IMAGE_SIZE)
+        error = "size must be 1 to " + to_string(MAX_IMAGE_SIZE);
+    else if (job.fov <= 1.0f || job.fov >= 179.0f)
+        error = "fov must be between 1 and 179 degrees";
+    else if (job.eye == job.target)
+        error = "eye and target must differ";
+    return error.empty();
+}
+
+
+bool ULoadBatchJobs(const string& path, vector<BatchJob>& jobs)
+{
+    ifstream in(path);
+    if (!in)
+    {
+        cout << "Failed to open batch job file " << path << endl;
+        return false;
+    }
+
+    bool ok = true;
+    string line;
+    for (int number = 1; getline(in, line); ++number)
+    {
+        BatchJob job;
+        string error;
+        if (UParseBatchJob(line, job, error))
+            jobs.push_back(job);
+        else if (!error.empty())
+        {
+            cout << path << ":" << number << ": " << error << endl;
+            ok = false;
+        }
+    }
+    return ok;
+}
+
+
+void BatchQueue::push(const BatchJob& job)
+{
+    {
+        lock_guard<std::mutex> lock(mutex);
+        jobs.push_back(job);
+    }
+    ready.notify_one();
+}
+
+
+bool BatchQueue::pop(BatchJob& job)
+{
+    unique_lock<std::mutex> lock(mutex);
+    ready.wait(lock, [this]() { return closed || !jobs.empty(); });
+    if (jobs.empty())
+        return false;
+    job = jobs.front();
+    jobs.pop_front();
+    return true;
+}
+
+
+void BatchQueue::close()
+{
+    {
+        lock_guard<std::mutex> lock(mutex);
+        closed = true;
+    }
+    ready.notify_all();
+}
+
+
+void BatchLog::add(const BatchTiming& timing)
+{
+    lock_guard<std::mutex> lock(mutex);
+    timings.push_back(timing);
+}
+
+
+int BatchLog::getFailedCount()
+{
+    lock_guard<std::mutex> lock(mutex);
+    int failed = 0;
+    for (const BatchTiming& timing : timings)
+        failed += timing.ok ? 0 : 1;
+    return failed;
+}
+
+
+void BatchLog::writeReport(ostream& out, const char* renderer, int threads, double seconds)
+{
+    lock_guard<std::mutex> lock(mutex);
+
+    int images = 0;
+    for (const BatchTiming& timing : timings)
+        images += timing.ok ? 1 : 0;
+
+    out << "{\n"
+        << "  \"renderer\": \"" << (renderer ? renderer : "unknown") << "\",\n"
+        << "  \"threads\": " << threads << ",\n"
+        << "  \"images\": " << images << ",\n"
+        << "  \"failed\": " << timings.size() - images << ",\n"
+        << "  \"seconds\": " << seconds << ",\n"
+        << "  \"images_per_sec\": " << (seconds > 0.0 ? images / seconds : 0.0) << ",\n"
+        << "  \"jobs\": [";
+    for (size_t i = 0; i < timings.size(); ++i)
+    {
+        const BatchTiming& timing = timings[i];
+        out << (i ? ",\n" : "\n")
+            << "    { \"name\": \"" << timing.name << "\""
+            << ", \"worker\": " << timing.worker
+            << ", \"width\": " << timing.width
+            << ", \"height\": " << timing.height
+            << ", \"render_ms\": " << timing.renderMs
+            << ", \"write_ms\": " << timing.writeMs
+            << ", \"ok\": " << (timing.ok ? "true" : "false") << " }";
+    }
+    out << (timings.empty() ? "]\n" : "\n  ]\n") << "}" << endl;
+}
+
+
+#ifndef _WIN32
+
+bool BatchSocketServer::open(const string& path)
+{
+    close();
+
+    sockaddr_un address = {};
+    address.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(address.sun_path))
+    {
+        cout << "Socket path too long: " << path << endl;
+        return false;
+    }
+    strcpy(address.sun_path, path.c_str());
+
+    // A socket left over from a previous run is replaced; anything else at the path is kept
+    struct stat status;
+    if (lstat(path.c_str(), &status) == 0)
+    {
+        if (!S_ISSOCK(status.st_mode))
+        {
+            cout << "Not replacing " << path << ", it exists and is not a socket" << endl;
+            return false;
+        }
+        unlink(path.c_str());
+    }
+
+    listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listener < 0 || bind(listener, (sockaddr*)&address, sizeof(address)) != 0 || listen(listener, 4) != 0)
+    {
+        cout << "Failed to listen on " << path << ": " << strerror(errno) << endl;
+        close();
+        return false;
+    }
+
+    this->path = path;
+    cout << "INFO: Accepting batch jobs on " << path << endl;
+    return true;
+}
+
+
+void BatchSocketServer::serve(BatchQueue& queue)
+{
+    bool quit = false;
+    while (!quit)
+    {
+        const int client = accept(listener, nullptr, nullptr);
+        if (client < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            break;
+        }
+
+        // Read lines until the client hangs up or asks to quit
+        string pending;
+        char buffer[4096];
+        ssize_t received;
+        while (!quit && (received = recv(client, buffer, sizeof(buffer), 0)) > 0)
+        {
+            pending.append(buffer, received);
+            size_t newline;
+            while (!quit && (newline = pending.find('\n')) != string::npos)
+            {
+                const string line = pending.substr(0, newline);
+                pending.erase(0, newline + 1);
+
+                string reply;
+                BatchJob job;
+                string error;
+                if (line == "quit" || line == "quit\r")
+                {
+                    quit = true;
+                    reply = "bye\n";
+                }
+                else if (UParseBatchJob(line, job, error))
+                {
+                    queue.push(job);
+                    reply = "queued " + job.name + "\n";
+                }
+                else if (!error.empty())
+                    reply = "error " + error + "\n";
+                if (!reply.empty())
+                    send(client, reply.data(), reply.size(), MSG_NOSIGNAL);
+            }
+
+            // A client that never sends a newline can't grow the buffer without bound
+            if (pending.size() > sizeof(buffer))
+                pending.clear();
+        }
+        ::close(client);
+    }
+
+    queue.close();
+}
+
+
+void BatchSocketServer::close()
+{
+    if (listener >= 0)
+        ::close(listener);
+    listener = -1;
+    if (!path.empty())
+        unlink(path.c_str());
+    path.clear();
+}
+
+#else
+
+bool BatchSocketServer::open(const string& path)
+{
+    cout << "--batch-socket needs UNIX domain sockets, which this build doesn't support" << endl;
+    return false;
+}
+
+
+void BatchSocketServer::serve(BatchQueue& queue)
+{
+    queue.close();
+}
+
+
+void BatchSocketServer::close()
+{
+}
+
+#endif
@@ -0,0 +1,131 @@
+///////////////////////////////////////////////////////////////////////////////
+// BatchRender.h
+// =============
+// Headless batch rendering of product shots. Jobs name an image, its size
+// and a camera pose; they come from a job file and/or a local UNIX socket
+// and are rendered by worker threads, each with its own hidden GL context.
+// The contexts share the meshes' vertex buffers and the textures with the
+// main context. Each worker creates its own VAOs and framebuffer (these
+// aren't shareable) and links its own shader programs, since uniform
+// values live in the program object and workers set them concurrently.
+//
+// Job lines, in the file and over the socket (# starts a comment):
+//   name width height eyeX eyeY eyeZ targetX targetY targetZ [fovDegrees]
+// Each job writes <out>/<name>.png. At the end a JSON report with per-job
+// timings and the throughput in images per second is printed.
+//
+// Socket clients send job lines and get "queued <name>" or "error ..."
+// back. A "quit" line stops accepting jobs; the queued ones still render.
+//
+// Usage:
+//   "Proj_1 Niebla" --batch jobs.txt [--batch-threads 4] [--batch-out dir]
+//                   [--batch-report report.json] [--software]
+//   "Proj_1 Niebla" --batch-socket /tmp/niebla.sock [--batch-threads 4]
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef BATCH_RENDER_H
+#define BATCH_RENDER_H
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+struct BatchOptions
+{
+    bool enabled = false;       // set by --batch or --batch-socket
+    std::string jobPath;
+    std::string socketPath;
+    int threads = 0;            // 0: one per hardware thread, up to MAX_BATCH_THREADS
+    std::string outputDir = ".";
+    std::string reportPath;     // JSON report file, stdout when empty
+};
+
+const int MAX_BATCH_THREADS = 16;
+
+bool UParseBatchArgs(int argc, char* argv[], BatchOptions& options);
+
+struct BatchJob
+{
+    std::string name;           // output file name without extension
+    int width = 0;
+    int height = 0;
+    glm::vec3 eye;
+    glm::vec3 target;
+    float fov = 45.0f;
+};
+
+// Parses one job line; false with error set when it is malformed. Blank and
+// comment lines return false with an empty error.
+bool UParseBatchJob(const std::string& line, BatchJob& job, std::string& error);
+
+// Reads every job of a job file, printing the malformed lines
+bool ULoadBatchJobs(const std::string& path, std::vector<BatchJob>& jobs);
+
+// Jobs waiting for a worker
+class BatchQueue
+{
+public:
+    void push(const BatchJob& job);
+
+    // Blocks for the next job; false once the queue is closed and drained
+    bool pop(BatchJob& job);
+
+    // No more jobs will be pushed
+    void close();
+
+private:
+    std::mutex mutex;
+    std::condition_variable ready;
+    std::deque<BatchJob> jobs;
+    bool closed = false;
+};
+
+// Outcome of one job
+struct BatchTiming
+{
+    std::string name;
+    int worker = 0;
+    int width = 0;
+    int height = 0;
+    double renderMs = 0.0;      // drawing and reading the image back
+    double writeMs = 0.0;       // PNG encoding and file write
+    bool ok = false;
+};
+
+// Collects timings from the workers and writes the report
+class BatchLog
+{
+public:
+    void add(const BatchTiming& timing);
+    int getFailedCount();
+    void writeReport(std::ostream& out, const char* renderer, int threads, double seconds);
+
+private:
+    std::mutex mutex;
+    std::vector<BatchTiming> timings;
+};
+
+// Accepts job lines on a UNIX domain socket, one client at a time
+class BatchSocketServer
+{
+public:
+    ~BatchSocketServer() { close(); }
+
+    bool open(const std::string& path);
+
+    // Serves clients until one sends "quit", then closes queue
+    void serve(BatchQueue& queue);
+
+    void close();
+
+private:
+    std::string path;
+    int listener = -1;
+};
+
+#endif
@@ -0,0 +1,604 @@
+#include "Bench.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+namespace
+{
+    // Orbit used by the scripted camera path
+    const float BENCH_ORBIT_RADIUS = 9.0f;
+    const float BENCH_ORBIT_HEIGHT = 3.5f;
+    const glm::vec3 BENCH_ORBIT_TARGET(0.0f, 0.5f, 0.5f);
+
+    // Timings below this many milliseconds are treated as noise when comparing baselines
+    const double BASELINE_NOISE_FLOOR_MS = 0.02;
+
+    // A golden-image pixel differs when any channel is off by more than this
+    const int GOLDEN_CHANNEL_THRESHOLD = 8;
+    // ...and the image regresses when more than this fraction of pixels differ
+    const double GOLDEN_MAX_MISMATCH = 0.005;
+
+    bool ParseInt(const char* text, int minValue, int& value)
+    {
+        char* end = nullptr;
+        long parsed = strtol(text, &end, 10);
+        if (end == text || *end != '\0' || parsed < minValue)
+            return false;
+        value = (int)parsed;
+        return true;
+    }
+
+    bool ParseDouble(const char* text, double& value)
+    {
+        char* end = nullptr;
+        double parsed = strtod(text, &end);
+        if (end == text || *end != '\0' || parsed < 0.0)
+            return false;
+        value = parsed;
+        return true;
+    }
+
+    // Escapes quotes and backslashes (e.g. Windows paths) for JSON strings
+    string JsonEscape(const string& text)
+    {
+        string escaped;
+        for (char c : text)
+        {
+            if (c == '"' || c == '\\')
+                escaped += '\\';
+            escaped += c;
+        }
+        return escaped;
+    }
+
+    double Percentile(const vector<double>& sorted, double fraction)
+    {
+        // Nearest-rank percentile on an already sorted series
+        size_t rank = (size_t)ceil(fraction * sorted.size());
+        if (rank > 0)
+            --rank;
+        return sorted[min(rank, sorted.size() - 1)];
+    }
+}
+
+
+bool UParseBenchArgs(int argc, char* argv[], BenchOptions& options)
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        const char* arg = argv[i];
+        const bool hasValue = i + 1 < argc;
+        int* intOption = nullptr;
+        int minValue = 1;
+
+        if (strcmp(arg, "--bench") == 0)
+            options.enabled = true;
+        else if (strcmp(arg, "--software") == 0)
+            options.software = true;
+        else if (strcmp(arg, "--width") == 0)
+            intOption = &options.width;
+        else if (strcmp(arg, "--height") == 0)
+            intOption = &options.height;
+        else if (strcmp(arg, "--frames") == 0)
+            intOption = &options.frames;
+        else if (strcmp(arg, "--warmup") == 0)
+        {
+            intOption = &options.warmup;
+            minValue = 0;
+        }
+        else if (strcmp(arg, "--copies") == 0)
+            intOption = &options.copies;
+        else if (strcmp(arg, "--update-baselines") == 0)
+            options.updateBaselines = true;
+        else if (strcmp(arg, "--tolerance") == 0)
+        {
+            if (!hasValue || !ParseDouble(argv[i + 1], options.tolerance))
+            {
+                cout << "Invalid value for " << arg << endl;
+                return false;
+            }
+            ++i;
+        }
+        else if (strcmp(arg, "--bench-out") == 0 || strcmp(arg, "--suite") == 0
+            || strcmp(arg, "--baseline") == 0 || strcmp(arg, "--golden") == 0)
+        {
+            if (!hasValue)
+            {
+                cout << "Missing value for " << arg << endl;
+                return false;
+            }
+
+            string& path = strcmp(arg, "--bench-out") == 0 ? options.outputPath
+                : strcmp(arg, "--suite") == 0 ? options.suiteDir
+                : strcmp(arg, "--baseline") == 0 ? options.baselinePath
+                : options.goldenPath;
+            path = argv[++i];
+        }
+
+        if (intOption)
+        {
+            if (!hasValue || !ParseInt(argv[i + 1], minValue, *intOption))
+            {
+                cout << "Invalid value for " << arg << endl;
+                return false;
+            }
+            ++i;
+        }
+    }
+
+    return true;
+}
+
+
+void UApplyBenchEnvironment(const BenchOptions& options)
+{
+    if (!options.software)
+        return;
+
+    // Mesa reads these when the context is created
+#ifdef _WIN32
+    _putenv_s("LIBGL_ALWAYS_SOFTWARE", "1");
+    _putenv_s("GALLIUM_DRIVER", "llvmpipe");
+#else
+    setenv("LIBGL_ALWAYS_SOFTWARE", "1", 1);
+    setenv("GALLIUM_DRIVER", "llvmpipe", 1);
+#endif
+}
+
+
+void UBenchCameraPose(int frame, int frameCount, Camera& camera)
+{
+    // One full revolution over the run, bobbing up and down twice
+    const float t = frameCount > 0 ? (float)frame / (float)frameCount : 0.0f;
+    const float angle = t * 2.0f * 3.14159265f;
+
+    glm::vec3 position(BENCH_ORBIT_TARGET.x + cos(angle) * BENCH_ORBIT_RADIUS,
+        BENCH_ORBIT_HEIGHT + sin(angle * 2.0f) * 1.5f,
+        BENCH_ORBIT_TARGET.z + sin(angle) * BENCH_ORBIT_RADIUS);
+
+    UCameraLookAt(camera, position, BENCH_ORBIT_TARGET);
+}
+
+
+void UCameraLookAt(Camera& camera, const glm::vec3& position, const glm::vec3& target)
+{
+    glm::vec3 direction = glm::normalize(target - position);
+
+    camera.Position = position;
+    camera.Pitch = glm::degrees(asin(direction.y));
+    camera.Yaw = glm::degrees(atan2(direction.z, direction.x));
+    camera.ProcessMouseMovement(0.0f, 0.0f); // recomputes Front/Right/Up from the new angles
+}
+
+
+vector<glm::vec3> UBuildCopyOffsets(int copies, float spacing)
+{
+    vector<glm::vec3> offsets;
+    offsets.reserve(copies);
+    offsets.push_back(glm::vec3(0.0f));
+
+    // Walk square rings of increasing radius around the original set
+    for (int ring = 1; (int)offsets.size() < copies; ++ring)
+    {
+        for (int z = -ring; z <= ring && (int)offsets.size() < copies; ++z)
+        {
+            for (int x = -ring; x <= ring && (int)offsets.size() < copies; ++x)
+            {
+                if (abs(x) != ring && abs(z) != ring)
+                    continue; // interior cells belong to smaller rings
+                offsets.push_back(glm::vec3(x * spacing, 0.0f, z * spacing));
+            }
+        }
+    }
+
+    return offsets;
+}
+
+
+BenchStats UComputeBenchStats(vector<double> samples)
+{
+    BenchStats stats;
+    if (samples.empty())
+        return stats;
+
+    sort(samples.begin(), samples.end());
+
+    double sum = 0.0;
+    for (double sample : samples)
+        sum += sample;
+
+    stats.min = samples.front();
+    stats.max = samples.back();
+    stats.mean = sum / samples.size();
+    stats.p50 = Percentile(samples, 0.50);
+    stats.p90 = Percentile(samples, 0.90);
+    stats.p95 = Percentile(samples, 0.95);
+    stats.p99 = Percentile(samples, 0.99);
+    return stats;
+}
+
+
+size_t UGetResidentMemoryBytes()
+{
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters;
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+        return counters.WorkingSetSize;
+    return 0;
+#else
+    ifstream statm("/proc/self/statm");
+    size_t totalPages = 0, residentPages = 0;
+    if (!(statm >> totalPages >> residentPages))
+        return 0;
+    return residentPages * (size_t)sysconf(_SC_PAGESIZE);
+#endif
+}
+
+
+void UWriteBenchReport(ostream& out, const BenchOptions& options, const char* renderer,
+    const BenchResult& result, const BenchCheck* check)
+{
+    BenchStats cpu = UComputeBenchStats(result.cpuMs);
+    BenchStats gpu = UComputeBenchStats(result.gpuMs);
+    BenchStats latency = UComputeBenchStats(result.latencyMs);
+    BenchStats occluded = UComputeBenchStats(result.occludedPerFrame);
+    BenchStats scale = UComputeBenchStats(result.resolutionScale);
+    BenchStats allocations = UComputeBenchStats(result.heapAllocations);
+    BenchStats glIssued = UComputeBenchStats(result.glIssued);
+    BenchStats glElided = UComputeBenchStats(result.glElided);
+    const double glCalls = glIssued.mean + glElided.mean;
+
+    double totalMs = 0.0;
+    for (double sample : result.cpuMs)
+        totalMs += sample;
+    const double seconds = totalMs / 1000.0;
+    const double fps = seconds > 0.0 ? result.cpuMs.size() / seconds : 0.0;
+
+    out << "{\n"
+        << "  \"variant\": \"" << result.variant << "\",\n"
+        << "  \"renderer\": \"" << JsonEscape(renderer ? renderer : "unknown") << "\",\n"
+        << "  \"width\": " << options.width << ",\n"
+        << "  \"height\": " << options.height << ",\n"
+        << "  \"frames\": " << result.cpuMs.size() << ",\n"
+        << "  \"warmup\": " << options.warmup << ",\n"
+        << "  \"frame_ms\": {"
+        << " \"min\": " << cpu.min
+        << ", \"mean\": " << cpu.mean
+        << ", \"p50\": " << cpu.p50
+        << ", \"p90\": " << cpu.p90
+        << ", \"p95\": " << cpu.p95
+        << ", \"p99\": " << cpu.p99
+        << ", \"max\": " << cpu.max << " },\n"
+        << "  \"gpu_ms\": {"
+        << " \"mean\": " << gpu.mean
+        << ", \"p50\": " << gpu.p50
+        << ", \"p95\": " << gpu.p95
+        << ", \"max\": " << gpu.max << " },\n"
+        << "  \"latency_ms\": {"
+        << " \"mean\": " << latency.mean
+        << ", \"p50\": " << latency.p50
+        << ", \"p95\": " << latency.p95
+        << ", \"max\": " << latency.max << " },\n"
+        << "  \"resident_mb\": " << result.residentMb << ",\n"
+        << "  \"draws_per_frame\": " << result.drawsPerFrame << ",\n"
+        << "  \"triangles_per_frame\": " << result.trianglesPerFrame << ",\n"
+        << "  \"instances\": { \"total\": " << result.instances
+        << ", \"visible\": " << result.instancesVisible
+        << ", \"culling\": \"" << (result.culling.empty() ? "none" : result.culling) << "\" },\n"
+        << "  \"occlusion\": {"
+        << " \"tested_frames\": " << result.occlusionFrames
+        << ", \"culled_mean\": " << occluded.mean
+        << ", \"culled_p50\": " << occluded.p50
+        << ", \"culled_max\": " << occluded.max << " },\n"
+        << "  \"resolution_scale\": {"
+        << " \"dynamic\": " << (result.resolutionScale.empty() ? "false" : "true")
+        << ", \"mean\": " << (result.resolutionScale.empty() ? 1.0 : scale.mean)
+        << ", \"min\": " << (result.resolutionScale.empty() ? 1.0 : scale.min)
+        << ", \"max\": " << (result.resolutionScale.empty() ? 1.0 : scale.max) << " },\n"
+        << "  \"frame_memory\": {"
+        << " \"heap_allocs_per_frame\": { \"mean\": " << allocations.mean
+        << ", \"max\": " << allocations.max << " }"
+        << ", \"zero_alloc_frames\": " << (allocations.max == 0.0 ? "true" : "false")
+        << ", \"arena_threads\": " << result.arenaThreads
+        << ", \"arena_high_water_kb\": " << result.arenaHighWaterBytes / 1024.0
+        << ", \"arena_capacity_kb\": " << result.arenaCapacityBytes / 1024.0 << " },\n"
+        << "  \"gl_state\": {"
+        << " \"issued_per_frame\": " << glIssued.mean
+        << ", \"elided_per_frame\": " << glElided.mean
+        << ", \"elided_fraction\": " << (glCalls > 0.0 ? glElided.mean / glCalls : 0.0) << " },\n"
+        << "  \"gpu_resources\": {"
+        << " \"textures\": " << result.textures
+        << ", \"meshes\": " << result.meshes
+        << ", \"texture_kb\": " << result.textureBytes / 1024.0
+        << ", \"mesh_kb\": " << result.meshBytes / 1024.0
+        << ", \"total_kb\": " << (result.textureBytes + result.meshBytes) / 1024.0
+        << ", \"peak_kb\": " << result.resourcePeakBytes / 1024.0
+        << ", \"budget_kb\": " << result.resourceBudgetBytes / 1024.0
+        << ", \"over_budget\": " << (result.resourceBudgetBytes && result.resourcePeakBytes > result.resourceBudgetBytes ? "true" : "false")
+        << ", \"dedup_hits\": " << result.resourceDedupHits << " },\n"
+        << "  \"throughput\": {"
+        << " \"fps\": " << fps
+        << ", \"draws_per_sec\": " << fps * result.drawsPerFrame
+        << ", \"mtriangles_per_sec\": " << fps * result.trianglesPerFrame / 1.0e6
+        << ", \"mpixels_per_sec\": " << fps * options.width * options.height / 1.0e6 << " }";
+
+    if (!result.softMs.empty())
+    {
+        BenchStats soft = UComputeBenchStats(result.softMs);
+        out << ",\n  \"soft_raster\": { \"threads\": " << result.softThreads
+            << ", \"frame_ms\": {"
+            << " \"mean\": " << soft.mean
+            << ", \"p50\": " << soft.p50
+            << ", \"p95\": " << soft.p95
+            << ", \"max\": " << soft.max << " }"
+            << ", \"speedup_vs_gl\": " << (soft.mean > 0.0 ? cpu.mean / soft.mean : 0.0)
+            << ", \"image_mismatch\": " << result.softMismatch
+            << ", \"image_psnr_db\": " << result.softPsnr
+            << ", \"matches_gl\": " << (result.softMatches ? "true" : "false") << " }";
+    }
+
+    if (!result.frameStages.empty())
+    {
+        // Speedups are relative to the first (single thread) entry
+        const FrameStageTiming& serial = result.frameStages.front();
+        out << ",\n  \"frame_prep\": { \"entities\": " << result.frameStageEntities
+            << ", \"visible\": " << result.frameStageVisible
+            << ", \"runs\": [";
+        for (size_t i = 0; i < result.frameStages.size(); ++i)
+        {
+            const FrameStageTiming& stage = result.frameStages[i];
+            const double total = stage.transformMs + stage.cullMs + stage.sortMs;
+            const double serialTotal = serial.transformMs + serial.cullMs + serial.sortMs;
+            out << (i ? "," : "") << "\n    { \"threads\": " << stage.threads
+                << ", \"transform_ms\": " << stage.transformMs
+                << ", \"cull_ms\": " << stage.cullMs
+                << ", \"sort_ms\": " << stage.sortMs
+                << ", \"total_ms\": " << total
+                << ", \"speedup\": {"
+                << " \"transform\": " << (stage.transformMs > 0.0 ? serial.transformMs / stage.transformMs : 0.0)
+                << ", \"cull\": " << (stage.cullMs > 0.0 ? serial.cullMs / stage.cullMs : 0.0)
+                << ", \"sort\": " << (stage.sortMs > 0.0 ? serial.sortMs / stage.sortMs : 0.0)
+                << ", \"total\": " << (total > 0.0 ? serialTotal / total : 0.0) << " } }";
+        }
+        out << "\n  ] }";
+    }
+
+    if (check)
+    {
+        out << ",\n  \"check\": { \"passed\": " << (check->passed ? "true" : "false")
+            << ", \"image_mismatch\": " << check->imageMismatch
+            << ", \"image_psnr_db\": " << check->imagePsnr
+            << ", \"failures\": [";
+        for (size_t i = 0; i < check->failures.size(); ++i)
+            out << (i ? ", " : " ") << "\"" << JsonEscape(check->failures[i]) << "\"";
+        out << (check->failures.empty() ? "" : " ") << "] }";
+    }
+
+    out << "\n}" << endl;
+}
+
+
+bool UWriteBaseline(const string& path, const BenchResult& result)
+{
+    ofstream out(path);
+    if (!out)
+    {
+        cout << "Failed to write baseline " << path << endl;
+        return false;
+    }
+
+    BenchStats cpu = UComputeBenchStats(result.cpuMs);
+    BenchStats gpu = UComputeBenchStats(result.gpuMs);
+
+    out << "# Niebla benchmark baseline, regenerate with --update-baselines\n"
+        << "variant " << result.variant << "\n"
+        << "cpu_ms_p50 " << cpu.p50 << "\n"
+        << "cpu_ms_p95 " << cpu.p95 << "\n"
+        << "gpu_ms_p50 " << gpu.p50 << "\n"
+        << "gpu_ms_p95 " << gpu.p95 << "\n"
+        << "resident_mb " << result.residentMb << "\n"
+        << "draws_per_frame " << result.drawsPerFrame << "\n"
+        << "triangles_per_frame " << result.trianglesPerFrame << "\n";
+    return true;
+}
+
+
+void UCompareBaseline(const string& path, const BenchResult& result, double tolerance, BenchCheck& check)
+{
+    ifstream in(path);
+    if (!in)
+    {
+        check.passed = false;
+        check.failures.push_back("missing baseline " + path);
+        return;
+    }
+
+    map<string, double> baseline;
+    string line;
+    while (getline(in, line))
+    {
+        if (line.empty() || line[0] == '#')
+            continue;
+        istringstream fields(line);
+        string key;
+        double value = 0.0;
+        if (fields >> key >> value)
+            baseline[key] = value;
+    }
+
+    BenchStats cpu = UComputeBenchStats(result.cpuMs);
+    BenchStats gpu = UComputeBenchStats(result.gpuMs);
+
+    // Lower is better for all of these; only slowdowns beyond the tolerance fail
+    const struct { const char* key; double value; double floor; } measured[] = {
+        { "cpu_ms_p50", cpu.p50, BASELINE_NOISE_FLOOR_MS },
+        { "cpu_ms_p95", cpu.p95, BASELINE_NOISE_FLOOR_MS },
+        { "gpu_ms_p50", gpu.p50, BASELINE_NOISE_FLOOR_MS },
+        { "gpu_ms_p95", gpu.p95, BASELINE_NOISE_FLOOR_MS },
+        { "resident_mb", result.residentMb, 1.0 },
+    };
+    for (const auto& metric : measured)
+    {
+        auto it = baseline.find(metric.key);
+        if (it == baseline.end())
+            continue;
+        const double limit = max(it->second * (1.0 + tolerance), it->second + metric.floor);
+        if (metric.value > limit)
+        {
+            ostringstream message;
+            message << metric.key << " " << metric.value << " exceeds baseline " << it->second;
+            check.failures.push_back(message.str());
+        }
+    }
+
+    // Work submitted must match exactly, otherwise the scene itself changed
+    const struct { const char* key; unsigned int value; } counted[] = {
+        { "draws_per_frame", result.drawsPerFrame },
+        { "triangles_per_frame", result.trianglesPerFrame },
+    };
+    for (const auto& metric : counted)
+    {
+        auto it = baseline.find(metric.key);
+        if (it != baseline.end() && (unsigned int)it->second != metric.value)
+        {
+            ostringstream message;
+            message << metric.key << " " << metric.value << " differs from baseline " << it->second;
+            check.failures.push_back(message.str());
+        }
+    }
+
+    if (!check.failures.empty())
+        check.passed = false;
+}
+
+
+bool UWriteGoldenImage(const string& path, const vector<unsigned char>& pixels, int width, int height)
+{
+    ofstream out(path, ios::binary);
+    if (!out)
+    {
+        cout << "Failed to write golden image " << path << endl;
+        return false;
+    }
+
+    out << "P6\n" << width << " " << height << "\n255\n";
+    vector<unsigned char> row(width * 3);
+    for (int y = height - 1; y >= 0; --y)
+    {
+        const unsigned char* src = &pixels[(size_t)y * width * 4];
+        for (int x = 0; x < width; ++x)
+        {
+            row[x * 3 + 0] = src[x * 4 + 0];
+            row[x * 3 + 1] = src[x * 4 + 1];
+            row[x * 3 + 2] = src[x * 4 + 2];
+        }
+        out.write(reinterpret_cast<const char*>(row.data()), row.size());
+    }
+    return true;
+}
+
+
+void UCompareGoldenImage(const string& path, const vector<unsigned char>& pixels, int width, int height,
+    BenchCheck& check)
+{
+    ifstream in(path, ios::binary);
+    string magic;
+    int goldenWidth = 0, goldenHeight = 0, maxValue = 0;
+    if (!in || !(in >> magic >> goldenWidth >> goldenHeight >> maxValue) || magic != "P6" || maxValue != 255)
+    {
+        check.passed = false;
+        check.failures.push_back("missing or unreadable golden image " + path);
+        return;
+    }
+    in.get(); // single whitespace byte before the pixel data
+
+    if (goldenWidth != width || goldenHeight != height)
+    {
+        check.passed = false;
+        check.failures.push_back("golden image " + path + " has a different resolution");
+        return;
+    }
+
+    vector<unsigned char> golden((size_t)width * height * 3);
+    if (!in.read(reinterpret_cast<char*>(golden.data()), golden.size()))
+    {
+        check.passed = false;
+        check.failures.push_back("golden image " + path + " is truncated");
+        return;
+    }
+
+    size_t mismatched = 0;
+    double squaredError = 0.0;
+    for (int y = 0; y < height; ++y)
+    {
+        const unsigned char* rendered = &pixels[(size_t)(height - 1 - y) * width * 4];
+        const unsigned char* expected = &golden[(size_t)y * width * 3];
+        for (int x = 0; x < width; ++x)
+        {
+            int worst = 0;
+            for (int c = 0; c < 3; ++c)
+            {
+                int diff = abs((int)rendered[x * 4 + c] - (int)expected[x * 3 + c]);
+                worst = max(worst, diff);
+                squaredError += diff * diff;
+            }
+            if (worst > GOLDEN_CHANNEL_THRESHOLD)
+                mismatched++;
+        }
+    }
+
+    const double pixelCount = (double)width * height;
+    const double mse = squaredError / (pixelCount * 3.0);
+    check.imageMismatch = mismatched / pixelCount;
+    check.imagePsnr = mse > 0.0 ? 10.0 * log10(255.0 * 255.0 / mse) : 99.0;
+
+    if (check.imageMismatch > GOLDEN_MAX_MISMATCH)
+    {
+        ostringstream message;
+        message << "image differs from golden in " << check.imageMismatch * 100.0 << "% of pixels";
+        check.failures.push_back(message.str());
+        check.passed = false;
+    }
+}
+
+
+bool UCompareFrames(const vector<unsigned char>& a, const vector<unsigned char>& b, int width, int height,
+    double& mismatch, double& psnr)
+{
+    size_t mismatched = 0;
+    double squaredError = 0.0;
+    const size_t pixelCount = (size_t)width * height;
+    for (size_t i = 0; i < pixelCount; ++i)
+    {
+        int worst = 0;
+        for (int c = 0; c < 3; ++c)
+        {
+            int diff = abs((int)a[i * 4 + c] - (int)b[i * 4 + c]);
+            worst = max(worst, diff);
+            squaredError += diff * diff;
+        }
+        if (worst > GOLDEN_CHANNEL_THRESHOLD)
+            mismatched++;
+    }
+
+    const double mse = squaredError / (pixelCount * 3.0);
+    mismatch = pixelCount ? mismatched / (double)pixelCount : 0.0;
+    psnr = mse > 0.0 ? 10.0 * log10(255.0 * 255.0 / mse) : 99.0;
+    return mismatch <= GOLDEN_MAX_MISMATCH;
+}
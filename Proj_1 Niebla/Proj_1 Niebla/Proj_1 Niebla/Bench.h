@@ -0,0 +1,169 @@
+///////////////////////////////////////////////////////////////////////////////
+// Bench.h
+// =======
+// Headless benchmark mode: command line options, the scripted camera path,
+// the JSON report printed at the end of a --bench run, and the regression
+// suite that compares runs against stored baselines and golden images.
+//
+// Usage:
+//   "Proj_1 Niebla" --bench [--width 1280] [--height 720] [--frames 300]
+//                   [--warmup 30] [--copies 1] [--software]
+//                   [--bench-out report.json]
+//                   [--baseline file.baseline] [--golden file.ppm]
+//                   [--tolerance 0.10] [--update-baselines]
+//                   [--soft-raster] (see SoftRaster.h)
+//   "Proj_1 Niebla" --bench --suite <dir> [--update-baselines]
+//
+// --software asks Mesa for its llvmpipe driver so the run works on hosts
+// without a GPU. The window is never shown, but a display connection is
+// still required (use xvfb-run on display-less Linux hosts).
+//
+// --suite runs the scene with 1, 10, 100 and 1000 copies of the book, ball,
+// candle and cable props and checks each variant against
+// <dir>/copies<N>.baseline and <dir>/copies<N>.ppm. With --update-baselines
+// the files are (re)written instead; commit them from the reference machine.
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include <GL/glew.h>        // GLboolean used by the camera
+#include <learnOpengl/camera.h> // Camera class
+
+struct BenchOptions
+{
+    bool enabled = false;
+    bool software = false;      // force the Mesa llvmpipe software rasterizer
+    int width = 1280;           // offscreen render resolution
+    int height = 720;
+    int frames = 300;           // measured frames
+    int warmup = 30;            // frames rendered before measuring starts
+    int copies = 1;             // copies of the prop set (book, ball, candle, cables)
+    std::string outputPath;     // JSON report file, stdout when empty
+
+    // regression checks
+    std::string suiteDir;       // runs every scene variant against files in this directory
+    std::string baselinePath;   // single run: metrics baseline to compare with
+    std::string goldenPath;     // single run: golden image to compare with
+    bool updateBaselines = false;   // write baselines/goldens instead of comparing
+    double tolerance = 0.10;    // allowed relative slowdown before a metric regresses
+};
+
+// Summary of a series of per-frame samples (timings are in milliseconds)
+struct BenchStats
+{
+    double min = 0.0;
+    double max = 0.0;
+    double mean = 0.0;
+    double p50 = 0.0;
+    double p90 = 0.0;
+    double p95 = 0.0;
+    double p99 = 0.0;
+};
+
+// Median time of each frame preparation stage (see FramePrep.h) on one job thread count
+struct FrameStageTiming
+{
+    int threads = 1;
+    double transformMs = 0.0;
+    double cullMs = 0.0;
+    double sortMs = 0.0;
+};
+
+// Everything measured during one benchmark run
+struct BenchResult
+{
+    std::string variant;            // e.g. "copies100"
+    std::vector<double> cpuMs;      // wall time per frame including glFinish
+    std::vector<double> gpuMs;      // GL_TIME_ELAPSED per frame
+    std::vector<double> latencyMs;  // input sampled to GPU done per frame
+    unsigned int drawsPerFrame = 0;
+    unsigned int trianglesPerFrame = 0;
+    double residentMb = 0.0;        // process resident set after the run
+    std::string culling;            // stress scene culling: "" for none, "gpu"
+    unsigned int instances = 0;     // generated stress scene instances
+    unsigned int instancesVisible = 0;  // instances drawn in the last frame
+    std::vector<double> occludedPerFrame;   // instances rejected by Hi-Z in each measured frame
+    unsigned int occlusionFrames = 0;   // measured frames that ran the Hi-Z test
+    std::vector<double> resolutionScale;    // dynamic resolution scale of each measured frame
+    std::vector<double> heapAllocations;    // operator new calls during each measured frame
+    int arenaThreads = 0;                   // frame arenas, one per job thread
+    size_t arenaHighWaterBytes = 0;         // most bytes any frame took from them, summed
+    size_t arenaCapacityBytes = 0;
+    std::vector<double> glIssued;           // state calls the GL state cache made in each measured frame
+    std::vector<double> glElided;           // and the ones it skipped as redundant
+
+    // Textures and meshes in the resource registry (see Resources.h), estimated video memory
+    int textures = 0;
+    int meshes = 0;
+    size_t textureBytes = 0;
+    size_t meshBytes = 0;
+    size_t resourcePeakBytes = 0;
+    size_t resourceBudgetBytes = 0;         // 0: no budget
+    unsigned long long resourceDedupHits = 0;
+
+    // --soft-raster: the same frames drawn by the CPU rasterizer
+    std::vector<double> softMs;     // render time per frame
+    int softThreads = 0;
+    double softMismatch = 0.0;      // first frame vs. GL, fraction of pixels outside the golden threshold
+    double softPsnr = 0.0;
+    bool softMatches = false;
+
+    // Frame preparation stages on 1, 2, 4, 8 and 16 job threads
+    std::vector<FrameStageTiming> frameStages;
+    unsigned int frameStageEntities = 0;
+    unsigned int frameStageVisible = 0;
+};
+
+// Outcome of comparing a result with its baseline and golden image
+struct BenchCheck
+{
+    bool passed = true;
+    std::vector<std::string> failures;
+    double imageMismatch = 0.0;     // fraction of pixels outside the per-channel threshold
+    double imagePsnr = 0.0;         // dB, 0 when no image was compared
+};
+
+// Fills options from argv, returns false (after printing why) on bad input
+bool UParseBenchArgs(int argc, char* argv[], BenchOptions& options);
+
+// Must run before glfwInit: selects the software GL driver when requested
+void UApplyBenchEnvironment(const BenchOptions& options);
+
+// Places the camera on a fixed orbit around the scene for the given frame
+void UBenchCameraPose(int frame, int frameCount, Camera& camera);
+
+// Points the camera at target, keeping the Euler angles consistent
+void UCameraLookAt(Camera& camera, const glm::vec3& position, const glm::vec3& target);
+
+// World offsets of the prop copies: copy 0 stays in place, the rest fill square rings around it
+std::vector<glm::vec3> UBuildCopyOffsets(int copies, float spacing);
+
+BenchStats UComputeBenchStats(std::vector<double> samples);
+
+// Resident memory of this process in bytes, 0 if unavailable
+size_t UGetResidentMemoryBytes();
+
+// Writes the benchmark report as a single JSON object
+void UWriteBenchReport(std::ostream& out, const BenchOptions& options, const char* renderer,
+    const BenchResult& result, const BenchCheck* check);
+
+// Metrics baselines are "key value" text files
+bool UWriteBaseline(const std::string& path, const BenchResult& result);
+void UCompareBaseline(const std::string& path, const BenchResult& result, double tolerance, BenchCheck& check);
+
+// Golden images are binary PPM (P6) files stored top row first.
+// pixels are RGBA8 rows as returned by glReadPixels (bottom row first).
+bool UWriteGoldenImage(const std::string& path, const std::vector<unsigned char>& pixels, int width, int height);
+void UCompareGoldenImage(const std::string& path, const std::vector<unsigned char>& pixels, int width, int height,
+    BenchCheck& check);
+
+// Compares two RGBA8 frames of the same size with the golden image thresholds; true when they match
+bool UCompareFrames(const std::vector<unsigned char>& a, const std::vector<unsigned char>& b, int width, int height,
+    double& mismatch, double& psnr);
+
+#endif
@@ -0,0 +1,533 @@
+#include "Capture.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+#include "GLState.h"
+#include "GpuStorage.h"
+
+using namespace std;
+
+namespace
+{
+    const size_t MAX_STORED_BLOCK = 65535;  // largest deflate stored block
+
+    struct CrcTable
+    {
+        uint32_t values[256];
+
+        CrcTable()
+        {
+            for (uint32_t n = 0; n < 256; ++n)
+            {
+                uint32_t c = n;
+                for (int k = 0; k < 8; ++k)
+                    c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+                values[n] = c;
+            }
+        }
+    };
+
+    uint32_t Crc32(uint32_t crc, const unsigned char* data, size_t size)
+    {
+        static const CrcTable table;
+
+        crc = ~crc;
+        for (size_t i = 0; i < size; ++i)
+            crc = table.values[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+        return ~crc;
+    }
+
+    uint32_t Adler32(uint32_t adler, const unsigned char* data, size_t size)
+    {
+        const uint32_t MOD = 65521;
+        uint32_t a = adler & 0xFFFF;
+        uint32_t b = adler >> 16;
+        while (size > 0)
+        {
+            // 5552 bytes is the most that can be summed before b could overflow 32 bits
+            const size_t n = min(size, (size_t)5552);
+            for (size_t i = 0; i < n; ++i)
+            {
+                a += data[i];
+                b += a;
+            }
+            a %= MOD;
+            b %= MOD;
+            data += n;
+            size -= n;
+        }
+        return (b << 16) | a;
+    }
+
+    void PutBigEndian(vector<unsigned char>& out, uint32_t value)
+    {
+        out.push_back((unsigned char)(value >> 24));
+        out.push_back((unsigned char)(value >> 16));
+        out.push_back((unsigned char)(value >> 8));
+        out.push_back((unsigned char)value);
+    }
+
+    void WriteChunk(ostream& out, const char* type, const vector<unsigned char>& data)
+    {
+        vector<unsigned char> header;
+        PutBigEndian(header, (uint32_t)data.size());
+        header.insert(header.end(), type, type + 4);
+
+        uint32_t crc = Crc32(0, header.data() + 4, 4);
+        crc = Crc32(crc, data.data(), data.size());
+        vector<unsigned char> footer;
+        PutBigEndian(footer, crc);
+
+        out.write(reinterpret_cast<const char*>(header.data()), header.size());
+        out.write(reinterpret_cast<const char*>(data.data()), data.size());
+        out.write(reinterpret_cast<const char*>(footer.data()), footer.size());
+    }
+
+    // Full range BT.601 4:2:0 planes (the C420jpeg layout), chroma averaged over 2x2 pixels
+    void WriteY4mFrame(ostream& out, const vector<unsigned char>& rgb, int width, int height)
+    {
+        const int chromaWidth = (width + 1) / 2;
+        const int chromaHeight = (height + 1) / 2;
+        vector<unsigned char> y((size_t)width * height);
+        vector<unsigned char> cb((size_t)chromaWidth * chromaHeight);
+        vector<unsigned char> cr((size_t)chromaWidth * chromaHeight);
+
+        for (size_t i = 0; i < y.size(); ++i)
+        {
+            const unsigned char* p = &rgb[i * 3];
+            y[i] = (unsigned char)(0.299f * p[0] + 0.587f * p[1] + 0.114f * p[2] + 0.5f);
+        }
+
+        for (int cy = 0; cy < chromaHeight; ++cy)
+        {
+            for (int cx = 0; cx < chromaWidth; ++cx)
+            {
+                float r = 0.0f, g = 0.0f, b = 0.0f;
+                int count = 0;
+                for (int dy = 0; dy < 2; ++dy)
+                {
+                    for (int dx = 0; dx < 2; ++dx)
+                    {
+                        const int px = cx * 2 + dx;
+                        const int py = cy * 2 + dy;
+                        if (px >= width || py >= height)
+                            continue;
+                        const unsigned char* p = &rgb[((size_t)py * width + px) * 3];
+                        r += p[0];
+                        g += p[1];
+                        b += p[2];
+                        count++;
+                    }
+                }
+                r /= count;
+                g /= count;
+                b /= count;
+                const size_t i = (size_t)cy * chromaWidth + cx;
+                cb[i] = (unsigned char)min(255.0f, max(0.0f, 128.0f - 0.168736f * r - 0.331264f * g + 0.5f * b + 0.5f));
+                cr[i] = (unsigned char)min(255.0f, max(0.0f, 128.0f + 0.5f * r - 0.418688f * g - 0.081312f * b + 0.5f));
+            }
+        }
+
+        out << "FRAME\n";
+        out.write(reinterpret_cast<const char*>(y.data()), y.size());
+        out.write(reinterpret_cast<const char*>(cb.data()), cb.size());
+        out.write(reinterpret_cast<const char*>(cr.data()), cr.size());
+    }
+
+    bool EndsWith(const string& text, const char* suffix)
+    {
+        const size_t n = strlen(suffix);
+        return text.size() >= n && text.compare(text.size() - n, n, suffix) == 0;
+    }
+}
+
+
+bool UParseCaptureArgs(int argc, char* argv[], CaptureOptions& options)
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        const char* arg = argv[i];
+        if (strncmp(arg, "--capture", 9) != 0)
+            continue;
+        if (i + 1 >= argc)
+        {
+            cout << "Missing value for " << arg << endl;
+            return false;
+        }
+
+        const char* value = argv[++i];
+        char* end = nullptr;
+        if (strcmp(arg, "--capture") == 0)
+            options.path = value;
+        else if (strcmp(arg, "--capture-frames") == 0)
+            options.frames = (int)strtol(value, &end, 10);
+        else if (strcmp(arg, "--capture-fps") == 0)
+            options.fps = (int)strtol(value, &end, 10);
+        else
+        {
+            cout << "Unknown option " << arg << endl;
+            return false;
+        }
+
+        if (end && (*end != '\0' || end == value))
+        {
+            cout << "Invalid value for " << arg << endl;
+            return false;
+        }
+    }
+
+    if (options.frames < 0 || options.fps < 1)
+    {
+        cout << "Invalid capture options" << endl;
+        return false;
+    }
+
+    if (EndsWith(options.path, ".raw"))
+        options.format = CAPTURE_RAW;
+    else if (EndsWith(options.path, ".y4m"))
+        options.format = CAPTURE_Y4M;
+    else if (options.path.empty() || EndsWith(options.path, ".png"))
+        options.format = CAPTURE_PNG;
+    else
+    {
+        cout << "--capture must name a .png, .raw or .y4m file" << endl;
+        return false;
+    }
+
+    return true;
+}
+
+
+bool UWritePng(const string& path, const unsigned char* rgb, int width, int height)
+{
+    ofstream out(path, ios::binary);
+    if (!out)
+    {
+        cout << "Failed to write " << path << endl;
+        return false;
+    }
+
+    static const unsigned char SIGNATURE[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+    out.write(reinterpret_cast<const char*>(SIGNATURE), sizeof(SIGNATURE));
+
+    vector<unsigned char> header;
+    PutBigEndian(header, (uint32_t)width);
+    PutBigEndian(header, (uint32_t)height);
+    header.push_back(8);    // bit depth
+    header.push_back(2);    // color type: RGB
+    header.push_back(0);    // deflate
+    header.push_back(0);    // adaptive filtering
+    header.push_back(0);    // no interlace
+    WriteChunk(out, "IHDR", header);
+
+    // Scanlines, each behind a filter type byte of 0 (none)
+    const size_t rowBytes = (size_t)width * 3;
+    vector<unsigned char> scanlines;
+    scanlines.reserve((rowBytes + 1) * height);
+    for (int y = 0; y < height; ++y)
+    {
+        scanlines.push_back(0);
+        scanlines.insert(scanlines.end(), rgb + y * rowBytes, rgb + (y + 1) * rowBytes);
+    }
+
+    // zlib stream of stored deflate blocks
+    vector<unsigned char> data;
+    data.reserve(scanlines.size() + scanlines.size() / MAX_STORED_BLOCK * 5 + 16);
+    data.push_back(0x78);
+    data.push_back(0x01);
+    size_t offset = 0;
+    do
+    {
+        const size_t size = min(MAX_STORED_BLOCK, scanlines.size() - offset);
+        const bool last = offset + size == scanlines.size();
+        data.push_back(last ? 1 : 0);
+        data.push_back((unsigned char)size);
+        data.push_back((unsigned char)(size >> 8));
+        data.push_back((unsigned char)~size);
+        data.push_back((unsigned char)(~size >> 8));
+        data.insert(data.end(), scanlines.begin() + offset, scanlines.begin() + offset + size);
+        offset += size;
+    } while (offset < scanlines.size());
+    PutBigEndian(data, Adler32(1, scanlines.data(), scanlines.size()));
+    WriteChunk(out, "IDAT", data);
+
+    WriteChunk(out, "IEND", vector<unsigned char>());
+    return (bool)out;
+}
+
+
+void URgbaToRgbTopDown(const vector<unsigned char>& rgba, int width, int height, vector<unsigned char>& rgb)
+{
+    rgb.resize((size_t)width * height * 3);
+    for (int y = 0; y < height; ++y)
+    {
+        const unsigned char* src = &rgba[(size_t)(height - 1 - y) * width * 4];
+        unsigned char* dst = &rgb[(size_t)y * width * 3];
+        for (int x = 0; x < width; ++x)
+        {
+            dst[x * 3 + 0] = src[x * 4 + 0];
+            dst[x * 3 + 1] = src[x * 4 + 1];
+            dst[x * 3 + 2] = src[x * 4 + 2];
+        }
+    }
+}
+
+
+string UNextScreenshotPath()
+{
+    for (int n = 1; ; ++n)
+    {
+        char name[32];
+        snprintf(name, sizeof(name), "screenshot_%04d.png", n);
+        if (!ifstream(name))
+            return name;
+    }
+}
+
+
+bool FrameCapture::start(const CaptureOptions& options)
+{
+    stop();
+    this->options = options;
+
+    if (!options.path.empty() && options.format != CAPTURE_PNG)
+    {
+        stream.open(options.path, ios::binary);
+        if (!stream)
+        {
+            cout << "Failed to open capture output " << options.path << endl;
+            return false;
+        }
+    }
+
+    stopping = false;
+    worker = thread(&FrameCapture::encodeLoop, this);
+    started = true;
+    return true;
+}
+
+
+void FrameCapture::stop()
+{
+    if (!started)
+        return;
+
+    // Everything already read back still gets written
+    while (pending > 0)
+        finishOldest(true);
+    resize(0, 0);
+
+    {
+        lock_guard<mutex> lock(jobMutex);
+        stopping = true;
+    }
+    wake.notify_one();
+    worker.join();
+    stream.close();
+    started = false;
+
+    if (framesRead > 0)
+        cout << "INFO: Captured " << framesWritten << " frames to " << options.path << " (" << dropped
+            << " dropped), " << renderThreadMs / framesRead << " ms per frame on the render thread, "
+            << (framesWritten ? encodeMs / framesWritten : 0.0) << " ms encoding" << endl;
+}
+
+
+void FrameCapture::readFrame(GLuint framebuffer, int width, int height, bool stream, const string& screenshotPath)
+{
+    const auto start = chrono::steady_clock::now();
+
+    if (width != this->width || height != this->height)
+        resize(width, height);
+
+    // All buffers still in flight: wait for the oldest rather than lose a frame
+    if (pending == RING_SIZE)
+        finishOldest(true);
+
+    Readback& readback = ring[head];
+    readback.stream = stream;
+    readback.screenshotPath = screenshotPath;
+
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+    glReadBuffer(framebuffer ? GL_COLOR_ATTACHMENT0 : GL_BACK);
+    UGLState().bindBuffer(GL_PIXEL_PACK_BUFFER, readback.pbo);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);  // into the buffer, returns at once
+    UGLState().bindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+    readback.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+    head = (head + 1) % RING_SIZE;
+    pending++;
+    if (stream)
+        framesRead++;
+
+    renderThreadMs += chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+}
+
+
+void FrameCapture::collect()
+{
+    const auto start = chrono::steady_clock::now();
+    const int before = pending;
+
+    while (pending > 0)
+    {
+        const Readback& oldest = ring[(head - pending + RING_SIZE) % RING_SIZE];
+        const GLenum status = glClientWaitSync(oldest.fence, 0, 0);
+        if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+            break;
+        finishOldest(false);
+    }
+
+    if (pending != before)
+        renderThreadMs += chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+}
+
+
+bool FrameCapture::isStreaming() const
+{
+    return started && !options.path.empty() && (options.frames == 0 || framesRead < options.frames);
+}
+
+
+// (Re)creates the ring for a new frame size; 0x0 just releases it
+void FrameCapture::resize(int width, int height)
+{
+    while (pending > 0)
+        finishOldest(true);
+
+    for (Readback& readback : ring)
+    {
+        if (readback.pbo)
+            UGLState().deleteBuffers(1, &readback.pbo);
+        readback = Readback();
+    }
+    head = 0;
+    this->width = width;
+    this->height = height;
+    if (width == 0 || height == 0)
+        return;
+
+    // Only ever mapped for reading; client storage hints at memory the CPU reads fast
+    for (Readback& readback : ring)
+        readback.pbo = UCreateImmutableBuffer((GLsizeiptr)width * height * 4, nullptr, GL_MAP_READ_BIT | GL_CLIENT_STORAGE_BIT);
+}
+
+
+// Maps the oldest readback, copies it out and queues it for the encoder
+void FrameCapture::finishOldest(bool wait)
+{
+    Readback& readback = ring[(head - pending + RING_SIZE) % RING_SIZE];
+    if (wait)
+        glClientWaitSync(readback.fence, GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+    glDeleteSync(readback.fence);
+    readback.fence = 0;
+    pending--;
+
+    Job job;
+    job.width = width;
+    job.height = height;
+    job.stream = readback.stream;
+    job.screenshotPath = readback.screenshotPath;
+
+    // A backed up encoder drops stream frames, never screenshots
+    bool queued;
+    {
+        lock_guard<mutex> lock(jobMutex);
+        queued = jobs.size() < MAX_QUEUED || !job.screenshotPath.empty();
+    }
+    if (!queued)
+    {
+        dropped++;
+        return;
+    }
+
+    const size_t size = (size_t)width * height * 4;
+    UGLState().bindBuffer(GL_PIXEL_PACK_BUFFER, readback.pbo);
+    const void* mapped = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, size, GL_MAP_READ_BIT);
+    if (mapped)
+    {
+        const unsigned char* bytes = static_cast<const unsigned char*>(mapped);
+        job.pixels.assign(bytes, bytes + size);
+        glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    }
+    UGLState().bindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    if (!mapped)
+    {
+        dropped++;
+        return;
+    }
+
+    {
+        lock_guard<mutex> lock(jobMutex);
+        jobs.push_back(move(job));
+    }
+    wake.notify_one();
+}
+
+
+void FrameCapture::encodeLoop()
+{
+    for (;;)
+    {
+        Job job;
+        {
+            unique_lock<mutex> lock(jobMutex);
+            wake.wait(lock, [this]() { return stopping || !jobs.empty(); });
+            if (jobs.empty())
+                return;
+            job = move(jobs.front());
+            jobs.pop_front();
+        }
+
+        const auto start = chrono::steady_clock::now();
+        encode(job);
+        if (job.stream)
+            encodeMs += chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    }
+}
+
+
+void FrameCapture::encode(const Job& job)
+{
+    vector<unsigned char> rgb;
+    URgbaToRgbTopDown(job.pixels, job.width, job.height, rgb);
+
+    if (!job.screenshotPath.empty() && UWritePng(job.screenshotPath, rgb.data(), job.width, job.height))
+        cout << "INFO: Saved " << job.screenshotPath << endl;
+    if (!job.stream)
+        return;
+
+    // Raw and y4m streams keep the size of their first frame, frames of another size are skipped
+    if (framesWritten == 0)
+    {
+        streamWidth = job.width;
+        streamHeight = job.height;
+        if (options.format == CAPTURE_Y4M)
+            stream << "YUV4MPEG2 W" << streamWidth << " H" << streamHeight << " F" << options.fps
+                << ":1 Ip A1:1 C420jpeg\n";
+    }
+    if (options.format != CAPTURE_PNG && (job.width != streamWidth || job.height != streamHeight))
+        return;
+
+    framesWritten++;
+    if (options.format == CAPTURE_PNG)
+    {
+        // out.png -> out_00001.png
+        char number[16];
+        snprintf(number, sizeof(number), "_%05d", framesWritten);
+        const string base = options.path.substr(0, options.path.size() - 4);
+        UWritePng(base + number + ".png", rgb.data(), job.width, job.height);
+    }
+    else if (options.format == CAPTURE_RAW)
+        stream.write(reinterpret_cast<const char*>(rgb.data()), rgb.size());
+    else
+        WriteY4mFrame(stream, rgb, job.width, job.height);
+}
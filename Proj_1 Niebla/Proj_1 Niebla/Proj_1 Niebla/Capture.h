@@ -0,0 +1,139 @@
+///////////////////////////////////////////////////////////////////////////////
+// Capture.h
+// =========
+// Frame capture and screenshots without stalling the render loop. The
+// frame is read into one of a ring of pixel pack buffers right before the
+// swap; the copy runs on the GPU and the buffer is mapped a couple of
+// frames later, once its fence has signaled. Encoding and file writes run
+// on a worker thread.
+//
+// --capture writes every rendered frame, picking the format by extension:
+//   .png   numbered image sequence, out.png -> out_00001.png, ...
+//   .raw   one stream of top-down RGB24 frames, e.g. for
+//          ffmpeg -f rawvideo -pix_fmt rgb24 -s WxH -i out.raw
+//   .y4m   YUV4MPEG2 4:2:0 video
+// F12 saves the next frame to screenshot_NNNN.png.
+//
+// PNGs are written with stored (uncompressed) deflate blocks, which keeps
+// encoding fast enough for full frame rate; recompress them offline. The
+// render thread cost is printed when the program exits.
+//
+// Usage:
+//   "Proj_1 Niebla" --capture out.y4m [--capture-frames 600] [--capture-fps 60]
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef CAPTURE_H
+#define CAPTURE_H
+
+#include <condition_variable>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <GL/glew.h>
+
+enum CaptureFormat
+{
+    CAPTURE_PNG,
+    CAPTURE_RAW,
+    CAPTURE_Y4M
+};
+
+struct CaptureOptions
+{
+    std::string path;           // empty: screenshots only
+    CaptureFormat format = CAPTURE_PNG;     // from the extension of path
+    int frames = 0;             // frames to capture, 0 until exit
+    int fps = 60;               // frame rate stored in .y4m headers
+};
+
+bool UParseCaptureArgs(int argc, char* argv[], CaptureOptions& options);
+
+// Writes an 8-bit RGB PNG; rgb holds height rows of width pixels, top row first
+bool UWritePng(const std::string& path, const unsigned char* rgb, int width, int height);
+
+// Converts a glReadPixels RGBA image (bottom row first) to RGB, top row first
+void URgbaToRgbTopDown(const std::vector<unsigned char>& rgba, int width, int height, std::vector<unsigned char>& rgb);
+
+// First screenshot_NNNN.png in the working directory that doesn't exist yet
+std::string UNextScreenshotPath();
+
+class FrameCapture
+{
+public:
+    ~FrameCapture() { stop(); }
+
+    // Opens the output and starts the encoder thread
+    bool start(const CaptureOptions& options);
+
+    // Finishes pending readbacks and encodes, releases the buffers and prints the cost
+    void stop();
+
+    // Starts reading framebuffer's color (the back buffer for 0) into the ring: as the
+    // next stream frame when stream is set, as a PNG when screenshotPath is given
+    void readFrame(GLuint framebuffer, int width, int height, bool stream, const std::string& screenshotPath);
+
+    // Hands readbacks the GPU has finished to the encoder, call once per loop
+    void collect();
+
+    // A --capture stream is running and has frames left
+    bool isStreaming() const;
+
+private:
+    struct Readback
+    {
+        GLuint pbo = 0;
+        GLsync fence = 0;
+        bool stream = false;
+        std::string screenshotPath;
+    };
+
+    struct Job
+    {
+        std::vector<unsigned char> pixels;  // RGBA, bottom row first
+        int width = 0;
+        int height = 0;
+        bool stream = false;
+        std::string screenshotPath;
+    };
+
+    static const int RING_SIZE = 3;
+    static const size_t MAX_QUEUED = 16;    // stream frames waiting for the encoder before new ones are dropped
+
+    void resize(int width, int height);
+    void finishOldest(bool wait);
+    void encodeLoop();
+    void encode(const Job& job);
+
+    CaptureOptions options;
+    bool started = false;
+
+    // render thread
+    Readback ring[RING_SIZE];
+    int head = 0;
+    int pending = 0;
+    int width = 0;
+    int height = 0;
+    int framesRead = 0;
+    int dropped = 0;
+    double renderThreadMs = 0.0;
+
+    // shared with the encoder thread
+    std::thread worker;
+    std::mutex jobMutex;
+    std::condition_variable wake;
+    std::deque<Job> jobs;
+    bool stopping = false;
+
+    // encoder thread
+    std::ofstream stream;
+    int streamWidth = 0;
+    int streamHeight = 0;
+    int framesWritten = 0;
+    double encodeMs = 0.0;
+};
+
+#endif
@@ -0,0 +1,176 @@
+#include "DynamicRes.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+using namespace std;
+
+namespace
+{
+    const float SCALE_STEP_DOWN = 0.85f;    // largest drop per adjustment
+    const float SCALE_STEP_UP = 1.10f;      // largest rise per adjustment, slower to avoid oscillation
+    const double RAISE_HEADROOM = 0.85;     // only scale up when under this fraction of the budget
+    const float MIN_CHANGE = 0.02f;         // ignore adjustments smaller than this
+}
+
+
+bool UParseDynResArgs(int argc, char* argv[], DynResOptions& options)
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        const char* arg = argv[i];
+        if (strcmp(arg, "--dynres") == 0)
+        {
+            options.enabled = true;
+            continue;
+        }
+        if (strncmp(arg, "--dynres-", 9) != 0)
+            continue;
+        if (i + 1 >= argc)
+        {
+            cout << "Missing value for " << arg << endl;
+            return false;
+        }
+
+        const char* value = argv[++i];
+        char* end = nullptr;
+        if (strcmp(arg, "--dynres-target") == 0)
+            options.targetMs = strtof(value, &end);
+        else if (strcmp(arg, "--dynres-min") == 0)
+            options.minScale = strtof(value, &end);
+        else if (strcmp(arg, "--dynres-max") == 0)
+            options.maxScale = strtof(value, &end);
+        else if (strcmp(arg, "--dynres-interval") == 0)
+            options.interval = (int)strtol(value, &end, 10);
+        else if (strcmp(arg, "--dynres-filter") == 0)
+        {
+            if (strcmp(value, "bilinear") == 0)
+                options.filter = UPSCALE_BILINEAR;
+            else if (strcmp(value, "sharpen") == 0)
+                options.filter = UPSCALE_SHARPEN;
+            else
+            {
+                cout << "--dynres-filter must be bilinear or sharpen" << endl;
+                return false;
+            }
+        }
+        else
+        {
+            cout << "Unknown option " << arg << endl;
+            return false;
+        }
+
+        if (end && (*end != '\0' || end == value))
+        {
+            cout << "Invalid value for " << arg << endl;
+            return false;
+        }
+    }
+
+    if (options.targetMs <= 0.0f || options.interval < 1 || options.minScale <= 0.0f
+        || options.maxScale > 1.0f || options.minScale > options.maxScale)
+    {
+        cout << "Invalid dynamic resolution options" << endl;
+        return false;
+    }
+
+    return true;
+}
+
+
+ResolutionController::ResolutionController(const DynResOptions& options)
+    : options(options), scale(options.maxScale)
+{
+}
+
+
+bool ResolutionController::addSample(double frameMs)
+{
+    sumMs += frameMs;
+    if (++samples < options.interval)
+        return false;
+
+    const double averageMs = sumMs / samples;
+    sumMs = 0.0;
+    samples = 0;
+    if (averageMs <= 0.0)
+        return false;
+
+    // Inside the band between the headroom and the budget: keep the current scale
+    if (averageMs < options.targetMs && averageMs > options.targetMs * RAISE_HEADROOM)
+        return false;
+
+    // Pixel cost grows with the square of the scale
+    float desired = scale * (float)sqrt(options.targetMs / averageMs);
+    desired = min(max(desired, scale * SCALE_STEP_DOWN), scale * SCALE_STEP_UP);
+    desired = min(max(desired, options.minScale), options.maxScale);
+
+    if (fabs(desired - scale) < MIN_CHANGE)
+        return false;
+
+    scale = desired;
+    return true;
+}
+
+
+int ResolutionController::scaledSize(int size) const
+{
+    return max(1, (int)(size * scale + 0.5f));
+}
+
+
+void GpuFrameTimer::create()
+{
+    destroy();
+    glGenQueries(FRAMES * 2, &queries[0][0]);
+}
+
+
+void GpuFrameTimer::destroy()
+{
+    if (queries[0][0])
+        glDeleteQueries(FRAMES * 2, &queries[0][0]);
+    *this = GpuFrameTimer();
+}
+
+
+void GpuFrameTimer::begin()
+{
+    // A full ring drops its oldest unread pair
+    if (pending == FRAMES)
+        pending--;
+    glQueryCounter(queries[head][0], GL_TIMESTAMP);
+}
+
+
+void GpuFrameTimer::end()
+{
+    glQueryCounter(queries[head][1], GL_TIMESTAMP);
+    head = (head + 1) % FRAMES;
+    pending++;
+}
+
+
+bool GpuFrameTimer::poll(double& frameMs)
+{
+    if (pending == 0)
+        return false;
+
+    const int oldest = (head - pending + FRAMES) % FRAMES;
+    GLint available = 0;
+    glGetQueryObjectiv(queries[oldest][1], GL_QUERY_RESULT_AVAILABLE, &available);
+    if (!available)
+        return false;
+
+    GLuint64 start = 0;
+    GLuint64 end = 0;
+    glGetQueryObjectui64v(queries[oldest][0], GL_QUERY_RESULT, &start);
+    glGetQueryObjectui64v(queries[oldest][1], GL_QUERY_RESULT, &end);
+    pending--;
+
+    frameMs = (end - start) / 1.0e6;
+    return true;
+}
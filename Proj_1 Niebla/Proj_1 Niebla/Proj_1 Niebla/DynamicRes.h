@@ -0,0 +1,84 @@
+///////////////////////////////////////////////////////////////////////////////
+// DynamicRes.h
+// ============
+// Dynamic resolution scaling: the 3D scene is rendered offscreen at a
+// fraction of the output size, and a controller adjusts that fraction every
+// few frames so the GPU frame time stays within a budget. The scene is then
+// upscaled to the window (or the benchmark target) with a bilinear or a
+// sharpening filter.
+//
+// GPU time is measured with timestamp queries that are read a few frames
+// later, so the controller never stalls the pipeline.
+//
+// Usage:
+//   "Proj_1 Niebla" --dynres [--dynres-target 16.6] [--dynres-min 0.5]
+//                   [--dynres-max 1.0] [--dynres-interval 8]
+//                   [--dynres-filter bilinear|sharpen]
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef DYNAMIC_RES_H
+#define DYNAMIC_RES_H
+
+#include <GL/glew.h>
+
+enum UpscaleFilter
+{
+    UPSCALE_BILINEAR,
+    UPSCALE_SHARPEN
+};
+
+struct DynResOptions
+{
+    bool enabled = false;
+    float targetMs = 16.6f;     // GPU frame time budget
+    float minScale = 0.5f;      // smallest fraction of the output width/height
+    float maxScale = 1.0f;
+    int interval = 8;           // frames averaged between adjustments
+    UpscaleFilter filter = UPSCALE_BILINEAR;
+};
+
+bool UParseDynResArgs(int argc, char* argv[], DynResOptions& options);
+
+// Chooses the render scale from measured frame times
+class ResolutionController
+{
+public:
+    explicit ResolutionController(const DynResOptions& options = DynResOptions());
+
+    // Adds one frame's GPU time; returns true when the scale changed
+    bool addSample(double frameMs);
+
+    float getScale() const { return scale; }
+
+    // Render size of one axis whose output size is size
+    int scaledSize(int size) const;
+
+private:
+    DynResOptions options;
+    float scale;
+    double sumMs = 0.0;
+    int samples = 0;
+};
+
+// Ring of timestamp query pairs: results are collected once the GPU has them
+class GpuFrameTimer
+{
+public:
+    void create();
+    void destroy();
+
+    void begin();
+    void end();
+
+    // Oldest finished frame time, false when none is ready yet
+    bool poll(double& frameMs);
+
+private:
+    static const int FRAMES = 4;
+
+    GLuint queries[FRAMES][2] = {};
+    int head = 0;           // next pair to write
+    int pending = 0;        // pairs written but not yet polled
+};
+
+#endif
@@ -0,0 +1,239 @@
+#include "Entities.h"
+#include "JobSystem.h"
+#include "TransformBatch.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+
+
+const uint32_t EntityHandle::INVALID_INDEX;
+
+
+EntityHandle EntityStore::create(const EntityTransform& transform, uint8_t meshId, uint16_t materialId, uint8_t layerMask)
+{
+    uint32_t slot;
+    if (!freeSlots.empty())
+    {
+        slot = freeSlots.back();
+        freeSlots.pop_back();
+    }
+    else
+    {
+        slot = (uint32_t)slotDense.size();
+        slotDense.push_back(EntityHandle::INVALID_INDEX);
+        slotGeneration.push_back(0);
+    }
+
+    const uint32_t dense = (uint32_t)position.size();
+    slotDense[slot] = dense;
+
+    position.push_back(transform.position);
+    rotation.push_back(transform.rotation);
+    scale.push_back(transform.scale);
+    mesh.push_back(meshId);
+    material.push_back(materialId);
+    layer.push_back(layerMask);
+    model.push_back(glm::mat4(1.0f));
+    worldBounds.push_back(glm::vec4(0.0f));
+    dirty.push_back(1);
+    owner.push_back(slot);
+    dirtyCount++;
+
+    EntityHandle handle;
+    handle.index = slot;
+    handle.generation = slotGeneration[slot];
+    return handle;
+}
+
+
+bool EntityStore::destroy(EntityHandle handle)
+{
+    const uint32_t dense = find(handle);
+    if (dense == EntityHandle::INVALID_INDEX)
+        return false;
+
+    // Move the last element into the hole and repoint its slot
+    const uint32_t last = (uint32_t)position.size() - 1;
+    if (dirty[dense])
+        dirtyCount--;
+    if (dense != last)
+    {
+        position[dense] = position[last];
+        rotation[dense] = rotation[last];
+        scale[dense] = scale[last];
+        mesh[dense] = mesh[last];
+        material[dense] = material[last];
+        layer[dense] = layer[last];
+        model[dense] = model[last];
+        worldBounds[dense] = worldBounds[last];
+        dirty[dense] = dirty[last];
+        owner[dense] = owner[last];
+        slotDense[owner[dense]] = dense;
+    }
+
+    position.pop_back();
+    rotation.pop_back();
+    scale.pop_back();
+    mesh.pop_back();
+    material.pop_back();
+    layer.pop_back();
+    model.pop_back();
+    worldBounds.pop_back();
+    dirty.pop_back();
+    owner.pop_back();
+
+    slotDense[handle.index] = EntityHandle::INVALID_INDEX;
+    slotGeneration[handle.index]++;
+    freeSlots.push_back(handle.index);
+    return true;
+}
+
+
+bool EntityStore::isAlive(EntityHandle handle) const
+{
+    return find(handle) != EntityHandle::INVALID_INDEX;
+}
+
+
+uint32_t EntityStore::find(EntityHandle handle) const
+{
+    if (handle.index >= slotDense.size() || slotGeneration[handle.index] != handle.generation)
+        return EntityHandle::INVALID_INDEX;
+    return slotDense[handle.index];
+}
+
+
+EntityHandle EntityStore::handleAt(uint32_t dense) const
+{
+    EntityHandle handle;
+    handle.index = owner[dense];
+    handle.generation = slotGeneration[handle.index];
+    return handle;
+}
+
+
+void EntityStore::setTransform(EntityHandle handle, const EntityTransform& transform)
+{
+    const uint32_t dense = find(handle);
+    if (dense == EntityHandle::INVALID_INDEX)
+        return;
+
+    position[dense] = transform.position;
+    rotation[dense] = transform.rotation;
+    scale[dense] = transform.scale;
+    if (!dirty[dense])
+    {
+        dirty[dense] = 1;
+        dirtyCount++;
+    }
+}
+
+
+void EntityStore::setMeshBounds(uint8_t meshId, const glm::vec4& bounds)
+{
+    if (meshId >= MAX_MESHES)
+        return;
+    meshBounds[meshId] = bounds;
+
+    for (size_t i = 0; i < mesh.size(); ++i)
+    {
+        if (mesh[i] == meshId && !dirty[i])
+        {
+            dirty[i] = 1;
+            dirtyCount++;
+        }
+    }
+}
+
+
+void EntityStore::updateTransforms(JobSystem* jobs)
+{
+    if (dirtyCount == 0)
+        return;
+
+    if (jobs)
+        jobs->parallelFor(position.size(), TRANSFORM_GRAIN, [this](size_t begin, size_t end) { updateRange(begin, end); });
+    else
+        updateRange(0, position.size());
+    dirtyCount = 0;
+}
+
+
+void EntityStore::invalidateTransforms()
+{
+    fill(dirty.begin(), dirty.end(), (uint8_t)1);
+    dirtyCount = dirty.size();
+}
+
+
+void EntityStore::updateRange(size_t first, size_t last)
+{
+    // Compose the model matrices of each run of changed entities in one batch
+    for (size_t begin = first; begin < last; )
+    {
+        if (!dirty[begin])
+        {
+            ++begin;
+            continue;
+        }
+        size_t end = begin + 1;
+        while (end < last && dirty[end])
+            ++end;
+
+        UComposeTransforms(&position[begin], &rotation[begin], &scale[begin], end - begin, &model[begin], nullptr);
+
+        for (size_t i = begin; i < end; ++i)
+        {
+            // The rotation keeps the radius, the largest scale axis bounds the stretch
+            const glm::vec3& s = scale[i];
+            const glm::vec4 local = mesh[i] < MAX_MESHES ? meshBounds[mesh[i]] : glm::vec4(0.0f);
+            const float stretch = max(fabs(s.x), max(fabs(s.y), fabs(s.z)));
+            worldBounds[i] = glm::vec4(glm::vec3(model[i] * glm::vec4(glm::vec3(local), 1.0f)), local.w * stretch);
+            dirty[i] = 0;
+        }
+        begin = end;
+    }
+}
+
+
+void EntityStore::reserve(size_t count)
+{
+    position.reserve(count);
+    rotation.reserve(count);
+    scale.reserve(count);
+    mesh.reserve(count);
+    material.reserve(count);
+    layer.reserve(count);
+    model.reserve(count);
+    worldBounds.reserve(count);
+    dirty.reserve(count);
+    owner.reserve(count);
+    slotDense.reserve(count);
+    slotGeneration.reserve(count);
+}
+
+
+void EntityStore::clear()
+{
+    // Keep the generations so handles from before the clear stay stale
+    for (uint32_t dense = 0; dense < owner.size(); ++dense)
+    {
+        slotDense[owner[dense]] = EntityHandle::INVALID_INDEX;
+        slotGeneration[owner[dense]]++;
+        freeSlots.push_back(owner[dense]);
+    }
+
+    position.clear();
+    rotation.clear();
+    scale.clear();
+    mesh.clear();
+    material.clear();
+    layer.clear();
+    model.clear();
+    worldBounds.clear();
+    dirty.clear();
+    owner.clear();
+    dirtyCount = 0;
+}
@@ -0,0 +1,129 @@
+///////////////////////////////////////////////////////////////////////////////
+// Entities.h
+// ==========
+// Entity-component store for the scene's objects. Components live in dense
+// parallel arrays (structure of arrays), one element per live entity, so
+// transform updates, culling and draw list building stream linearly through
+// memory instead of chasing per-object globals.
+//
+// Entities are named by handles: a slot index plus the slot's generation.
+// Destroying an entity bumps its slot's generation, so stale handles are
+// detected instead of silently reaching whatever entity reuses the slot.
+// Removal moves the last dense element into the hole (swap-remove), which
+// keeps the arrays dense; both create and destroy are O(1).
+//
+// Dense order is creation order until something is destroyed. Pointers
+// returned by the component accessors are invalidated by create/destroy.
+//
+// The model matrix of an entity is translate(position) * scale(scale) *
+// rotation, the order URender composes its props in.
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef ENTITIES_H
+#define ENTITIES_H
+
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+struct EntityHandle
+{
+    static const uint32_t INVALID_INDEX = 0xFFFFFFFFu;
+
+    uint32_t index = INVALID_INDEX;     // slot, not the dense position
+    uint32_t generation = 0;
+};
+
+struct EntityTransform
+{
+    glm::vec3 position = glm::vec3(0.0f);
+    glm::quat rotation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f);
+    glm::vec3 scale = glm::vec3(1.0f);
+};
+
+// Layers group entities for systems that only process some of them
+enum EntityLayer : uint8_t
+{
+    ENTITY_LAYER_PROPS = 1 << 0,    // the book/ball/candle/cable sets
+    ENTITY_LAYER_STRESS = 1 << 1,   // generated stress scene instances
+    ENTITY_LAYER_ALL = 0xFF
+};
+
+class JobSystem;
+
+class EntityStore
+{
+public:
+    static const int MAX_MESHES = 16;
+    static const size_t TRANSFORM_GRAIN = 4096;    // entities per transform update job
+
+    EntityHandle create(const EntityTransform& transform, uint8_t mesh, uint16_t material, uint8_t layer);
+
+    // Returns false for handles that are stale or were never valid
+    bool destroy(EntityHandle handle);
+
+    bool isAlive(EntityHandle handle) const;
+
+    // Dense position of a live entity, EntityHandle::INVALID_INDEX otherwise
+    uint32_t find(EntityHandle handle) const;
+
+    // Handle of the entity at a dense position
+    EntityHandle handleAt(uint32_t dense) const;
+
+    void setTransform(EntityHandle handle, const EntityTransform& transform);
+
+    // Local bounding sphere (xyz center, w radius) of a mesh; marks its users' bounds stale
+    void setMeshBounds(uint8_t mesh, const glm::vec4& bounds);
+
+    // Recomputes the model matrices and world bounding spheres of the changed
+    // entities, split into ranges over jobs when given
+    void updateTransforms(JobSystem* jobs = nullptr);
+
+    // Marks every entity changed, e.g. to time a full update
+    void invalidateTransforms();
+
+    void reserve(size_t count);
+    void clear();
+
+    size_t size() const { return position.size(); }
+    bool empty() const { return position.empty(); }
+
+    // Dense component arrays, size() elements each
+    const glm::vec3* positions() const { return position.data(); }
+    const glm::quat* rotations() const { return rotation.data(); }
+    const glm::vec3* scales() const { return scale.data(); }
+    const uint8_t* meshes() const { return mesh.data(); }
+    const uint16_t* materials() const { return material.data(); }
+    const uint8_t* layers() const { return layer.data(); }
+
+    // Valid after updateTransforms
+    const glm::mat4* models() const { return model.data(); }
+    const glm::vec4* bounds() const { return worldBounds.data(); }
+
+private:
+    void updateRange(size_t begin, size_t end);
+
+    // dense components
+    std::vector<glm::vec3> position;
+    std::vector<glm::quat> rotation;
+    std::vector<glm::vec3> scale;
+    std::vector<uint8_t> mesh;
+    std::vector<uint16_t> material;
+    std::vector<uint8_t> layer;
+    std::vector<glm::mat4> model;
+    std::vector<glm::vec4> worldBounds;
+    std::vector<uint8_t> dirty;         // model and bounds need recomputing
+    std::vector<uint32_t> owner;        // slot of each dense element
+
+    // slots
+    std::vector<uint32_t> slotDense;    // dense position of the slot's entity
+    std::vector<uint32_t> slotGeneration;
+    std::vector<uint32_t> freeSlots;
+
+    glm::vec4 meshBounds[MAX_MESHES] = {};
+    size_t dirtyCount = 0;
+};
+
+#endif
@@ -0,0 +1,171 @@
+#include "FrameArena.h"
+
+#include <algorithm>
+#include <cstdint>
+
+#include "JobSystem.h"
+
+using namespace std;
+
+
+FrameArena::FrameArena(size_t blockSize) : blockSize(max<size_t>(blockSize, 1024))
+{
+}
+
+
+FrameArena::~FrameArena()
+{
+    for (Block& block : blocks)
+        delete[] block.data;
+}
+
+
+void* FrameArena::allocate(size_t size, size_t alignment)
+{
+    for (;;)
+    {
+        if (current < blocks.size())
+        {
+            Block& block = blocks[current];
+            const uintptr_t base = (uintptr_t)block.data;
+            const size_t aligned = (size_t)(((base + offset + alignment - 1) & ~(uintptr_t)(alignment - 1)) - base);
+            if (aligned + size <= block.size)
+            {
+                used += aligned + size - offset;
+                offset = aligned + size;
+                return block.data + aligned;
+            }
+
+            // Leave the rest of this block unused and try the next one; like reserve(), count
+            // the skipped tail as used, since the frame needed a block this full
+            used += block.size - offset;
+            current++;
+            offset = 0;
+            continue;
+        }
+
+        addBlock(size + alignment);
+    }
+}
+
+
+void FrameArena::reset()
+{
+    highWater = max(highWater, used);
+
+    // A frame that spilled into several blocks gets one block of their combined size
+    if (blocks.size() > 1)
+    {
+        const size_t total = getCapacity();
+        for (Block& block : blocks)
+            delete[] block.data;
+        blocks.clear();
+        addBlock(total);
+    }
+
+    current = 0;
+    offset = 0;
+    used = 0;
+}
+
+
+void FrameArena::reserve(size_t bytes)
+{
+    if (current < blocks.size() && blocks[current].size - offset >= bytes)
+        return;
+
+    // Skip whatever is left; reset() merges the blocks for the next frame
+    if (current < blocks.size())
+        used += blocks[current].size - offset;
+    addBlock(bytes);
+    current = blocks.size() - 1;
+    offset = 0;
+}
+
+
+size_t FrameArena::getHighWater() const
+{
+    return max(highWater, used);
+}
+
+
+size_t FrameArena::getCapacity() const
+{
+    size_t total = 0;
+    for (const Block& block : blocks)
+        total += block.size;
+    return total;
+}
+
+
+void FrameArena::addBlock(size_t minimumSize)
+{
+    Block block;
+    block.size = max(blockSize, minimumSize);
+    block.data = new unsigned char[block.size];
+    blocks.push_back(block);
+    blockAllocations++;
+}
+
+
+FrameArenas::FrameArenas(int threads, size_t blockSize) : blockSize(blockSize)
+{
+    resize(threads);
+}
+
+
+void FrameArenas::resize(int threads)
+{
+    threads = max(threads, 1);
+    while ((int)arenas.size() < threads)
+        arenas.emplace_back(new FrameArena(blockSize));
+    arenas.resize(threads);
+}
+
+
+FrameArena& FrameArenas::local(const JobSystem* jobs)
+{
+    const int index = jobs ? jobs->getWorkerIndex() : 0;
+    return *arenas[index < (int)arenas.size() ? index : 0];
+}
+
+
+void FrameArenas::reset()
+{
+    for (unique_ptr<FrameArena>& arena : arenas)
+        arena->reset();
+}
+
+
+void FrameArenas::reserveEach(size_t bytes)
+{
+    for (unique_ptr<FrameArena>& arena : arenas)
+        arena->reserve(bytes);
+}
+
+
+size_t FrameArenas::getHighWater() const
+{
+    size_t total = 0;
+    for (const unique_ptr<FrameArena>& arena : arenas)
+        total += arena->getHighWater();
+    return total;
+}
+
+
+size_t FrameArenas::getCapacity() const
+{
+    size_t total = 0;
+    for (const unique_ptr<FrameArena>& arena : arenas)
+        total += arena->getCapacity();
+    return total;
+}
+
+
+unsigned long long FrameArenas::getBlockAllocations() const
+{
+    unsigned long long total = 0;
+    for (const unique_ptr<FrameArena>& arena : arenas)
+        total += arena->getBlockAllocations();
+    return total;
+}
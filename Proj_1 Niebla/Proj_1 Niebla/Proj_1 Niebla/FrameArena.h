@@ -0,0 +1,162 @@
+///////////////////////////////////////////////////////////////////////////////
+// FrameArena.h
+// ============
+// Linear (bump) allocation for data that lives for one frame: draw lists,
+// culling results and other per-frame scratch. An allocation is a pointer
+// bump inside a block owned by the arena, freeing is a no-op, and reset()
+// at the start of the next frame makes the whole arena reusable at once.
+//
+// Blocks are kept across resets. When a frame needs more than the current
+// blocks hold, new blocks are allocated, and the next reset merges them into
+// a single block of the combined size. Once the arena has seen the frame's
+// peak it makes no more heap allocations.
+//
+// FrameArenas holds one arena per job thread (sub-arenas), so jobs allocate
+// without locking; arena 0 belongs to the thread that owns the JobSystem
+// and doubles as the frame's main arena.
+//
+// Arena usage is reported as a high-water mark (the most bytes any frame
+// took) next to the capacity actually held.
+//
+// ArenaAllocator adapts an arena for STL containers (FrameVector). Memory is
+// only reclaimed by reset(), so a container must not outlive the frame.
+//
+// Usage:
+//   gFrameArenas.reset();                              // start of URender
+//   uint32_t* list = gFrameArenas.main().allocateArray<uint32_t>(count);
+//   FrameVector<uint64_t> keys{ ArenaAllocator<uint64_t>(gFrameArenas.local(jobs)) };
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef FRAME_ARENA_H
+#define FRAME_ARENA_H
+
+#include <cstddef>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+class JobSystem;
+
+class FrameArena
+{
+public:
+    static const size_t DEFAULT_BLOCK_SIZE = 256 * 1024;
+
+    explicit FrameArena(size_t blockSize = DEFAULT_BLOCK_SIZE);
+    ~FrameArena();
+
+    FrameArena(const FrameArena&) = delete;
+    FrameArena& operator=(const FrameArena&) = delete;
+
+    // Uninitialized memory, valid until the next reset()
+    void* allocate(size_t size, size_t alignment = alignof(std::max_align_t));
+
+    // Uninitialized array of count elements; for types that need no constructor
+    // run, otherwise placement-new the elements
+    template <typename T>
+    T* allocateArray(size_t count)
+    {
+        return static_cast<T*>(allocate(count * sizeof(T), alignof(T)));
+    }
+
+    // Releases every allocation and records the frame's usage
+    void reset();
+
+    // Makes sure the next allocations of up to bytes in total (alignment
+    // included) fit in the current block
+    void reserve(size_t bytes);
+
+    size_t getUsed() const { return used; }                 // bytes handed out this frame
+    size_t getHighWater() const;                            // most bytes used by any frame
+    size_t getCapacity() const;                             // bytes in all blocks
+    size_t getBlockCount() const { return blocks.size(); }
+    unsigned long long getBlockAllocations() const { return blockAllocations; }
+
+private:
+    struct Block
+    {
+        unsigned char* data = nullptr;
+        size_t size = 0;
+    };
+
+    void addBlock(size_t minimumSize);
+
+    std::vector<Block> blocks;
+    size_t blockSize;
+    size_t current = 0;         // block allocations come from
+    size_t offset = 0;          // first free byte in blocks[current]
+    size_t used = 0;
+    size_t highWater = 0;
+    unsigned long long blockAllocations = 0;
+};
+
+// One arena per job thread
+class FrameArenas
+{
+public:
+    explicit FrameArenas(int threads = 1, size_t blockSize = FrameArena::DEFAULT_BLOCK_SIZE);
+
+    // Matches the arenas to a job system's thread count, keeping existing ones
+    void resize(int threads);
+
+    // Arena of the frame's owning thread
+    FrameArena& main() { return *arenas[0]; }
+
+    // Arena of the calling job thread; threads outside jobs (or a null jobs) get main()
+    FrameArena& local(const JobSystem* jobs);
+
+    // Resets every arena; call when no job is running
+    void reset();
+
+    // Reserves bytes in every arena, for a stage whose jobs may all be run
+    // (stolen) by any one thread; call before submitting them
+    void reserveEach(size_t bytes);
+
+    int getCount() const { return (int)arenas.size(); }
+    FrameArena& get(int index) { return *arenas[index]; }
+
+    // Totals over all arenas
+    size_t getHighWater() const;
+    size_t getCapacity() const;
+    unsigned long long getBlockAllocations() const;
+
+private:
+    size_t blockSize;
+    std::vector<std::unique_ptr<FrameArena>> arenas;
+};
+
+// STL allocator drawing from a FrameArena; deallocate is a no-op
+template <typename T>
+class ArenaAllocator
+{
+public:
+    typedef T value_type;
+
+    // Containers take their allocator along when moved or swapped
+    typedef std::true_type propagate_on_container_move_assignment;
+    typedef std::true_type propagate_on_container_swap;
+
+    explicit ArenaAllocator(FrameArena& arena) : arena(&arena) {}
+
+    template <typename U>
+    ArenaAllocator(const ArenaAllocator<U>& other) : arena(other.getArena()) {}
+
+    T* allocate(size_t count) { return arena->allocateArray<T>(count); }
+    void deallocate(T*, size_t) {}
+
+    FrameArena* getArena() const { return arena; }
+
+private:
+    FrameArena* arena;
+};
+
+template <typename T, typename U>
+bool operator==(const ArenaAllocator<T>& a, const ArenaAllocator<U>& b) { return a.getArena() == b.getArena(); }
+
+template <typename T, typename U>
+bool operator!=(const ArenaAllocator<T>& a, const ArenaAllocator<U>& b) { return a.getArena() != b.getArena(); }
+
+template <typename T>
+using FrameVector = std::vector<T, ArenaAllocator<T>>;
+
+#endif
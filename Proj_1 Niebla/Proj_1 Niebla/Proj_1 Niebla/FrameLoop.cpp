@@ -0,0 +1,272 @@
+#include "FrameLoop.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <thread>
+
+#include <GLFW/glfw3.h>
+
+using namespace std;
+
+namespace
+{
+    const double HUD_INTERVAL = 0.5;            // seconds between title updates
+    const GLuint64 FENCE_TIMEOUT_NS = 1000000000;   // don't hang forever on a lost context
+}
+
+
+bool UParseFrameLoopArgs(int argc, char* argv[], FrameLoopOptions& options)
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        const char* arg = argv[i];
+        if (strcmp(arg, "--on-demand") == 0)
+            options.onDemand = true;
+        else if (strcmp(arg, "--late-input") == 0)
+            options.lateInput = true;
+        else if (strcmp(arg, "--hud") == 0)
+            options.hud = true;
+        else if (strcmp(arg, "--idle-timeout") == 0)
+        {
+            char* end = nullptr;
+            if (i + 1 < argc)
+                options.idleTimeout = strtod(argv[++i], &end);
+            if (!end || *end != '\0' || options.idleTimeout <= 0.0)
+            {
+                cout << "Invalid value for " << arg << endl;
+                return false;
+            }
+        }
+        else if (strcmp(arg, "--fps-limit") == 0)
+        {
+            char* end = nullptr;
+            if (i + 1 < argc)
+                options.fpsLimit = strtod(argv[++i], &end);
+            if (!end || *end != '\0' || options.fpsLimit < 0.0)
+            {
+                cout << "Invalid value for " << arg << endl;
+                return false;
+            }
+        }
+        else if (strcmp(arg, "--max-frames-in-flight") == 0)
+        {
+            char* end = nullptr;
+            if (i + 1 < argc)
+                options.maxFramesInFlight = (int)strtol(argv[++i], &end, 10);
+            if (!end || *end != '\0' || options.maxFramesInFlight < 0
+                || options.maxFramesInFlight > FrameFences::MAX_FRAMES)
+            {
+                cout << "Invalid value for " << arg << endl;
+                return false;
+            }
+        }
+        else if (strcmp(arg, "--vsync") == 0)
+        {
+            const char* value = i + 1 < argc ? argv[++i] : "";
+            if (strcmp(value, "off") == 0)
+                options.swap = SWAP_OFF;
+            else if (strcmp(value, "on") == 0)
+                options.swap = SWAP_ON;
+            else if (strcmp(value, "adaptive") == 0)
+                options.swap = SWAP_ADAPTIVE;
+            else
+            {
+                cout << "--vsync must be off, on or adaptive" << endl;
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+
+void UApplySwapInterval(SwapMode mode)
+{
+    switch (mode)
+    {
+    case SWAP_OFF:
+        glfwSwapInterval(0);
+        break;
+    case SWAP_ON:
+        glfwSwapInterval(1);
+        break;
+    case SWAP_ADAPTIVE:
+        if (glfwExtensionSupported("WGL_EXT_swap_control_tear") || glfwExtensionSupported("GLX_EXT_swap_control_tear"))
+            glfwSwapInterval(-1);
+        else
+        {
+            cout << "INFO: Adaptive vsync not supported, using vsync on" << endl;
+            glfwSwapInterval(1);
+        }
+        break;
+    case SWAP_DRIVER:
+        break;
+    }
+}
+
+
+FrameLimiter::FrameLimiter(double maxFps)
+    : period(maxFps > 0.0 ? chrono::duration_cast<Clock::duration>(chrono::duration<double>(1.0 / maxFps)) : Clock::duration::zero()),
+    sliceCost(chrono::milliseconds(2))
+{
+}
+
+
+void FrameLimiter::wait()
+{
+    if (period == Clock::duration::zero())
+        return;
+
+    Clock::time_point now = Clock::now();
+    // First frame, or more than a frame late: start over instead of rushing to catch up
+    if (!started || now - next > period)
+        next = now;
+    started = true;
+
+    // Sleep in short slices while one surely fits. The estimate jumps up on a long
+    // sleep and relaxes slowly, since the scheduler's overshoot varies.
+    while (next - now > sliceCost)
+    {
+        const Clock::time_point before = now;
+        this_thread::sleep_for(chrono::milliseconds(1));
+        now = Clock::now();
+        const Clock::duration slept = now - before;
+        sliceCost = slept > sliceCost ? slept : sliceCost - (sliceCost - slept) / 64;
+    }
+
+    // Spin out the rest
+    while (Clock::now() < next)
+        this_thread::yield();
+
+    next += period;
+}
+
+
+void FrameFences::destroy()
+{
+    for (GLsync& fence : fences)
+    {
+        if (fence)
+            glDeleteSync(fence);
+    }
+    *this = FrameFences(limit);
+}
+
+
+void FrameFences::wait()
+{
+    while (limit > 0 && pending >= limit)
+    {
+        const int oldest = (head - pending + MAX_FRAMES) % MAX_FRAMES;
+        glClientWaitSync(fences[oldest], GL_SYNC_FLUSH_COMMANDS_BIT, FENCE_TIMEOUT_NS);
+        glDeleteSync(fences[oldest]);
+        fences[oldest] = 0;
+        pending--;
+    }
+}
+
+
+void FrameFences::insert()
+{
+    if (limit <= 0)
+        return;
+
+    // Only reached if wait() was skipped; keep the ring bounded regardless
+    if (pending == MAX_FRAMES)
+        wait();
+    fences[head] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    head = (head + 1) % MAX_FRAMES;
+    pending++;
+}
+
+
+void LatencyMeter::create()
+{
+    destroy();
+    glGenQueries(FRAMES, queries);
+}
+
+
+void LatencyMeter::destroy()
+{
+    if (queries[0])
+        glDeleteQueries(FRAMES, queries);
+    *this = LatencyMeter();
+}
+
+
+void LatencyMeter::markInput()
+{
+    // GL time at which the commands issued so far reach the GPU, on the timestamp query clock
+    glGetInteger64v(GL_TIMESTAMP, &inputTime);
+}
+
+
+void LatencyMeter::markPresented()
+{
+    // A full ring drops its oldest unread frame
+    if (pending == FRAMES)
+        pending--;
+    glQueryCounter(queries[head], GL_TIMESTAMP);
+    inputTimes[head] = inputTime;
+    head = (head + 1) % FRAMES;
+    pending++;
+}
+
+
+bool LatencyMeter::poll(double& latencyMs)
+{
+    if (pending == 0)
+        return false;
+
+    const int oldest = (head - pending + FRAMES) % FRAMES;
+    GLint available = 0;
+    glGetQueryObjectiv(queries[oldest], GL_QUERY_RESULT_AVAILABLE, &available);
+    if (!available)
+        return false;
+
+    GLuint64 done = 0;
+    glGetQueryObjectui64v(queries[oldest], GL_QUERY_RESULT, &done);
+    pending--;
+
+    latencyMs = ((GLint64)done - inputTimes[oldest]) / 1.0e6;
+    return true;
+}
+
+
+void PacingHud::addFrame(double frameSeconds)
+{
+    frameSum += frameSeconds;
+    frames++;
+}
+
+
+void PacingHud::addLatency(double latencyMs)
+{
+    latencySum += latencyMs;
+    latencies++;
+}
+
+
+bool PacingHud::update(double time, string& text)
+{
+    if (time - lastUpdate < HUD_INTERVAL || frames == 0)
+        return false;
+
+    const double frameMs = frameSum / frames * 1000.0;
+    char buffer[128];
+    if (latencies > 0)
+        snprintf(buffer, sizeof(buffer), "%.2f ms (%.0f fps), latency %.1f ms", frameMs, 1000.0 / frameMs,
+            latencySum / latencies);
+    else
+        snprintf(buffer, sizeof(buffer), "%.2f ms (%.0f fps)", frameMs, 1000.0 / frameMs);
+    text = buffer;
+
+    *this = PacingHud();
+    lastUpdate = time;
+    return true;
+}
@@ -0,0 +1,150 @@
+///////////////////////////////////////////////////////////////////////////////
+// FrameLoop.h
+// ===========
+// Options and helpers controlling how the interactive render loop schedules
+// and paces frames.
+//
+// --on-demand only redraws when something changed the image (camera
+// movement, the perspective toggle, a resize, a replayed trace or a new
+// dynamic resolution scale). While nothing changes the loop blocks in
+// glfwWaitEventsTimeout instead of spinning, which keeps idle kiosks cool.
+// --idle-timeout caps how long one wait may last, in seconds.
+//
+// Frame pacing, for lower and steadier input-to-display latency:
+//   --vsync off|on|adaptive   swap interval; adaptive tears late frames
+//                             instead of waiting a whole refresh, when the
+//                             driver supports it. Default: driver setting.
+//   --fps-limit N             caps the frame rate by sleeping, then spinning
+//                             for the last stretch the scheduler can't hit.
+//   --max-frames-in-flight N  waits on fences so the driver never queues
+//                             more than N frames ahead of the GPU.
+//   --late-input              polls events right before a frame is built,
+//                             after the pacing waits, not after the swap.
+//   --hud                     shows frame time and latency in the title bar.
+//
+// Latency is measured from input sampling to the GPU finishing the frame,
+// after which it can be presented; scan-out adds up to one refresh on top.
+//
+// Usage:
+//   "Proj_1 Niebla" --on-demand [--idle-timeout 0.5]
+//   "Proj_1 Niebla" --vsync off --fps-limit 144 --max-frames-in-flight 1 --late-input --hud
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef FRAME_LOOP_H
+#define FRAME_LOOP_H
+
+#include <chrono>
+#include <string>
+
+#include <GL/glew.h>
+
+enum SwapMode
+{
+    SWAP_DRIVER,                // leave the driver's default swap interval
+    SWAP_OFF,
+    SWAP_ON,
+    SWAP_ADAPTIVE
+};
+
+struct FrameLoopOptions
+{
+    bool onDemand = false;      // skip rendering while the scene is unchanged
+    double idleTimeout = 0.5;   // longest single wait for events, seconds
+    SwapMode swap = SWAP_DRIVER;
+    double fpsLimit = 0.0;      // 0: unlimited
+    int maxFramesInFlight = 0;  // 0: as many as the driver queues
+    bool lateInput = false;     // poll events just before building a frame
+    bool hud = false;           // frame time and latency in the window title
+};
+
+bool UParseFrameLoopArgs(int argc, char* argv[], FrameLoopOptions& options);
+
+// Sets the swap interval of the current context, falling back to vsync on
+// when adaptive vsync isn't supported
+void UApplySwapInterval(SwapMode mode);
+
+// Sleep + spin limiter holding frames to a fixed period
+class FrameLimiter
+{
+public:
+    explicit FrameLimiter(double maxFps = 0.0);
+
+    // Returns at the start time of the next frame
+    void wait();
+
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    Clock::duration period;
+    Clock::time_point next;
+    Clock::duration sliceCost;  // how long a 1 ms sleep actually takes, worst case lately
+    bool started = false;
+};
+
+// Limits the frames queued ahead of the GPU with one fence per frame
+class FrameFences
+{
+public:
+    explicit FrameFences(int limit = 0) : limit(limit) {}
+    void destroy();
+
+    // Blocks until fewer than limit frames are still in flight
+    void wait();
+
+    // Marks the end of a frame, call after the swap
+    void insert();
+
+    static const int MAX_FRAMES = 8;
+
+private:
+    int limit;
+    GLsync fences[MAX_FRAMES] = {};
+    int head = 0;           // next slot to write
+    int pending = 0;        // fences not yet waited on
+};
+
+// Input-to-completion latency from GPU timestamps, collected a few frames later like GpuFrameTimer
+class LatencyMeter
+{
+public:
+    void create();
+    void destroy();
+
+    // Input for the next frame was just sampled
+    void markInput();
+
+    // The frame's commands are submitted (after the swap, or the last draw offscreen)
+    void markPresented();
+
+    // Oldest finished frame's latency, false when none is ready yet
+    bool poll(double& latencyMs);
+
+private:
+    static const int FRAMES = 4;
+
+    GLuint queries[FRAMES] = {};
+    GLint64 inputTimes[FRAMES] = {};
+    GLint64 inputTime = 0;
+    int head = 0;
+    int pending = 0;
+};
+
+// Averages frame time and latency for the title bar
+class PacingHud
+{
+public:
+    void addFrame(double frameSeconds);
+    void addLatency(double latencyMs);
+
+    // Every half second, fills text with the averages and returns true
+    bool update(double time, std::string& text);
+
+private:
+    double lastUpdate = 0.0;
+    double frameSum = 0.0;
+    int frames = 0;
+    double latencySum = 0.0;
+    int latencies = 0;
+};
+
+#endif
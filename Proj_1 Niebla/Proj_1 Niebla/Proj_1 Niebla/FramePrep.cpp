@@ -0,0 +1,152 @@
+#include "FramePrep.h"
+
+#include <algorithm>
+#include <chrono>
+#include <new>
+
+#include "Entities.h"
+#include "GpuCull.h"
+#include "JobSystem.h"
+
+using namespace std;
+
+namespace
+{
+    typedef chrono::steady_clock Clock;
+
+    double MillisecondsSince(Clock::time_point start)
+    {
+        return chrono::duration<double, milli>(Clock::now() - start).count();
+    }
+
+    // JobSystem::parallelFor, or the same ranges in order on this thread
+    template <typename Body>
+    void ForRanges(JobSystem* jobs, size_t count, size_t grain, const Body& body)
+    {
+        if (jobs)
+        {
+            jobs->parallelFor(count, grain, body);
+            return;
+        }
+        for (size_t begin = 0; begin < count; begin += grain)
+            body(begin, min(begin + grain, count));
+    }
+
+    // Mesh, then material, then dense index
+    uint64_t DrawKey(uint8_t mesh, uint16_t material, uint32_t dense)
+    {
+        return ((uint64_t)mesh << 56) | ((uint64_t)material << 40) | dense;
+    }
+}
+
+
+void FramePrep::prepare(EntityStore& entities, const glm::mat4& viewProjection, uint8_t layers, JobSystem* jobs,
+    FrameArenas& arenas, FramePrepTimings* timings)
+{
+    Clock::time_point start = Clock::now();
+    entities.updateTransforms(jobs);
+    if (timings)
+        timings->transformMs = MillisecondsSince(start);
+
+    start = Clock::now();
+    cull(entities, viewProjection, layers, jobs, arenas);
+    if (timings)
+        timings->cullMs = MillisecondsSince(start);
+
+    start = Clock::now();
+    sort(jobs, arenas.main());
+    if (timings)
+        timings->sortMs = MillisecondsSince(start);
+}
+
+
+void FramePrep::cull(const EntityStore& entities, const glm::mat4& viewProjection, uint8_t layers, JobSystem* jobs,
+    FrameArenas& arenas)
+{
+    glm::vec4 planes[6];
+    UFrustumPlanes(viewProjection, planes);
+
+    const size_t count = entities.size();
+    chunkCount = (count + CULL_GRAIN - 1) / CULL_GRAIN;
+    chunks = arenas.main().allocateArray<FrameVector<uint64_t>>(chunkCount);
+
+    const uint8_t* meshes = entities.meshes();
+    const uint16_t* materials = entities.materials();
+    const uint8_t* entityLayers = entities.layers();
+    const glm::vec4* bounds = entities.bounds();
+
+    // Stealing decides which thread culls which range, so any one of them may
+    // end up with every range's list
+    arenas.reserveEach(count * sizeof(uint64_t));
+    ForRanges(jobs, count, CULL_GRAIN, [&](size_t begin, size_t end) {
+        // The range's list lives in this job thread's arena
+        FrameVector<uint64_t>* visible = new (&chunks[begin / CULL_GRAIN])
+            FrameVector<uint64_t>(ArenaAllocator<uint64_t>(arenas.local(jobs)));
+        visible->reserve(end - begin);
+        for (size_t i = begin; i < end; ++i)
+        {
+            if (!(entityLayers[i] & layers))
+                continue;
+
+            const glm::vec4& sphere = bounds[i];
+            bool inside = true;
+            for (int p = 0; p < 6 && inside; ++p)
+                inside = glm::dot(glm::vec3(planes[p]), glm::vec3(sphere)) + planes[p].w >= -sphere.w;
+            if (inside)
+                visible->push_back(DrawKey(meshes[i], materials[i], (uint32_t)i));
+        }
+    });
+}
+
+
+void FramePrep::sort(JobSystem* jobs, FrameArena& arena)
+{
+    // Sort every chunk and gather them into one array of sorted runs
+    const size_t runs = chunkCount;
+    size_t total = 0;
+    for (size_t c = 0; c < runs; ++c)
+        total += chunks[c].size();
+
+    // In one piece, so how much of the cull ran on this thread doesn't decide
+    // whether the arrays below still fit
+    arena.reserve((runs + 1) * sizeof(size_t) + total * (2 * sizeof(uint64_t) + sizeof(uint32_t)) +
+        3 * alignof(uint64_t));
+
+    size_t* runStart = arena.allocateArray<size_t>(runs + 1);
+    runStart[0] = 0;
+    for (size_t c = 0; c < runs; ++c)
+        runStart[c + 1] = runStart[c] + chunks[c].size();
+    uint64_t* keys = arena.allocateArray<uint64_t>(total);
+    uint64_t* merged = arena.allocateArray<uint64_t>(total);
+
+    ForRanges(jobs, runs, 1, [&](size_t begin, size_t end) {
+        for (size_t c = begin; c < end; ++c)
+        {
+            std::sort(chunks[c].begin(), chunks[c].end());
+            copy(chunks[c].begin(), chunks[c].end(), keys + runStart[c]);
+        }
+    });
+
+    // Merge neighbouring runs until one is left
+    for (size_t width = 1; width < runs; width *= 2)
+    {
+        const size_t pairs = (runs + 2 * width - 1) / (2 * width);
+        ForRanges(jobs, pairs, 1, [&](size_t begin, size_t end) {
+            for (size_t pair = begin; pair < end; ++pair)
+            {
+                const size_t first = runStart[pair * 2 * width];
+                const size_t middle = runStart[min(pair * 2 * width + width, runs)];
+                const size_t last = runStart[min(pair * 2 * width + 2 * width, runs)];
+                merge(keys + first, keys + middle, keys + middle, keys + last, merged + first);
+            }
+        });
+        swap(keys, merged);
+    }
+
+    drawList = arena.allocateArray<uint32_t>(total);
+    drawCount = total;
+    ForRanges(jobs, total, CULL_GRAIN, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i)
+            drawList[i] = (uint32_t)keys[i];
+    });
+}
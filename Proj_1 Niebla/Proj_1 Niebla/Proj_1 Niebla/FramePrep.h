@@ -0,0 +1,67 @@
+///////////////////////////////////////////////////////////////////////////////
+// FramePrep.h
+// ===========
+// CPU preparation of a frame's entity draws, run before URender touches GL:
+//   1. transforms: model matrices and bounds of changed entities
+//   2. cull:       bounding spheres against the view frustum
+//   3. sort:       survivors by mesh, then material, then dense index, so
+//                  the submission loop rebinds as little as possible
+// Each stage fans out over a JobSystem and waits for the previous one; only
+// the resulting draw list is handed to the GL thread. The list is identical
+// for any thread count.
+//
+// Culling writes one list per fixed-size range of entities into the job
+// thread's frame arena, which the sort stage sorts in parallel and then
+// merges pairwise. Everything a frame needs comes from the FrameArenas, so
+// the draw list is valid until they are next reset.
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef FRAME_PREP_H
+#define FRAME_PREP_H
+
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "FrameArena.h"
+
+class EntityStore;
+class JobSystem;
+
+// Milliseconds spent in each stage of the last prepare()
+struct FramePrepTimings
+{
+    double transformMs = 0.0;
+    double cullMs = 0.0;
+    double sortMs = 0.0;
+};
+
+class FramePrep
+{
+public:
+    static const size_t CULL_GRAIN = 2048;     // entities per cull job
+
+    // Builds the draw list of the entities on layers inside the frustum of
+    // viewProjection. Without jobs every stage runs on the calling thread;
+    // arenas needs one arena per job thread.
+    void prepare(EntityStore& entities, const glm::mat4& viewProjection, uint8_t layers, JobSystem* jobs,
+        FrameArenas& arenas, FramePrepTimings* timings = nullptr);
+
+    // Dense entity indices in submission order
+    const uint32_t* getDrawList() const { return drawList; }
+    size_t getDrawCount() const { return drawCount; }
+
+private:
+    void cull(const EntityStore& entities, const glm::mat4& viewProjection, uint8_t layers, JobSystem* jobs,
+        FrameArenas& arenas);
+    void sort(JobSystem* jobs, FrameArena& arena);
+
+    // Valid until the arenas are reset
+    FrameVector<uint64_t>* chunks = nullptr;    // sort keys of the visible entities of each cull range
+    size_t chunkCount = 0;
+    uint32_t* drawList = nullptr;
+    size_t drawCount = 0;
+};
+
+#endif
@@ -0,0 +1,370 @@
+#include "GLState.h"
+
+#include <algorithm>
+#include <cstring>
+#include <thread>
+
+#include <glm/gtc/type_ptr.hpp>
+
+using namespace std;
+
+const GLuint GLStateCache::UNKNOWN;
+
+namespace
+{
+    // Binding points and capabilities the cache tracks; others are passed through
+    const GLenum BUFFER_TARGET_LIST[] = {
+        GL_ARRAY_BUFFER, GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, GL_DRAW_INDIRECT_BUFFER,
+        GL_PARAMETER_BUFFER_ARB, GL_PIXEL_PACK_BUFFER, GL_PIXEL_UNPACK_BUFFER, GL_SHADER_STORAGE_BUFFER,
+    };
+    const GLenum CAPABILITY_LIST[] = {
+        GL_DEPTH_TEST, GL_CULL_FACE, GL_BLEND, GL_SCISSOR_TEST, GL_STENCIL_TEST, GL_POLYGON_OFFSET_FILL,
+    };
+}
+
+
+GLStateCache& UGLState()
+{
+    // The main thread's cache is never destroyed: resource handles in globals
+    // release through it during static destruction, after function-local
+    // statics and thread_locals are gone
+    static GLStateCache* const mainCache = new GLStateCache();
+    static const thread::id mainThread = this_thread::get_id();
+    if (this_thread::get_id() == mainThread)
+        return *mainCache;
+
+    thread_local GLStateCache cache;
+    return cache;
+}
+
+
+GLStateCache::GLStateCache()
+{
+    invalidate();
+}
+
+
+void GLStateCache::invalidate()
+{
+    program = UNKNOWN;
+    programState = nullptr;
+    vao = UNKNOWN;
+    activeUnit = -1;
+    fill(begin(textures), end(textures), UNKNOWN);
+    fill(begin(buffers), end(buffers), UNKNOWN);
+    fill(begin(storageBindings), end(storageBindings), UNKNOWN);
+    fill(begin(capabilities), end(capabilities), UNKNOWN);
+    clearKnown = false;
+
+    // Uniform values live in the programs, but whether they still match is unknown
+    for (auto& entry : programs)
+    {
+        for (UniformValue& value : entry.second.values)
+            value.type = UNIFORM_UNKNOWN;
+    }
+}
+
+
+void GLStateCache::useProgram(GLuint program)
+{
+    if (!changed(this->program, program))
+        return;
+    glUseProgram(program);
+    programState = program ? &programs[program] : nullptr;
+}
+
+
+void GLStateCache::bindVertexArray(GLuint vao)
+{
+    if (changed(this->vao, vao))
+        glBindVertexArray(vao);
+}
+
+
+void GLStateCache::bindTexture(int unit, GLuint texture)
+{
+    if (unit < 0 || unit >= TEXTURE_UNITS)
+    {
+        glActiveTexture(GL_TEXTURE0 + unit);
+        glBindTexture(GL_TEXTURE_2D, texture);
+        activeUnit = unit;
+        issued += 2;
+        return;
+    }
+
+    if (!changed(textures[unit], texture))
+        return;
+    if (activeUnit != unit)
+    {
+        glActiveTexture(GL_TEXTURE0 + unit);
+        activeUnit = unit;
+        issued++;
+    }
+    glBindTexture(GL_TEXTURE_2D, texture);
+}
+
+
+void GLStateCache::bindBuffer(GLenum target, GLuint buffer)
+{
+    const int slot = bufferSlot(target);
+    if (slot < 0)
+    {
+        glBindBuffer(target, buffer);
+        issued++;
+        return;
+    }
+
+    if (changed(buffers[slot], buffer))
+        glBindBuffer(target, buffer);
+}
+
+
+void GLStateCache::bindBufferBase(GLenum target, GLuint index, GLuint buffer)
+{
+    // Binding an index also binds the generic point
+    const int slot = bufferSlot(target);
+    if (target == GL_SHADER_STORAGE_BUFFER && index < (GLuint)STORAGE_BINDINGS)
+    {
+        if (!changed(storageBindings[index], buffer))
+            return;
+    }
+    else
+    {
+        issued++;
+    }
+    glBindBufferBase(target, index, buffer);
+    if (slot >= 0)
+        buffers[slot] = buffer;
+}
+
+
+void GLStateCache::enable(GLenum capability)
+{
+    const int slot = capabilitySlot(capability);
+    if (slot < 0)
+    {
+        glEnable(capability);
+        issued++;
+    }
+    else if (changed(capabilities[slot], GL_TRUE))
+    {
+        glEnable(capability);
+    }
+}
+
+
+void GLStateCache::disable(GLenum capability)
+{
+    const int slot = capabilitySlot(capability);
+    if (slot < 0)
+    {
+        glDisable(capability);
+        issued++;
+    }
+    else if (changed(capabilities[slot], GL_FALSE))
+    {
+        glDisable(capability);
+    }
+}
+
+
+void GLStateCache::clearColor(float red, float green, float blue, float alpha)
+{
+    const glm::vec4 color(red, green, blue, alpha);
+    if (clearKnown && clear == color)
+    {
+        elided++;
+        return;
+    }
+    glClearColor(red, green, blue, alpha);
+    clear = color;
+    clearKnown = true;
+    issued++;
+}
+
+
+GLint GLStateCache::getUniformLocation(GLuint program, const char* name)
+{
+    // A handful of uniforms per program: a linear search beats hashing the name
+    ProgramState& state = programs[program];
+    for (const pair<string, GLint>& location : state.locations)
+    {
+        if (location.first == name)
+            return location.second;
+    }
+
+    const GLint location = glGetUniformLocation(program, name);
+    state.locations.emplace_back(name, location);
+    return location;
+}
+
+
+void GLStateCache::uniform1i(GLint location, GLint value)
+{
+    if (uniformChanged(location, UNIFORM_INT, &value, sizeof(value)))
+        glUniform1i(location, value);
+}
+
+
+void GLStateCache::uniform1ui(GLint location, GLuint value)
+{
+    if (uniformChanged(location, UNIFORM_UINT, &value, sizeof(value)))
+        glUniform1ui(location, value);
+}
+
+
+void GLStateCache::uniform2i(GLint location, GLint x, GLint y)
+{
+    const GLint values[2] = { x, y };
+    if (uniformChanged(location, UNIFORM_INT, values, sizeof(values)))
+        glUniform2i(location, x, y);
+}
+
+
+void GLStateCache::uniform1f(GLint location, GLfloat value)
+{
+    if (uniformChanged(location, UNIFORM_FLOAT, &value, sizeof(value)))
+        glUniform1f(location, value);
+}
+
+
+void GLStateCache::uniform2f(GLint location, const glm::vec2& value)
+{
+    if (uniformChanged(location, UNIFORM_FLOAT, glm::value_ptr(value), sizeof(value)))
+        glUniform2fv(location, 1, glm::value_ptr(value));
+}
+
+
+void GLStateCache::uniform3f(GLint location, const glm::vec3& value)
+{
+    if (uniformChanged(location, UNIFORM_FLOAT, glm::value_ptr(value), sizeof(value)))
+        glUniform3f(location, value.x, value.y, value.z);
+}
+
+
+void GLStateCache::uniform4fv(GLint location, GLsizei count, const GLfloat* values)
+{
+    if (uniformChanged(location, UNIFORM_FLOAT, values, count * 4 * sizeof(GLfloat)))
+        glUniform4fv(location, count, values);
+}
+
+
+void GLStateCache::uniform1uiv(GLint location, GLsizei count, const GLuint* values)
+{
+    if (uniformChanged(location, UNIFORM_UINT, values, count * sizeof(GLuint)))
+        glUniform1uiv(location, count, values);
+}
+
+
+void GLStateCache::uniformMatrix4(GLint location, const glm::mat4& value)
+{
+    if (uniformChanged(location, UNIFORM_MATRIX, glm::value_ptr(value), sizeof(value)))
+        glUniformMatrix4fv(location, 1, GL_FALSE, glm::value_ptr(value));
+}
+
+
+void GLStateCache::deleteProgram(GLuint program)
+{
+    if (!program)
+        return;
+    glDeleteProgram(program);
+    programs.erase(program);
+
+    // A current program is only deleted once it is unbound; its name stays current until then
+    if (this->program == program)
+    {
+        this->program = UNKNOWN;
+        programState = nullptr;
+    }
+}
+
+
+void GLStateCache::deleteTextures(GLsizei count, const GLuint* textures)
+{
+    glDeleteTextures(count, textures);
+    for (GLsizei i = 0; i < count; ++i)
+        replace(begin(this->textures), end(this->textures), textures[i], 0u);
+}
+
+
+void GLStateCache::deleteBuffers(GLsizei count, const GLuint* buffers)
+{
+    glDeleteBuffers(count, buffers);
+    for (GLsizei i = 0; i < count; ++i)
+    {
+        replace(begin(this->buffers), end(this->buffers), buffers[i], 0u);
+        replace(begin(storageBindings), end(storageBindings), buffers[i], 0u);
+    }
+}
+
+
+void GLStateCache::deleteVertexArrays(GLsizei count, const GLuint* vaos)
+{
+    glDeleteVertexArrays(count, vaos);
+    for (GLsizei i = 0; i < count; ++i)
+    {
+        if (vao == vaos[i])
+            vao = 0;
+    }
+}
+
+
+bool GLStateCache::changed(GLuint& cached, GLuint value)
+{
+    if (cached == value)
+    {
+        elided++;
+        return false;
+    }
+    cached = value;
+    issued++;
+    return true;
+}
+
+
+bool GLStateCache::uniformChanged(GLint location, UniformType type, const void* data, size_t bytes)
+{
+    if (location < 0)
+        return false;
+
+    issued++;
+    if (!programState || bytes > MAX_UNIFORM_BYTES)
+        return true;
+
+    if ((size_t)location >= programState->values.size())
+        programState->values.resize(location + 1);
+    UniformValue& value = programState->values[location];
+    if (value.type == type && value.bytes == bytes && memcmp(value.data, data, bytes) == 0)
+    {
+        issued--;
+        elided++;
+        return false;
+    }
+
+    value.type = type;
+    value.bytes = bytes;
+    memcpy(value.data, data, bytes);
+    return true;
+}
+
+
+int GLStateCache::bufferSlot(GLenum target) const
+{
+    for (int i = 0; i < BUFFER_TARGETS; ++i)
+    {
+        if (BUFFER_TARGET_LIST[i] == target)
+            return i;
+    }
+    return -1;
+}
+
+
+int GLStateCache::capabilitySlot(GLenum capability) const
+{
+    for (int i = 0; i < CAPABILITIES; ++i)
+    {
+        if (CAPABILITY_LIST[i] == capability)
+            return i;
+    }
+    return -1;
+}
@@ -0,0 +1,141 @@
+///////////////////////////////////////////////////////////////////////////////
+// GLState.h
+// =========
+// Thin state cache in front of the GL calls the render paths make every
+// frame. It remembers the current program, vertex array, the 2D texture of
+// each unit, the common buffer binding points (plain and indexed shader
+// storage), enable flags, the clear color and, per program, uniform
+// locations and the last value uploaded to each uniform. A call that would
+// set what is already set is skipped.
+//
+// The cache only knows what went through it, so every path that renders
+// uses it for the state it covers, including creation code that binds.
+// Deleting a program, texture, buffer or vertex array must go through the
+// delete* functions here as well: GL unbinds deleted objects and may hand
+// their names out again. invalidate() forgets everything, for code that
+// cannot use the cache.
+//
+// State belongs to a context, so each thread has its own cache (the main
+// thread and each batch worker own one context). The first thread to ask
+// for a cache is taken to be the main thread; its cache lives until the
+// process ends. Counters of issued and
+// elided calls show how much the cache saves.
+//
+// Usage:
+//   GLStateCache& gl = UGLState();
+//   gl.useProgram(programId);
+//   gl.uniformMatrix4(gl.getUniformLocation(programId, "view"), view);
+//   gl.bindTexture(0, textureId);
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef GL_STATE_H
+#define GL_STATE_H
+
+#include <cstddef>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+class GLStateCache
+{
+public:
+    static const int TEXTURE_UNITS = 16;
+    static const int STORAGE_BINDINGS = 8;
+    static const size_t MAX_UNIFORM_BYTES = 32 * sizeof(float);    // larger uniforms are always uploaded
+
+    GLStateCache();
+
+    // Forgets all state, so the next call of each kind is issued
+    void invalidate();
+
+    void useProgram(GLuint program);
+    void bindVertexArray(GLuint vao);
+    void bindTexture(int unit, GLuint texture);         // GL_TEXTURE_2D of the unit
+    void bindBuffer(GLenum target, GLuint buffer);
+    void bindBufferBase(GLenum target, GLuint index, GLuint buffer);
+    void enable(GLenum capability);
+    void disable(GLenum capability);
+    void clearColor(float red, float green, float blue, float alpha);
+
+    // Looked up once per program and name
+    GLint getUniformLocation(GLuint program, const char* name);
+
+    // Set on the current program; location -1 is ignored like GL does
+    void uniform1i(GLint location, GLint value);
+    void uniform1ui(GLint location, GLuint value);
+    void uniform2i(GLint location, GLint x, GLint y);
+    void uniform1f(GLint location, GLfloat value);
+    void uniform2f(GLint location, const glm::vec2& value);
+    void uniform3f(GLint location, const glm::vec3& value);
+    void uniform4fv(GLint location, GLsizei count, const GLfloat* values);
+    void uniform1uiv(GLint location, GLsizei count, const GLuint* values);
+    void uniformMatrix4(GLint location, const glm::mat4& value);
+
+    // Delete and drop the objects from the cache
+    void deleteProgram(GLuint program);
+    void deleteTextures(GLsizei count, const GLuint* textures);
+    void deleteBuffers(GLsizei count, const GLuint* buffers);
+    void deleteVertexArrays(GLsizei count, const GLuint* vaos);
+
+    unsigned long long getIssued() const { return issued; }
+    unsigned long long getElided() const { return elided; }
+    void resetCounters() { issued = 0; elided = 0; }
+
+private:
+    // Binding or enable flag not known to the cache
+    static const GLuint UNKNOWN = 0xFFFFFFFFu;
+    static const int BUFFER_TARGETS = 8;
+    static const int CAPABILITIES = 6;
+
+    enum UniformType
+    {
+        UNIFORM_UNKNOWN,
+        UNIFORM_INT,
+        UNIFORM_UINT,
+        UNIFORM_FLOAT,
+        UNIFORM_MATRIX,
+    };
+
+    struct UniformValue
+    {
+        UniformType type = UNIFORM_UNKNOWN;
+        size_t bytes = 0;
+        unsigned char data[MAX_UNIFORM_BYTES];
+    };
+
+    struct ProgramState
+    {
+        std::vector<std::pair<std::string, GLint>> locations;
+        std::vector<UniformValue> values;       // indexed by location
+    };
+
+    // True (and counted as issued) when the call must be made
+    bool changed(GLuint& cached, GLuint value);
+    bool uniformChanged(GLint location, UniformType type, const void* data, size_t bytes);
+    int bufferSlot(GLenum target) const;
+    int capabilitySlot(GLenum capability) const;
+
+    GLuint program = UNKNOWN;
+    ProgramState* programState = nullptr;       // of program, null when unknown
+    GLuint vao = UNKNOWN;
+    int activeUnit = -1;
+    GLuint textures[TEXTURE_UNITS];
+    GLuint buffers[BUFFER_TARGETS];
+    GLuint storageBindings[STORAGE_BINDINGS];
+    GLuint capabilities[CAPABILITIES];       // GL_TRUE, GL_FALSE or UNKNOWN
+    glm::vec4 clear;
+    bool clearKnown = false;
+    std::unordered_map<GLuint, ProgramState> programs;
+
+    unsigned long long issued = 0;
+    unsigned long long elided = 0;
+};
+
+// Cache of the context current on the calling thread
+GLStateCache& UGLState();
+
+#endif
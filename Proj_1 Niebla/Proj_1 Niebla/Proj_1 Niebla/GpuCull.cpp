@@ -0,0 +1,446 @@
+#include "GpuCull.h"
+
+#include <cfloat>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+#include <glm/gtc/type_ptr.hpp>
+
+#include "GLState.h"
+#include "GpuStorage.h"
+#include "HiZ.h"
+
+using namespace std;
+
+/*Shader program Macro*/
+#ifndef GLSL
+#define GLSL(Version, Source) "#version " #Version " core \n" #Source
+#endif
+
+namespace
+{
+    const GLuint CULL_GROUP_SIZE = 64;
+    const GLsizei FLOATS_PER_VERTEX = 8;    // position 3, normal 3, uv 2
+    const GLuint OCCLUDED_COUNTER = SCENE_MESH_COUNT;   // after the per-mesh draw counts
+    const GLuint COUNTER_COUNT = SCENE_MESH_COUNT + 1;
+
+    // Matches the std430 layout in the compute shader and DrawArraysIndirectCommand
+    struct DrawCommand
+    {
+        GLuint count;
+        GLuint instanceCount;
+        GLuint first;
+        GLuint baseInstance;
+    };
+
+    /* Cull Compute Shader Source Code*/
+    const GLchar* cullComputeShaderSource = GLSL(440,
+        layout(local_size_x = 64) in;
+
+        struct DrawCommand
+        {
+            uint count;
+            uint instanceCount;
+            uint first;
+            uint baseInstance;
+        };
+
+        layout(std430, binding = 1) readonly buffer Bounds { vec4 bounds[]; };
+        layout(std430, binding = 2) readonly buffer Meshes { uint meshes[]; };
+        layout(std430, binding = 3) writeonly buffer Commands { DrawCommand commands[]; };
+        layout(std430, binding = 4) buffer Counts { uint counts[]; };   // per mesh, then occluded
+
+        // SCENE_MESH_COUNT is defined by the host (see withSceneMeshCount)
+        const uint OCCLUDED_COUNTER = SCENE_MESH_COUNT;
+
+        layout(binding = 0) uniform sampler2D depthPyramid;
+
+        uniform vec4 frustumPlanes[6];  // normalized, inside is positive
+        uniform uint objectCount;
+        uniform uint meshFirst[SCENE_MESH_COUNT];
+        uniform uint meshVertexCount[SCENE_MESH_COUNT];
+        uniform uint regionStart[SCENE_MESH_COUNT];
+        uniform bool occlusionEnabled;
+        uniform mat4 occlusionViewProjection;   // camera the pyramid was rendered with
+        uniform ivec2 pyramidSize;
+        uniform int pyramidLevels;
+
+        // Tests the sphere's bounding box against the farthest depth of the pyramid texels it covers
+        bool isOccluded(vec4 sphere)
+        {
+            vec3 lower = vec3(1.0e30);
+            vec3 upper = vec3(-1.0e30);
+            for (int i = 0; i < 8; ++i)
+            {
+                vec3 corner = sphere.xyz + sphere.w * (vec3(i & 1, (i >> 1) & 1, (i >> 2) & 1) * 2.0 - 1.0);
+                vec4 clip = occlusionViewProjection * vec4(corner, 1.0);
+                if (clip.w <= 0.0)
+                    return false;   // reaches behind the camera
+                vec3 ndc = clip.xyz / clip.w * 0.5 + 0.5;
+                lower = min(lower, ndc);
+                upper = max(upper, ndc);
+            }
+            if (lower.z <= 0.0)
+                return false;       // crosses the near plane
+
+            // Pick the level where the box spans two or three texels per axis
+            ivec2 first = ivec2(clamp(lower.xy, 0.0, 1.0) * vec2(pyramidSize));
+            ivec2 last = ivec2(clamp(upper.xy, 0.0, 1.0) * vec2(pyramidSize));
+            ivec2 extent = last - first + 1;
+            int level = min(int(ceil(log2(float(max(extent.x, extent.y))))), pyramidLevels - 1);
+
+            ivec2 levelMax = textureSize(depthPyramid, level) - 1;
+            first = min(first >> level, levelMax);
+            last = min(last >> level, levelMax);
+
+            float depth = 0.0;
+            for (int y = first.y; y <= last.y; ++y)
+            {
+                for (int x = first.x; x <= last.x; ++x)
+                    depth = max(depth, texelFetch(depthPyramid, ivec2(x, y), level).r);
+            }
+            return lower.z > depth;
+        }
+
+        void main()
+        {
+            uint object = gl_GlobalInvocationID.x;
+            if (object >= objectCount)
+                return;
+
+            // Bounding sphere against the six frustum planes
+            vec4 sphere = bounds[object];
+            for (int i = 0; i < 6; ++i)
+            {
+                if (dot(frustumPlanes[i].xyz, sphere.xyz) + frustumPlanes[i].w < -sphere.w)
+                    return;
+            }
+
+            if (occlusionEnabled && isOccluded(sphere))
+            {
+                atomicAdd(counts[OCCLUDED_COUNTER], 1u);
+                return;
+            }
+
+            // Append to the mesh's command region; baseInstance carries the object index
+            uint mesh = meshes[object];
+            uint slot = atomicAdd(counts[mesh], 1u);
+            commands[regionStart[mesh] + slot] = DrawCommand(meshVertexCount[mesh], 1u, meshFirst[mesh], object);
+        }
+    );
+
+    // The shader source with SCENE_MESH_COUNT defined after its #version line, so the
+    // counter and uniform array sizes follow the host's mesh count
+    string withSceneMeshCount(const char* source)
+    {
+        string text = source;
+        return text.insert(text.find('\n') + 1, "#define SCENE_MESH_COUNT " + to_string(SCENE_MESH_COUNT) + "\n");
+    }
+}
+
+
+bool UCreateComputeProgram(const char* source, GLuint& programId)
+{
+    int success = 0;
+    char infoLog[512];
+
+    GLuint shaderId = glCreateShader(GL_COMPUTE_SHADER);
+    glShaderSource(shaderId, 1, &source, NULL);
+    glCompileShader(shaderId);
+    glGetShaderiv(shaderId, GL_COMPILE_STATUS, &success);
+    if (!success)
+    {
+        glGetShaderInfoLog(shaderId, sizeof(infoLog), NULL, infoLog);
+        cout << "ERROR::SHADER::COMPUTE::COMPILATION_FAILED\n" << infoLog << endl;
+        glDeleteShader(shaderId);
+        return false;
+    }
+
+    programId = glCreateProgram();
+    glAttachShader(programId, shaderId);
+    glLinkProgram(programId);
+    glDeleteShader(shaderId);
+    glGetProgramiv(programId, GL_LINK_STATUS, &success);
+    if (!success)
+    {
+        glGetProgramInfoLog(programId, sizeof(infoLog), NULL, infoLog);
+        cout << "ERROR::SHADER::PROGRAM::LINKING_FAILED\n" << infoLog << endl;
+        glDeleteProgram(programId);
+        programId = 0;
+        return false;
+    }
+
+    return true;
+}
+
+
+bool UParseGpuCullArgs(int argc, char* argv[], GpuCullOptions& options)
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "--gpu-cull") == 0)
+            options.enabled = true;
+    }
+    return true;
+}
+
+
+bool GpuCuller::create(const GpuCullMesh meshes[SCENE_MESH_COUNT], const vector<SceneInstance>& instances,
+    const vector<glm::mat4>& models)
+{
+    destroy();
+
+    if (!GLEW_VERSION_4_3)
+    {
+        cout << "GPU culling needs OpenGL 4.3 compute shaders" << endl;
+        return false;
+    }
+    if (instances.empty())
+        return false;
+    if (!UCreateComputeProgram(withSceneMeshCount(cullComputeShaderSource).c_str(), cullProgram))
+        return false;
+
+    indirectCount = GLEW_ARB_indirect_parameters != GL_FALSE;
+    instanceCount = (GLuint)instances.size();
+
+    // One vertex buffer holding every mesh so all draws share a VAO
+    const GLsizei vertexBytes = FLOATS_PER_VERTEX * sizeof(float);
+    GLuint totalVertices = 0;
+    for (int mesh = 0; mesh < SCENE_MESH_COUNT; ++mesh)
+    {
+        meshFirst[mesh] = totalVertices;
+        meshVertexCount[mesh] = meshes[mesh].nVertices;
+        totalVertices += meshes[mesh].nVertices;
+    }
+
+    GLStateCache& gl = UGLState();
+    vertexBuffer = UCreateImmutableBuffer((GLsizeiptr)totalVertices * vertexBytes, NULL, 0);
+    if (!UUsingDirectStateAccess())
+        gl.bindBuffer(GL_COPY_WRITE_BUFFER, vertexBuffer);
+    for (int mesh = 0; mesh < SCENE_MESH_COUNT; ++mesh)
+    {
+        const GLintptr offset = (GLintptr)meshFirst[mesh] * vertexBytes;
+        const GLsizeiptr size = (GLsizeiptr)meshes[mesh].nVertices * vertexBytes;
+        if (UUsingDirectStateAccess())
+        {
+            glCopyNamedBufferSubData(meshes[mesh].vbo, vertexBuffer, 0, offset, size);
+            continue;
+        }
+        gl.bindBuffer(GL_COPY_READ_BUFFER, meshes[mesh].vbo);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, offset, size);
+    }
+
+    // Per-instance data: world space bounding spheres from the mesh bounds
+    glm::vec4 meshBounds[SCENE_MESH_COUNT];
+    UComputeMeshBounds(meshes, meshBounds);
+
+    vector<glm::vec4> bounds(instanceCount);
+    vector<GLuint> meshIndices(instanceCount);
+    vector<GLuint> objectIndices(instanceCount);
+    for (GLuint i = 0; i < instanceCount; ++i)
+    {
+        const int mesh = instances[i].mesh;
+        const glm::mat4& model = models[i];
+        const float scale = glm::max(glm::length(glm::vec3(model[0])),
+            glm::max(glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2]))));
+        const glm::vec4 center = model * glm::vec4(glm::vec3(meshBounds[mesh]), 1.0f);
+        bounds[i] = glm::vec4(glm::vec3(center), meshBounds[mesh].w * scale);
+        meshIndices[i] = mesh;
+        objectIndices[i] = i;
+        regionSize[mesh]++;
+    }
+    for (int mesh = 1; mesh < SCENE_MESH_COUNT; ++mesh)
+        regionStart[mesh] = regionStart[mesh - 1] + regionSize[mesh - 1];
+
+    // Written only by the cull shader and glClearBufferData, read back with
+    // glGetBufferSubData; none of that needs storage flags
+    modelBuffer = UCreateImmutableBuffer(instanceCount * sizeof(glm::mat4), models.data(), 0);
+    boundsBuffer = UCreateImmutableBuffer(instanceCount * sizeof(glm::vec4), bounds.data(), 0);
+    meshBuffer = UCreateImmutableBuffer(instanceCount * sizeof(GLuint), meshIndices.data(), 0);
+    commandBuffer = UCreateImmutableBuffer(instanceCount * sizeof(DrawCommand), NULL, 0);
+    countBuffer = UCreateImmutableBuffer(COUNTER_COUNT * sizeof(GLuint), NULL, 0);
+    objectIndexBuffer = UCreateImmutableBuffer(instanceCount * sizeof(GLuint), objectIndices.data(), 0);
+
+    // Same vertex format as the prop meshes plus the per-draw object index
+    vao = UCreateMeshVertexArray(vertexBuffer);
+    UAddIntegerAttribute(vao, 3, MESH_VERTEX_BINDING + 1, objectIndexBuffer, sizeof(GLuint), 1);
+    gl.bindBuffer(GL_COPY_READ_BUFFER, 0);
+    gl.bindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+    cout << "INFO: GPU culling " << instanceCount << " instances, submitting with "
+        << (indirectCount ? "glMultiDrawArraysIndirectCountARB" : "glMultiDrawArraysIndirect (fixed size)") << endl;
+    return true;
+}
+
+
+void GpuCuller::destroy()
+{
+    GLStateCache& gl = UGLState();
+    GLuint buffers[] = { vertexBuffer, objectIndexBuffer, modelBuffer, boundsBuffer, meshBuffer, commandBuffer, countBuffer };
+    for (GLuint buffer : buffers)
+    {
+        if (buffer)
+            gl.deleteBuffers(1, &buffer);
+    }
+    if (vao)
+        gl.deleteVertexArrays(1, &vao);
+    gl.deleteProgram(cullProgram);
+
+    *this = GpuCuller();
+}
+
+
+void GpuCuller::cull(const glm::mat4& viewProjection, const HiZPyramid* occlusion)
+{
+    if (!isCreated())
+        return;
+
+    glm::vec4 planes[6];
+    UFrustumPlanes(viewProjection, planes);
+
+    // Reset the counters; without the count parameter stale commands must be zeroed too
+    GLStateCache& gl = UGLState();
+    const GLuint zero = 0;
+    gl.bindBuffer(GL_SHADER_STORAGE_BUFFER, countBuffer);
+    glClearBufferData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, &zero);
+    if (!indirectCount)
+    {
+        gl.bindBuffer(GL_SHADER_STORAGE_BUFFER, commandBuffer);
+        glClearBufferData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, &zero);
+    }
+
+    // Only the planes change from frame to frame; the cache drops the rest
+    gl.useProgram(cullProgram);
+    gl.uniform4fv(gl.getUniformLocation(cullProgram, "frustumPlanes"), 6, glm::value_ptr(planes[0]));
+    gl.uniform1ui(gl.getUniformLocation(cullProgram, "objectCount"), instanceCount);
+    gl.uniform1uiv(gl.getUniformLocation(cullProgram, "meshFirst"), SCENE_MESH_COUNT, meshFirst);
+    gl.uniform1uiv(gl.getUniformLocation(cullProgram, "meshVertexCount"), SCENE_MESH_COUNT, meshVertexCount);
+    gl.uniform1uiv(gl.getUniformLocation(cullProgram, "regionStart"), SCENE_MESH_COUNT, regionStart);
+
+    occlusionTested = occlusion != nullptr && occlusion->getTexture() != 0;
+    gl.uniform1i(gl.getUniformLocation(cullProgram, "occlusionEnabled"), occlusionTested);
+    if (occlusionTested)
+    {
+        gl.uniformMatrix4(gl.getUniformLocation(cullProgram, "occlusionViewProjection"), occlusion->getViewProjection());
+        gl.uniform2i(gl.getUniformLocation(cullProgram, "pyramidSize"), occlusion->getWidth(), occlusion->getHeight());
+        gl.uniform1i(gl.getUniformLocation(cullProgram, "pyramidLevels"), occlusion->getLevels());
+        gl.bindTexture(0, occlusion->getTexture());
+    }
+
+    gl.bindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, boundsBuffer);
+    gl.bindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, meshBuffer);
+    gl.bindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, commandBuffer);
+    gl.bindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, countBuffer);
+
+    glDispatchCompute((instanceCount + CULL_GROUP_SIZE - 1) / CULL_GROUP_SIZE, 1, 1);
+
+    // The commands and counts are consumed as indirect/parameter buffers by the draws
+    glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT);
+    gl.useProgram(0);
+}
+
+
+int GpuCuller::draw(const GLuint textures[SCENE_MESH_COUNT])
+{
+    if (!isCreated())
+        return 0;
+
+    GLStateCache& gl = UGLState();
+    gl.bindVertexArray(vao);
+    gl.bindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, modelBuffer);
+    gl.bindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+    if (indirectCount)
+        gl.bindBuffer(GL_PARAMETER_BUFFER_ARB, countBuffer);
+
+    int drawCalls = 0;
+    for (int mesh = 0; mesh < SCENE_MESH_COUNT; ++mesh)
+    {
+        if (regionSize[mesh] == 0)
+            continue;
+
+        gl.bindTexture(0, textures[mesh]);
+        const void* commands = (const void*)(regionStart[mesh] * sizeof(DrawCommand));
+        if (indirectCount)
+            glMultiDrawArraysIndirectCountARB(GL_TRIANGLES, commands, mesh * sizeof(GLuint), regionSize[mesh], 0);
+        else
+            glMultiDrawArraysIndirect(GL_TRIANGLES, commands, regionSize[mesh], 0);
+        drawCalls++;
+    }
+
+    gl.bindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+    if (indirectCount)
+        gl.bindBuffer(GL_PARAMETER_BUFFER_ARB, 0);
+    gl.bindVertexArray(0);
+    return drawCalls;
+}
+
+
+void GpuCuller::readStats(GpuCullStats& stats)
+{
+    stats = GpuCullStats();
+    if (!isCreated())
+        return;
+
+    GLuint counters[COUNTER_COUNT];
+    UGLState().bindBuffer(GL_SHADER_STORAGE_BUFFER, countBuffer);
+    glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(counters), counters);
+
+    for (int mesh = 0; mesh < SCENE_MESH_COUNT; ++mesh)
+    {
+        stats.visible[mesh] = counters[mesh];
+        stats.visibleTotal += counters[mesh];
+    }
+    stats.occluded = counters[OCCLUDED_COUNTER];
+    stats.frustumCulled = instanceCount - stats.visibleTotal - stats.occluded;
+    stats.occlusionTested = occlusionTested;
+}
+
+
+void UComputeMeshBounds(const GpuCullMesh meshes[SCENE_MESH_COUNT], glm::vec4 bounds[SCENE_MESH_COUNT])
+{
+    vector<float> vertices;
+    for (int mesh = 0; mesh < SCENE_MESH_COUNT; ++mesh)
+    {
+        if (meshes[mesh].boundsKnown)
+        {
+            bounds[mesh] = meshes[mesh].bounds;
+            continue;
+        }
+
+        vertices.resize((size_t)meshes[mesh].nVertices * FLOATS_PER_VERTEX);
+        UGLState().bindBuffer(GL_COPY_READ_BUFFER, meshes[mesh].vbo);
+        glGetBufferSubData(GL_COPY_READ_BUFFER, 0, vertices.size() * sizeof(float), vertices.data());
+
+        glm::vec3 lower(FLT_MAX);
+        glm::vec3 upper(-FLT_MAX);
+        for (size_t v = 0; v < vertices.size(); v += FLOATS_PER_VERTEX)
+        {
+            const glm::vec3 position(vertices[v], vertices[v + 1], vertices[v + 2]);
+            lower = glm::min(lower, position);
+            upper = glm::max(upper, position);
+        }
+
+        const glm::vec3 center = meshes[mesh].nVertices ? 0.5f * (lower + upper) : glm::vec3(0.0f);
+        float radius = 0.0f;
+        for (size_t v = 0; v < vertices.size(); v += FLOATS_PER_VERTEX)
+            radius = glm::max(radius, glm::length(glm::vec3(vertices[v], vertices[v + 1], vertices[v + 2]) - center));
+
+        bounds[mesh] = glm::vec4(center, radius);
+    }
+}
+
+
+void UFrustumPlanes(const glm::mat4& viewProjection, glm::vec4 planes[6])
+{
+    // Gribb/Hartmann: w +- each of x, y and z
+    for (int i = 0; i < 3; ++i)
+    {
+        const glm::vec4 row(viewProjection[0][i], viewProjection[1][i], viewProjection[2][i], viewProjection[3][i]);
+        const glm::vec4 w(viewProjection[0][3], viewProjection[1][3], viewProjection[2][3], viewProjection[3][3]);
+        planes[i * 2] = w + row;
+        planes[i * 2 + 1] = w - row;
+    }
+    for (int i = 0; i < 6; ++i)
+        planes[i] /= glm::length(glm::vec3(planes[i]));
+}
@@ -0,0 +1,117 @@
+///////////////////////////////////////////////////////////////////////////////
+// GpuCull.h
+// =========
+// GPU-driven rendering of the generated stress scene. Per-instance model
+// matrices and bounding spheres live in shader storage buffers; each frame a
+// compute shader frustum-culls every instance and appends the survivors as
+// indirect draw commands, so the CPU cost of a frame does not depend on the
+// instance count.
+//
+// The draws are submitted with glMultiDrawArraysIndirectCountARB when
+// GL_ARB_indirect_parameters is available. Otherwise every command slot is
+// submitted with glMultiDrawArraysIndirect and culled slots are left with an
+// instance count of zero.
+//
+// Buffer bindings shared with the vertex shader:
+//   SSBO 0    mat4 models[]        (read by the vertex shader)
+//   attrib 3  uint object index    (instanced, selected by baseInstance)
+//
+// Usage:
+//   "Proj_1 Niebla" --instances 1000000 --gpu-cull
+// See HiZ.h for the optional occlusion test.
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef GPU_CULL_H
+#define GPU_CULL_H
+
+#include <vector>
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include "SceneGen.h"
+
+struct GpuCullOptions
+{
+    bool enabled = false;
+};
+
+bool UParseGpuCullArgs(int argc, char* argv[], GpuCullOptions& options);
+
+// Compiles and links a compute shader program, printing errors like UCreateShaderProgram
+bool UCreateComputeProgram(const char* source, GLuint& programId);
+
+// Outcome of the last cull
+struct GpuCullStats
+{
+    GLuint visible[SCENE_MESH_COUNT] = {};  // instances drawn per mesh
+    GLuint visibleTotal = 0;
+    GLuint frustumCulled = 0;
+    GLuint occluded = 0;                    // rejected by the Hi-Z test
+    bool occlusionTested = false;           // false when the Hi-Z test was skipped
+};
+
+class HiZPyramid;
+
+// Vertex data of one prop mesh: interleaved position/normal/uv floats as in UCreateMesh
+struct GpuCullMesh
+{
+    GLuint vbo = 0;
+    GLuint nVertices = 0;
+    glm::vec4 bounds = glm::vec4(0.0f);     // used as is when boundsKnown (mesh files store them)
+    bool boundsKnown = false;
+};
+
+// Bounding sphere (xyz center, w radius) of each mesh's vertices, read back from its VBO
+// unless the mesh already knows it
+void UComputeMeshBounds(const GpuCullMesh meshes[SCENE_MESH_COUNT], glm::vec4 bounds[SCENE_MESH_COUNT]);
+
+// Normalized frustum planes (inside positive) from the rows of a view-projection matrix
+void UFrustumPlanes(const glm::mat4& viewProjection, glm::vec4 planes[6]);
+
+class GpuCuller
+{
+public:
+    // Uploads the meshes and instances; instances must be sorted by mesh as UGenerateScene returns them
+    bool create(const GpuCullMesh meshes[SCENE_MESH_COUNT], const std::vector<SceneInstance>& instances,
+        const std::vector<glm::mat4>& models);
+    void destroy();
+    bool isCreated() const { return cullProgram != 0; }
+
+    // Culls every instance against the view frustum and, when occlusion is given,
+    // its depth pyramid, then rebuilds the indirect draws
+    void cull(const glm::mat4& viewProjection, const HiZPyramid* occlusion = nullptr);
+
+    // Issues the indirect draws with the currently bound program, binding textures[mesh]
+    // for each mesh. Returns the number of draw calls made.
+    int draw(const GLuint textures[SCENE_MESH_COUNT]);
+
+    // Reads the counters of the last cull back from the GPU, so only call it
+    // outside the measured part of a frame
+    void readStats(GpuCullStats& stats);
+
+    bool usesIndirectCount() const { return indirectCount; }
+    GLuint getInstanceCount() const { return instanceCount; }
+    GLuint getMeshVertexCount(int mesh) const { return meshVertexCount[mesh]; }
+
+private:
+    GLuint vao = 0;
+    GLuint vertexBuffer = 0;        // all prop meshes back to back
+    GLuint objectIndexBuffer = 0;   // 0..N-1, read through baseInstance
+    GLuint modelBuffer = 0;
+    GLuint boundsBuffer = 0;        // world space bounding sphere per instance
+    GLuint meshBuffer = 0;          // mesh kind per instance
+    GLuint commandBuffer = 0;       // one command slot per instance
+    GLuint countBuffer = 0;         // surviving draws per mesh
+    GLuint cullProgram = 0;
+
+    GLuint instanceCount = 0;
+    GLuint meshFirst[SCENE_MESH_COUNT] = {};        // first vertex of each mesh in vertexBuffer
+    GLuint meshVertexCount[SCENE_MESH_COUNT] = {};
+    GLuint regionStart[SCENE_MESH_COUNT] = {};      // first command slot of each mesh
+    GLuint regionSize[SCENE_MESH_COUNT] = {};       // instances of each mesh
+    bool indirectCount = false;
+    bool occlusionTested = false;   // the last cull ran the Hi-Z test
+};
+
+#endif
@@ -0,0 +1,172 @@
+#include "GpuStorage.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+#include "GLState.h"
+
+using namespace std;
+
+namespace
+{
+    bool useDsa = false;
+}
+
+
+bool UParseGpuStorageArgs(int argc, char* argv[], GpuStorageOptions& options)
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "--no-dsa") == 0)
+            options.directStateAccess = false;
+    }
+
+    return true;
+}
+
+
+void UInitGpuStorage(const GpuStorageOptions& options)
+{
+    useDsa = options.directStateAccess && (GLEW_VERSION_4_5 || GLEW_ARB_direct_state_access);
+    cout << "INFO: Creating resources with " << (useDsa ? "direct state access" : "GL 4.4 bind-to-edit")
+        << ", immutable storage" << endl;
+}
+
+
+bool UUsingDirectStateAccess()
+{
+    return useDsa;
+}
+
+
+int UMipLevelCount(int width, int height)
+{
+    int levels = 1;
+    for (int size = max(width, height); size > 1; size /= 2)
+        levels++;
+    return levels;
+}
+
+
+GLuint UCreateImmutableTexture(GLenum internalFormat, int width, int height, int levels, GLint minFilter,
+    GLint magFilter, GLint wrap)
+{
+    GLuint texture = 0;
+    if (useDsa)
+    {
+        glCreateTextures(GL_TEXTURE_2D, 1, &texture);
+        glTextureStorage2D(texture, levels, internalFormat, width, height);
+        glTextureParameteri(texture, GL_TEXTURE_MIN_FILTER, minFilter);
+        glTextureParameteri(texture, GL_TEXTURE_MAG_FILTER, magFilter);
+        glTextureParameteri(texture, GL_TEXTURE_WRAP_S, wrap);
+        glTextureParameteri(texture, GL_TEXTURE_WRAP_T, wrap);
+        return texture;
+    }
+
+    // Bound through the cache so it stays in step with the render paths
+    GLStateCache& gl = UGLState();
+    glGenTextures(1, &texture);
+    gl.bindTexture(0, texture);
+    glTexStorage2D(GL_TEXTURE_2D, levels, internalFormat, width, height);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, minFilter);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, magFilter);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, wrap);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, wrap);
+    gl.bindTexture(0, 0);
+    return texture;
+}
+
+
+void UUploadTexture(GLuint texture, int width, int height, GLenum format, GLenum type, const void* pixels,
+    bool generateMipmaps)
+{
+    if (useDsa)
+    {
+        glTextureSubImage2D(texture, 0, 0, 0, width, height, format, type, pixels);
+        if (generateMipmaps)
+            glGenerateTextureMipmap(texture);
+        return;
+    }
+
+    GLStateCache& gl = UGLState();
+    gl.bindTexture(0, texture);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, format, type, pixels);
+    if (generateMipmaps)
+        glGenerateMipmap(GL_TEXTURE_2D);
+    gl.bindTexture(0, 0);
+}
+
+
+GLuint UCreateImmutableBuffer(GLsizeiptr size, const void* data, GLbitfield flags)
+{
+    GLuint buffer = 0;
+    if (useDsa)
+    {
+        glCreateBuffers(1, &buffer);
+        glNamedBufferStorage(buffer, size, data, flags);
+        return buffer;
+    }
+
+    // The copy target changes no VAO or indexed binding
+    GLStateCache& gl = UGLState();
+    glGenBuffers(1, &buffer);
+    gl.bindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+    glBufferStorage(GL_COPY_WRITE_BUFFER, size, data, flags);
+    gl.bindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    return buffer;
+}
+
+
+GLuint UCreateMeshVertexArray(GLuint vbo)
+{
+    GLuint vao = 0;
+    if (useDsa)
+    {
+        glCreateVertexArrays(1, &vao);
+        glVertexArrayVertexBuffer(vao, MESH_VERTEX_BINDING, vbo, 0, MESH_VERTEX_STRIDE);
+        for (const VertexAttribute& attribute : MESH_VERTEX_FORMAT)
+        {
+            glVertexArrayAttribFormat(vao, attribute.index, attribute.components, GL_FLOAT, GL_FALSE, attribute.offset);
+            glVertexArrayAttribBinding(vao, attribute.index, MESH_VERTEX_BINDING);
+            glEnableVertexArrayAttrib(vao, attribute.index);
+        }
+        return vao;
+    }
+
+    GLStateCache& gl = UGLState();
+    glGenVertexArrays(1, &vao);
+    gl.bindVertexArray(vao);
+    glBindVertexBuffer(MESH_VERTEX_BINDING, vbo, 0, MESH_VERTEX_STRIDE);
+    for (const VertexAttribute& attribute : MESH_VERTEX_FORMAT)
+    {
+        glVertexAttribFormat(attribute.index, attribute.components, GL_FLOAT, GL_FALSE, attribute.offset);
+        glVertexAttribBinding(attribute.index, MESH_VERTEX_BINDING);
+        glEnableVertexAttribArray(attribute.index);
+    }
+    gl.bindVertexArray(0);
+    return vao;
+}
+
+
+void UAddIntegerAttribute(GLuint vao, GLuint index, GLuint binding, GLuint buffer, GLsizei stride, GLuint divisor)
+{
+    if (useDsa)
+    {
+        glVertexArrayVertexBuffer(vao, binding, buffer, 0, stride);
+        glVertexArrayAttribIFormat(vao, index, 1, GL_UNSIGNED_INT, 0);
+        glVertexArrayAttribBinding(vao, index, binding);
+        glVertexArrayBindingDivisor(vao, binding, divisor);
+        glEnableVertexArrayAttrib(vao, index);
+        return;
+    }
+
+    GLStateCache& gl = UGLState();
+    gl.bindVertexArray(vao);
+    glBindVertexBuffer(binding, buffer, 0, stride);
+    glVertexAttribIFormat(index, 1, GL_UNSIGNED_INT, 0);
+    glVertexAttribBinding(index, binding);
+    glVertexBindingDivisor(binding, divisor);
+    glEnableVertexAttribArray(index);
+    gl.bindVertexArray(0);
+}
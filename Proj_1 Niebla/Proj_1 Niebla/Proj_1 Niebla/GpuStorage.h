@@ -0,0 +1,85 @@
+///////////////////////////////////////////////////////////////////////////////
+// GpuStorage.h
+// ============
+// Creation of GL textures, buffers and vertex arrays, all with immutable
+// storage: glTexStorage2D with the exact mip level count and
+// glBufferStorage, so the driver knows a resource's final size and usage
+// up front and can place it accordingly.
+//
+// With GL 4.5 or ARB_direct_state_access objects are created and filled
+// through DSA (glCreateTextures, glTextureStorage2D, glNamedBufferStorage,
+// glVertexArrayVertexBuffer ...), which needs no binding. On a plain 4.4
+// context the same storage is made with the bind-to-edit entry points; the
+// functions restore the bindings they touch to 0 either way.
+//
+// Every scene mesh uses one vertex format (MESH_VERTEX_FORMAT): interleaved
+// position, normal and texture coordinate read from vertex buffer binding
+// 0, set up with the separate attribute format API on both paths.
+//
+// Usage:
+//   "Proj_1 Niebla" [--no-dsa]         (force the 4.4 path)
+//
+//   UInitGpuStorage(options);          // once, after glewInit
+//   GLuint texture = UCreateImmutableTexture(GL_RGBA8, width, height, UMipLevelCount(width, height),
+//       GL_LINEAR, GL_LINEAR, GL_REPEAT);
+//   UUploadTexture(texture, width, height, GL_RGBA, GL_UNSIGNED_BYTE, pixels, true);
+//   GLuint vao = UCreateMeshVertexArray(UCreateImmutableBuffer(bytes, vertices, 0));
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef GPU_STORAGE_H
+#define GPU_STORAGE_H
+
+#include <GL/glew.h>
+
+struct GpuStorageOptions
+{
+    bool directStateAccess = true;      // use DSA when the context has it
+};
+
+bool UParseGpuStorageArgs(int argc, char* argv[], GpuStorageOptions& options);
+
+// Picks DSA or the 4.4 path for the current context and reports which
+void UInitGpuStorage(const GpuStorageOptions& options);
+bool UUsingDirectStateAccess();
+
+// One attribute of the shared mesh vertex format
+struct VertexAttribute
+{
+    GLuint index;
+    GLint components;
+    GLuint offset;      // bytes from the start of the vertex
+};
+
+const int MESH_VERTEX_ATTRIBUTE_COUNT = 3;
+const VertexAttribute MESH_VERTEX_FORMAT[MESH_VERTEX_ATTRIBUTE_COUNT] = {
+    { 0, 3, 0 },                    // position
+    { 1, 3, 3 * sizeof(float) },    // normal
+    { 2, 2, 6 * sizeof(float) },    // texture coordinate
+};
+const GLsizei MESH_VERTEX_STRIDE = 8 * sizeof(float);
+const GLuint MESH_VERTEX_BINDING = 0;
+
+// Levels of a full mip chain down to 1x1
+int UMipLevelCount(int width, int height);
+
+// Texture with levels levels of immutable storage and its sampling parameters
+GLuint UCreateImmutableTexture(GLenum internalFormat, int width, int height, int levels, GLint minFilter,
+    GLint magFilter, GLint wrap);
+
+// Fills level 0, optionally generating the remaining levels from it
+void UUploadTexture(GLuint texture, int width, int height, GLenum format, GLenum type, const void* pixels,
+    bool generateMipmaps);
+
+// Buffer of size bytes, initialized from data when not null. flags are
+// glBufferStorage flags: 0 for data only the GPU touches afterwards (copies,
+// clears and shader writes need none), GL_MAP_READ_BIT for readbacks ...
+GLuint UCreateImmutableBuffer(GLsizeiptr size, const void* data, GLbitfield flags);
+
+// Vertex array reading MESH_VERTEX_FORMAT from vbo at binding 0
+GLuint UCreateMeshVertexArray(GLuint vbo);
+
+// Adds a single unsigned int attribute read from its own buffer binding,
+// advancing once per divisor instances (0: per vertex)
+void UAddIntegerAttribute(GLuint vao, GLuint index, GLuint binding, GLuint buffer, GLsizei stride, GLuint divisor);
+
+#endif
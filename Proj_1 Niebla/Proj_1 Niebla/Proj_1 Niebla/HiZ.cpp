@@ -0,0 +1,208 @@
+#include "HiZ.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+#include "GLState.h"
+#include "GpuCull.h"        // UCreateComputeProgram
+#include "GpuStorage.h"
+
+using namespace std;
+
+/*Shader program Macro*/
+#ifndef GLSL
+#define GLSL(Version, Source) "#version " #Version " core \n" #Source
+#endif
+
+namespace
+{
+    const GLuint REDUCE_GROUP_SIZE = 8;
+
+    /* Depth Copy Compute Shader Source Code: depth attachment -> pyramid level 0*/
+    const GLchar* copyComputeShaderSource = GLSL(440,
+        layout(local_size_x = 8, local_size_y = 8) in;
+
+        layout(binding = 0) uniform sampler2D depthTexture;
+        layout(r32f, binding = 0) writeonly uniform image2D destination;
+        uniform ivec2 size;
+
+        void main()
+        {
+            ivec2 texel = ivec2(gl_GlobalInvocationID.xy);
+            if (any(greaterThanEqual(texel, size)))
+                return;
+            imageStore(destination, texel, vec4(texelFetch(depthTexture, texel, 0).r));
+        }
+    );
+
+    /* Depth Reduce Compute Shader Source Code: farthest depth of the covered texels*/
+    const GLchar* reduceComputeShaderSource = GLSL(440,
+        layout(local_size_x = 8, local_size_y = 8) in;
+
+        layout(r32f, binding = 0) readonly uniform image2D source;
+        layout(r32f, binding = 1) writeonly uniform image2D destination;
+        uniform ivec2 sourceSize;
+        uniform ivec2 destinationSize;
+
+        void main()
+        {
+            ivec2 texel = ivec2(gl_GlobalInvocationID.xy);
+            if (any(greaterThanEqual(texel, destinationSize)))
+                return;
+
+            // The last row/column also takes the leftover texel of an odd-sized source
+            ivec2 first = texel * 2;
+            ivec2 last = min(first + 1 + ivec2(equal(texel, destinationSize - 1)) * (sourceSize & 1), sourceSize - 1);
+
+            float depth = 0.0;
+            for (int y = first.y; y <= last.y; ++y)
+            {
+                for (int x = first.x; x <= last.x; ++x)
+                    depth = max(depth, imageLoad(source, ivec2(x, y)).r);
+            }
+            imageStore(destination, texel, vec4(depth));
+        }
+    );
+
+    // Forward direction of a view matrix (the camera looks down -Z)
+    glm::vec3 UViewForward(const glm::mat4& view)
+    {
+        return -glm::vec3(view[0][2], view[1][2], view[2][2]);
+    }
+
+    // Camera position of a rigid view matrix
+    glm::vec3 UViewPosition(const glm::mat4& view)
+    {
+        const glm::vec3 translation(view[3]);
+        return -glm::vec3(glm::dot(glm::vec3(view[0][0], view[0][1], view[0][2]), translation),
+            glm::dot(glm::vec3(view[1][0], view[1][1], view[1][2]), translation),
+            glm::dot(glm::vec3(view[2][0], view[2][1], view[2][2]), translation));
+    }
+}
+
+
+bool UParseHiZArgs(int argc, char* argv[], HiZOptions& options)
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        const char* arg = argv[i];
+        if (strcmp(arg, "--hiz") == 0)
+        {
+            options.enabled = true;
+            continue;
+        }
+        if (strcmp(arg, "--hiz-max-move") != 0 && strcmp(arg, "--hiz-max-turn") != 0)
+            continue;
+
+        char* end = nullptr;
+        const float value = i + 1 < argc ? strtof(argv[i + 1], &end) : -1.0f;
+        if (!end || *end != '\0' || value < 0.0f)
+        {
+            cout << "Invalid value for " << arg << endl;
+            return false;
+        }
+        (strcmp(arg, "--hiz-max-move") == 0 ? options.maxMove : options.maxTurn) = value;
+        ++i;
+    }
+
+    return true;
+}
+
+
+bool HiZPyramid::create()
+{
+    destroy();
+
+    if (!UCreateComputeProgram(copyComputeShaderSource, copyProgram)
+        || !UCreateComputeProgram(reduceComputeShaderSource, reduceProgram))
+    {
+        destroy();
+        return false;
+    }
+    return true;
+}
+
+
+void HiZPyramid::destroy()
+{
+    GLStateCache& gl = UGLState();
+    gl.deleteProgram(copyProgram);
+    gl.deleteProgram(reduceProgram);
+    if (texture)
+        gl.deleteTextures(1, &texture);
+
+    *this = HiZPyramid();
+}
+
+
+void HiZPyramid::build(GLuint depthTexture, int width, int height, const glm::mat4& view, const glm::mat4& projection)
+{
+    if (!isCreated() || width <= 0 || height <= 0)
+        return;
+
+    // Immutable storage, so a new size needs a new texture
+    if (width != this->width || height != this->height)
+    {
+        if (texture)
+            UGLState().deleteTextures(1, &texture);
+
+        this->width = width;
+        this->height = height;
+        levels = UMipLevelCount(width, height);
+        texture = UCreateImmutableTexture(GL_R32F, width, height, levels, GL_NEAREST_MIPMAP_NEAREST, GL_NEAREST,
+            GL_CLAMP_TO_EDGE);
+    }
+
+    // Level 0: plain copy of the depth attachment
+    GLStateCache& gl = UGLState();
+    gl.useProgram(copyProgram);
+    gl.uniform2i(gl.getUniformLocation(copyProgram, "size"), width, height);
+    gl.bindTexture(0, depthTexture);
+    glBindImageTexture(0, texture, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+    glDispatchCompute((width + REDUCE_GROUP_SIZE - 1) / REDUCE_GROUP_SIZE, (height + REDUCE_GROUP_SIZE - 1) / REDUCE_GROUP_SIZE, 1);
+
+    // Remaining levels: 2x2 (3x3 at odd edges) max reduction of the level below
+    gl.useProgram(reduceProgram);
+    GLint sourceSizeLoc = gl.getUniformLocation(reduceProgram, "sourceSize");
+    GLint destinationSizeLoc = gl.getUniformLocation(reduceProgram, "destinationSize");
+    int sourceWidth = width;
+    int sourceHeight = height;
+    for (int level = 1; level < levels; ++level)
+    {
+        const int levelWidth = max(1, sourceWidth / 2);
+        const int levelHeight = max(1, sourceHeight / 2);
+
+        glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+        gl.uniform2i(sourceSizeLoc, sourceWidth, sourceHeight);
+        gl.uniform2i(destinationSizeLoc, levelWidth, levelHeight);
+        glBindImageTexture(0, texture, level - 1, GL_FALSE, 0, GL_READ_ONLY, GL_R32F);
+        glBindImageTexture(1, texture, level, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+        glDispatchCompute((levelWidth + REDUCE_GROUP_SIZE - 1) / REDUCE_GROUP_SIZE, (levelHeight + REDUCE_GROUP_SIZE - 1) / REDUCE_GROUP_SIZE, 1);
+
+        sourceWidth = levelWidth;
+        sourceHeight = levelHeight;
+    }
+
+    // The cull shader samples the pyramid as a texture
+    glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+    gl.useProgram(0);
+
+    this->view = view;
+    this->projection = projection;
+    viewProjection = projection * view;
+    valid = true;
+}
+
+
+bool HiZPyramid::canTest(const glm::mat4& view, const glm::mat4& projection, const HiZOptions& options) const
+{
+    if (!valid || projection != this->projection)
+        return false;
+
+    const float moved = glm::length(UViewPosition(view) - UViewPosition(this->view));
+    const float turnCos = glm::dot(UViewForward(view), UViewForward(this->view));
+    return moved <= options.maxMove && turnCos >= cos(glm::radians(options.maxTurn));
+}
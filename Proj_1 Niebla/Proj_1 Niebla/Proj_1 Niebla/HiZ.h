@@ -0,0 +1,71 @@
+///////////////////////////////////////////////////////////////////////////////
+// HiZ.h
+// =====
+// Hierarchical-Z occlusion culling for the GPU-driven stress scene. After a
+// frame is rendered its depth buffer is reduced into a mip pyramid where each
+// texel holds the farthest depth of the pixels it covers. On the next frame
+// the cull compute shader projects every instance's bounds with that frame's
+// view-projection and skips instances whose nearest depth lies behind the
+// pyramid texels covering them.
+//
+// The pyramid describes the previous frame, so objects revealed by a large
+// camera move would pop in a frame late. When the camera moved or turned
+// more than the configured limits (or the projection changed) the occlusion
+// test is skipped for that frame and only frustum culling runs.
+//
+// Usage:
+//   "Proj_1 Niebla" --instances 100000 --hiz [--hiz-max-move 0.25]
+//                   [--hiz-max-turn 2.0]
+// --hiz implies --gpu-cull.
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef HI_Z_H
+#define HI_Z_H
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+struct HiZOptions
+{
+    bool enabled = false;
+    float maxMove = 0.25f;      // camera travel per frame (world units) that still allows the test
+    float maxTurn = 2.0f;       // camera rotation per frame (degrees) that still allows the test
+};
+
+bool UParseHiZArgs(int argc, char* argv[], HiZOptions& options);
+
+class HiZPyramid
+{
+public:
+    bool create();
+    void destroy();
+    bool isCreated() const { return copyProgram != 0; }
+
+    // Reduces the first width x height pixels of depthTexture into the pyramid and
+    // remembers the camera they were rendered with
+    void build(GLuint depthTexture, int width, int height, const glm::mat4& view, const glm::mat4& projection);
+
+    // True when the pyramid is recent enough to test against for this camera
+    bool canTest(const glm::mat4& view, const glm::mat4& projection, const HiZOptions& options) const;
+
+    GLuint getTexture() const { return texture; }
+    int getWidth() const { return width; }
+    int getHeight() const { return height; }
+    int getLevels() const { return levels; }
+    const glm::mat4& getViewProjection() const { return viewProjection; }
+
+private:
+    GLuint copyProgram = 0;     // depth texture -> level 0
+    GLuint reduceProgram = 0;   // level n -> level n + 1
+    GLuint texture = 0;         // R32F with a full mip chain
+    int width = 0;
+    int height = 0;
+    int levels = 0;
+    bool valid = false;         // a frame has been reduced into the pyramid
+
+    glm::mat4 view;
+    glm::mat4 projection;
+    glm::mat4 viewProjection;
+};
+
+#endif
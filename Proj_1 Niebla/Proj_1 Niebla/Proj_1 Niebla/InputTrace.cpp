@@ -0,0 +1,318 @@
+#include "InputTrace.h"
+
+#include <cstring>
+#include <iostream>
+#include <iterator>
+
+using namespace std;
+
+namespace
+{
+    // File header: magic, the format version and (from version 2) the camera state at the start
+    const char TRACE_MAGIC[8] = { 'N', 'I', 'E', 'B', 'T', 'R', 'C', '1' };
+    const uint32_t TRACE_VERSION = 2;
+    const uint32_t TRACE_VERSION_NO_START = 1;
+
+    template <typename T>
+    void Write(ofstream& out, const T& value)
+    {
+        out.write(reinterpret_cast<const char*>(&value), sizeof(T));
+    }
+
+    void WriteCamera(ofstream& out, const CameraState& camera)
+    {
+        Write(out, camera.position.x);
+        Write(out, camera.position.y);
+        Write(out, camera.position.z);
+        Write(out, camera.yaw);
+        Write(out, camera.pitch);
+        Write(out, camera.zoom);
+        Write(out, camera.speed);
+        Write(out, (uint8_t)(camera.perspective ? 1 : 0));
+    }
+
+    // Bounds-checked reader over the loaded trace bytes
+    struct Reader
+    {
+        const vector<char>& data;
+        size_t offset;
+
+        template <typename T>
+        bool read(T& value)
+        {
+            if (offset + sizeof(T) > data.size())
+                return false;
+            memcpy(&value, data.data() + offset, sizeof(T));
+            offset += sizeof(T);
+            return true;
+        }
+
+        bool readCamera(CameraState& camera)
+        {
+            uint8_t perspective = 1;
+            const bool ok = read(camera.position.x) && read(camera.position.y) && read(camera.position.z)
+                && read(camera.yaw) && read(camera.pitch) && read(camera.zoom) && read(camera.speed)
+                && read(perspective);
+            camera.perspective = perspective != 0;
+            return ok;
+        }
+    };
+}
+
+
+bool UParseTraceArgs(int argc, char* argv[], TraceOptions& options)
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        string* path = nullptr;
+        if (strcmp(argv[i], "--record") == 0)
+            path = &options.recordPath;
+        else if (strcmp(argv[i], "--replay") == 0)
+            path = &options.replayPath;
+
+        if (path)
+        {
+            if (i + 1 >= argc)
+            {
+                cout << "Missing value for " << argv[i] << endl;
+                return false;
+            }
+            *path = argv[++i];
+        }
+    }
+
+    if (!options.recordPath.empty() && !options.replayPath.empty())
+    {
+        cout << "--record and --replay cannot be used together" << endl;
+        return false;
+    }
+
+    return true;
+}
+
+
+CameraState UCaptureCameraState(const Camera& camera, float speed, bool perspective)
+{
+    CameraState state;
+    state.position = camera.Position;
+    state.yaw = camera.Yaw;
+    state.pitch = camera.Pitch;
+    state.zoom = camera.Zoom;
+    state.speed = speed;
+    state.perspective = perspective;
+    return state;
+}
+
+
+void URestoreCameraState(const CameraState& state, Camera& camera, float& speed, bool& perspective)
+{
+    camera.Position = state.position;
+    camera.Yaw = state.yaw;
+    camera.Pitch = state.pitch;
+    camera.Zoom = state.zoom;
+    camera.ProcessMouseMovement(0.0f, 0.0f); // recomputes Front/Right/Up from the new angles
+    speed = state.speed;
+    perspective = state.perspective;
+}
+
+
+bool InputRecorder::open(const string& path, const CameraState& start)
+{
+    out.open(path, ios::binary | ios::trunc);
+    if (!out)
+    {
+        cout << "Failed to open input trace " << path << " for writing" << endl;
+        return false;
+    }
+
+    out.write(TRACE_MAGIC, sizeof(TRACE_MAGIC));
+    Write(out, TRACE_VERSION);
+    WriteCamera(out, start);
+    frameCount = 0;
+    return true;
+}
+
+
+void InputRecorder::close()
+{
+    if (out.is_open())
+        out.close();
+}
+
+
+void InputRecorder::recordFrame(float time, float deltaTime, uint8_t keyMask, const CameraState& camera)
+{
+    InputEvent event;
+    event.type = INPUT_EVENT_FRAME;
+    event.time = time;
+    event.deltaTime = deltaTime;
+    event.keyMask = keyMask;
+    event.camera = camera;
+    writeEvent(event);
+    frameCount++;
+}
+
+
+void InputRecorder::recordMouseMove(double x, double y)
+{
+    InputEvent event;
+    event.type = INPUT_EVENT_MOUSE_MOVE;
+    event.x = x;
+    event.y = y;
+    writeEvent(event);
+}
+
+
+void InputRecorder::recordScroll(double xoffset, double yoffset)
+{
+    InputEvent event;
+    event.type = INPUT_EVENT_SCROLL;
+    event.x = xoffset;
+    event.y = yoffset;
+    writeEvent(event);
+}
+
+
+void InputRecorder::recordKey(int key, int action)
+{
+    InputEvent event;
+    event.type = INPUT_EVENT_KEY;
+    event.key = key;
+    event.action = action;
+    writeEvent(event);
+}
+
+
+// Each event is a type byte followed by only the fields that type uses
+void InputRecorder::writeEvent(const InputEvent& event)
+{
+    if (!out.is_open())
+        return;
+
+    Write(out, event.type);
+    switch (event.type)
+    {
+    case INPUT_EVENT_FRAME:
+        Write(out, event.time);
+        Write(out, event.deltaTime);
+        Write(out, event.keyMask);
+        WriteCamera(out, event.camera);
+        break;
+
+    case INPUT_EVENT_MOUSE_MOVE:
+    case INPUT_EVENT_SCROLL:
+        Write(out, event.x);
+        Write(out, event.y);
+        break;
+
+    case INPUT_EVENT_KEY:
+        Write(out, event.key);
+        Write(out, event.action);
+        break;
+    }
+}
+
+
+bool InputReplayer::open(const string& path)
+{
+    ifstream in(path, ios::binary);
+    if (!in)
+    {
+        cout << "Failed to open input trace " << path << endl;
+        return false;
+    }
+
+    vector<char> data((istreambuf_iterator<char>(in)), istreambuf_iterator<char>());
+    Reader reader = { data, 0 };
+
+    uint32_t version = 0;
+    reader.offset = sizeof(TRACE_MAGIC);
+    if (data.size() < sizeof(TRACE_MAGIC) + sizeof(version) || memcmp(data.data(), TRACE_MAGIC, sizeof(TRACE_MAGIC)) != 0
+        || !reader.read(version) || (version != TRACE_VERSION && version != TRACE_VERSION_NO_START))
+    {
+        cout << "Not a supported input trace: " << path << endl;
+        return false;
+    }
+
+    // Traces from before the start state was recorded replay from whatever the camera is
+    hasStart = version == TRACE_VERSION;
+    if (hasStart && !reader.readCamera(start))
+    {
+        cout << "Not a supported input trace: " << path << endl;
+        return false;
+    }
+
+    events.clear();
+    frameCount = 0;
+    while (reader.offset < data.size())
+    {
+        InputEvent event;
+        bool ok = reader.read(event.type);
+        switch (event.type)
+        {
+        case INPUT_EVENT_FRAME:
+            ok = ok && reader.read(event.time) && reader.read(event.deltaTime) && reader.read(event.keyMask)
+                && reader.readCamera(event.camera);
+            frameCount++;
+            break;
+
+        case INPUT_EVENT_MOUSE_MOVE:
+        case INPUT_EVENT_SCROLL:
+            ok = ok && reader.read(event.x) && reader.read(event.y);
+            break;
+
+        case INPUT_EVENT_KEY:
+            ok = ok && reader.read(event.key) && reader.read(event.action);
+            break;
+
+        default:
+            ok = false;
+            break;
+        }
+
+        if (!ok)
+        {
+            // A truncated tail (e.g. the recording process was killed) still replays up to the last full event
+            cout << "WARNING: input trace " << path << " is truncated or corrupt after " << frameCount << " frames" << endl;
+            break;
+        }
+        events.push_back(event);
+    }
+
+    cursor = 0;
+    loaded = true;
+    return true;
+}
+
+
+bool InputReplayer::getStartState(CameraState& state) const
+{
+    if (hasStart)
+        state = start;
+    return hasStart;
+}
+
+
+bool InputReplayer::nextFrame(vector<InputEvent>& frameEvents, InputEvent& frame)
+{
+    frameEvents.clear();
+    while (cursor < events.size())
+    {
+        const InputEvent& event = events[cursor++];
+        if (event.type == INPUT_EVENT_FRAME)
+        {
+            frame = event;
+            return true;
+        }
+        frameEvents.push_back(event);
+    }
+    return false;
+}
+
+
+void InputReplayer::checkDivergence(const CameraState& recorded, const CameraState& replayed)
+{
+    float distance = glm::length(recorded.position - replayed.position);
+    if (distance > maxDivergence)
+        maxDivergence = distance;
+}
@@ -0,0 +1,140 @@
+///////////////////////////////////////////////////////////////////////////////
+// InputTrace.h
+// ============
+// Records the input that drives the camera (sampled movement keys, mouse,
+// scroll and key events) together with the per-frame camera state into a
+// compact binary trace, and plays such a trace back deterministically.
+//
+// Usage:
+//   "Proj_1 Niebla" --record session.trace     // interactive run, records
+//   "Proj_1 Niebla" --replay session.trace     // replays it, then exits
+//   "Proj_1 Niebla" --bench --replay session.trace
+//
+// During playback the simulation advances with the delta time stored in
+// the trace instead of the wall clock, so every replay produces the same
+// frames regardless of how fast the replaying machine renders. The trace
+// also holds the camera state the recording started from, which replay
+// restores before the first frame.
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef INPUT_TRACE_H
+#define INPUT_TRACE_H
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <GL/glew.h>        // GLboolean used by the camera
+#include <learnOpengl/camera.h> // Camera class
+
+// Bits of the movement key mask sampled once per frame
+enum InputKeyBits
+{
+    INPUT_KEY_FORWARD = 1 << 0,     // W
+    INPUT_KEY_BACKWARD = 1 << 1,    // S
+    INPUT_KEY_LEFT = 1 << 2,        // A
+    INPUT_KEY_RIGHT = 1 << 3,       // D
+    INPUT_KEY_UP = 1 << 4,          // Q
+    INPUT_KEY_DOWN = 1 << 5         // E
+};
+
+enum InputEventType
+{
+    INPUT_EVENT_FRAME = 1,          // start of a frame: key mask, delta time and camera state
+    INPUT_EVENT_MOUSE_MOVE = 2,
+    INPUT_EVENT_SCROLL = 3,
+    INPUT_EVENT_KEY = 4
+};
+
+// Camera state captured at the end of a frame's input processing
+struct CameraState
+{
+    glm::vec3 position;
+    float yaw = 0.0f;
+    float pitch = 0.0f;
+    float zoom = 0.0f;
+    float speed = 0.0f;             // cameraSpeed, changed by the scroll wheel
+    bool perspective = true;
+};
+
+struct InputEvent
+{
+    uint8_t type = 0;
+    uint8_t keyMask = 0;            // INPUT_EVENT_FRAME
+    float time = 0.0f;              // INPUT_EVENT_FRAME, seconds since start
+    float deltaTime = 0.0f;         // INPUT_EVENT_FRAME
+    double x = 0.0;                 // mouse position or scroll offset
+    double y = 0.0;
+    int32_t key = 0;                // INPUT_EVENT_KEY
+    int32_t action = 0;
+    CameraState camera;             // INPUT_EVENT_FRAME, state after the frame's input
+};
+
+struct TraceOptions
+{
+    std::string recordPath;
+    std::string replayPath;
+};
+
+bool UParseTraceArgs(int argc, char* argv[], TraceOptions& options);
+
+CameraState UCaptureCameraState(const Camera& camera, float speed, bool perspective);
+void URestoreCameraState(const CameraState& state, Camera& camera, float& speed, bool& perspective);
+
+// Writes events as they happen; frames are written after their input was applied
+class InputRecorder
+{
+public:
+    // start: the camera state before the first recorded frame
+    bool open(const std::string& path, const CameraState& start);
+    bool isOpen() const { return out.is_open(); }
+    void close();
+
+    void recordFrame(float time, float deltaTime, uint8_t keyMask, const CameraState& camera);
+    void recordMouseMove(double x, double y);
+    void recordScroll(double xoffset, double yoffset);
+    void recordKey(int key, int action);
+
+    unsigned int getFrameCount() const { return frameCount; }
+
+private:
+    void writeEvent(const InputEvent& event);
+
+    std::ofstream out;
+    unsigned int frameCount = 0;
+};
+
+// Loads a whole trace and hands it back one frame at a time
+class InputReplayer
+{
+public:
+    bool open(const std::string& path);
+    bool isOpen() const { return loaded; }
+    bool finished() const { return cursor >= events.size(); }
+    bool atStart() const { return cursor == 0; }
+
+    // Camera state the recording started from; false for traces that do not store it
+    bool getStartState(CameraState& state) const;
+
+    // Returns the events that precede the next frame marker plus the marker itself.
+    // Returns false once the trace is exhausted.
+    bool nextFrame(std::vector<InputEvent>& frameEvents, InputEvent& frame);
+
+    unsigned int getFrameCount() const { return frameCount; }
+
+    // Largest distance seen between a recorded and a replayed camera position
+    void checkDivergence(const CameraState& recorded, const CameraState& replayed);
+    float getMaxDivergence() const { return maxDivergence; }
+
+private:
+    std::vector<InputEvent> events;
+    size_t cursor = 0;
+    unsigned int frameCount = 0;
+    bool loaded = false;
+    CameraState start;
+    bool hasStart = false;
+    float maxDivergence = 0.0f;
+};
+
+#endif
@@ -0,0 +1,219 @@
+#include "JobSystem.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+using namespace std;
+
+namespace
+{
+    const size_t INITIAL_QUEUE_CAPACITY = 256;
+
+    // The system and worker index the current thread belongs to
+    thread_local const JobSystem* tlsSystem = nullptr;
+    thread_local int tlsWorker = 0;
+}
+
+
+bool UParseJobArgs(int argc, char* argv[], JobOptions& options)
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        const char* arg = argv[i];
+        if (strcmp(arg, "--jobs") == 0)
+        {
+            char* end = nullptr;
+            if (i + 1 < argc)
+                options.threads = (int)strtol(argv[++i], &end, 10);
+            if (!end || *end != '\0' || options.threads < 0 || options.threads > MAX_JOB_THREADS)
+            {
+                cout << "Invalid value for " << arg << endl;
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+
+JobSystem::JobSystem(int threads)
+{
+    if (threads <= 0)
+        threads = (int)thread::hardware_concurrency();
+    threadCount = min(max(threads, 1), MAX_JOB_THREADS);
+
+    queues.reserve(threadCount);
+    for (int i = 0; i < threadCount; ++i)
+    {
+        queues.emplace_back(new Queue());
+        queues.back()->ring.resize(INITIAL_QUEUE_CAPACITY);
+    }
+
+    // The constructing thread is worker 0
+    tlsSystem = this;
+    tlsWorker = 0;
+
+    workers.reserve(threadCount - 1);
+    for (int i = 1; i < threadCount; ++i)
+        workers.emplace_back(&JobSystem::workerLoop, this, i);
+}
+
+
+JobSystem::~JobSystem()
+{
+    {
+        lock_guard<mutex> lock(sleepMutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (thread& worker : workers)
+        worker.join();
+
+    if (tlsSystem == this)
+        tlsSystem = nullptr;
+}
+
+
+void JobSystem::run(JobFunction function, void* data, size_t begin, size_t end, JobCounter* counter)
+{
+    if (counter)
+        counter->pending.fetch_add(1, memory_order_relaxed);
+
+    Job job;
+    job.function = function;
+    job.data = data;
+    job.begin = begin;
+    job.end = end;
+    job.counter = counter;
+
+    Queue& queue = *queues[getWorkerIndex()];
+    {
+        lock_guard<mutex> lock(queue.mutex);
+        const size_t capacity = queue.ring.size();
+        if (queue.count == capacity)
+        {
+            // Unroll the ring into a buffer twice the size
+            vector<Job> grown(capacity * 2);
+            for (size_t i = 0; i < queue.count; ++i)
+                grown[i] = queue.ring[(queue.head + i) & (capacity - 1)];
+            queue.ring.swap(grown);
+            queue.head = 0;
+        }
+        queue.ring[(queue.head + queue.count) & (queue.ring.size() - 1)] = job;
+        queue.count++;
+    }
+
+    {
+        lock_guard<mutex> lock(sleepMutex);
+        queued++;
+    }
+    wake.notify_one();
+}
+
+
+void JobSystem::wait(JobCounter& counter)
+{
+    const int worker = getWorkerIndex();
+    while (!counter.isDone())
+    {
+        // Help with whatever is queued; the last jobs may be running elsewhere
+        if (!runOne(worker))
+            this_thread::yield();
+    }
+}
+
+
+void JobSystem::parallelFor(size_t count, size_t grain, JobFunction function, void* data)
+{
+    if (count == 0)
+        return;
+    grain = max<size_t>(grain, 1);
+
+    const size_t ranges = (count + grain - 1) / grain;
+    if (ranges == 1 || threadCount == 1)
+    {
+        for (size_t begin = 0; begin < count; begin += grain)
+            function(data, begin, min(begin + grain, count));
+        return;
+    }
+
+    // Queue the later ranges back to front, so this thread pops range 1 next
+    // while thieves take the far end, and run range 0 right away
+    JobCounter counter;
+    for (size_t range = ranges - 1; range > 0; --range)
+    {
+        const size_t begin = range * grain;
+        run(function, data, begin, min(begin + grain, count), &counter);
+    }
+    function(data, 0, min(grain, count));
+    wait(counter);
+}
+
+
+int JobSystem::getWorkerIndex() const
+{
+    return tlsSystem == this ? tlsWorker : 0;
+}
+
+
+bool JobSystem::runOne(int worker)
+{
+    Job job;
+    bool found = false;
+
+    {
+        Queue& own = *queues[worker];
+        lock_guard<mutex> lock(own.mutex);
+        if (own.count)
+        {
+            own.count--;
+            job = own.ring[(own.head + own.count) & (own.ring.size() - 1)];
+            found = true;
+        }
+    }
+
+    for (int offset = 1; !found && offset < threadCount; ++offset)
+    {
+        Queue& victim = *queues[(worker + offset) % threadCount];
+        lock_guard<mutex> lock(victim.mutex);
+        if (victim.count)
+        {
+            job = victim.ring[victim.head];
+            victim.head = (victim.head + 1) & (victim.ring.size() - 1);
+            victim.count--;
+            found = true;
+            steals.fetch_add(1, memory_order_relaxed);
+        }
+    }
+
+    if (!found)
+        return false;
+
+    queued--;
+    job.function(job.data, job.begin, job.end);
+    jobsRun.fetch_add(1, memory_order_relaxed);
+    if (job.counter)
+        job.counter->pending.fetch_sub(1, memory_order_release);
+    return true;
+}
+
+
+void JobSystem::workerLoop(int index)
+{
+    tlsSystem = this;
+    tlsWorker = index;
+
+    for (;;)
+    {
+        if (runOne(index))
+            continue;
+
+        unique_lock<mutex> lock(sleepMutex);
+        wake.wait(lock, [this]() { return stopping || queued > 0; });
+        if (stopping)
+            return;
+    }
+}
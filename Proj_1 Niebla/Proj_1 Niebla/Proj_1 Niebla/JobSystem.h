@@ -0,0 +1,145 @@
+///////////////////////////////////////////////////////////////////////////////
+// JobSystem.h
+// ===========
+// Work-stealing job system for the per-frame CPU stages (transform updates,
+// culling, draw list sorting) so they use every core while GL submission
+// stays on the context thread.
+//
+// Every thread owns a deque of jobs. A thread pushes and pops at the back of
+// its own deque (newest first, which keeps a range split's data warm) and,
+// when that is empty, steals from the front of another thread's deque
+// (oldest first, usually the largest remaining piece of work). The deques
+// are short and each has its own mutex, so contention only happens on
+// steals. A job is a function pointer, its data and an index range, and the
+// deques are rings that only grow, so once they have reached their peak
+// depth queuing work never touches the heap.
+//
+// The thread that creates the system counts as worker 0: it runs jobs while
+// it waits on a counter instead of blocking, so threads = 1 runs everything
+// inline on the caller.
+//
+// Completion is tracked with JobCounter: run() increments it, the job's
+// completion decrements it, and wait() helps until it reaches zero. A stage
+// that depends on another simply waits on the other stage's counter before
+// submitting its own jobs.
+//
+// Usage:
+//   "Proj_1 Niebla" [--jobs 8]      (0: one thread per hardware thread)
+//
+//   JobSystem jobs(4);
+//   jobs.parallelFor(count, 1024, [&](size_t begin, size_t end) { ... });
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef JOB_SYSTEM_H
+#define JOB_SYSTEM_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+struct JobOptions
+{
+    int threads = 0;            // 0: one per hardware thread
+};
+
+const int MAX_JOB_THREADS = 64;
+
+bool UParseJobArgs(int argc, char* argv[], JobOptions& options);
+
+// Runs the job's work on [begin, end)
+typedef void (*JobFunction)(void* data, size_t begin, size_t end);
+
+// Number of jobs still pending; shared by the jobs of one stage
+class JobCounter
+{
+public:
+    bool isDone() const { return pending.load(std::memory_order_acquire) == 0; }
+
+private:
+    friend class JobSystem;
+    std::atomic<int> pending{ 0 };
+};
+
+class JobSystem
+{
+public:
+    explicit JobSystem(int threads = 0);
+    ~JobSystem();
+
+    JobSystem(const JobSystem&) = delete;
+    JobSystem& operator=(const JobSystem&) = delete;
+
+    // Queues function(data, begin, end) on the calling thread's deque; counter,
+    // if given, is incremented now and decremented when the job has run.
+    // data must outlive the job.
+    void run(JobFunction function, void* data, size_t begin, size_t end, JobCounter* counter = nullptr);
+
+    // Runs queued jobs until counter reaches zero
+    void wait(JobCounter& counter);
+
+    // Calls body(begin, end) over [0, count) in ranges of at most grain
+    // elements and returns when all have run. Ranges are contiguous and
+    // ascending, so a body can use begin / grain as a chunk index.
+    template <typename Body>
+    void parallelFor(size_t count, size_t grain, const Body& body)
+    {
+        parallelFor(count, grain, &InvokeRange<Body>, const_cast<Body*>(&body));
+    }
+    void parallelFor(size_t count, size_t grain, JobFunction function, void* data);
+
+    int getThreadCount() const { return threadCount; }
+
+    // Index of the calling thread in [0, getThreadCount()); threads outside the pool share 0
+    int getWorkerIndex() const;
+
+    // Since construction, for checking the balance of a stage
+    unsigned long long getJobsRun() const { return jobsRun.load(std::memory_order_relaxed); }
+    unsigned long long getSteals() const { return steals.load(std::memory_order_relaxed); }
+
+private:
+    struct Job
+    {
+        JobFunction function = nullptr;
+        void* data = nullptr;
+        size_t begin = 0;
+        size_t end = 0;
+        JobCounter* counter = nullptr;
+    };
+
+    // Ring buffer deque; capacity is a power of two and doubles when full
+    struct Queue
+    {
+        std::mutex mutex;
+        std::vector<Job> ring;
+        size_t head = 0;            // front element
+        size_t count = 0;
+    };
+
+    template <typename Body>
+    static void InvokeRange(void* data, size_t begin, size_t end)
+    {
+        (*static_cast<const Body*>(data))(begin, end);
+    }
+
+    bool runOne(int worker);
+    void workerLoop(int index);
+
+    int threadCount = 1;
+    std::vector<std::unique_ptr<Queue>> queues;
+    std::vector<std::thread> workers;
+
+    // Idle workers sleep until a job is queued
+    std::mutex sleepMutex;
+    std::condition_variable wake;
+    std::atomic<int> queued{ 0 };
+    bool stopping = false;
+
+    std::atomic<unsigned long long> jobsRun{ 0 };
+    std::atomic<unsigned long long> steals{ 0 };
+};
+
+#endif
@@ -0,0 +1,180 @@
+#include "Lz4.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+using namespace std;
+
+namespace
+{
+    const size_t MIN_MATCH = 4;
+    const size_t LAST_LITERALS = 5;     // a block ends in at least this many literals
+    const size_t MATCH_FIND_LIMIT = 12; // and its last match starts at least this far from the end
+    const size_t MAX_OFFSET = 65535;
+    const int HASH_BITS = 12;
+    const int SKIP_SHIFT = 6;           // after 2^SKIP_SHIFT misses, probe every other position, and so on
+
+    uint32_t read32(const unsigned char* bytes)
+    {
+        uint32_t value;
+        memcpy(&value, bytes, sizeof(value));
+        return value;
+    }
+
+    uint32_t hashSequence(uint32_t sequence)
+    {
+        return (sequence * 2654435761u) >> (32 - HASH_BITS);
+    }
+
+    // Rest of a length past the 15 its token nibble holds
+    void writeLength(vector<unsigned char>& out, size_t length)
+    {
+        length -= 15;
+        while (length >= 255)
+        {
+            out.push_back(255);
+            length -= 255;
+        }
+        out.push_back((unsigned char)length);
+    }
+
+    bool readLength(const unsigned char* in, size_t size, size_t& position, size_t& length)
+    {
+        unsigned char byte;
+        do
+        {
+            if (position >= size)
+                return false;
+            byte = in[position++];
+            length += byte;
+        } while (byte == 255);
+        return true;
+    }
+
+    void writeLiterals(vector<unsigned char>& out, const unsigned char* literals, size_t count, unsigned char matchNibble)
+    {
+        out.push_back((unsigned char)((min(count, (size_t)15) << 4) | matchNibble));
+        if (count >= 15)
+            writeLength(out, count);
+        out.insert(out.end(), literals, literals + count);
+    }
+}
+
+
+void ULz4Compress(const unsigned char* data, size_t size, vector<unsigned char>& compressed)
+{
+    compressed.clear();
+    compressed.reserve(size + size / 255 + 16);
+
+    // Positions + 1 of the last 4-byte sequence with each hash, 0 when none
+    uint32_t table[1 << HASH_BITS] = {};
+    size_t anchor = 0;
+    size_t position = 0;
+    if (size >= MATCH_FIND_LIMIT + 1)
+    {
+        const size_t matchEnd = size - LAST_LITERALS;
+        unsigned misses = 0;
+        while (position + MATCH_FIND_LIMIT <= size)
+        {
+            const uint32_t sequence = read32(data + position);
+            uint32_t& slot = table[hashSequence(sequence)];
+            const size_t candidate = slot;
+            slot = (uint32_t)position + 1;
+
+            if (candidate == 0 || position - (candidate - 1) > MAX_OFFSET || read32(data + candidate - 1) != sequence)
+            {
+                position += 1 + (misses++ >> SKIP_SHIFT);
+                continue;
+            }
+            misses = 0;
+
+            size_t match = candidate - 1;
+            size_t length = MIN_MATCH;
+            while (position + length < matchEnd && data[match + length] == data[position + length])
+                ++length;
+            while (position > anchor && match > 0 && data[position - 1] == data[match - 1])
+            {
+                --position;
+                --match;
+                ++length;
+            }
+
+            const size_t offset = position - match;
+            const size_t matchLength = length - MIN_MATCH;
+            writeLiterals(compressed, data + anchor, position - anchor, (unsigned char)min(matchLength, (size_t)15));
+            compressed.push_back((unsigned char)(offset & 0xFF));
+            compressed.push_back((unsigned char)(offset >> 8));
+            if (matchLength >= 15)
+                writeLength(compressed, matchLength);
+
+            position += length;
+            anchor = position;
+            // The position two back is likely to start the next repeat as well
+            if (position + MATCH_FIND_LIMIT <= size)
+                table[hashSequence(read32(data + position - 2))] = (uint32_t)(position - 2) + 1;
+        }
+    }
+
+    writeLiterals(compressed, data + anchor, size - anchor, 0);
+}
+
+
+bool ULz4Decompress(const unsigned char* compressed, size_t compressedSize, unsigned char* output, size_t size)
+{
+    size_t in = 0;
+    size_t out = 0;
+    while (in < compressedSize)
+    {
+        const unsigned char token = compressed[in++];
+
+        size_t literals = token >> 4;
+        if (literals == 15 && !readLength(compressed, compressedSize, in, literals))
+            return false;
+        if (literals > compressedSize - in || literals > size - out)
+            return false;
+        if (literals > 0)
+            memcpy(output + out, compressed + in, literals);
+        in += literals;
+        out += literals;
+
+        // The last sequence has literals only
+        if (in == compressedSize)
+            break;
+
+        if (compressedSize - in < 2)
+            return false;
+        const size_t offset = compressed[in] | (size_t)compressed[in + 1] << 8;
+        in += 2;
+        if (offset == 0 || offset > out)
+            return false;
+
+        size_t length = token & 15;
+        if (length == 15 && !readLength(compressed, compressedSize, in, length))
+            return false;
+        length += MIN_MATCH;
+        if (length > size - out)
+            return false;
+
+        // A match may overlap what it writes: copy in steps no longer than the offset
+        const unsigned char* source = output + out - offset;
+        unsigned char* target = output + out;
+        if (offset >= length)
+        {
+            memcpy(target, source, length);
+        }
+        else if (offset >= 8)
+        {
+            for (size_t i = 0; i < length; i += 8)
+                memcpy(target + i, source + i, min((size_t)8, length - i));
+        }
+        else
+        {
+            for (size_t i = 0; i < length; ++i)
+                target[i] = source[i];
+        }
+        out += length;
+    }
+
+    return out == size;
+}
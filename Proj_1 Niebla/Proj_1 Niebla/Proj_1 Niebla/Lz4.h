@@ -0,0 +1,33 @@
+///////////////////////////////////////////////////////////////////////////////
+// Lz4.h
+// =====
+// LZ4 block format (no frame header, no checksums): literal runs and
+// back references of at least 4 bytes within the last 64 KB. Decoding is
+// a loop of copies, fast enough that a compressed asset is ready sooner
+// than the extra bytes of the uncompressed one could be read from disk.
+//
+// The compressor is the greedy single-probe hash search of LZ4's fast mode,
+// skipping ahead faster through data that does not compress. Blocks are
+// interchangeable with the reference implementation's LZ4_compress_default
+// and LZ4_decompress_safe.
+//
+// Usage:
+//   std::vector<unsigned char> packed;
+//   ULz4Compress(data, size, packed);
+//   ULz4Decompress(packed.data(), packed.size(), output, size);
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef LZ4_H
+#define LZ4_H
+
+#include <cstddef>
+#include <vector>
+
+// Replaces compressed with the block for size bytes of data
+void ULz4Compress(const unsigned char* data, size_t size, std::vector<unsigned char>& compressed);
+
+// Decodes a block into exactly size bytes of output; false when the block is
+// corrupt or decodes to another size. Never reads or writes out of bounds.
+bool ULz4Decompress(const unsigned char* compressed, size_t compressedSize, unsigned char* output, size_t size);
+
+#endif
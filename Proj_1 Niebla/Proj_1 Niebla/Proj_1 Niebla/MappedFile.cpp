@@ -0,0 +1,131 @@
+#include "MappedFile.h"
+
+#include <algorithm>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+
+#ifdef _WIN32
+
+bool MappedFile::open(const string& path)
+{
+    close();
+
+    HANDLE handle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+        FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (handle == INVALID_HANDLE_VALUE)
+        return false;
+    file = handle;
+
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(handle, &fileSize))
+    {
+        close();
+        return false;
+    }
+    // Empty files cannot be mapped, and have nothing to map
+    if (fileSize.QuadPart == 0)
+        return true;
+
+    mapping = CreateFileMappingA(handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    data = mapping ? static_cast<const unsigned char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0)) : nullptr;
+    if (!data)
+    {
+        close();
+        return false;
+    }
+    size = (size_t)fileSize.QuadPart;
+    return true;
+}
+
+
+void MappedFile::close()
+{
+    if (data)
+        UnmapViewOfFile(data);
+    if (mapping)
+        CloseHandle(mapping);
+    if (file)
+        CloseHandle(file);
+    data = nullptr;
+    size = 0;
+    mapping = nullptr;
+    file = nullptr;
+}
+
+
+void MappedFile::prefetch(size_t offset, size_t bytes) const
+{
+    if (!data || offset >= size)
+        return;
+    WIN32_MEMORY_RANGE_ENTRY range;
+    range.VirtualAddress = const_cast<unsigned char*>(data) + offset;
+    range.NumberOfBytes = min(bytes, size - offset);
+    PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+}
+
+#else
+
+bool MappedFile::open(const string& path)
+{
+    close();
+
+    descriptor = ::open(path.c_str(), O_RDONLY);
+    if (descriptor < 0)
+        return false;
+
+    struct stat status;
+    if (fstat(descriptor, &status) != 0)
+    {
+        close();
+        return false;
+    }
+    // Empty files cannot be mapped, and have nothing to map
+    if (status.st_size == 0)
+        return true;
+
+    void* view = mmap(nullptr, (size_t)status.st_size, PROT_READ, MAP_PRIVATE, descriptor, 0);
+    if (view == MAP_FAILED)
+    {
+        close();
+        return false;
+    }
+    data = static_cast<const unsigned char*>(view);
+    size = (size_t)status.st_size;
+    return true;
+}
+
+
+void MappedFile::close()
+{
+    if (data)
+        munmap(const_cast<unsigned char*>(data), size);
+    if (descriptor >= 0)
+        ::close(descriptor);
+    data = nullptr;
+    size = 0;
+    descriptor = -1;
+}
+
+
+void MappedFile::prefetch(size_t offset, size_t bytes) const
+{
+    if (!data || offset >= size)
+        return;
+    // madvise wants a page-aligned start
+    const size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    const size_t start = offset / page * page;
+    madvise(const_cast<unsigned char*>(data) + start, min(bytes, size - offset) + (offset - start), MADV_WILLNEED);
+}
+
+#endif
@@ -0,0 +1,57 @@
+///////////////////////////////////////////////////////////////////////////////
+// MappedFile.h
+// ============
+// Read-only memory mapping of a whole file (mmap, or a file mapping on
+// Windows). Pages are read in by the OS as they are touched, so data can be
+// used in place, without reading it into a buffer first.
+//
+// Usage:
+//   MappedFile file;
+//   if (file.open("scene.nmesh"))
+//   {
+//       file.prefetch(0, file.getSize());     // start reading ahead
+//       use(file.getData(), file.getSize());
+//   }
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <cstddef>
+#include <string>
+
+class MappedFile
+{
+public:
+    MappedFile() {}
+    ~MappedFile() { close(); }
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    // Fails for missing files; an empty file opens with no data and size 0
+    bool open(const std::string& path);
+    void close();
+
+#ifdef _WIN32
+    bool isOpen() const { return file != nullptr; }
+#else
+    bool isOpen() const { return descriptor >= 0; }
+#endif
+    const unsigned char* getData() const { return data; }      // nullptr when empty
+    size_t getSize() const { return size; }
+
+    // Asks the OS to read the range in ahead of use; returns at once
+    void prefetch(size_t offset, size_t bytes) const;
+
+private:
+    const unsigned char* data = nullptr;
+    size_t size = 0;
+#ifdef _WIN32
+    void* file = nullptr;       // HANDLEs
+    void* mapping = nullptr;
+#else
+    int descriptor = -1;
+#endif
+};
+
+#endif
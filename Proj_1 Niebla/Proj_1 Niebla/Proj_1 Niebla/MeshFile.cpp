@@ -0,0 +1,269 @@
+#include "MeshFile.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+#include "Resources.h"
+
+using namespace std;
+
+namespace
+{
+    const char MAGIC[4] = { 'N', 'M', 'S', 'H' };
+
+    uint64_t alignUp(uint64_t offset)
+    {
+        return (offset + MESH_FILE_ALIGNMENT - 1) / MESH_FILE_ALIGNMENT * MESH_FILE_ALIGNMENT;
+    }
+
+    // True when [offset, offset + bytes) lies within size bytes
+    bool inside(uint64_t offset, uint64_t bytes, uint64_t size)
+    {
+        return offset <= size && bytes <= size - offset;
+    }
+
+    // String at offset in the table, null when it runs past the end
+    const char* tableString(const char* table, uint64_t tableBytes, uint32_t offset)
+    {
+        if (offset >= tableBytes)
+            return nullptr;
+        const void* terminator = memchr(table + offset, '\0', (size_t)(tableBytes - offset));
+        return terminator ? table + offset : nullptr;
+    }
+
+    void computeBounds(const float* vertices, uint32_t vertexCount, MeshFileEntry& entry)
+    {
+        glm::vec3 lower(0.0f), upper(0.0f);
+        for (uint32_t i = 0; i < vertexCount; ++i)
+        {
+            const float* position = vertices + (size_t)i * MESH_FILE_FLOATS_PER_VERTEX;
+            const glm::vec3 point(position[0], position[1], position[2]);
+            lower = i == 0 ? point : glm::min(lower, point);
+            upper = i == 0 ? point : glm::max(upper, point);
+        }
+
+        const glm::vec3 center = (lower + upper) * 0.5f;
+        float radius = 0.0f;
+        for (uint32_t i = 0; i < vertexCount; ++i)
+        {
+            const float* position = vertices + (size_t)i * MESH_FILE_FLOATS_PER_VERTEX;
+            radius = max(radius, glm::length(glm::vec3(position[0], position[1], position[2]) - center));
+        }
+
+        for (int axis = 0; axis < 3; ++axis)
+        {
+            entry.lower[axis] = lower[axis];
+            entry.upper[axis] = upper[axis];
+            entry.sphere[axis] = center[axis];
+        }
+        entry.sphere[3] = radius;
+    }
+
+    bool writePadding(ofstream& file, uint64_t offset)
+    {
+        static const char zeros[MESH_FILE_ALIGNMENT] = {};
+        const uint64_t padding = alignUp(offset) - offset;
+        return (bool)file.write(zeros, (streamsize)padding);
+    }
+}
+
+
+bool UParseMeshFileArgs(int argc, char* argv[], MeshFileOptions& options)
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        const char* arg = argv[i];
+        string* path = nullptr;
+        if (strcmp(arg, "--save-meshes") == 0)
+            path = &options.savePath;
+        else if (strcmp(arg, "--load-meshes") == 0)
+            path = &options.loadPath;
+        else
+            continue;
+
+        const char* value = i + 1 < argc ? argv[++i] : "";
+        if (value[0] == '\0')
+        {
+            cout << "Invalid value for " << arg << endl;
+            return false;
+        }
+        *path = value;
+    }
+
+    return true;
+}
+
+
+bool UWriteMeshFile(const string& path, const vector<MeshFileSource>& meshes)
+{
+    // Lay out the table, the strings and the blobs before writing anything
+    MeshFileHeader header = {};
+    memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version = MESH_FILE_VERSION;
+    header.headerBytes = sizeof(MeshFileHeader);
+    header.entryBytes = sizeof(MeshFileEntry);
+    header.meshCount = (uint32_t)meshes.size();
+    header.meshTableOffset = sizeof(MeshFileHeader);
+
+    string strings;
+    vector<MeshFileEntry> entries(meshes.size());
+    for (size_t i = 0; i < meshes.size(); ++i)
+    {
+        MeshFileEntry& entry = entries[i];
+        entry.name = (uint32_t)strings.size();
+        strings.append(meshes[i].name).push_back('\0');
+        entry.material = MESH_FILE_NO_STRING;
+        if (!meshes[i].material.empty())
+        {
+            entry.material = (uint32_t)strings.size();
+            strings.append(meshes[i].material).push_back('\0');
+        }
+    }
+    header.stringTableOffset = header.meshTableOffset + entries.size() * sizeof(MeshFileEntry);
+    header.stringTableBytes = strings.size();
+
+    // The scene draws unindexed triangles, so no index blobs are written
+    uint64_t offset = header.stringTableOffset + header.stringTableBytes;
+    for (size_t i = 0; i < meshes.size(); ++i)
+    {
+        const MeshFileSource& mesh = meshes[i];
+        MeshFileEntry& entry = entries[i];
+        entry.floatsPerVertex = MESH_FILE_FLOATS_PER_VERTEX;
+        entry.vertexCount = mesh.vertexCount;
+        entry.vertexOffset = alignUp(offset);
+        entry.vertexBytes = (uint64_t)mesh.vertexCount * MESH_FILE_FLOATS_PER_VERTEX * sizeof(float);
+        entry.indexOffset = 0;
+        entry.indexCount = 0;
+        entry.indexSize = 0;
+        entry.contentHash = UMeshContentHash(mesh.vertices, (size_t)entry.vertexBytes);
+        computeBounds(mesh.vertices, mesh.vertexCount, entry);
+        offset = entry.vertexOffset + entry.vertexBytes;
+    }
+    header.fileBytes = offset;
+
+    ofstream file(path, ios::binary | ios::trunc);
+    if (!file)
+    {
+        cout << "Failed to create mesh file " << path << endl;
+        return false;
+    }
+
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char*>(entries.data()), (streamsize)(entries.size() * sizeof(MeshFileEntry)));
+    file.write(strings.data(), (streamsize)strings.size());
+    offset = header.stringTableOffset + header.stringTableBytes;
+    for (size_t i = 0; i < meshes.size() && file; ++i)
+    {
+        writePadding(file, offset);
+        file.write(reinterpret_cast<const char*>(meshes[i].vertices), (streamsize)entries[i].vertexBytes);
+        offset = entries[i].vertexOffset + entries[i].vertexBytes;
+    }
+
+    if (!file.flush())
+    {
+        cout << "Failed to write mesh file " << path << endl;
+        return false;
+    }
+    return true;
+}
+
+
+bool MeshFile::open(const string& path)
+{
+    close();
+    if (!UAssets().read(path, file))
+    {
+        cout << "Failed to read mesh file " << path << endl;
+        return false;
+    }
+
+    const unsigned char* data = file.getData();
+    const uint64_t size = file.getSize();
+    MeshFileHeader header;
+    if (size < sizeof(header))
+    {
+        cout << "Mesh file " << path << " is too short" << endl;
+        close();
+        return false;
+    }
+    memcpy(&header, data, sizeof(header));
+
+    if (memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 || header.version != MESH_FILE_VERSION)
+    {
+        cout << "Mesh file " << path << " is not a version " << MESH_FILE_VERSION << " mesh file" << endl;
+        close();
+        return false;
+    }
+    if (header.headerBytes < sizeof(MeshFileHeader) || header.entryBytes < sizeof(MeshFileEntry) ||
+        header.fileBytes != size ||
+        header.meshTableOffset % alignof(MeshFileEntry) != 0 ||
+        !inside(header.meshTableOffset, (uint64_t)header.meshCount * header.entryBytes, size) ||
+        !inside(header.stringTableOffset, header.stringTableBytes, size))
+    {
+        cout << "Mesh file " << path << " has a corrupt header" << endl;
+        close();
+        return false;
+    }
+
+    const char* strings = reinterpret_cast<const char*>(data + header.stringTableOffset);
+    meshes.resize(header.meshCount);
+    for (uint32_t i = 0; i < header.meshCount; ++i)
+    {
+        MeshFileEntry entry;
+        memcpy(&entry, data + header.meshTableOffset + (uint64_t)i * header.entryBytes, sizeof(entry));
+
+        MeshFileMesh& mesh = meshes[i];
+        mesh.name = tableString(strings, header.stringTableBytes, entry.name);
+        mesh.material = entry.material == MESH_FILE_NO_STRING ? ""
+            : tableString(strings, header.stringTableBytes, entry.material);
+
+        const uint64_t indexBytes = (uint64_t)entry.indexCount * entry.indexSize;
+        const bool valid = mesh.name && mesh.material &&
+            entry.floatsPerVertex == MESH_FILE_FLOATS_PER_VERTEX &&
+            entry.vertexBytes == (uint64_t)entry.vertexCount * MESH_FILE_FLOATS_PER_VERTEX * sizeof(float) &&
+            entry.vertexOffset % alignof(float) == 0 &&
+            inside(entry.vertexOffset, entry.vertexBytes, size) &&
+            (entry.indexSize == 0 || entry.indexSize == 2 || entry.indexSize == 4) &&
+            (entry.indexSize == 0 || entry.indexOffset % entry.indexSize == 0) &&
+            inside(entry.indexOffset, indexBytes, size);
+        if (!valid)
+        {
+            cout << "Mesh file " << path << " has a corrupt entry " << i << endl;
+            close();
+            return false;
+        }
+
+        mesh.vertices = reinterpret_cast<const float*>(data + entry.vertexOffset);
+        mesh.vertexBytes = (size_t)entry.vertexBytes;
+        mesh.vertexCount = entry.vertexCount;
+        mesh.indices = entry.indexSize ? data + entry.indexOffset : nullptr;
+        mesh.indexCount = entry.indexSize ? entry.indexCount : 0;
+        mesh.indexSize = entry.indexSize;
+        mesh.contentHash = entry.contentHash;
+        mesh.lower = glm::vec3(entry.lower[0], entry.lower[1], entry.lower[2]);
+        mesh.upper = glm::vec3(entry.upper[0], entry.upper[1], entry.upper[2]);
+        mesh.sphere = glm::vec4(entry.sphere[0], entry.sphere[1], entry.sphere[2], entry.sphere[3]);
+    }
+
+    return true;
+}
+
+
+void MeshFile::close()
+{
+    meshes.clear();
+    file.reset();
+}
+
+
+const MeshFileMesh* MeshFile::find(const char* name) const
+{
+    for (const MeshFileMesh& mesh : meshes)
+    {
+        if (strcmp(mesh.name, name) == 0)
+            return &mesh;
+    }
+    return nullptr;
+}
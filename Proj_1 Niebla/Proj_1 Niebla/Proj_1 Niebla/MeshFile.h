@@ -0,0 +1,139 @@
+///////////////////////////////////////////////////////////////////////////////
+// MeshFile.h
+// ==========
+// Binary container for scene meshes, read through a memory mapping so the
+// vertex data goes from the page cache straight into buffer storage with no
+// parsing and no intermediate copy; loading is bound by reading the file.
+//
+// Layout (little endian, offsets from the start of the file):
+//   header        magic "NMSH", version, mesh count, table offsets, file size
+//   mesh table    one MeshFileEntry per mesh
+//   string table  NUL-terminated mesh names and material (texture) paths
+//   blobs         vertex data in the GPU layout (8 floats: position, normal,
+//                 texture coordinate), then optional 16 or 32-bit indices,
+//                 each aligned to MESH_FILE_ALIGNMENT
+//
+// Every entry also holds the mesh's bounds and the content hash the
+// resource registry deduplicates by, so loading computes neither. A file is
+// checked when it is opened: an unknown version, a table or blob outside
+// the file or an unterminated string rejects it as a whole.
+//
+// The scene is saved after its meshes (built-in or --mesh imports) and
+// textures are created, and loaded meshes replace the built-in ones of the
+// same name, drawn with the material the file names.
+//
+// Usage:
+//   "Proj_1 Niebla" [--save-meshes scene.nmesh] [--load-meshes scene.nmesh]
+//
+//   MeshFile file;
+//   if (file.open("scene.nmesh"))
+//       upload(file.getMesh(0).vertices, file.getMesh(0).vertexBytes);
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef MESH_FILE_H
+#define MESH_FILE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "AssetPack.h"
+
+const uint32_t MESH_FILE_VERSION = 1;
+const uint32_t MESH_FILE_ALIGNMENT = 256;
+const uint32_t MESH_FILE_NO_STRING = 0xFFFFFFFFu;
+const uint32_t MESH_FILE_FLOATS_PER_VERTEX = 8;
+
+struct MeshFileOptions
+{
+    std::string savePath;       // write the scene meshes here once created
+    std::string loadPath;       // replace the scene meshes with this file's
+};
+
+struct MeshFileHeader
+{
+    char magic[4];              // "NMSH"
+    uint32_t version;
+    uint32_t headerBytes;       // sizeof(MeshFileHeader) when written
+    uint32_t entryBytes;        // sizeof(MeshFileEntry) when written
+    uint32_t meshCount;
+    uint32_t reserved;
+    uint64_t meshTableOffset;
+    uint64_t stringTableOffset;
+    uint64_t stringTableBytes;
+    uint64_t fileBytes;
+};
+
+struct MeshFileEntry
+{
+    uint32_t name;              // string table offsets
+    uint32_t material;          // MESH_FILE_NO_STRING when none
+    uint32_t floatsPerVertex;
+    uint32_t vertexCount;
+    uint64_t vertexOffset;
+    uint64_t vertexBytes;
+    uint64_t indexOffset;
+    uint32_t indexCount;
+    uint32_t indexSize;         // 0 (unindexed), 2 or 4 bytes
+    uint64_t contentHash;       // UMeshContentHash of the vertex blob
+    float lower[3];             // bounding box
+    float upper[3];
+    float sphere[4];            // bounding sphere: center, radius
+};
+
+static_assert(sizeof(MeshFileHeader) == 56, "MeshFileHeader layout");
+static_assert(sizeof(MeshFileEntry) == 96, "MeshFileEntry layout");
+
+// Mesh as stored in an open file; the pointers are into the file data
+struct MeshFileMesh
+{
+    const char* name = "";
+    const char* material = "";  // empty when none
+    const float* vertices = nullptr;
+    size_t vertexBytes = 0;
+    uint32_t vertexCount = 0;
+    const void* indices = nullptr;
+    uint32_t indexCount = 0;
+    uint32_t indexSize = 0;
+    uint64_t contentHash = 0;
+    glm::vec3 lower;
+    glm::vec3 upper;
+    glm::vec4 sphere;
+};
+
+// Mesh to write
+struct MeshFileSource
+{
+    std::string name;
+    std::string material;
+    const float* vertices = nullptr;    // MESH_FILE_FLOATS_PER_VERTEX floats each
+    uint32_t vertexCount = 0;
+};
+
+bool UParseMeshFileArgs(int argc, char* argv[], MeshFileOptions& options);
+
+bool UWriteMeshFile(const std::string& path, const std::vector<MeshFileSource>& meshes);
+
+class MeshFile
+{
+public:
+    // Maps (or finds in a mounted pack) and validates the file; the meshes
+    // point into it until close()
+    bool open(const std::string& path);
+    void close();
+
+    uint32_t getMeshCount() const { return (uint32_t)meshes.size(); }
+    const MeshFileMesh& getMesh(uint32_t index) const { return meshes[index]; }
+
+    // Mesh with the name, null if none
+    const MeshFileMesh* find(const char* name) const;
+
+private:
+    AssetData file;
+    std::vector<MeshFileMesh> meshes;
+};
+
+#endif
@@ -0,0 +1,1209 @@
+#include "MeshImport.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+#include "AssetPack.h"
+#include "JobSystem.h"
+
+using namespace std;
+
+const int ImportedMesh::FLOATS_PER_VERTEX;
+
+namespace
+{
+    const int FLOATS = ImportedMesh::FLOATS_PER_VERTEX;
+    const size_t OBJ_CHUNK_BYTES = 1 << 20;     // smaller chunks are not worth a job
+    const size_t EXPAND_GRAIN = 16384;          // triangles per job when expanding
+    const uint32_t OBJ_NONE = 0xFFFFFFFFu;
+    const int JSON_MAX_DEPTH = 64;
+
+    // Powers of ten a double holds exactly
+    const double POW10[] = {
+        1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+    };
+
+    // Up to 19 significant digits in an integer mantissa, then one scaling by a
+    // power of ten; within an ulp of the double, so exact enough for a float
+    const char* parseDecimal(const char* text, const char* end, double& value)
+    {
+        const char* p = text;
+        bool negative = false;
+        if (p < end && (*p == '-' || *p == '+'))
+            negative = *p++ == '-';
+
+        uint64_t mantissa = 0;
+        int significant = 0;
+        int exponent = 0;
+        bool digits = false;
+        for (; p < end && *p >= '0' && *p <= '9'; ++p)
+        {
+            digits = true;
+            if (significant < 19)
+            {
+                mantissa = mantissa * 10 + (*p - '0');
+                significant += mantissa != 0;
+            }
+            else
+            {
+                exponent++;
+            }
+        }
+        if (p < end && *p == '.')
+        {
+            for (++p; p < end && *p >= '0' && *p <= '9'; ++p)
+            {
+                digits = true;
+                if (significant < 19)
+                {
+                    mantissa = mantissa * 10 + (*p - '0');
+                    significant += mantissa != 0;
+                    exponent--;
+                }
+            }
+        }
+        if (!digits)
+            return text;
+
+        if (p < end && (*p == 'e' || *p == 'E'))
+        {
+            const char* q = p + 1;
+            bool negativeExponent = false;
+            if (q < end && (*q == '-' || *q == '+'))
+                negativeExponent = *q++ == '-';
+            if (q < end && *q >= '0' && *q <= '9')
+            {
+                int written = 0;
+                for (; q < end && *q >= '0' && *q <= '9'; ++q)
+                    written = min(written * 10 + (*q - '0'), 10000);
+                exponent += negativeExponent ? -written : written;
+                p = q;
+            }
+        }
+
+        double result = (double)mantissa;
+        if (mantissa != 0)
+        {
+            exponent = max(-400, min(exponent, 400));
+            for (; exponent > 22; exponent -= 22)
+                result *= POW10[22];
+            for (; exponent < -22; exponent += 22)
+                result /= POW10[22];
+            result = exponent < 0 ? result / POW10[-exponent] : result * POW10[exponent];
+        }
+        value = negative ? -result : result;
+        return p;
+    }
+
+    const char* skipSpaces(const char* p, const char* end)
+    {
+        while (p < end && (*p == ' ' || *p == '\t' || *p == '\r'))
+            ++p;
+        return p;
+    }
+
+    const char* findLineEnd(const char* p, const char* end)
+    {
+        const void* newline = memchr(p, '\n', end - p);
+        return newline ? static_cast<const char*>(newline) : end;
+    }
+
+    bool isSpace(char c)
+    {
+        return c == ' ' || c == '\t';
+    }
+
+    // Runs body(i) for every i in [0, count), on the job system when there is one
+    template <typename Body>
+    void forEach(JobSystem* jobs, size_t count, size_t grain, const Body& body)
+    {
+        if (!jobs || count <= grain)
+        {
+            for (size_t i = 0; i < count; ++i)
+                body(i);
+            return;
+        }
+        jobs->parallelFor(count, grain, [&body](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i)
+                body(i);
+        });
+    }
+
+    glm::vec3 loadVec3(const float* values)
+    {
+        return glm::vec3(values[0], values[1], values[2]);
+    }
+
+    glm::vec2 loadVec2(const float* values)
+    {
+        return glm::vec2(values[0], values[1]);
+    }
+
+    glm::vec3 faceNormal(const glm::vec3& a, const glm::vec3& b, const glm::vec3& c)
+    {
+        const glm::vec3 normal = glm::cross(b - a, c - a);
+        const float length = glm::length(normal);
+        return length > 0.0f ? normal / length : glm::vec3(0.0f);
+    }
+
+    void writeVertex(float* out, const glm::vec3& position, const glm::vec3& normal, const glm::vec2& uv)
+    {
+        out[0] = position.x;
+        out[1] = position.y;
+        out[2] = position.z;
+        out[3] = normal.x;
+        out[4] = normal.y;
+        out[5] = normal.z;
+        out[6] = uv.x;
+        out[7] = uv.y;
+    }
+
+
+    ///////////////////////////////////////////////////////////////////////////
+    // OBJ
+
+    enum ObjLine
+    {
+        OBJ_OTHER,
+        OBJ_POSITION,
+        OBJ_UV,
+        OBJ_NORMAL,
+        OBJ_FACE,
+    };
+
+    struct ObjCorner
+    {
+        uint32_t position;
+        uint32_t uv;
+        uint32_t normal;
+    };
+
+    struct ObjChunk
+    {
+        const char* begin = nullptr;
+        const char* end = nullptr;
+        size_t positions = 0;       // elements defined in the chunk
+        size_t uvs = 0;
+        size_t normals = 0;
+        size_t firstPosition = 0;   // global index of the chunk's first element
+        size_t firstUv = 0;
+        size_t firstNormal = 0;
+        size_t firstVertex = 0;
+        vector<ObjCorner> corners;  // three per triangle
+        const char* error = nullptr;
+    };
+
+    // Kind of the line at p (leading blanks skipped); p is left after the keyword
+    ObjLine classifyObjLine(const char*& p, const char* end)
+    {
+        p = skipSpaces(p, end);
+        if (end - p < 2)
+            return OBJ_OTHER;
+        if (p[0] == 'f' && isSpace(p[1]))
+        {
+            p += 2;
+            return OBJ_FACE;
+        }
+        if (p[0] != 'v')
+            return OBJ_OTHER;
+        if (isSpace(p[1]))
+        {
+            p += 2;
+            return OBJ_POSITION;
+        }
+        if (end - p < 3 || !isSpace(p[2]))
+            return OBJ_OTHER;
+        p += 3;
+        return p[-2] == 't' ? OBJ_UV : p[-2] == 'n' ? OBJ_NORMAL : OBJ_OTHER;
+    }
+
+    const char* parseFloats(const char* p, const char* end, float* values, int required, int optional)
+    {
+        for (int i = 0; i < required + optional; ++i)
+        {
+            p = skipSpaces(p, end);
+            const char* next = UParseFloat(p, end, values[i]);
+            if (next == p)
+            {
+                if (i < required)
+                    return nullptr;
+                values[i] = 0.0f;
+                continue;
+            }
+            p = next;
+        }
+        return p;
+    }
+
+    // One index of a face corner; OBJ counts from 1 and negative values count back
+    // from the last element defined so far
+    bool resolveObjIndex(const char*& p, const char* end, size_t defined, size_t total, uint32_t& index)
+    {
+        bool negative = false;
+        if (p < end && *p == '-')
+        {
+            negative = true;
+            ++p;
+        }
+        if (p >= end || *p < '0' || *p > '9')
+            return false;
+
+        uint64_t value = 0;
+        for (; p < end && *p >= '0' && *p <= '9'; ++p)
+            value = min<uint64_t>(value * 10 + (*p - '0'), 0xFFFFFFFFull);
+
+        if (value == 0 || (negative && value > defined) || (!negative && value > total))
+            return false;
+        index = (uint32_t)(negative ? defined - value : value - 1);
+        return true;
+    }
+
+    void countObjChunk(ObjChunk& chunk)
+    {
+        for (const char* line = chunk.begin; line < chunk.end;)
+        {
+            const char* lineEnd = findLineEnd(line, chunk.end);
+            const char* p = line;
+            switch (classifyObjLine(p, lineEnd))
+            {
+            case OBJ_POSITION: chunk.positions++; break;
+            case OBJ_UV: chunk.uvs++; break;
+            case OBJ_NORMAL: chunk.normals++; break;
+            default: break;
+            }
+            line = lineEnd + 1;
+        }
+    }
+
+    void parseObjChunk(ObjChunk& chunk, size_t totalPositions, size_t totalUvs, size_t totalNormals,
+        float* positions, float* uvs, float* normals)
+    {
+        size_t position = chunk.firstPosition;
+        size_t uv = chunk.firstUv;
+        size_t normal = chunk.firstNormal;
+        vector<ObjCorner> polygon;
+
+        for (const char* line = chunk.begin; line < chunk.end;)
+        {
+            const char* lineEnd = findLineEnd(line, chunk.end);
+            const char* p = line;
+            line = lineEnd + 1;
+
+            switch (classifyObjLine(p, lineEnd))
+            {
+            case OBJ_POSITION:
+                if (!parseFloats(p, lineEnd, positions + 3 * position++, 3, 0))
+                    chunk.error = "Invalid vertex position";
+                break;
+            case OBJ_UV:
+                if (!parseFloats(p, lineEnd, uvs + 2 * uv++, 1, 1))
+                    chunk.error = "Invalid texture coordinate";
+                break;
+            case OBJ_NORMAL:
+                if (!parseFloats(p, lineEnd, normals + 3 * normal++, 3, 0))
+                    chunk.error = "Invalid vertex normal";
+                break;
+            case OBJ_FACE:
+                polygon.clear();
+                for (p = skipSpaces(p, lineEnd); p < lineEnd && *p != '#'; p = skipSpaces(p, lineEnd))
+                {
+                    ObjCorner corner = { OBJ_NONE, OBJ_NONE, OBJ_NONE };
+                    bool valid = resolveObjIndex(p, lineEnd, position, totalPositions, corner.position);
+                    if (valid && p < lineEnd && *p == '/')
+                    {
+                        ++p;
+                        if (p < lineEnd && *p != '/')
+                            valid = resolveObjIndex(p, lineEnd, uv, totalUvs, corner.uv);
+                        if (valid && p < lineEnd && *p == '/')
+                        {
+                            ++p;
+                            valid = resolveObjIndex(p, lineEnd, normal, totalNormals, corner.normal);
+                        }
+                    }
+                    if (!valid || (p < lineEnd && !isSpace(*p) && *p != '\r'))
+                    {
+                        chunk.error = "Invalid face index";
+                        break;
+                    }
+                    polygon.push_back(corner);
+                }
+                for (size_t i = 2; i < polygon.size(); ++i)
+                {
+                    chunk.corners.push_back(polygon[0]);
+                    chunk.corners.push_back(polygon[i - 1]);
+                    chunk.corners.push_back(polygon[i]);
+                }
+                break;
+            default:
+                break;
+            }
+        }
+    }
+
+    void expandObjChunk(const ObjChunk& chunk, const float* positions, const float* uvs, const float* normals,
+        float* out)
+    {
+        out += chunk.firstVertex * FLOATS;
+        for (size_t c = 0; c < chunk.corners.size(); c += 3)
+        {
+            const ObjCorner* corners = &chunk.corners[c];
+            glm::vec3 triangle[3];
+            for (int k = 0; k < 3; ++k)
+                triangle[k] = loadVec3(positions + 3 * (size_t)corners[k].position);
+
+            const bool smooth = corners[0].normal != OBJ_NONE && corners[1].normal != OBJ_NONE
+                && corners[2].normal != OBJ_NONE;
+            const glm::vec3 flat = smooth ? glm::vec3(0.0f) : faceNormal(triangle[0], triangle[1], triangle[2]);
+            for (int k = 0; k < 3; ++k)
+            {
+                const glm::vec3 normal = smooth ? loadVec3(normals + 3 * (size_t)corners[k].normal) : flat;
+                const glm::vec2 uv = corners[k].uv != OBJ_NONE ? loadVec2(uvs + 2 * (size_t)corners[k].uv)
+                    : glm::vec2(0.0f);
+                writeVertex(out, triangle[k], normal, uv);
+                out += FLOATS;
+            }
+        }
+    }
+
+
+    ///////////////////////////////////////////////////////////////////////////
+    // glTF
+
+    struct JsonValue
+    {
+        enum Type
+        {
+            JSON_NULL,
+            JSON_BOOL,
+            JSON_NUMBER,
+            JSON_STRING,
+            JSON_ARRAY,
+            JSON_OBJECT,
+        };
+
+        Type type = JSON_NULL;
+        double number = 0.0;
+        string text;
+        vector<JsonValue> items;
+        vector<pair<string, JsonValue>> members;
+
+        // Member by key, or a null value
+        const JsonValue& operator[](const char* key) const
+        {
+            static const JsonValue missing;
+            for (const pair<string, JsonValue>& member : members)
+            {
+                if (member.first == key)
+                    return member.second;
+            }
+            return missing;
+        }
+
+        const JsonValue& operator[](size_t index) const
+        {
+            static const JsonValue missing;
+            return index < items.size() ? items[index] : missing;
+        }
+
+        bool isNull() const { return type == JSON_NULL; }
+        double getNumber(double fallback) const { return type == JSON_NUMBER ? number : fallback; }
+        long long getIndex() const { return type == JSON_NUMBER ? (long long)number : -1; }
+    };
+
+    class JsonParser
+    {
+    public:
+        JsonParser(const char* begin, const char* end) : p(begin), end(end) {}
+
+        bool parse(JsonValue& value)
+        {
+            return parseValue(value, 0) && skip() == end;
+        }
+
+    private:
+        const char* skip()
+        {
+            while (p < end && (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n'))
+                ++p;
+            return p;
+        }
+
+        bool literal(const char* word)
+        {
+            const size_t length = strlen(word);
+            if ((size_t)(end - p) < length || memcmp(p, word, length) != 0)
+                return false;
+            p += length;
+            return true;
+        }
+
+        bool parseValue(JsonValue& value, int depth)
+        {
+            if (depth > JSON_MAX_DEPTH || skip() == end)
+                return false;
+
+            switch (*p)
+            {
+            case '{':
+                value.type = JsonValue::JSON_OBJECT;
+                ++p;
+                if (skip() < end && *p == '}')
+                {
+                    ++p;
+                    return true;
+                }
+                for (;;)
+                {
+                    value.members.emplace_back();
+                    if (skip() == end || *p != '"' || !parseString(value.members.back().first))
+                        return false;
+                    if (skip() == end || *p++ != ':' || !parseValue(value.members.back().second, depth + 1))
+                        return false;
+                    if (skip() == end)
+                        return false;
+                    if (*p == '}')
+                    {
+                        ++p;
+                        return true;
+                    }
+                    if (*p++ != ',')
+                        return false;
+                }
+            case '[':
+                value.type = JsonValue::JSON_ARRAY;
+                ++p;
+                if (skip() < end && *p == ']')
+                {
+                    ++p;
+                    return true;
+                }
+                for (;;)
+                {
+                    value.items.emplace_back();
+                    if (!parseValue(value.items.back(), depth + 1) || skip() == end)
+                        return false;
+                    if (*p == ']')
+                    {
+                        ++p;
+                        return true;
+                    }
+                    if (*p++ != ',')
+                        return false;
+                }
+            case '"':
+                value.type = JsonValue::JSON_STRING;
+                return parseString(value.text);
+            case 't':
+            case 'f':
+                value.type = JsonValue::JSON_BOOL;
+                value.number = *p == 't';
+                return literal(*p == 't' ? "true" : "false");
+            case 'n':
+                return literal("null");
+            default:
+            {
+                value.type = JsonValue::JSON_NUMBER;
+                const char* next = parseDecimal(p, end, value.number);
+                if (next == p)
+                    return false;
+                p = next;
+                return true;
+            }
+            }
+        }
+
+        bool parseString(string& text)
+        {
+            for (++p; p < end; ++p)
+            {
+                if (*p == '"')
+                {
+                    ++p;
+                    return true;
+                }
+                if (*p != '\\')
+                {
+                    text += *p;
+                    continue;
+                }
+                if (++p == end)
+                    return false;
+                switch (*p)
+                {
+                case 'b': text += '\b'; break;
+                case 'f': text += '\f'; break;
+                case 'n': text += '\n'; break;
+                case 'r': text += '\r'; break;
+                case 't': text += '\t'; break;
+                case 'u':
+                {
+                    unsigned int code = 0;
+                    for (int i = 0; i < 4; ++i)
+                    {
+                        if (++p == end || !isxdigit((unsigned char)*p))
+                            return false;
+                        code = code * 16 + (*p <= '9' ? *p - '0' : (*p | 0x20) - 'a' + 10);
+                    }
+                    // UTF-8; a surrogate pair's halves are encoded separately, which is
+                    // good enough for the names and URIs a glTF file holds
+                    if (code < 0x80)
+                    {
+                        text += (char)code;
+                    }
+                    else if (code < 0x800)
+                    {
+                        text += (char)(0xC0 | (code >> 6));
+                        text += (char)(0x80 | (code & 0x3F));
+                    }
+                    else
+                    {
+                        text += (char)(0xE0 | (code >> 12));
+                        text += (char)(0x80 | ((code >> 6) & 0x3F));
+                        text += (char)(0x80 | (code & 0x3F));
+                    }
+                    break;
+                }
+                default: text += *p; break;     // \" \\ \/
+                }
+            }
+            return false;
+        }
+
+        const char* p;
+        const char* end;
+    };
+
+    struct GltfBuffer
+    {
+        const unsigned char* data = nullptr;
+        size_t size = 0;
+        vector<char> storage;       // external and data: buffers
+    };
+
+    struct GltfAccessor
+    {
+        const unsigned char* data = nullptr;
+        size_t stride = 0;
+        size_t count = 0;
+        int componentType = 0;
+        int components = 0;
+        bool normalized = false;
+    };
+
+    const int GLTF_BYTE = 5120;
+    const int GLTF_UNSIGNED_BYTE = 5121;
+    const int GLTF_SHORT = 5122;
+    const int GLTF_UNSIGNED_SHORT = 5123;
+    const int GLTF_UNSIGNED_INT = 5125;
+    const int GLTF_FLOAT = 5126;
+    const int GLTF_TRIANGLES = 4;
+    const size_t GLTF_MAX_STRIDE = 252;
+
+    const uint32_t GLB_MAGIC = 0x46546C67;      // "glTF"
+    const uint32_t GLB_JSON = 0x4E4F534A;
+    const uint32_t GLB_BIN = 0x004E4942;
+
+    uint32_t readU32(const char* bytes)
+    {
+        uint32_t value;
+        memcpy(&value, bytes, sizeof(value));   // glTF is little endian, like every target
+        return value;
+    }
+
+    // A JSON number (or fallback when absent) as a size; false unless it is a whole number in [0, limit]
+    bool readSize(const JsonValue& value, double fallback, size_t limit, size_t& size)
+    {
+        const double number = value.getNumber(fallback);
+        if (!(number >= 0.0) || number > (double)limit || number != floor(number))
+            return false;
+        size = (size_t)number;
+        return true;
+    }
+
+    int componentBytes(int componentType)
+    {
+        switch (componentType)
+        {
+        case GLTF_BYTE: case GLTF_UNSIGNED_BYTE: return 1;
+        case GLTF_SHORT: case GLTF_UNSIGNED_SHORT: return 2;
+        case GLTF_UNSIGNED_INT: case GLTF_FLOAT: return 4;
+        default: return 0;
+        }
+    }
+
+    int typeComponents(const string& type)
+    {
+        if (type == "SCALAR") return 1;
+        if (type == "VEC2") return 2;
+        if (type == "VEC3") return 3;
+        if (type == "VEC4") return 4;
+        if (type == "MAT4") return 16;
+        return 0;
+    }
+
+    bool decodeBase64(const char* text, size_t length, vector<char>& bytes)
+    {
+        bytes.clear();
+        bytes.reserve(length / 4 * 3);
+        unsigned int bits = 0;
+        int count = 0;
+        for (size_t i = 0; i < length && text[i] != '='; ++i)
+        {
+            const char c = text[i];
+            int value;
+            if (c >= 'A' && c <= 'Z') value = c - 'A';
+            else if (c >= 'a' && c <= 'z') value = c - 'a' + 26;
+            else if (c >= '0' && c <= '9') value = c - '0' + 52;
+            else if (c == '+' || c == '-') value = 62;
+            else if (c == '/' || c == '_') value = 63;
+            else return false;
+
+            bits = (bits << 6) | value;
+            count += 6;
+            if (count >= 8)
+            {
+                count -= 8;
+                bytes.push_back((char)((bits >> count) & 0xFF));
+            }
+        }
+        return true;
+    }
+
+    string decodeUri(const string& uri)
+    {
+        string path;
+        for (size_t i = 0; i < uri.size(); ++i)
+        {
+            if (uri[i] == '%' && i + 2 < uri.size() && isxdigit((unsigned char)uri[i + 1]) && isxdigit((unsigned char)uri[i + 2]))
+            {
+                path += (char)stoi(uri.substr(i + 1, 2), nullptr, 16);
+                i += 2;
+                continue;
+            }
+            path += uri[i];
+        }
+        return path;
+    }
+
+    bool loadGltfBuffers(const JsonValue& gltf, const string& directory, const char* binary, size_t binarySize,
+        vector<GltfBuffer>& buffers)
+    {
+        const JsonValue& list = gltf["buffers"];
+        buffers.resize(list.items.size());
+        for (size_t i = 0; i < list.items.size(); ++i)
+        {
+            const JsonValue& uri = list[i]["uri"];
+            const size_t length = (size_t)list[i]["byteLength"].getNumber(0.0);
+            GltfBuffer& buffer = buffers[i];
+            if (uri.isNull())
+            {
+                // The GLB binary chunk (only the first buffer may use it)
+                if (i != 0 || !binary)
+                {
+                    cout << "glTF buffer " << i << " has no data" << endl;
+                    return false;
+                }
+                buffer.data = reinterpret_cast<const unsigned char*>(binary);
+                buffer.size = binarySize;
+            }
+            else if (uri.text.compare(0, 5, "data:") == 0)
+            {
+                const size_t comma = uri.text.find(";base64,");
+                if (comma == string::npos
+                    || !decodeBase64(uri.text.data() + comma + 8, uri.text.size() - comma - 8, buffer.storage))
+                {
+                    cout << "Unsupported glTF data URI in buffer " << i << endl;
+                    return false;
+                }
+            }
+            else if (!UReadFileBytes(directory + decodeUri(uri.text), buffer.storage))
+            {
+                cout << "Failed to read glTF buffer " << directory + decodeUri(uri.text) << endl;
+                return false;
+            }
+
+            if (!uri.isNull())
+            {
+                buffer.data = reinterpret_cast<const unsigned char*>(buffer.storage.data());
+                buffer.size = buffer.storage.size();
+            }
+            if (buffer.size < length)
+            {
+                cout << "glTF buffer " << i << " is shorter than its byteLength" << endl;
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool resolveAccessor(const JsonValue& gltf, const vector<GltfBuffer>& buffers, long long index,
+        GltfAccessor& accessor)
+    {
+        const JsonValue& description = gltf["accessors"][(size_t)index];
+        if (index < 0 || description.isNull())
+            return false;
+        if (!description["sparse"].isNull())
+        {
+            cout << "Sparse glTF accessors are not supported" << endl;
+            return false;
+        }
+
+        accessor.componentType = (int)description["componentType"].getNumber(0.0);
+        accessor.components = typeComponents(description["type"].text);
+        accessor.normalized = description["normalized"].number != 0.0;
+        const size_t elementBytes = (size_t)componentBytes(accessor.componentType) * accessor.components;
+        if (elementBytes == 0)
+            return false;
+
+        const JsonValue& view = gltf["bufferViews"][(size_t)description["bufferView"].getIndex()];
+        const long long bufferIndex = view["buffer"].getIndex();
+        if (view.isNull() || bufferIndex < 0 || bufferIndex >= (long long)buffers.size())
+            return false;
+        const GltfBuffer& buffer = buffers[(size_t)bufferIndex];
+
+        // Every size is checked before it is used, so none of the bounds below can overflow
+        size_t viewOffset = 0, viewLength = 0, offset = 0;
+        const bool inside = readSize(view["byteOffset"], 0.0, buffer.size, viewOffset)
+            && readSize(view["byteLength"], 0.0, buffer.size - viewOffset, viewLength)
+            && readSize(description["byteOffset"], 0.0, viewLength, offset)
+            && readSize(view["byteStride"], (double)elementBytes, GLTF_MAX_STRIDE, accessor.stride)
+            && readSize(description["count"], 0.0, viewLength, accessor.count)
+            && accessor.stride >= elementBytes
+            && (accessor.count == 0 || (elementBytes <= viewLength - offset
+            && accessor.count - 1 <= (viewLength - offset - elementBytes) / accessor.stride));
+        if (!inside)
+        {
+            cout << "glTF accessor " << index << " reads outside its buffer" << endl;
+            return false;
+        }
+        accessor.data = buffer.data + viewOffset + offset;
+        return true;
+    }
+
+    // Reads the first n components of element i as floats, applying normalization
+    void readFloats(const GltfAccessor& accessor, size_t i, float* values, int n)
+    {
+        const unsigned char* element = accessor.data + accessor.stride * i;
+        for (int c = 0; c < n; ++c)
+        {
+            switch (accessor.componentType)
+            {
+            case GLTF_FLOAT:
+                memcpy(&values[c], element + 4 * c, 4);
+                break;
+            case GLTF_UNSIGNED_BYTE:
+                values[c] = element[c] / (accessor.normalized ? 255.0f : 1.0f);
+                break;
+            case GLTF_UNSIGNED_SHORT:
+            {
+                uint16_t value;
+                memcpy(&value, element + 2 * c, 2);
+                values[c] = value / (accessor.normalized ? 65535.0f : 1.0f);
+                break;
+            }
+            case GLTF_BYTE:
+                values[c] = accessor.normalized ? max((signed char)element[c] / 127.0f, -1.0f) : (signed char)element[c];
+                break;
+            case GLTF_SHORT:
+            {
+                int16_t value;
+                memcpy(&value, element + 2 * c, 2);
+                values[c] = accessor.normalized ? max(value / 32767.0f, -1.0f) : value;
+                break;
+            }
+            default:
+                values[c] = 0.0f;
+                break;
+            }
+        }
+    }
+
+    // Indices are unsigned bytes, shorts or ints (appendPrimitive rejects the rest)
+    uint32_t readIndex(const GltfAccessor& accessor, size_t i)
+    {
+        const unsigned char* element = accessor.data + accessor.stride * i;
+        switch (accessor.componentType)
+        {
+        case GLTF_UNSIGNED_BYTE:
+            return element[0];
+        case GLTF_UNSIGNED_SHORT:
+        {
+            uint16_t value;
+            memcpy(&value, element, 2);
+            return value;
+        }
+        case GLTF_UNSIGNED_INT:
+        default:
+        {
+            uint32_t value;
+            memcpy(&value, element, 4);
+            return value;
+        }
+        }
+    }
+
+    glm::mat4 nodeTransform(const JsonValue& node)
+    {
+        const JsonValue& matrix = node["matrix"];
+        if (matrix.items.size() == 16)
+        {
+            glm::mat4 result;
+            for (int i = 0; i < 16; ++i)
+                glm::value_ptr(result)[i] = (float)matrix.items[i].number;     // column major, like glm
+            return result;
+        }
+
+        glm::vec3 translation(0.0f);
+        glm::quat rotation(1.0f, 0.0f, 0.0f, 0.0f);
+        glm::vec3 scale(1.0f);
+        const JsonValue& t = node["translation"];
+        const JsonValue& r = node["rotation"];
+        const JsonValue& s = node["scale"];
+        if (t.items.size() == 3)
+            translation = glm::vec3(t.items[0].number, t.items[1].number, t.items[2].number);
+        if (r.items.size() == 4)     // x, y, z, w
+            rotation = glm::quat((float)r.items[3].number, (float)r.items[0].number, (float)r.items[1].number,
+                (float)r.items[2].number);
+        if (s.items.size() == 3)
+            scale = glm::vec3(s.items[0].number, s.items[1].number, s.items[2].number);
+        return glm::translate(glm::mat4(1.0f), translation) * glm::mat4_cast(rotation) * glm::scale(glm::mat4(1.0f), scale);
+    }
+
+    void collectMeshInstances(const JsonValue& gltf, long long nodeIndex, const glm::mat4& parent, int depth,
+        vector<pair<long long, glm::mat4>>& instances)
+    {
+        const JsonValue& node = gltf["nodes"][(size_t)nodeIndex];
+        if (nodeIndex < 0 || node.isNull() || depth > (int)gltf["nodes"].items.size())
+            return;     // a cycle, which glTF forbids
+
+        const glm::mat4 world = parent * nodeTransform(node);
+        if (node["mesh"].getIndex() >= 0)
+            instances.emplace_back(node["mesh"].getIndex(), world);
+        for (const JsonValue& child : node["children"].items)
+            collectMeshInstances(gltf, child.getIndex(), world, depth + 1, instances);
+    }
+
+    bool appendPrimitive(const JsonValue& gltf, const vector<GltfBuffer>& buffers, const JsonValue& primitive,
+        const glm::mat4& world, ImportedMesh& mesh, JobSystem* jobs)
+    {
+        if (primitive["mode"].getNumber(GLTF_TRIANGLES) != GLTF_TRIANGLES)
+        {
+            cout << "Skipping glTF primitive that is not a triangle list" << endl;
+            return true;
+        }
+
+        const JsonValue& attributes = primitive["attributes"];
+        GltfAccessor positions, normals, uvs, indices;
+        if (!resolveAccessor(gltf, buffers, attributes["POSITION"].getIndex(), positions) || positions.components != 3)
+        {
+            cout << "glTF primitive without usable positions" << endl;
+            return false;
+        }
+        const bool hasNormals = resolveAccessor(gltf, buffers, attributes["NORMAL"].getIndex(), normals)
+            && normals.components == 3 && normals.count == positions.count;
+        const bool hasUvs = resolveAccessor(gltf, buffers, attributes["TEXCOORD_0"].getIndex(), uvs)
+            && uvs.components == 2 && uvs.count == positions.count;
+        const bool indexed = !primitive["indices"].isNull();
+        if (indexed && (!resolveAccessor(gltf, buffers, primitive["indices"].getIndex(), indices)
+            || indices.components != 1 || (indices.componentType != GLTF_UNSIGNED_BYTE
+            && indices.componentType != GLTF_UNSIGNED_SHORT && indices.componentType != GLTF_UNSIGNED_INT)))
+        {
+            cout << "glTF primitive with unusable indices" << endl;
+            return false;
+        }
+
+        const size_t triangles = (indexed ? indices.count : positions.count) / 3;
+        const size_t first = mesh.getVertexCount();
+        mesh.vertices.resize((first + triangles * 3) * FLOATS);
+        float* out = mesh.vertices.data() + first * FLOATS;
+
+        const glm::mat3 normalMatrix = glm::transpose(glm::inverse(glm::mat3(world)));
+        atomic<bool> outOfRange(false);
+        forEach(jobs, (triangles + EXPAND_GRAIN - 1) / EXPAND_GRAIN, 1, [&](size_t range) {
+            const size_t end = min(triangles, (range + 1) * EXPAND_GRAIN);
+            for (size_t t = range * EXPAND_GRAIN; t < end; ++t)
+            {
+                uint32_t corner[3];
+                glm::vec3 position[3];
+                for (int k = 0; k < 3; ++k)
+                {
+                    corner[k] = indexed ? readIndex(indices, 3 * t + k) : (uint32_t)(3 * t + k);
+                    if (corner[k] >= positions.count)
+                    {
+                        outOfRange = true;
+                        corner[k] = 0;
+                    }
+                    float value[3];
+                    readFloats(positions, corner[k], value, 3);
+                    position[k] = glm::vec3(world * glm::vec4(loadVec3(value), 1.0f));
+                }
+
+                const glm::vec3 flat = hasNormals ? glm::vec3(0.0f) : faceNormal(position[0], position[1], position[2]);
+                for (int k = 0; k < 3; ++k)
+                {
+                    glm::vec3 normal = flat;
+                    if (hasNormals)
+                    {
+                        float value[3];
+                        readFloats(normals, corner[k], value, 3);
+                        normal = normalMatrix * loadVec3(value);
+                        const float length = glm::length(normal);
+                        normal = length > 0.0f ? normal / length : normal;
+                    }
+                    glm::vec2 uv(0.0f);
+                    if (hasUvs)
+                    {
+                        float value[2];
+                        readFloats(uvs, corner[k], value, 2);
+                        uv = glm::vec2(value[0], 1.0f - value[1]);
+                    }
+                    writeVertex(out + (3 * t + k) * FLOATS, position[k], normal, uv);
+                }
+            }
+        });
+
+        if (outOfRange)
+        {
+            cout << "glTF primitive has indices past its vertices" << endl;
+            return false;
+        }
+        return true;
+    }
+}
+
+
+bool UParseMeshImportArgs(int argc, char* argv[], MeshImportOptions& options)
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        const char* arg = argv[i];
+        if (strcmp(arg, "--mesh") != 0)
+            continue;
+
+        const char* value = i + 1 < argc ? argv[++i] : "";
+        const char* separator = strchr(value, '=');
+        if (!separator || separator == value || separator[1] == '\0')
+        {
+            cout << "Invalid value for " << arg << endl;
+            return false;
+        }
+        options.files.emplace_back(string(value, separator), string(separator + 1));
+    }
+
+    return true;
+}
+
+
+const char* UParseFloat(const char* text, const char* end, float& value)
+{
+    double result;
+    const char* next = parseDecimal(text, end, result);
+    if (next != text)
+        value = (float)result;
+    return next;
+}
+
+
+bool UReadFileBytes(const string& path, vector<char>& data)
+{
+    // Packed files are copied out of the pack
+    if (UAssets().contains(path))
+    {
+        AssetData asset;
+        if (!UAssets().read(path, asset))
+            return false;
+        data.assign(asset.getData(), asset.getData() + asset.getSize());
+        return true;
+    }
+
+    ifstream file(path, ios::binary | ios::ate);
+    if (!file)
+        return false;
+
+    const streamoff size = file.tellg();
+    data.resize((size_t)size);
+    file.seekg(0);
+    return size == 0 || (bool)file.read(data.data(), size);
+}
+
+
+bool UImportObj(const char* data, size_t size, ImportedMesh& mesh, JobSystem* jobs)
+{
+    // Chunks start after a line break, so no line is split
+    const size_t maxChunks = jobs ? 4 * (size_t)jobs->getThreadCount() : 1;
+    const size_t chunkCount = max<size_t>(1, min(maxChunks, size / OBJ_CHUNK_BYTES));
+    vector<ObjChunk> chunks(chunkCount);
+    const char* end = data + size;
+    const char* begin = data;
+    for (size_t i = 0; i < chunkCount; ++i)
+    {
+        const char* split = i + 1 == chunkCount ? end : data + size / chunkCount * (i + 1);
+        split = max(split, begin);
+        if (split < end)
+        {
+            const char* lineEnd = findLineEnd(split, end);
+            split = lineEnd < end ? lineEnd + 1 : end;
+        }
+        chunks[i].begin = begin;
+        chunks[i].end = split;
+        begin = split;
+    }
+
+    forEach(jobs, chunkCount, 1, [&](size_t i) { countObjChunk(chunks[i]); });
+
+    size_t positions = 0, uvs = 0, normals = 0;
+    for (ObjChunk& chunk : chunks)
+    {
+        chunk.firstPosition = positions;
+        chunk.firstUv = uvs;
+        chunk.firstNormal = normals;
+        positions += chunk.positions;
+        uvs += chunk.uvs;
+        normals += chunk.normals;
+    }
+
+    vector<float> positionData(positions * 3), uvData(uvs * 2), normalData(normals * 3);
+    forEach(jobs, chunkCount, 1, [&](size_t i) {
+        parseObjChunk(chunks[i], positions, uvs, normals, positionData.data(), uvData.data(), normalData.data());
+    });
+
+    size_t vertices = 0;
+    for (ObjChunk& chunk : chunks)
+    {
+        if (chunk.error)
+        {
+            cout << chunk.error << " in OBJ file" << endl;
+            return false;
+        }
+        chunk.firstVertex = vertices;
+        vertices += chunk.corners.size();
+    }
+
+    mesh.vertices.resize(vertices * FLOATS);
+    forEach(jobs, chunkCount, 1, [&](size_t i) {
+        expandObjChunk(chunks[i], positionData.data(), uvData.data(), normalData.data(), mesh.vertices.data());
+    });
+    return true;
+}
+
+
+bool UImportGltf(const char* data, size_t size, const string& directory, ImportedMesh& mesh, JobSystem* jobs)
+{
+    // A .glb holds the JSON and the first buffer as chunks; a .gltf is all JSON
+    const char* json = data;
+    size_t jsonSize = size;
+    const char* binary = nullptr;
+    size_t binarySize = 0;
+    if (size >= 12 && readU32(data) == GLB_MAGIC)
+    {
+        json = nullptr;
+        const size_t length = min<size_t>(readU32(data + 8), size);
+        for (size_t offset = 12; offset + 8 <= length;)
+        {
+            const size_t chunkSize = readU32(data + offset);
+            const uint32_t chunkType = readU32(data + offset + 4);
+            if (chunkSize > length - offset - 8)
+                break;
+            if (chunkType == GLB_JSON && !json)
+            {
+                json = data + offset + 8;
+                jsonSize = chunkSize;
+            }
+            else if (chunkType == GLB_BIN && !binary)
+            {
+                binary = data + offset + 8;
+                binarySize = chunkSize;
+            }
+            offset += 8 + ((chunkSize + 3) & ~(size_t)3);
+        }
+        if (!json)
+        {
+            cout << "GLB file without a JSON chunk" << endl;
+            return false;
+        }
+    }
+
+    JsonValue gltf;
+    if (!JsonParser(json, json + jsonSize).parse(gltf) || gltf.type != JsonValue::JSON_OBJECT)
+    {
+        cout << "Invalid glTF JSON" << endl;
+        return false;
+    }
+    if (gltf["asset"]["version"].text.compare(0, 2, "2.") != 0)
+    {
+        cout << "Only glTF 2.0 files are supported" << endl;
+        return false;
+    }
+
+    vector<GltfBuffer> buffers;
+    if (!loadGltfBuffers(gltf, directory, binary, binarySize, buffers))
+        return false;
+
+    // Meshes where the default scene places them; without scenes, every mesh once
+    vector<pair<long long, glm::mat4>> instances;
+    const JsonValue& scenes = gltf["scenes"];
+    if (scenes.items.empty())
+    {
+        for (size_t i = 0; i < gltf["meshes"].items.size(); ++i)
+            instances.emplace_back((long long)i, glm::mat4(1.0f));
+    }
+    else
+    {
+        const JsonValue& scene = scenes[(size_t)max(0LL, (long long)gltf["scene"].getNumber(0.0))];
+        for (const JsonValue& node : scene["nodes"].items)
+            collectMeshInstances(gltf, node.getIndex(), glm::mat4(1.0f), 0, instances);
+    }
+
+    mesh.vertices.clear();
+    for (const pair<long long, glm::mat4>& instance : instances)
+    {
+        for (const JsonValue& primitive : gltf["meshes"][(size_t)instance.first]["primitives"].items)
+        {
+            if (!appendPrimitive(gltf, buffers, primitive, instance.second, mesh, jobs))
+                return false;
+        }
+    }
+    return true;
+}
+
+
+bool UImportMesh(const string& path, ImportedMesh& mesh, JobSystem* jobs)
+{
+    const size_t dot = path.find_last_of('.');
+    string extension = dot == string::npos ? string() : path.substr(dot + 1);
+    transform(extension.begin(), extension.end(), extension.begin(), [](char c) { return (char)tolower((unsigned char)c); });
+    if (extension != "obj" && extension != "gltf" && extension != "glb")
+    {
+        cout << "Unsupported mesh format " << path << " (expected .obj, .gltf or .glb)" << endl;
+        return false;
+    }
+
+    // Parsed in place, from the pack or the file's mapping
+    AssetData file;
+    if (!UAssets().read(path, file))
+    {
+        cout << "Failed to read mesh " << path << endl;
+        return false;
+    }
+
+    const char* data = reinterpret_cast<const char*>(file.getData());
+    const size_t slash = path.find_last_of("/\\");
+    const string directory = slash == string::npos ? string() : path.substr(0, slash + 1);
+    const bool imported = extension == "obj" ? UImportObj(data, file.getSize(), mesh, jobs)
+        : UImportGltf(data, file.getSize(), directory, mesh, jobs);
+    if (!imported)
+        cout << "Failed to import mesh " << path << endl;
+    return imported;
+}
@@ -0,0 +1,78 @@
+///////////////////////////////////////////////////////////////////////////////
+// MeshImport.h
+// ============
+// Loads meshes from Wavefront OBJ and glTF 2.0 files (.gltf with external or
+// base64 buffers, and binary .glb) into the layout the scene meshes use:
+// unindexed triangles for glDrawArrays, 8 floats per vertex (position,
+// normal, texture coordinate).
+//
+// Numbers are read with UParseFloat, which ignores the locale and works on
+// the file buffer in place instead of copying each token like strtof.
+// OBJ files are cut into chunks at line breaks and parsed on the job
+// system in three passes: the first counts the v/vt/vn lines of every
+// chunk so each knows where its elements land (relative indices included),
+// the second parses them straight into shared arrays and collects the
+// chunk's faces, and the third expands the faces into vertices at the
+// chunk's offset. glTF primitives are expanded on the job system in ranges
+// of triangles.
+//
+// Polygons are fan triangulated. Missing normals become face normals and
+// missing texture coordinates 0. glTF meshes are placed by the node
+// hierarchy of the default scene, and their texture coordinates flipped to
+// the OBJ convention of v pointing up, which is what the flipped texture
+// images expect.
+//
+// Files, external glTF buffers included, are read through UAssets(), so they
+// may come from a mounted asset pack.
+//
+// Usage:
+//   "Proj_1 Niebla" [--mesh book=assets/book.obj] [--mesh cable=cable.glb]
+//                   (base, book, ball, candle, topper or cable)
+//
+//   ImportedMesh mesh;
+//   if (UImportMesh("assets/book.obj", mesh, jobs))
+//       upload(mesh.vertices.data(), mesh.vertices.size() * sizeof(float));
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef MESH_IMPORT_H
+#define MESH_IMPORT_H
+
+#include <cstddef>
+#include <string>
+#include <utility>
+#include <vector>
+
+class JobSystem;
+
+struct MeshImportOptions
+{
+    std::vector<std::pair<std::string, std::string>> files;    // scene mesh name, file
+};
+
+struct ImportedMesh
+{
+    static const int FLOATS_PER_VERTEX = 8;     // position, normal, texture coordinate
+
+    std::vector<float> vertices;
+
+    size_t getVertexCount() const { return vertices.size() / FLOATS_PER_VERTEX; }
+};
+
+bool UParseMeshImportArgs(int argc, char* argv[], MeshImportOptions& options);
+
+// Parses a decimal number ("-1.5e3", no hex, inf or nan) starting at text.
+// Returns the end of the number, or text when there is none.
+const char* UParseFloat(const char* text, const char* end, float& value);
+
+bool UReadFileBytes(const std::string& path, std::vector<char>& data);
+
+// jobs may be null to parse on the calling thread; directory is where a
+// .gltf file's external buffers are looked up
+bool UImportObj(const char* data, size_t size, ImportedMesh& mesh, JobSystem* jobs = nullptr);
+bool UImportGltf(const char* data, size_t size, const std::string& directory, ImportedMesh& mesh,
+    JobSystem* jobs = nullptr);
+
+// Picks the importer by extension (.obj, .gltf, .glb)
+bool UImportMesh(const std::string& path, ImportedMesh& mesh, JobSystem* jobs = nullptr);
+
+#endif
@@ -0,0 +1,986 @@
+#include "MeshSimplify.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+#include <glm/glm.hpp>
+
+using namespace std;
+
+namespace
+{
+    const int FLOATS = 8;           // position, normal, texture coordinate
+    const int ATTRIBUTES = 5;       // normal and texture coordinate components
+    const uint32_t NONE = 0xFFFFFFFFu;
+    // A collapse may turn a triangle by up to about 75 degrees
+    const float MIN_NORMAL_COSINE = 0.25f;
+    // Points within 1 / WELD_STEPS of the radius of the bounds weld
+    const float WELD_STEPS = 1e5f;
+
+    // Sum of weighted squared distances w * (n.p + d)^2, as p'Ap + 2b.p + c
+    struct PositionQuadric
+    {
+        float a00, a11, a22, a01, a02, a12;
+        float b0, b1, b2;
+        float c;
+    };
+
+    // Position part plus, per attribute, the weighted sums of the gradients and
+    // offsets of the linear functions the triangles interpolate it with
+    struct Quadric
+    {
+        PositionQuadric position;
+        float weight;                   // area of the triangles summed in
+        float gradient[ATTRIBUTES][3];
+        float offset[ATTRIBUTES];
+    };
+
+    enum VertexKind : uint8_t
+    {
+        VERTEX_INTERIOR,    // manifold, no open edges
+        VERTEX_BORDER,      // manifold, on one open border
+        VERTEX_LOCKED,      // non-manifold or where borders meet: never removed
+    };
+
+    void addSquared(PositionQuadric& q, const glm::vec3& n, float d, float weight)
+    {
+        q.a00 += weight * n.x * n.x;
+        q.a11 += weight * n.y * n.y;
+        q.a22 += weight * n.z * n.z;
+        q.a01 += weight * n.x * n.y;
+        q.a02 += weight * n.x * n.z;
+        q.a12 += weight * n.y * n.z;
+        q.b0 += weight * d * n.x;
+        q.b1 += weight * d * n.y;
+        q.b2 += weight * d * n.z;
+        q.c += weight * d * d;
+    }
+
+    void add(PositionQuadric& to, const PositionQuadric& from)
+    {
+        to.a00 += from.a00;
+        to.a11 += from.a11;
+        to.a22 += from.a22;
+        to.a01 += from.a01;
+        to.a02 += from.a02;
+        to.a12 += from.a12;
+        to.b0 += from.b0;
+        to.b1 += from.b1;
+        to.b2 += from.b2;
+        to.c += from.c;
+    }
+
+    void add(Quadric& to, const Quadric& from)
+    {
+        add(to.position, from.position);
+        to.weight += from.weight;
+        for (int j = 0; j < ATTRIBUTES; ++j)
+        {
+            for (int axis = 0; axis < 3; ++axis)
+                to.gradient[j][axis] += from.gradient[j][axis];
+            to.offset[j] += from.offset[j];
+        }
+    }
+
+    float evaluate(const PositionQuadric& q, const glm::vec3& p)
+    {
+        return p.x * p.x * q.a00 + p.y * p.y * q.a11 + p.z * p.z * q.a22
+            + 2.0f * (p.x * p.y * q.a01 + p.x * p.z * q.a02 + p.y * p.z * q.a12)
+            + 2.0f * (p.x * q.b0 + p.y * q.b1 + p.z * q.b2) + q.c;
+    }
+
+    // Error of moving the wedge the quadric belongs to onto p with the given (scaled) attributes
+    float evaluate(const Quadric& q, const glm::vec3& p, const float* attributes)
+    {
+        float error = evaluate(q.position, p);
+        for (int j = 0; j < ATTRIBUTES; ++j)
+        {
+            const float* g = q.gradient[j];
+            const float s = attributes[j];
+            error += q.weight * s * s - 2.0f * s * (g[0] * p.x + g[1] * p.y + g[2] * p.z + q.offset[j]);
+        }
+        return error;
+    }
+
+    uint32_t hashFloats(const float* values, int count)
+    {
+        uint32_t hash = 2166136261u;
+        for (int i = 0; i < count; ++i)
+        {
+            uint32_t bits;
+            memcpy(&bits, values + i, sizeof(bits));
+            hash = (hash ^ bits) * 16777619u;
+            hash ^= hash >> 15;
+        }
+        return hash;
+    }
+
+    // Numbers count records of stride floats by their first compared floats, in
+    // order of first appearance: ids gets each record's number, firsts the
+    // record each number was first seen at
+    void weld(const float* records, size_t count, int stride, int compared, vector<uint32_t>& ids, vector<uint32_t>& firsts)
+    {
+        size_t tableSize = 16;
+        while (tableSize < count * 2)
+            tableSize *= 2;
+        vector<uint32_t> table(tableSize, NONE);
+
+        ids.resize(count);
+        firsts.clear();
+        for (size_t i = 0; i < count; ++i)
+        {
+            const float* record = records + i * stride;
+            size_t slot = hashFloats(record, compared) & (tableSize - 1);
+            for (;;)
+            {
+                const uint32_t found = table[slot];
+                if (found == NONE)
+                {
+                    table[slot] = (uint32_t)i;
+                    ids[i] = (uint32_t)firsts.size();
+                    firsts.push_back((uint32_t)i);
+                    break;
+                }
+                if (memcmp(records + (size_t)found * stride, record, compared * sizeof(float)) == 0)
+                {
+                    ids[i] = ids[found];
+                    break;
+                }
+                slot = (slot + 1) & (tableSize - 1);
+            }
+        }
+    }
+
+    // Closest point to p on triangle abc (Ericson, Real-Time Collision Detection 5.1.5)
+    glm::vec3 closestOnTriangle(const glm::vec3& p, const glm::vec3& a, const glm::vec3& b, const glm::vec3& c)
+    {
+        const glm::vec3 ab = b - a;
+        const glm::vec3 ac = c - a;
+        const glm::vec3 ap = p - a;
+        const float d1 = glm::dot(ab, ap);
+        const float d2 = glm::dot(ac, ap);
+        if (d1 <= 0.0f && d2 <= 0.0f)
+            return a;
+
+        const glm::vec3 bp = p - b;
+        const float d3 = glm::dot(ab, bp);
+        const float d4 = glm::dot(ac, bp);
+        if (d3 >= 0.0f && d4 <= d3)
+            return b;
+        const float vc = d1 * d4 - d3 * d2;
+        if (vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f)
+            return a + ab * (d1 / (d1 - d3));
+
+        const glm::vec3 cp = p - c;
+        const float d5 = glm::dot(ab, cp);
+        const float d6 = glm::dot(ac, cp);
+        if (d6 >= 0.0f && d5 <= d6)
+            return c;
+        const float vb = d5 * d2 - d1 * d6;
+        if (vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f)
+            return a + ac * (d2 / (d2 - d6));
+        const float va = d3 * d6 - d5 * d4;
+        if (va <= 0.0f && d4 - d3 >= 0.0f && d5 - d6 >= 0.0f)
+            return b + (c - b) * ((d4 - d3) / ((d4 - d3) + (d5 - d6)));
+
+        const float sum = va + vb + vc;
+        if (!(sum > 0.0f))
+            return a;
+        return a + ab * (vb / sum) + ac * (vc / sum);
+    }
+
+    glm::vec3 positionAt(const float* vertices, size_t index)
+    {
+        const float* vertex = vertices + index * FLOATS;
+        return glm::vec3(vertex[0], vertex[1], vertex[2]);
+    }
+
+    // Of the sphere around the center of the box, as the scene's mesh bounds
+    // are; 1 for a point, so distances relative to it stay finite
+    float boundingRadius(const float* vertices, size_t vertexCount, const glm::vec3& center)
+    {
+        float radius = 0.0f;
+        for (size_t i = 0; i < vertexCount; ++i)
+            radius = max(radius, glm::length(positionAt(vertices, i) - center));
+        return radius > 0.0f ? radius : 1.0f;
+    }
+
+    // Reference triangles bucketed into a uniform grid of cubic cells, searched
+    // in growing shells of cells around the query point
+    class TriangleGrid
+    {
+    public:
+        TriangleGrid(const float* vertices, size_t vertexCount, const glm::vec3& lower, const glm::vec3& upper);
+
+        float distance(const glm::vec3& p);
+
+    private:
+        int cellOf(float value, int axis) const;
+
+        vector<glm::vec3> corners;
+        glm::vec3 lower;
+        float cellSize;
+        int resolution;
+        vector<uint32_t> cellStarts;
+        vector<uint32_t> cellTriangles;
+        vector<uint32_t> visited;       // query that last tested each triangle
+        uint32_t query = 0;
+    };
+
+
+    TriangleGrid::TriangleGrid(const float* vertices, size_t vertexCount, const glm::vec3& lower, const glm::vec3& upper)
+        : lower(lower)
+    {
+        const size_t triangleCount = vertexCount / 3;
+        corners.resize(triangleCount * 3);
+        for (size_t i = 0; i < corners.size(); ++i)
+            corners[i] = positionAt(vertices, i);
+
+        const glm::vec3 extent = upper - lower;
+        const float largest = max(max(extent.x, extent.y), max(extent.z, 1e-6f));
+        // About one triangle per cell along a surface
+        resolution = (int)min(128.0, max(1.0, sqrt((double)triangleCount)));
+        cellSize = largest / resolution;
+
+        // Two passes over each triangle's box of cells: count, then fill
+        const size_t cellCount = (size_t)resolution * resolution * resolution;
+        cellStarts.assign(cellCount + 1, 0);
+        for (int pass = 0; pass < 2; ++pass)
+        {
+            vector<uint32_t> cursor;
+            if (pass == 1)
+            {
+                for (size_t c = 0; c < cellCount; ++c)
+                    cellStarts[c + 1] += cellStarts[c];
+                cellTriangles.resize(cellStarts[cellCount]);
+                cursor.assign(cellStarts.begin(), cellStarts.end() - 1);
+            }
+            for (size_t t = 0; t < triangleCount; ++t)
+            {
+                const glm::vec3* triangle = &corners[t * 3];
+                const glm::vec3 low = glm::min(glm::min(triangle[0], triangle[1]), triangle[2]);
+                const glm::vec3 high = glm::max(glm::max(triangle[0], triangle[1]), triangle[2]);
+                for (int z = cellOf(low.z, 2); z <= cellOf(high.z, 2); ++z)
+                {
+                    for (int y = cellOf(low.y, 1); y <= cellOf(high.y, 1); ++y)
+                    {
+                        for (int x = cellOf(low.x, 0); x <= cellOf(high.x, 0); ++x)
+                        {
+                            const size_t cell = ((size_t)z * resolution + y) * resolution + x;
+                            if (pass == 0)
+                                cellStarts[cell + 1]++;
+                            else
+                                cellTriangles[cursor[cell]++] = (uint32_t)t;
+                        }
+                    }
+                }
+            }
+        }
+        visited.assign(triangleCount, NONE);
+    }
+
+
+    int TriangleGrid::cellOf(float value, int axis) const
+    {
+        const int cell = (int)floor((value - lower[axis]) / cellSize);
+        return min(max(cell, 0), resolution - 1);
+    }
+
+
+    float TriangleGrid::distance(const glm::vec3& p)
+    {
+        query++;
+        const int center[3] = { cellOf(p.x, 0), cellOf(p.y, 1), cellOf(p.z, 2) };
+        float best = INFINITY;
+        for (int ring = 0; ring < resolution; ++ring)
+        {
+            for (int z = max(center[2] - ring, 0); z <= min(center[2] + ring, resolution - 1); ++z)
+            {
+                for (int y = max(center[1] - ring, 0); y <= min(center[1] + ring, resolution - 1); ++y)
+                {
+                    for (int x = max(center[0] - ring, 0); x <= min(center[0] + ring, resolution - 1); ++x)
+                    {
+                        // Only the shell; the cells inside were searched by the smaller rings
+                        const int shell = max(max(abs(x - center[0]), abs(y - center[1])), abs(z - center[2]));
+                        if (shell != ring)
+                            continue;
+
+                        const size_t cell = ((size_t)z * resolution + y) * resolution + x;
+                        for (uint32_t i = cellStarts[cell]; i < cellStarts[cell + 1]; ++i)
+                        {
+                            const uint32_t t = cellTriangles[i];
+                            if (visited[t] == query)
+                                continue;
+                            visited[t] = query;
+                            const glm::vec3* triangle = &corners[(size_t)t * 3];
+                            best = min(best, glm::length(p - closestOnTriangle(p, triangle[0], triangle[1], triangle[2])));
+                        }
+                    }
+                }
+            }
+            // Cells past this shell are at least ring cells away from the one holding p
+            if (best <= ring * cellSize)
+                break;
+        }
+        return best;
+    }
+
+
+    // Collapses position edges of a welded mesh; see MeshSimplify.h
+    class Simplifier
+    {
+    public:
+        Simplifier(const float* vertices, size_t vertexCount, const SimplifyOptions& options);
+
+        // Collapses edges until at most target triangles are left or no collapse is allowed
+        void simplify(size_t targetTriangles);
+        void extract(vector<float>& vertices) const;
+
+        size_t getTriangleCount() const { return triangles.size() / 3; }
+        float getError() const { return sqrt(maxCost); }
+
+    private:
+        struct Candidate
+        {
+            float cost;
+            uint32_t from;
+            uint32_t to;
+        };
+
+        // A wedge of the removed vertex and the wedge it merges into, or NONE when it moves
+        struct WedgeMove
+        {
+            uint32_t wedge;
+            uint32_t target;
+        };
+
+        uint32_t positionOf(size_t corner) const { return wedgePositions[triangles[corner]]; }
+        void buildAdjacency();
+        void classifyVertices();
+        size_t collectMoves(uint32_t from, uint32_t to);
+        void collectNeighbors(uint32_t position, vector<uint32_t>& neighbors) const;
+        bool computeCost(uint32_t from, uint32_t to, float& cost);
+        bool tryCollapse(uint32_t from, uint32_t to, size_t& removed);
+        bool flipsTriangle(uint32_t from, uint32_t to) const;
+        void compactTriangles();
+
+        // Per wedge
+        vector<uint32_t> wedgePositions;
+        vector<float> attributes;           // as given, for the output
+        vector<float> scaledAttributes;     // weighted for the costs
+        vector<Quadric> quadrics;
+        vector<uint32_t> wedgeRemap;        // wedge each merged one is replaced by this pass
+
+        // Per position
+        vector<glm::vec3> positions;        // relative to the bounds, for the costs
+        vector<glm::vec3> originals;
+        vector<PositionQuadric> borders;
+        vector<uint8_t> kinds;
+        vector<uint8_t> locked;
+        vector<uint32_t> adjacencyStarts;   // triangles around each position
+        vector<uint32_t> adjacency;
+
+        vector<uint32_t> triangles;         // wedges, 3 per triangle
+        float maxCost = 0.0f;
+
+        vector<uint64_t> edges;             // each once, lower position first
+        vector<Candidate> candidates;
+        vector<WedgeMove> moves;
+        vector<uint32_t> fromNeighbors;
+        vector<uint32_t> toNeighbors;
+    };
+
+
+    Simplifier::Simplifier(const float* vertices, size_t vertexCount, const SimplifyOptions& options)
+    {
+        // -0 equals 0 but would not weld with it
+        vector<float> corners(vertices, vertices + (vertexCount - vertexCount % 3) * FLOATS);
+        for (float& value : corners)
+        {
+            if (value == 0.0f)
+                value = 0.0f;
+        }
+        const size_t cornerCount = corners.size() / FLOATS;
+
+        vector<uint32_t> cornerWedges, wedgeCorners;
+        weld(corners.data(), cornerCount, FLOATS, FLOATS, cornerWedges, wedgeCorners);
+        const size_t wedgeCount = wedgeCorners.size();
+        vector<float> wedges(wedgeCount * FLOATS);
+        for (size_t w = 0; w < wedgeCount; ++w)
+            copy_n(&corners[(size_t)wedgeCorners[w] * FLOATS], FLOATS, &wedges[w * FLOATS]);
+
+        // Costs are measured relative to the radius of the bounds, so the same
+        // weights suit meshes of any size
+        glm::vec3 lower(0.0f), upper(0.0f);
+        for (size_t w = 0; w < wedgeCount; ++w)
+        {
+            const glm::vec3 position = positionAt(wedges.data(), w);
+            lower = w == 0 ? position : glm::min(lower, position);
+            upper = w == 0 ? position : glm::max(upper, position);
+        }
+        const glm::vec3 center = (lower + upper) * 0.5f;
+        const float radius = boundingRadius(wedges.data(), wedgeCount, center);
+
+        // Positions are welded on a fine grid: generated meshes such as the
+        // sphere close their seams and poles with points a rounding error apart
+        vector<float> cells(wedgeCount * 3);
+        for (size_t w = 0; w < wedgeCount; ++w)
+        {
+            for (int axis = 0; axis < 3; ++axis)
+            {
+                const float cell = round((wedges[w * FLOATS + axis] - center[axis]) / radius * WELD_STEPS);
+                cells[w * 3 + axis] = cell == 0.0f ? 0.0f : cell;
+            }
+        }
+        vector<uint32_t> positionWedges;
+        weld(cells.data(), wedgeCount, 3, 3, wedgePositions, positionWedges);
+        const size_t positionCount = positionWedges.size();
+
+        originals.resize(positionCount);
+        positions.resize(positionCount);
+        for (size_t p = 0; p < positionCount; ++p)
+        {
+            originals[p] = positionAt(wedges.data(), positionWedges[p]);
+            positions[p] = (originals[p] - center) / radius;
+        }
+
+        const float scales[ATTRIBUTES] = { options.normalWeight, options.normalWeight, options.normalWeight,
+            options.uvWeight, options.uvWeight };
+        attributes.resize(wedgeCount * ATTRIBUTES);
+        scaledAttributes.resize(wedgeCount * ATTRIBUTES);
+        for (size_t w = 0; w < wedgeCount; ++w)
+        {
+            for (int j = 0; j < ATTRIBUTES; ++j)
+            {
+                attributes[w * ATTRIBUTES + j] = wedges[w * FLOATS + 3 + j];
+                scaledAttributes[w * ATTRIBUTES + j] = wedges[w * FLOATS + 3 + j] * scales[j];
+            }
+        }
+
+        // Triangles with two corners at one position have no area to keep
+        triangles.reserve(cornerCount);
+        for (size_t corner = 0; corner < cornerCount; corner += 3)
+        {
+            const uint32_t* wedge = &cornerWedges[corner];
+            const uint32_t p0 = wedgePositions[wedge[0]], p1 = wedgePositions[wedge[1]], p2 = wedgePositions[wedge[2]];
+            if (p0 != p1 && p1 != p2 && p2 != p0)
+                triangles.insert(triangles.end(), wedge, wedge + 3);
+        }
+
+        quadrics.assign(wedgeCount, Quadric());
+        for (size_t t = 0; t < triangles.size(); t += 3)
+        {
+            const uint32_t* wedge = &triangles[t];
+            const glm::vec3& p0 = positions[wedgePositions[wedge[0]]];
+            const glm::vec3 e1 = positions[wedgePositions[wedge[1]]] - p0;
+            const glm::vec3 e2 = positions[wedgePositions[wedge[2]]] - p0;
+            const glm::vec3 normal = glm::cross(e1, e2);
+            const float normalLength = glm::length(normal);
+            if (!(normalLength > 0.0f))
+                continue;
+
+            Quadric q = {};
+            q.weight = normalLength * 0.5f;
+            const glm::vec3 unitNormal = normal / normalLength;
+            addSquared(q.position, unitNormal, -glm::dot(unitNormal, p0), q.weight);
+
+            // Each attribute as the linear function g.p + d the triangle interpolates it with
+            const glm::vec3 across1 = glm::cross(e2, normal) / (normalLength * normalLength);
+            const glm::vec3 across2 = glm::cross(normal, e1) / (normalLength * normalLength);
+            for (int j = 0; j < ATTRIBUTES; ++j)
+            {
+                const float s0 = scaledAttributes[wedge[0] * ATTRIBUTES + j];
+                const float s1 = scaledAttributes[wedge[1] * ATTRIBUTES + j];
+                const float s2 = scaledAttributes[wedge[2] * ATTRIBUTES + j];
+                const glm::vec3 g = across1 * (s1 - s0) + across2 * (s2 - s0);
+                const float d = s0 - glm::dot(g, p0);
+                addSquared(q.position, g, d, q.weight);
+                for (int axis = 0; axis < 3; ++axis)
+                    q.gradient[j][axis] = q.weight * g[axis];
+                q.offset[j] = q.weight * d;
+            }
+
+            for (int k = 0; k < 3; ++k)
+                add(quadrics[wedge[k]], q);
+        }
+
+        // Open edges are those whose reverse no triangle has; planes through them,
+        // perpendicular to their triangle, hold the border vertices on the outline
+        vector<uint64_t> edges;
+        edges.reserve(triangles.size());
+        for (size_t t = 0; t < triangles.size(); t += 3)
+        {
+            for (int k = 0; k < 3; ++k)
+                edges.push_back((uint64_t)positionOf(t + k) << 32 | positionOf(t + (k + 1) % 3));
+        }
+        sort(edges.begin(), edges.end());
+
+        borders.assign(positionCount, PositionQuadric());
+        for (size_t t = 0; t < triangles.size(); t += 3)
+        {
+            const glm::vec3 normal = glm::cross(positions[positionOf(t + 1)] - positions[positionOf(t)],
+                positions[positionOf(t + 2)] - positions[positionOf(t)]);
+            for (int k = 0; k < 3; ++k)
+            {
+                const uint32_t a = positionOf(t + k), b = positionOf(t + (k + 1) % 3);
+                if (binary_search(edges.begin(), edges.end(), (uint64_t)b << 32 | a))
+                    continue;
+                const glm::vec3 edge = positions[b] - positions[a];
+                const glm::vec3 outward = glm::cross(edge, normal);
+                const float outwardLength = glm::length(outward);
+                if (!(outwardLength > 0.0f))
+                    continue;
+                const glm::vec3 plane = outward / outwardLength;
+                const float weight = options.borderWeight * glm::dot(edge, edge);
+                addSquared(borders[a], plane, -glm::dot(plane, positions[a]), weight);
+                addSquared(borders[b], plane, -glm::dot(plane, positions[a]), weight);
+            }
+        }
+
+        wedgeRemap.resize(wedgeCount);
+        for (size_t w = 0; w < wedgeCount; ++w)
+            wedgeRemap[w] = (uint32_t)w;
+        kinds.resize(positionCount);
+        locked.resize(positionCount);
+    }
+
+
+    void Simplifier::simplify(size_t targetTriangles)
+    {
+        while (getTriangleCount() > targetTriangles)
+        {
+            buildAdjacency();
+            classifyVertices();
+
+            // The cheaper direction of every edge
+            candidates.clear();
+            for (uint64_t edge : edges)
+            {
+                const uint32_t a = (uint32_t)(edge >> 32), b = (uint32_t)edge;
+                float costA, costB;
+                const bool validA = computeCost(a, b, costA);
+                const bool validB = computeCost(b, a, costB);
+                if (validA && (!validB || costA <= costB))
+                    candidates.push_back(Candidate{ costA, a, b });
+                else if (validB)
+                    candidates.push_back(Candidate{ costB, b, a });
+            }
+            if (candidates.empty())
+                break;
+
+            // Collapses overlapping a cheaper one wait for the next pass; past 1.5
+            // times the cost of the last one needed, waiting is better than taking
+            // a costly collapse now, unless none within it is allowed. Close to the
+            // target a sixteenth of the edges stay within it, or the last few
+            // collapses would take a pass each.
+            const size_t excess = getTriangleCount() - targetTriangles;
+            const auto cheaper = [](const Candidate& l, const Candidate& r) { return l.cost < r.cost; };
+            const auto goal = candidates.begin() + min(candidates.size() - 1, max(excess / 2, candidates.size() / 16));
+            nth_element(candidates.begin(), goal, candidates.end(), cheaper);
+            float costLimit = goal->cost * 1.5f;
+            // Only those within the limit are ranked, unless it comes to the rest
+            const auto within = partition(candidates.begin(), candidates.end(),
+                [costLimit](const Candidate& c) { return c.cost <= costLimit; });
+            sort(candidates.begin(), within, cheaper);
+
+            fill(locked.begin(), locked.end(), (uint8_t)0);
+            size_t removed = 0;
+            size_t collapses = 0;
+            for (size_t i = 0; i < candidates.size() && removed < excess; ++i)
+            {
+                if (candidates[i].cost > costLimit)
+                {
+                    if (collapses > 0)
+                        break;
+                    sort(candidates.begin() + i, candidates.end(), cheaper);
+                    costLimit = candidates[i].cost * 1.5f;
+                }
+                if (tryCollapse(candidates[i].from, candidates[i].to, removed))
+                {
+                    maxCost = max(maxCost, candidates[i].cost);
+                    collapses++;
+                }
+            }
+            if (collapses == 0)
+                break;
+            compactTriangles();
+        }
+    }
+
+
+    void Simplifier::extract(vector<float>& vertices) const
+    {
+        vertices.resize(triangles.size() * FLOATS);
+        for (size_t corner = 0; corner < triangles.size(); ++corner)
+        {
+            const uint32_t wedge = triangles[corner];
+            float* vertex = &vertices[corner * FLOATS];
+            const glm::vec3& position = originals[wedgePositions[wedge]];
+            vertex[0] = position.x;
+            vertex[1] = position.y;
+            vertex[2] = position.z;
+            copy_n(&attributes[(size_t)wedge * ATTRIBUTES], ATTRIBUTES, vertex + 3);
+        }
+    }
+
+
+    void Simplifier::buildAdjacency()
+    {
+        adjacencyStarts.assign(positions.size() + 1, 0);
+        for (size_t corner = 0; corner < triangles.size(); ++corner)
+            adjacencyStarts[positionOf(corner) + 1]++;
+        for (size_t p = 0; p < positions.size(); ++p)
+            adjacencyStarts[p + 1] += adjacencyStarts[p];
+
+        adjacency.resize(triangles.size());
+        vector<uint32_t> cursor(adjacencyStarts.begin(), adjacencyStarts.end() - 1);
+        for (size_t corner = 0; corner < triangles.size(); ++corner)
+            adjacency[cursor[positionOf(corner)]++] = (uint32_t)(corner / 3);
+    }
+
+
+    // Manifold vertices have each neighbor once after and once before them in
+    // their triangles' winding, but for the two ends of the one open border
+    // they lie on. Lists every edge once on the way.
+    void Simplifier::classifyVertices()
+    {
+        edges.clear();
+        struct Link
+        {
+            uint32_t neighbor;
+            int outgoing;
+            int incoming;
+        };
+        vector<Link> links;
+
+        for (uint32_t p = 0; p < positions.size(); ++p)
+        {
+            links.clear();
+            for (uint32_t i = adjacencyStarts[p]; i < adjacencyStarts[p + 1]; ++i)
+            {
+                const size_t t = (size_t)adjacency[i] * 3;
+                int k = 0;
+                while (positionOf(t + k) != p)
+                    ++k;
+                const uint32_t next = positionOf(t + (k + 1) % 3);
+                const uint32_t previous = positionOf(t + (k + 2) % 3);
+                for (int side = 0; side < 2; ++side)
+                {
+                    const uint32_t neighbor = side == 0 ? next : previous;
+                    auto link = find_if(links.begin(), links.end(), [neighbor](const Link& l) { return l.neighbor == neighbor; });
+                    if (link == links.end())
+                        link = links.insert(links.end(), Link{ neighbor, 0, 0 });
+                    (side == 0 ? link->outgoing : link->incoming)++;
+                }
+            }
+
+            int openEdges = 0;
+            bool manifold = true;
+            for (const Link& link : links)
+            {
+                if (link.neighbor > p)
+                    edges.push_back((uint64_t)p << 32 | link.neighbor);
+                manifold = manifold && link.outgoing <= 1 && link.incoming <= 1;
+                openEdges += link.outgoing != link.incoming;
+            }
+            if (!manifold || (openEdges != 0 && openEdges != 2))
+                kinds[p] = VERTEX_LOCKED;
+            else
+                kinds[p] = openEdges == 0 ? VERTEX_INTERIOR : VERTEX_BORDER;
+        }
+    }
+
+
+    // Fills moves with the wedges of from and what becomes of them; returns the
+    // number of triangles the collapse removes
+    size_t Simplifier::collectMoves(uint32_t from, uint32_t to)
+    {
+        moves.clear();
+        size_t shared = 0;
+        for (uint32_t i = adjacencyStarts[from]; i < adjacencyStarts[from + 1]; ++i)
+        {
+            const size_t t = (size_t)adjacency[i] * 3;
+            uint32_t wedge = NONE, target = NONE;
+            for (int k = 0; k < 3; ++k)
+            {
+                const uint32_t position = positionOf(t + k);
+                if (position == from)
+                    wedge = triangles[t + k];
+                else if (position == to)
+                    target = triangles[t + k];
+            }
+            shared += target != NONE;
+
+            auto move = find_if(moves.begin(), moves.end(), [wedge](const WedgeMove& m) { return m.wedge == wedge; });
+            if (move == moves.end())
+                moves.push_back(WedgeMove{ wedge, target });
+            else if (move->target == NONE)
+                move->target = target;
+        }
+        return shared;
+    }
+
+
+    void Simplifier::collectNeighbors(uint32_t position, vector<uint32_t>& neighbors) const
+    {
+        neighbors.clear();
+        for (uint32_t i = adjacencyStarts[position]; i < adjacencyStarts[position + 1]; ++i)
+        {
+            const size_t t = (size_t)adjacency[i] * 3;
+            for (int k = 0; k < 3; ++k)
+            {
+                if (positionOf(t + k) != position)
+                    neighbors.push_back(positionOf(t + k));
+            }
+        }
+        sort(neighbors.begin(), neighbors.end());
+        neighbors.erase(unique(neighbors.begin(), neighbors.end()), neighbors.end());
+    }
+
+
+    bool Simplifier::computeCost(uint32_t from, uint32_t to, float& cost)
+    {
+        if (kinds[from] == VERTEX_LOCKED)
+            return false;
+        const size_t shared = collectMoves(from, to);
+        // Border vertices only slide along their border
+        if (shared == 0 || (kinds[from] == VERTEX_BORDER && shared != 1))
+            return false;
+
+        const glm::vec3& position = positions[to];
+        float error = evaluate(borders[from], position);
+        float weight = 0.0f;
+        for (const WedgeMove& move : moves)
+        {
+            const uint32_t kept = move.target != NONE ? move.target : move.wedge;
+            error += evaluate(quadrics[move.wedge], position, &scaledAttributes[(size_t)kept * ATTRIBUTES]);
+            weight += quadrics[move.wedge].weight;
+        }
+        cost = max(error, 0.0f) / max(weight, 1e-12f);
+        return true;
+    }
+
+
+    bool Simplifier::tryCollapse(uint32_t from, uint32_t to, size_t& removed)
+    {
+        if (locked[from] || locked[to])
+            return false;
+
+        // Edges between neighbors of both ends that are not sides of the
+        // collapsing triangles would be doubled
+        const size_t shared = collectMoves(from, to);
+        collectNeighbors(from, fromNeighbors);
+        collectNeighbors(to, toNeighbors);
+        size_t common = 0;
+        for (size_t i = 0, j = 0; i < fromNeighbors.size() && j < toNeighbors.size();)
+        {
+            if (fromNeighbors[i] < toNeighbors[j])
+                ++i;
+            else if (fromNeighbors[i] > toNeighbors[j])
+                ++j;
+            else
+            {
+                common++;
+                ++i;
+                ++j;
+            }
+        }
+        if (common != shared || flipsTriangle(from, to))
+            return false;
+
+        for (const WedgeMove& move : moves)
+        {
+            if (move.target != NONE)
+            {
+                wedgeRemap[move.wedge] = move.target;
+                add(quadrics[move.target], quadrics[move.wedge]);
+            }
+            wedgePositions[move.wedge] = to;
+        }
+        add(borders[to], borders[from]);
+
+        locked[from] = 1;
+        locked[to] = 1;
+        for (uint32_t neighbor : fromNeighbors)
+            locked[neighbor] = 1;
+        removed += shared;
+        return true;
+    }
+
+
+    bool Simplifier::flipsTriangle(uint32_t from, uint32_t to) const
+    {
+        for (uint32_t i = adjacencyStarts[from]; i < adjacencyStarts[from + 1]; ++i)
+        {
+            const size_t t = (size_t)adjacency[i] * 3;
+            glm::vec3 before[3], after[3];
+            bool collapsing = false;
+            for (int k = 0; k < 3; ++k)
+            {
+                const uint32_t position = positionOf(t + k);
+                collapsing = collapsing || position == to;
+                before[k] = positions[position];
+                after[k] = positions[position == from ? to : position];
+            }
+            if (collapsing)
+                continue;
+
+            const glm::vec3 oldNormal = glm::cross(before[1] - before[0], before[2] - before[0]);
+            const glm::vec3 newNormal = glm::cross(after[1] - after[0], after[2] - after[0]);
+            if (glm::dot(oldNormal, newNormal) <= MIN_NORMAL_COSINE * glm::length(oldNormal) * glm::length(newNormal))
+                return true;
+        }
+        return false;
+    }
+
+
+    void Simplifier::compactTriangles()
+    {
+        size_t kept = 0;
+        for (size_t t = 0; t < triangles.size(); t += 3)
+        {
+            uint32_t wedge[3];
+            for (int k = 0; k < 3; ++k)
+                wedge[k] = wedgeRemap[triangles[t + k]];
+            const uint32_t p0 = wedgePositions[wedge[0]], p1 = wedgePositions[wedge[1]], p2 = wedgePositions[wedge[2]];
+            if (p0 == p1 || p1 == p2 || p2 == p0)
+                continue;
+            copy_n(wedge, 3, &triangles[kept]);
+            kept += 3;
+        }
+        triangles.resize(kept);
+    }
+}
+
+
+bool UParseLodArgs(int argc, char* argv[], LodOptions& options)
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        const char* arg = argv[i];
+        if (strcmp(arg, "--lod") == 0)
+        {
+            options.enabled = true;
+            continue;
+        }
+        if (strcmp(arg, "--lod-report") == 0)
+        {
+            options.report = true;
+            continue;
+        }
+        if (strcmp(arg, "--lod-ratios") != 0 && strcmp(arg, "--lod-pixels") != 0)
+            continue;
+
+        const char* value = i + 1 < argc ? argv[++i] : "";
+        bool valid = value[0] != '\0';
+        if (strcmp(arg, "--lod-pixels") == 0)
+        {
+            char* end = nullptr;
+            options.maxPixels = strtof(value, &end);
+            valid = valid && *end == '\0' && options.maxPixels > 0.0f;
+        }
+        else
+        {
+            // Comma separated, each of the base mesh's triangles in (0, 1)
+            options.ratios.clear();
+            const char* next = value;
+            while (valid)
+            {
+                char* end = nullptr;
+                const float ratio = strtof(next, &end);
+                valid = end != next && ratio > 0.0f && ratio < 1.0f && (*end == ',' || *end == '\0');
+                if (valid)
+                    options.ratios.push_back(ratio);
+                if (*end != ',')
+                    break;
+                next = end + 1;
+            }
+        }
+
+        if (!valid)
+        {
+            cout << "Invalid value for " << arg << endl;
+            return false;
+        }
+    }
+
+    return true;
+}
+
+
+void USimplifyMesh(const float* vertices, size_t vertexCount, const vector<float>& ratios,
+    const SimplifyOptions& options, vector<SimplifiedMesh>& lods)
+{
+    vector<float> sorted(ratios);
+    sort(sorted.begin(), sorted.end(), [](float l, float r) { return l > r; });
+    lods.assign(sorted.size(), SimplifiedMesh());
+
+    Simplifier simplifier(vertices, vertexCount, options);
+    const size_t triangleCount = vertexCount / 3;
+    for (size_t i = 0; i < sorted.size(); ++i)
+    {
+        const float ratio = min(max(sorted[i], 0.0f), 1.0f);
+        simplifier.simplify((size_t)(triangleCount * ratio));
+        simplifier.extract(lods[i].vertices);
+        lods[i].error = simplifier.getError();
+    }
+}
+
+
+MeshDistance UMeasureMeshDistance(const float* mesh, size_t meshVertexCount,
+    const float* reference, size_t referenceVertexCount)
+{
+    MeshDistance distance;
+    meshVertexCount -= meshVertexCount % 3;
+    referenceVertexCount -= referenceVertexCount % 3;
+    if (meshVertexCount == 0 || referenceVertexCount == 0)
+        return distance;
+
+    // The grid covers both meshes, so every query point lies in a cell
+    glm::vec3 referenceLower = positionAt(reference, 0), referenceUpper = referenceLower;
+    for (size_t i = 1; i < referenceVertexCount; ++i)
+    {
+        referenceLower = glm::min(referenceLower, positionAt(reference, i));
+        referenceUpper = glm::max(referenceUpper, positionAt(reference, i));
+    }
+    glm::vec3 lower = referenceLower, upper = referenceUpper;
+    for (size_t i = 0; i < meshVertexCount; ++i)
+    {
+        lower = glm::min(lower, positionAt(mesh, i));
+        upper = glm::max(upper, positionAt(mesh, i));
+    }
+    TriangleGrid grid(reference, referenceVertexCount, lower, upper);
+
+    double sum = 0.0;
+    size_t samples = 0;
+    for (size_t i = 0; i < meshVertexCount; i += 3)
+    {
+        const glm::vec3 corners[3] = { positionAt(mesh, i), positionAt(mesh, i + 1), positionAt(mesh, i + 2) };
+        for (int k = 0; k < 4; ++k)
+        {
+            const glm::vec3 point = k < 3 ? corners[k] : (corners[0] + corners[1] + corners[2]) / 3.0f;
+            const float d = grid.distance(point);
+            sum += d;
+            distance.max = max(distance.max, d);
+            samples++;
+        }
+    }
+
+    const float radius = boundingRadius(reference, referenceVertexCount, (referenceLower + referenceUpper) * 0.5f);
+    distance.mean = (float)(sum / samples) / radius;
+    distance.max /= radius;
+    return distance;
+}
+
+
+int USelectLod(const float* errors, int count, float worldRadius, float pixelsPerUnit, float maxPixels)
+{
+    int lod = 0;
+    while (lod < count && errors[lod] * worldRadius * pixelsPerUnit <= maxPixels)
+        ++lod;
+    return lod;
+}
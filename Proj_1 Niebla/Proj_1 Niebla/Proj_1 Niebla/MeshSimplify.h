@@ -0,0 +1,98 @@
+///////////////////////////////////////////////////////////////////////////////
+// MeshSimplify.h
+// ==============
+// Quadric error simplification of the scene's meshes (unindexed triangles,
+// 8 floats per vertex) into chains of levels of detail, so hand-authored and
+// imported meshes get coarser versions the renderer draws when they cover
+// few pixels.
+//
+// Corners with equal position, normal and texture coordinate are welded
+// into wedges, and wedges with equal positions into vertices; seams (hard
+// edges, texture borders) are vertices with several wedges. Each wedge
+// accumulates the quadric of its triangles: the squared distance to their
+// planes plus, for normal and texture coordinate components, the squared
+// difference from the linear function each triangle interpolates them with
+// (Hoppe's memory-efficient attribute quadric). Vertices on open borders add
+// planes through their border edges, perpendicular to the surface, which
+// keep the outline in place.
+//
+// Edges are collapsed onto one of their vertices (half-edge collapses), so
+// every LOD reuses the base mesh's positions and attributes and no vertex is
+// placed anywhere new. A pass ranks the collapses of every edge by error and
+// applies the cheapest ones whose neighborhoods do not overlap, refusing
+// those that would make the surface non-manifold (link condition), flip a
+// triangle, or move a border vertex off its border. Wedges of the removed
+// vertex that share a triangle with the kept one merge into its wedge there,
+// the others move with the vertex, so seams stay closed.
+//
+// Errors are the square root of the largest collapse cost so far per unit
+// of area, relative to the radius of the mesh's bounding sphere (centered on
+// its box, like the scene's entity bounds): a LOD with error e is about
+// e * radius off its base mesh, which USelectLod turns into pixels.
+//
+// Usage:
+//   "Proj_1 Niebla" [--lod] [--lod-ratios 0.5,0.25,0.125] [--lod-pixels 1.0]
+//                   [--lod-report]  (measure each LOD against its base mesh)
+//   --lod cannot be combined with --soft-raster, which draws the base meshes.
+//
+//   std::vector<SimplifiedMesh> lods;
+//   USimplifyMesh(vertices, vertexCount, { 0.5f, 0.25f }, SimplifyOptions(), lods);
+//   int lod = USelectLod(errors, lodCount, radius, pixelsPerUnit, 1.0f);
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef MESH_SIMPLIFY_H
+#define MESH_SIMPLIFY_H
+
+#include <cstddef>
+#include <vector>
+
+struct LodOptions
+{
+    bool enabled = false;
+    std::vector<float> ratios = { 0.5f, 0.25f, 0.125f };   // of the base mesh's triangles, one LOD each
+    float maxPixels = 1.0f;     // largest error on screen a LOD may be drawn with
+    bool report = false;        // measure the distance of each LOD to its base mesh
+};
+
+struct SimplifyOptions
+{
+    float normalWeight = 0.25f;     // cost of a normal change, in radii per unit of change
+    float uvWeight = 0.5f;          // cost of a texture coordinate change
+    float borderWeight = 10.0f;     // how firmly open borders keep their outline
+};
+
+struct SimplifiedMesh
+{
+    std::vector<float> vertices;    // unindexed, 8 floats per vertex
+    float error = 0.0f;             // in radii of the input's bounding sphere
+
+    size_t getTriangleCount() const { return vertices.size() / 24; }
+};
+
+struct MeshDistance
+{
+    float mean = 0.0f;      // in radii of the reference's bounding sphere
+    float max = 0.0f;
+};
+
+bool UParseLodArgs(int argc, char* argv[], LodOptions& options);
+
+// Simplifies towards each ratio of the input's triangles in turn, each LOD
+// continuing from the one before, so a chain costs about as much as its
+// coarsest LOD. Ratios are sorted; a LOD may keep more triangles than its
+// ratio asks for when no collapse is left that keeps the surface valid.
+void USimplifyMesh(const float* vertices, size_t vertexCount, const std::vector<float>& ratios,
+    const SimplifyOptions& options, std::vector<SimplifiedMesh>& lods);
+
+// Distance from the corners and triangle centers of mesh to the surface of
+// reference; one-sided, so the larger max of both directions approximates
+// the Hausdorff distance
+MeshDistance UMeasureMeshDistance(const float* mesh, size_t meshVertexCount,
+    const float* reference, size_t referenceVertexCount);
+
+// LOD to draw, 0 for the base mesh and l + 1 for errors[l]: the coarsest one
+// whose error, on an object of worldRadius seen at pixelsPerUnit, spans at
+// most maxPixels. errors must not decrease.
+int USelectLod(const float* errors, int count, float worldRadius, float pixelsPerUnit, float maxPixels);
+
+#endif
@@ -0,0 +1,132 @@
+#include "MicroBench.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+using namespace std;
+
+volatile unsigned char MicroBench::sink = 0;
+
+
+bool UParseMicroBenchArgs(int argc, char* argv[], MicroBenchOptions& options)
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        const char* arg = argv[i];
+        if (strcmp(arg, "--microbench") == 0)
+        {
+            options.enabled = true;
+            continue;
+        }
+
+        if (strncmp(arg, "--mb-", 5) != 0)
+            continue;
+        if (i + 1 >= argc)
+        {
+            cout << "Missing value for " << arg << endl;
+            return false;
+        }
+
+        const char* value = argv[++i];
+        char* end = nullptr;
+        if (strcmp(arg, "--mb-samples") == 0)
+            options.samples = (int)strtol(value, &end, 10);
+        else if (strcmp(arg, "--mb-warmup") == 0)
+            options.warmup = (int)strtol(value, &end, 10);
+        else if (strcmp(arg, "--mb-min-sample-ms") == 0)
+            options.minSampleMs = strtod(value, &end);
+        else if (strcmp(arg, "--mb-seed") == 0)
+            options.seed = (unsigned int)strtoul(value, &end, 10);
+        else if (strcmp(arg, "--mb-filter") == 0)
+            options.filter = value;
+        else if (strcmp(arg, "--mb-out") == 0)
+            options.outputPath = value;
+        else if (strcmp(arg, "--mb-obj-mb") == 0)
+            options.objMb = (int)strtol(value, &end, 10);
+        else if (strcmp(arg, "--mb-import") == 0)
+            options.importPath = value;
+        else
+        {
+            cout << "Unknown option " << arg << endl;
+            return false;
+        }
+
+        if (end && (*end != '\0' || end == value))
+        {
+            cout << "Invalid value for " << arg << endl;
+            return false;
+        }
+    }
+
+    if (options.samples < 1 || options.warmup < 0 || options.minSampleMs <= 0.0 || options.objMb < 1)
+    {
+        cout << "Invalid microbenchmark sampling options" << endl;
+        return false;
+    }
+
+    return true;
+}
+
+
+void MicroBench::addResult(const char* name, long long iterations, vector<double>& sampleNs, double bytesPerOp)
+{
+    sort(sampleNs.begin(), sampleNs.end());
+
+    MicroBenchResult result;
+    result.name = name;
+    result.iterations = iterations;
+    result.samples = (int)sampleNs.size();
+    result.bytesPerOp = bytesPerOp;
+    result.minNs = sampleNs.front();
+
+    const size_t count = sampleNs.size();
+    result.medianNs = count % 2 ? sampleNs[count / 2] : 0.5 * (sampleNs[count / 2 - 1] + sampleNs[count / 2]);
+    result.p95Ns = sampleNs[min(count - 1, (size_t)ceil(0.95 * count) - 1)];
+
+    double sum = 0.0;
+    for (double ns : sampleNs)
+        sum += ns;
+    result.meanNs = sum / count;
+
+    double variance = 0.0;
+    for (double ns : sampleNs)
+        variance += (ns - result.meanNs) * (ns - result.meanNs);
+    result.stddevNs = count > 1 ? sqrt(variance / (count - 1)) : 0.0;
+
+    results.push_back(result);
+
+    // Progress on stderr so stdout stays valid JSON
+    cerr << name << ": " << result.medianNs << " ns/op (median of " << count << ")" << endl;
+}
+
+
+void MicroBench::writeReport(ostream& out) const
+{
+    out << "{\n"
+        << "  \"seed\": " << options.seed << ",\n"
+        << "  \"samples\": " << options.samples << ",\n"
+        << "  \"warmup\": " << options.warmup << ",\n"
+        << "  \"kernels\": [";
+
+    for (size_t i = 0; i < results.size(); ++i)
+    {
+        const MicroBenchResult& r = results[i];
+        out << (i ? "," : "") << "\n    { \"name\": \"" << r.name << "\""
+            << ", \"iterations\": " << r.iterations
+            << ", \"samples\": " << r.samples
+            << ", \"ns_per_op\": { \"min\": " << r.minNs
+            << ", \"median\": " << r.medianNs
+            << ", \"mean\": " << r.meanNs
+            << ", \"stddev\": " << r.stddevNs
+            << ", \"p95\": " << r.p95Ns << " }"
+            << ", \"ops_per_sec\": " << (r.medianNs > 0.0 ? 1.0e9 / r.medianNs : 0.0);
+        if (r.bytesPerOp > 0.0)
+            out << ", \"mb_per_sec\": " << (r.medianNs > 0.0 ? r.bytesPerOp / r.medianNs * 1.0e3 : 0.0);
+        out << " }";
+    }
+
+    out << "\n  ]\n}" << endl;
+}
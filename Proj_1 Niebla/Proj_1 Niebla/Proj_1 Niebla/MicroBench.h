@@ -0,0 +1,122 @@
+///////////////////////////////////////////////////////////////////////////////
+// MicroBench.h
+// ============
+// Small harness for timing CPU-side kernels in isolation (no GL context).
+// Each kernel is warmed up, its iteration count is calibrated so a sample
+// lasts at least minSampleMs, and then a fixed number of samples is taken.
+// Results are reported per operation as JSON.
+//
+// Usage:
+//   "Proj_1 Niebla" --microbench [--mb-samples 30] [--mb-warmup 5]
+//                   [--mb-min-sample-ms 10] [--mb-seed 1234]
+//                   [--mb-filter name] [--mb-out results.json]
+//                   [--mb-obj-mb 16] [--mb-import model.obj]
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef MICRO_BENCH_H
+#define MICRO_BENCH_H
+
+#include <chrono>
+#include <ostream>
+#include <string>
+#include <vector>
+
+struct MicroBenchOptions
+{
+    bool enabled = false;
+    int samples = 30;           // timed samples per kernel
+    int warmup = 5;             // untimed samples before measuring
+    double minSampleMs = 10.0;  // calibrate iterations until one sample takes this long
+    unsigned int seed = 1234;   // seed for every kernel's input data
+    std::string filter;         // only run kernels whose name contains this
+    std::string outputPath;     // JSON report file, stdout when empty
+    int objMb = 16;             // size of the generated OBJ file the importer is timed on
+    std::string importPath;     // mesh file to time the importer on as well
+};
+
+// Per-operation statistics of one kernel, in nanoseconds
+struct MicroBenchResult
+{
+    std::string name;
+    long long iterations = 0;   // operations per sample
+    int samples = 0;
+    double minNs = 0.0;
+    double medianNs = 0.0;
+    double meanNs = 0.0;
+    double stddevNs = 0.0;
+    double p95Ns = 0.0;
+    double bytesPerOp = 0.0;    // input bytes touched per operation, 0 if not meaningful
+};
+
+bool UParseMicroBenchArgs(int argc, char* argv[], MicroBenchOptions& options);
+
+class MicroBench
+{
+public:
+    explicit MicroBench(const MicroBenchOptions& options) : options(options) {}
+
+    // Times kernel(); bytesPerOp is used to report bandwidth
+    template <typename Kernel>
+    void run(const char* name, Kernel kernel, double bytesPerOp = 0.0);
+
+    void writeReport(std::ostream& out) const;
+    const std::vector<MicroBenchResult>& getResults() const { return results; }
+
+    // Keeps the optimizer from discarding a kernel's result
+    template <typename T>
+    static void keep(const T& value)
+    {
+        sink ^= (unsigned char)*reinterpret_cast<const volatile unsigned char*>(&value);
+    }
+
+private:
+    void addResult(const char* name, long long iterations, std::vector<double>& sampleNs, double bytesPerOp);
+
+    MicroBenchOptions options;
+    std::vector<MicroBenchResult> results;
+    static volatile unsigned char sink;
+};
+
+
+template <typename Kernel>
+void MicroBench::run(const char* name, Kernel kernel, double bytesPerOp)
+{
+    typedef std::chrono::steady_clock Clock;
+
+    if (!options.filter.empty() && std::string(name).find(options.filter) == std::string::npos)
+        return;
+
+    // Calibrate: double the batch size until one batch takes minSampleMs
+    long long iterations = 1;
+    for (;;)
+    {
+        Clock::time_point start = Clock::now();
+        for (long long i = 0; i < iterations; ++i)
+            kernel();
+        double ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+        if (ms >= options.minSampleMs || iterations >= (1LL << 40))
+            break;
+        iterations *= 2;
+    }
+
+    for (int w = 0; w < options.warmup; ++w)
+    {
+        for (long long i = 0; i < iterations; ++i)
+            kernel();
+    }
+
+    std::vector<double> sampleNs;
+    sampleNs.reserve(options.samples);
+    for (int s = 0; s < options.samples; ++s)
+    {
+        Clock::time_point start = Clock::now();
+        for (long long i = 0; i < iterations; ++i)
+            kernel();
+        double ns = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+        sampleNs.push_back(ns / iterations);
+    }
+
+    addResult(name, iterations, sampleNs, bytesPerOp);
+}
+
+#endif
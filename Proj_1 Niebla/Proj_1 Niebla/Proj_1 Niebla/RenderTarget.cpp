@@ -0,0 +1,66 @@
+#include "RenderTarget.h"
+
+#include <iostream>
+
+#include "GLState.h"
+#include "GpuStorage.h"
+
+using namespace std;
+
+
+bool UCreateRenderTarget(RenderTarget& target, int width, int height)
+{
+    target.width = width;
+    target.height = height;
+
+    // Color attachment
+    // Immutable storage; a resize creates a new target
+    target.colorTexture = UCreateImmutableTexture(GL_RGBA8, width, height, 1, GL_LINEAR, GL_LINEAR, GL_CLAMP_TO_EDGE);
+
+    // Depth attachment is a texture (not a renderbuffer) so later passes can sample it
+    target.depthTexture = UCreateImmutableTexture(GL_DEPTH_COMPONENT32F, width, height, 1, GL_NEAREST, GL_NEAREST,
+        GL_CLAMP_TO_EDGE);
+
+    glGenFramebuffers(1, &target.fbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, target.fbo);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, target.colorTexture, 0);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, target.depthTexture, 0);
+
+    GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    if (status != GL_FRAMEBUFFER_COMPLETE)
+    {
+        cout << "ERROR::FRAMEBUFFER::INCOMPLETE (0x" << hex << status << dec << ")" << endl;
+        UDestroyRenderTarget(target);
+        return false;
+    }
+
+    return true;
+}
+
+
+void UDestroyRenderTarget(RenderTarget& target)
+{
+    glDeleteFramebuffers(1, &target.fbo);
+    UGLState().deleteTextures(1, &target.colorTexture);
+    UGLState().deleteTextures(1, &target.depthTexture);
+    target = RenderTarget();
+}
+
+
+void UBindRenderTarget(const RenderTarget& target)
+{
+    glBindFramebuffer(GL_FRAMEBUFFER, target.fbo);
+    glViewport(0, 0, target.width, target.height);
+}
+
+
+void UReadRenderTarget(const RenderTarget& target, unsigned char* pixels)
+{
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, target.fbo);
+    glReadBuffer(GL_COLOR_ATTACHMENT0);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(0, 0, target.width, target.height, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+}
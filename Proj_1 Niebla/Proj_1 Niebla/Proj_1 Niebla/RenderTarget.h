@@ -0,0 +1,33 @@
+///////////////////////////////////////////////////////////////////////////////
+// RenderTarget.h
+// ==============
+// Offscreen framebuffer (color + depth textures) that the scene can be
+// rendered into instead of the window's default framebuffer.
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef RENDER_TARGET_H
+#define RENDER_TARGET_H
+
+#include <GL/glew.h>
+
+// Stores the GL data relative to an offscreen framebuffer
+struct RenderTarget
+{
+    GLuint fbo = 0;             // Handle for the framebuffer object
+    GLuint colorTexture = 0;    // RGBA8 color attachment
+    GLuint depthTexture = 0;    // 32-bit float depth attachment (sampleable)
+    int width = 0;
+    int height = 0;
+};
+
+// Creates the framebuffer and its attachments, returns false if incomplete
+bool UCreateRenderTarget(RenderTarget& target, int width, int height);
+void UDestroyRenderTarget(RenderTarget& target);
+
+// Binds the target for drawing and sets the viewport to cover it
+void UBindRenderTarget(const RenderTarget& target);
+
+// Reads the color attachment back as tightly packed RGBA8, bottom row first
+void UReadRenderTarget(const RenderTarget& target, unsigned char* pixels);
+
+#endif
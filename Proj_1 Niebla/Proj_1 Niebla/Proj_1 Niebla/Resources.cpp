@@ -0,0 +1,349 @@
+#include "Resources.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <utility>
+
+#include "GLState.h"
+#include "GpuStorage.h"
+
+using namespace std;
+
+namespace
+{
+    const uint64_t FNV_OFFSET = 14695981039346656037ull;
+    const uint64_t FNV_PRIME = 1099511628211ull;
+
+    uint64_t hashBytes(const void* data, size_t size, uint64_t hash = FNV_OFFSET)
+    {
+        const unsigned char* bytes = static_cast<const unsigned char*>(data);
+        for (size_t i = 0; i < size; ++i)
+        {
+            hash ^= bytes[i];
+            hash *= FNV_PRIME;
+        }
+        return hash;
+    }
+
+
+    bool sameBufferData(GLuint buffer, const void* data, size_t size)
+    {
+        vector<unsigned char> stored(size);
+        UGLState().bindBuffer(GL_COPY_READ_BUFFER, buffer);
+        glGetBufferSubData(GL_COPY_READ_BUFFER, 0, (GLsizeiptr)size, stored.data());
+        UGLState().bindBuffer(GL_COPY_READ_BUFFER, 0);
+        return size == 0 || memcmp(stored.data(), data, size) == 0;
+    }
+
+
+    bool sameTextureData(GLuint texture, const unsigned char* pixels, size_t size, int channels)
+    {
+        vector<unsigned char> stored(size);
+        GLStateCache& gl = UGLState();
+        gl.bindTexture(0, texture);
+        glPixelStorei(GL_PACK_ALIGNMENT, 1);
+        glGetTexImage(GL_TEXTURE_2D, 0, channels == 3 ? GL_RGB : GL_RGBA, GL_UNSIGNED_BYTE, stored.data());
+        gl.bindTexture(0, 0);
+        return size == 0 || memcmp(stored.data(), pixels, size) == 0;
+    }
+}
+
+
+bool UParseResourceArgs(int argc, char* argv[], ResourceOptions& options)
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        const char* arg = argv[i];
+        if (strcmp(arg, "--vram-budget") == 0)
+        {
+            char* end = nullptr;
+            long long value = -1;
+            if (i + 1 < argc)
+                value = strtoll(argv[++i], &end, 10);
+            if (!end || *end != '\0' || value < 0)
+            {
+                cout << "Invalid value for " << arg << endl;
+                return false;
+            }
+            options.budgetMb = (size_t)value;
+        }
+    }
+
+    return true;
+}
+
+
+size_t UTextureBytes(int width, int height, int channels, bool mipmapped)
+{
+    const size_t texelBytes = channels == 3 ? 4 : (size_t)channels;
+    size_t total = 0;
+    for (;;)
+    {
+        total += (size_t)width * height * texelBytes;
+        if (!mipmapped || (width == 1 && height == 1))
+            return total;
+        width = max(width / 2, 1);
+        height = max(height / 2, 1);
+    }
+}
+
+
+uint64_t UMeshContentHash(const GLfloat* vertices, size_t bytes)
+{
+    const uint64_t size = bytes;
+    return hashBytes(vertices, bytes, hashBytes(&size, sizeof(size)));
+}
+
+
+ResourceHandle::ResourceHandle(ResourceRegistry* registry, ResourceKind kind, uint32_t slot)
+    : registry(registry), kind(kind), slot(slot)
+{
+    registry->addRef(kind, slot);
+}
+
+
+ResourceHandle::ResourceHandle(const ResourceHandle& other)
+    : registry(other.registry), kind(other.kind), slot(other.slot)
+{
+    if (registry)
+        registry->addRef(kind, slot);
+}
+
+
+ResourceHandle::ResourceHandle(ResourceHandle&& other)
+    : registry(other.registry), kind(other.kind), slot(other.slot)
+{
+    other.registry = nullptr;
+}
+
+
+ResourceHandle& ResourceHandle::operator=(ResourceHandle other)
+{
+    // other takes the old reference along when it goes out of scope
+    swap(registry, other.registry);
+    swap(kind, other.kind);
+    swap(slot, other.slot);
+    return *this;
+}
+
+
+ResourceHandle::~ResourceHandle()
+{
+    reset();
+}
+
+
+void ResourceHandle::reset()
+{
+    if (!registry)
+        return;
+    ResourceRegistry* owner = registry;
+    registry = nullptr;
+    owner->release(kind, slot);
+}
+
+
+size_t ResourceHandle::getBytes() const
+{
+    return registry ? registry->get(kind, slot).bytes : 0;
+}
+
+
+int ResourceHandle::getRefCount() const
+{
+    return registry ? registry->get(kind, slot).refs : 0;
+}
+
+
+GLuint TextureHandle::getId() const
+{
+    return registry ? registry->get(kind, slot).id : 0;
+}
+
+
+GLuint MeshHandle::getVao() const
+{
+    return registry ? registry->get(kind, slot).vao : 0;
+}
+
+
+GLuint MeshHandle::getVbo() const
+{
+    return registry ? registry->get(kind, slot).id : 0;
+}
+
+
+GLuint MeshHandle::getVertexCount() const
+{
+    return registry ? registry->get(kind, slot).vertexCount : 0;
+}
+
+
+TextureHandle ResourceRegistry::findTexture(const string& path)
+{
+    auto found = texturePaths.find(path);
+    if (found == texturePaths.end())
+        return TextureHandle();
+
+    dedupHits++;
+    return TextureHandle(this, found->second);
+}
+
+
+TextureHandle ResourceRegistry::createTexture(const string& path, const unsigned char* pixels, int width, int height,
+    int channels)
+{
+    if (channels != 3 && channels != 4)
+    {
+        cout << "Not implemented to handle image with " << channels << " channels" << endl;
+        return TextureHandle();
+    }
+
+    const size_t size = (size_t)width * height * channels;
+    const int shape[3] = { width, height, channels };
+    const uint64_t hash = hashBytes(pixels, size, hashBytes(shape, sizeof(shape)));
+
+    // Same image under another path
+    auto found = hashes[RESOURCE_TEXTURE].find(hash);
+    if (found != hashes[RESOURCE_TEXTURE].end())
+    {
+        Entry& existing = entries[RESOURCE_TEXTURE][found->second];
+        if (existing.width == width && existing.height == height && existing.channels == channels
+            && sameTextureData(existing.id, pixels, size, channels))
+        {
+            existing.paths.push_back(path);
+            texturePaths[path] = found->second;
+            dedupHits++;
+            return TextureHandle(this, found->second);
+        }
+    }
+
+    const int levels = UMipLevelCount(width, height);
+    const GLuint id = UCreateImmutableTexture(channels == 3 ? GL_RGB8 : GL_RGBA8, width, height, levels,
+        GL_LINEAR, GL_LINEAR, GL_REPEAT);
+    UUploadTexture(id, width, height, channels == 3 ? GL_RGB : GL_RGBA, GL_UNSIGNED_BYTE, pixels, true);
+
+    const uint32_t slot = allocateSlot(RESOURCE_TEXTURE);
+    Entry& entry = entries[RESOURCE_TEXTURE][slot];
+    entry.id = id;
+    entry.bytes = UTextureBytes(width, height, channels, true);
+    entry.dataBytes = size;
+    entry.width = width;
+    entry.height = height;
+    entry.channels = channels;
+    entry.hash = hash;
+    entry.paths.push_back(path);
+    texturePaths[path] = slot;
+    remember(RESOURCE_TEXTURE, hash, slot);
+    track(RESOURCE_TEXTURE, entry.bytes);
+
+    return TextureHandle(this, slot);
+}
+
+
+MeshHandle ResourceRegistry::createMesh(const GLfloat* vertices, size_t bytes)
+{
+    return createMesh(vertices, bytes, UMeshContentHash(vertices, bytes));
+}
+
+
+MeshHandle ResourceRegistry::createMesh(const GLfloat* vertices, size_t bytes, uint64_t hash)
+{
+    auto found = hashes[RESOURCE_MESH].find(hash);
+    if (found != hashes[RESOURCE_MESH].end())
+    {
+        const Entry& existing = entries[RESOURCE_MESH][found->second];
+        if (existing.dataBytes == bytes && sameBufferData(existing.id, vertices, bytes))
+        {
+            dedupHits++;
+            return MeshHandle(this, found->second);
+        }
+    }
+
+    // The scene never rewrites vertex data, so the buffer takes no flags
+    const GLuint vbo = UCreateImmutableBuffer((GLsizeiptr)bytes, vertices, 0);
+    const GLuint vao = UCreateMeshVertexArray(vbo);
+
+    const uint32_t slot = allocateSlot(RESOURCE_MESH);
+    Entry& entry = entries[RESOURCE_MESH][slot];
+    entry.id = vbo;
+    entry.vao = vao;
+    entry.vertexCount = (GLuint)(bytes / (sizeof(GLfloat) * FLOATS_PER_VERTEX));
+    entry.bytes = bytes;
+    entry.dataBytes = bytes;
+    entry.hash = hash;
+    remember(RESOURCE_MESH, hash, slot);
+    track(RESOURCE_MESH, entry.bytes);
+
+    return MeshHandle(this, slot);
+}
+
+
+uint32_t ResourceRegistry::allocateSlot(ResourceKind kind)
+{
+    if (!freeSlots[kind].empty())
+    {
+        const uint32_t slot = freeSlots[kind].back();
+        freeSlots[kind].pop_back();
+        return slot;
+    }
+
+    entries[kind].emplace_back();
+    return (uint32_t)entries[kind].size() - 1;
+}
+
+
+void ResourceRegistry::remember(ResourceKind kind, uint64_t hash, uint32_t slot)
+{
+    // On a collision the first resource keeps the hash; the other is simply not shared
+    hashes[kind].insert(make_pair(hash, slot));
+}
+
+
+void ResourceRegistry::track(ResourceKind kind, size_t bytes)
+{
+    const size_t before = getTotalBytes();
+    liveCount[kind]++;
+    liveBytes[kind] += bytes;
+    peakBytes = max(peakBytes, getTotalBytes());
+
+    if (budget && before <= budget && getTotalBytes() > budget)
+        cout << "Estimated video memory " << getTotalBytes() / (1024 * 1024) << " MB exceeds the budget of "
+            << budget / (1024 * 1024) << " MB" << endl;
+}
+
+
+void ResourceRegistry::addRef(ResourceKind kind, uint32_t slot)
+{
+    entries[kind][slot].refs++;
+}
+
+
+void ResourceRegistry::release(ResourceKind kind, uint32_t slot)
+{
+    Entry& entry = entries[kind][slot];
+    if (--entry.refs > 0)
+        return;
+
+    if (kind == RESOURCE_TEXTURE)
+    {
+        UGLState().deleteTextures(1, &entry.id);
+        for (const string& path : entry.paths)
+            texturePaths.erase(path);
+    }
+    else
+    {
+        UGLState().deleteVertexArrays(1, &entry.vao);
+        UGLState().deleteBuffers(1, &entry.id);
+    }
+    auto hashed = hashes[kind].find(entry.hash);
+    if (hashed != hashes[kind].end() && hashed->second == slot)
+        hashes[kind].erase(hashed);
+
+    liveCount[kind]--;
+    liveBytes[kind] -= entry.bytes;
+    entry = Entry();
+    freeSlots[kind].push_back(slot);
+}
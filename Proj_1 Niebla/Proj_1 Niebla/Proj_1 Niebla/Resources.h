@@ -0,0 +1,196 @@
+///////////////////////////////////////////////////////////////////////////////
+// Resources.h
+// ===========
+// Registry of the GPU resources the scene loads: textures and meshes (a VBO
+// of interleaved position, normal and texture coordinate plus its VAO).
+//
+// Resources are handed out as reference-counted handles. Copying a handle
+// adds a reference, destroying or reset()ing it drops one, and the GL
+// objects are deleted with the last reference. Loading the same thing twice
+// returns the existing resource:
+//   - textures by path, then by a hash of the decoded pixels (the same
+//     image under another name)
+//   - meshes by a hash of the vertex data
+// Content hashes are 64-bit FNV-1a over the data and its size. CPU copies
+// are not kept, so a hash hit reads the existing resource back and compares
+// it byte for byte; a collision then only costs the sharing.
+//
+// Every resource carries an estimate of the video memory it takes (textures
+// with their full mip chain), and the registry keeps totals and the peak so
+// the HUD and the bench report can show the footprint. --vram-budget prints
+// a warning whenever a new resource takes the total past the budget.
+//
+// GL objects can only be deleted while the context is current, so handles in
+// globals must be reset before the context goes away. The registry and its
+// handles belong to the GL thread.
+//
+// Usage:
+//   "Proj_1 Niebla" [--vram-budget 256]    (MB, 0: no budget)
+//
+//   TextureHandle texture = gResources.findTexture(path);
+//   if (!texture.isValid())
+//       texture = gResources.createTexture(path, pixels, width, height, channels);
+//   glBindTexture(GL_TEXTURE_2D, texture.getId());
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef RESOURCES_H
+#define RESOURCES_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <GL/glew.h>
+
+struct ResourceOptions
+{
+    size_t budgetMb = 0;        // warn above this many MB of estimated video memory, 0: no budget
+};
+
+bool UParseResourceArgs(int argc, char* argv[], ResourceOptions& options);
+
+class ResourceRegistry;
+
+enum ResourceKind
+{
+    RESOURCE_TEXTURE,
+    RESOURCE_MESH,
+    RESOURCE_KIND_COUNT
+};
+
+// One reference to a registry resource; empty when default constructed
+class ResourceHandle
+{
+public:
+    ResourceHandle() {}
+    ResourceHandle(const ResourceHandle& other);
+    ResourceHandle(ResourceHandle&& other);
+    ResourceHandle& operator=(ResourceHandle other);
+    ~ResourceHandle();
+
+    // Drops the reference, deleting the resource if it was the last one
+    void reset();
+
+    bool isValid() const { return registry != nullptr; }
+    size_t getBytes() const;        // estimated video memory
+    int getRefCount() const;
+
+protected:
+    ResourceHandle(ResourceRegistry* registry, ResourceKind kind, uint32_t slot);
+
+    ResourceRegistry* registry = nullptr;
+    ResourceKind kind = RESOURCE_TEXTURE;
+    uint32_t slot = 0;
+};
+
+class TextureHandle : public ResourceHandle
+{
+public:
+    TextureHandle() {}
+
+    GLuint getId() const;           // 0 when empty
+
+private:
+    friend class ResourceRegistry;
+    TextureHandle(ResourceRegistry* registry, uint32_t slot) : ResourceHandle(registry, RESOURCE_TEXTURE, slot) {}
+};
+
+class MeshHandle : public ResourceHandle
+{
+public:
+    MeshHandle() {}
+
+    // 0 when empty
+    GLuint getVao() const;
+    GLuint getVbo() const;
+    GLuint getVertexCount() const;
+
+private:
+    friend class ResourceRegistry;
+    MeshHandle(ResourceRegistry* registry, uint32_t slot) : ResourceHandle(registry, RESOURCE_MESH, slot) {}
+};
+
+class ResourceRegistry
+{
+public:
+    static const int FLOATS_PER_VERTEX = 8;    // position, normal, texture coordinate
+
+    ResourceRegistry() {}
+    ResourceRegistry(const ResourceRegistry&) = delete;
+    ResourceRegistry& operator=(const ResourceRegistry&) = delete;
+
+    void setBudget(size_t bytes) { budget = bytes; }
+    size_t getBudget() const { return budget; }
+
+    // Texture already loaded from path, empty if none
+    TextureHandle findTexture(const std::string& path);
+
+    // Uploads decoded 3 or 4 channel pixels (rows bottom first) as a repeating,
+    // mipmapped texture known under path. Returns the existing texture if one
+    // has the same pixels, an empty handle for other channel counts.
+    TextureHandle createTexture(const std::string& path, const unsigned char* pixels, int width, int height,
+        int channels);
+
+    // Uploads interleaved vertices (FLOATS_PER_VERTEX floats each) into a VBO
+    // with a VAO in the shared mesh vertex format (see GpuStorage.h), or
+    // returns the mesh with the same data
+    MeshHandle createMesh(const GLfloat* vertices, size_t bytes);
+    // Same with the UMeshContentHash of the vertices already known (mesh files
+    // store it); a wrong hash only misses the sharing
+    MeshHandle createMesh(const GLfloat* vertices, size_t bytes, uint64_t hash);
+
+    int getCount(ResourceKind kind) const { return liveCount[kind]; }
+    size_t getBytes(ResourceKind kind) const { return liveBytes[kind]; }
+    size_t getTotalBytes() const { return liveBytes[RESOURCE_TEXTURE] + liveBytes[RESOURCE_MESH]; }
+    size_t getPeakBytes() const { return peakBytes; }
+    unsigned long long getDedupHits() const { return dedupHits; }    // loads answered by an existing resource
+
+private:
+    friend class ResourceHandle;
+    friend class TextureHandle;
+    friend class MeshHandle;
+
+    struct Entry
+    {
+        int refs = 0;
+        GLuint id = 0;              // texture or VBO
+        GLuint vao = 0;
+        GLuint vertexCount = 0;
+        size_t bytes = 0;
+        size_t dataBytes = 0;       // pixels or vertices as created
+        int width = 0;              // textures
+        int height = 0;
+        int channels = 0;
+        uint64_t hash = 0;
+        std::vector<std::string> paths;     // textures: every path that resolved to it
+    };
+
+    uint32_t allocateSlot(ResourceKind kind);
+    void remember(ResourceKind kind, uint64_t hash, uint32_t slot);
+    void track(ResourceKind kind, size_t bytes);
+    void addRef(ResourceKind kind, uint32_t slot);
+    void release(ResourceKind kind, uint32_t slot);
+    const Entry& get(ResourceKind kind, uint32_t slot) const { return entries[kind][slot]; }
+
+    std::vector<Entry> entries[RESOURCE_KIND_COUNT];
+    std::vector<uint32_t> freeSlots[RESOURCE_KIND_COUNT];
+    std::unordered_map<std::string, uint32_t> texturePaths;
+    std::unordered_map<uint64_t, uint32_t> hashes[RESOURCE_KIND_COUNT];
+
+    int liveCount[RESOURCE_KIND_COUNT] = {};
+    size_t liveBytes[RESOURCE_KIND_COUNT] = {};
+    size_t peakBytes = 0;
+    size_t budget = 0;
+    unsigned long long dedupHits = 0;
+};
+
+// Estimated video memory of a texture of the given size and channel count
+// with its full mip chain; drivers store RGB8 as RGBA8, so both count 4 bytes
+size_t UTextureBytes(int width, int height, int channels, bool mipmapped);
+
+// Hash meshes are deduplicated by; the same on every platform, so it can be stored
+uint64_t UMeshContentHash(const GLfloat* vertices, size_t bytes);
+
+#endif
@@ -0,0 +1,158 @@
+#include "SceneGen.h"
+
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <random>
+
+#include <glm/gtc/quaternion.hpp>
+
+using namespace std;
+
+namespace
+{
+    // Per-mesh placement matching the props in URender: height above the base,
+    // uniform scale and the fixed rotation that stands the mesh upright
+    struct MeshPlacement
+    {
+        float height;
+        float scale;
+        float angle;            // degrees
+        glm::vec3 axis;
+    };
+
+    const MeshPlacement MESH_PLACEMENTS[SCENE_MESH_COUNT] = {
+        { 0.0f, 2.0f, 0.0f, glm::vec3(1.0f, 0.0f, 0.0f) },      // book (gScale)
+        { 0.1f, 0.25f, 0.0f, glm::vec3(1.0f, 0.0f, 0.0f) },     // ball (ballscale)
+        { 0.1f, 1.0f, 90.0f, glm::vec3(1.0f, 0.0f, 0.0f) },     // candle
+        { 1.3f, 1.0f, 90.0f, glm::vec3(1.0f, 0.0f, 0.0f) },     // topper
+        { -0.2f, 0.85f, 90.0f, glm::vec3(1.0f, 0.05f, 0.6f) },  // cable
+    };
+}
+
+
+bool UParseSceneGenArgs(int argc, char* argv[], SceneGenOptions& options)
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        const char* arg = argv[i];
+        const bool known = strcmp(arg, "--instances") == 0 || strcmp(arg, "--layout") == 0
+            || strcmp(arg, "--seed") == 0 || strcmp(arg, "--spacing") == 0;
+        if (!known)
+            continue;
+        if (i + 1 >= argc)
+        {
+            cout << "Missing value for " << arg << endl;
+            return false;
+        }
+
+        const char* value = argv[++i];
+        char* end = nullptr;
+        if (strcmp(arg, "--instances") == 0)
+        {
+            long count = strtol(value, &end, 10);
+            if (end == value || *end != '\0' || count < 0 || count > MAX_SCENE_INSTANCES)
+            {
+                cout << "--instances must be between 0 and " << MAX_SCENE_INSTANCES << endl;
+                return false;
+            }
+            options.instances = (int)count;
+        }
+        else if (strcmp(arg, "--layout") == 0)
+        {
+            if (strcmp(value, "grid") == 0)
+                options.layout = SCENE_LAYOUT_GRID;
+            else if (strcmp(value, "random") == 0)
+                options.layout = SCENE_LAYOUT_RANDOM;
+            else
+            {
+                cout << "--layout must be grid or random" << endl;
+                return false;
+            }
+        }
+        else if (strcmp(arg, "--seed") == 0)
+        {
+            options.seed = (unsigned int)strtoul(value, &end, 10);
+            if (end == value || *end != '\0')
+            {
+                cout << "Invalid value for " << arg << endl;
+                return false;
+            }
+        }
+        else
+        {
+            options.spacing = strtof(value, &end);
+            if (end == value || *end != '\0' || options.spacing <= 0.0f)
+            {
+                cout << "Invalid value for " << arg << endl;
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+
+void UGenerateScene(const SceneGenOptions& options, vector<SceneInstance>& instances)
+{
+    instances.clear();
+    if (options.instances <= 0)
+        return;
+
+    mt19937 random(options.seed);
+    uniform_int_distribution<int> meshDistribution(0, SCENE_MESH_COUNT - 1);
+    uniform_real_distribution<float> yawDistribution(0.0f, 2.0f * 3.14159265f);
+    uniform_real_distribution<float> scaleDistribution(0.7f, 1.3f);
+
+    // Square footprint that holds every instance at the requested spacing
+    const int side = (int)ceil(sqrt((double)options.instances));
+    const float extent = side * options.spacing;
+    uniform_real_distribution<float> positionDistribution(-0.5f * extent, 0.5f * extent);
+
+    // Bucket by mesh while generating so the result is sorted without a comparison sort
+    vector<SceneInstance> buckets[SCENE_MESH_COUNT];
+    for (int i = 0; i < options.instances; ++i)
+    {
+        SceneInstance instance;
+        instance.mesh = meshDistribution(random);
+        instance.yaw = yawDistribution(random);
+        instance.scale = scaleDistribution(random);
+
+        if (options.layout == SCENE_LAYOUT_GRID)
+        {
+            const int column = i % side;
+            const int row = i / side;
+            instance.position = glm::vec3((column + 0.5f) * options.spacing - 0.5f * extent, 0.0f,
+                (row + 0.5f) * options.spacing - 0.5f * extent);
+        }
+        else
+        {
+            const float x = positionDistribution(random);
+            const float z = positionDistribution(random);
+            instance.position = glm::vec3(x, 0.0f, z);
+        }
+        instance.position.y = MESH_PLACEMENTS[instance.mesh].height;
+
+        buckets[instance.mesh].push_back(instance);
+    }
+
+    instances.reserve(options.instances);
+    for (int mesh = 0; mesh < SCENE_MESH_COUNT; ++mesh)
+        instances.insert(instances.end(), buckets[mesh].begin(), buckets[mesh].end());
+}
+
+
+EntityTransform UInstanceTransform(const SceneInstance& instance)
+{
+    const MeshPlacement& placement = MESH_PLACEMENTS[instance.mesh];
+
+    EntityTransform transform;
+    transform.position = instance.position;
+    transform.scale = glm::vec3(placement.scale * instance.scale);
+    transform.rotation = glm::angleAxis(instance.yaw, glm::vec3(0.0f, 1.0f, 0.0f));
+    if (placement.angle != 0.0f)
+        transform.rotation = transform.rotation * glm::angleAxis(glm::radians(placement.angle), glm::normalize(placement.axis));
+    return transform;
+}
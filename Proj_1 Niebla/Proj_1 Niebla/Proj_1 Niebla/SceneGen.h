@@ -0,0 +1,67 @@
+///////////////////////////////////////////////////////////////////////////////
+// SceneGen.h
+// ==========
+// Procedural stress scenes: places N instances of the existing prop meshes
+// (book, ball, candle, topper, cable) on a grid or a random distribution
+// with varied rotation and scale, so frame time can be charted against
+// object count. Works in the interactive app and in --bench runs.
+//
+// Usage:
+//   "Proj_1 Niebla" [--bench] --instances 100000 [--layout grid|random]
+//                   [--seed 1234] [--spacing 3.0]
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef SCENE_GEN_H
+#define SCENE_GEN_H
+
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "Entities.h"
+
+// Meshes a generated instance can use; instances are sorted in this order
+enum SceneMesh
+{
+    SCENE_MESH_BOOK,
+    SCENE_MESH_BALL,
+    SCENE_MESH_CANDLE,
+    SCENE_MESH_TOPPER,
+    SCENE_MESH_CABLE,
+    SCENE_MESH_COUNT
+};
+
+enum SceneLayout
+{
+    SCENE_LAYOUT_GRID,
+    SCENE_LAYOUT_RANDOM
+};
+
+struct SceneGenOptions
+{
+    int instances = 0;          // 0 disables the generator, up to MAX_SCENE_INSTANCES
+    SceneLayout layout = SCENE_LAYOUT_GRID;
+    unsigned int seed = 1234;
+    float spacing = 3.0f;       // grid cell size, also sets the random layout's density
+};
+
+struct SceneInstance
+{
+    int mesh = SCENE_MESH_BOOK;
+    glm::vec3 position;
+    float yaw = 0.0f;           // rotation about +Y, radians
+    float scale = 1.0f;         // multiplies the mesh's own scale
+};
+
+const int MAX_SCENE_INSTANCES = 1000000;
+
+bool UParseSceneGenArgs(int argc, char* argv[], SceneGenOptions& options);
+
+// Fills instances (sorted by mesh) according to options; deterministic for a given seed
+void UGenerateScene(const SceneGenOptions& options, std::vector<SceneInstance>& instances);
+
+// Transform of an instance, including the mesh's base scale and orientation from URender.
+// The scale is uniform, so it commutes with the yaw and the entity order applies.
+EntityTransform UInstanceTransform(const SceneInstance& instance);
+
+#endif
@@ -0,0 +1,115 @@
+#include "Simulation.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+using namespace std;
+
+namespace
+{
+    const chrono::steady_clock::time_point CLOCK_EPOCH = chrono::steady_clock::now();
+}
+
+
+bool UParseSimArgs(int argc, char* argv[], SimOptions& options)
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        const char* arg = argv[i];
+        if (strcmp(arg, "--fixed-step") == 0)
+            options.fixedStep = true;
+        else if (strcmp(arg, "--sim-thread") == 0)
+            options.fixedStep = options.thread = true;
+        else if (strcmp(arg, "--sim-rate") == 0)
+        {
+            char* end = nullptr;
+            if (i + 1 < argc)
+                options.rate = strtod(argv[++i], &end);
+            if (!end || *end != '\0' || options.rate < 1.0 || options.rate > 10000.0)
+            {
+                cout << "Invalid value for " << arg << endl;
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+
+CameraState UInterpolateCameraState(const CameraState& a, const CameraState& b, float alpha)
+{
+    CameraState state = b;
+    state.position = a.position + (b.position - a.position) * alpha;
+    state.yaw = a.yaw + (b.yaw - a.yaw) * alpha;
+    state.pitch = a.pitch + (b.pitch - a.pitch) * alpha;
+    state.zoom = a.zoom + (b.zoom - a.zoom) * alpha;
+    return state;
+}
+
+
+bool USameCameraState(const CameraState& a, const CameraState& b)
+{
+    return a.position == b.position && a.yaw == b.yaw && a.pitch == b.pitch && a.zoom == b.zoom
+        && a.speed == b.speed && a.perspective == b.perspective;
+}
+
+
+double USimulationTime()
+{
+    return chrono::duration<double>(chrono::steady_clock::now() - CLOCK_EPOCH).count();
+}
+
+
+int FixedStepClock::advance(double seconds)
+{
+    accumulator += seconds;
+
+    int steps = 0;
+    while (accumulator >= step && steps < MAX_STEPS)
+    {
+        accumulator -= step;
+        steps++;
+    }
+    if (accumulator >= step)
+        accumulator = 0.0;
+
+    return steps;
+}
+
+
+void SimulationThread::start(double rate, function<void(double)> step)
+{
+    stop();
+    running = true;
+
+    thread = std::thread([this, rate, step]()
+    {
+        typedef chrono::steady_clock Clock;
+        const Clock::duration period = chrono::duration_cast<Clock::duration>(chrono::duration<double>(1.0 / rate));
+        const double stepSeconds = 1.0 / rate;
+
+        Clock::time_point next = Clock::now();
+        while (running)
+        {
+            step(stepSeconds);
+
+            // Fall behind by more than a few steps (e.g. a suspended process) and the backlog is dropped
+            next += period;
+            const Clock::time_point now = Clock::now();
+            if (now - next > period * FixedStepClock::MAX_STEPS)
+                next = now;
+            this_thread::sleep_until(next);
+        }
+    });
+}
+
+
+void SimulationThread::stop()
+{
+    running = false;
+    if (thread.joinable())
+        thread.join();
+}
@@ -0,0 +1,156 @@
+///////////////////////////////////////////////////////////////////////////////
+// Simulation.h
+// ============
+// Fixed-timestep simulation: input and camera movement advance in steps of
+// a fixed length, and the renderer draws the camera interpolated between the
+// last two simulated states, so motion does not depend on the frame rate.
+//
+// With --sim-thread the steps run on their own thread. GLFW only delivers
+// input on the main thread, so the main thread forwards events through a
+// lock-free queue and publishes the held movement keys atomically. The
+// simulation hands its snapshots back through a lock-free triple buffer.
+// Recording and replaying traces need the single-threaded loop.
+//
+// Usage:
+//   "Proj_1 Niebla" --fixed-step [--sim-rate 120] [--sim-thread]
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef SIMULATION_H
+#define SIMULATION_H
+
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <thread>
+
+#include "InputTrace.h"     // CameraState
+
+struct SimOptions
+{
+    bool fixedStep = false;
+    double rate = 120.0;        // simulation steps per second
+    bool thread = false;        // run the steps on a separate thread (implies fixedStep)
+};
+
+bool UParseSimArgs(int argc, char* argv[], SimOptions& options);
+
+// Camera state between a and b; speed and perspective switch with b
+CameraState UInterpolateCameraState(const CameraState& a, const CameraState& b, float alpha);
+bool USameCameraState(const CameraState& a, const CameraState& b);
+
+// Seconds on a monotonic clock shared by the simulation and render threads
+double USimulationTime();
+
+// What the simulation publishes after each step
+struct SimSnapshot
+{
+    CameraState previous;
+    CameraState current;
+    double time = 0.0;          // USimulationTime() when current was produced
+};
+
+// Accumulates frame time and tells the single-threaded loop how many steps are due
+class FixedStepClock
+{
+public:
+    explicit FixedStepClock(double rate = 120.0) : step(1.0 / rate) {}
+
+    // Adds elapsed seconds and returns the number of steps to run. After a long stall
+    // at most MAX_STEPS run and the rest of the backlog is dropped.
+    int advance(double seconds);
+
+    double getStep() const { return step; }
+
+    // Fraction of a step left over, used to interpolate between the last two states
+    float getAlpha() const { return (float)(accumulator / step); }
+
+    static const int MAX_STEPS = 8;
+
+private:
+    double step;
+    double accumulator = 0.0;
+};
+
+// Single producer / single consumer handoff of the latest value. Neither side
+// ever waits: the writer replaces any unread value and the reader keeps the
+// last value it saw until a newer one is published.
+template <typename T>
+class TripleBuffer
+{
+public:
+    // Producer side
+    void write(const T& value)
+    {
+        slots[back] = value;
+        back = middle.exchange(back | FRESH, std::memory_order_acq_rel) & INDEX;
+    }
+
+    // Consumer side: returns true when value is newer than the previous read
+    bool read(T& value)
+    {
+        bool fresh = (middle.load(std::memory_order_acquire) & FRESH) != 0;
+        if (fresh)
+            front = middle.exchange(front, std::memory_order_acq_rel) & INDEX;
+        value = slots[front];
+        return fresh;
+    }
+
+private:
+    static const int INDEX = 3;
+    static const int FRESH = 4;
+
+    T slots[3];
+    std::atomic<int> middle{ 1 };
+    int back = 0;               // producer only
+    int front = 2;              // consumer only
+};
+
+// Bounded single producer / single consumer queue; Capacity must be a power of two
+template <typename T, size_t Capacity>
+class SpscQueue
+{
+public:
+    // Producer side, false when full
+    bool push(const T& item)
+    {
+        const size_t tail = this->tail.load(std::memory_order_relaxed);
+        if (tail - head.load(std::memory_order_acquire) == Capacity)
+            return false;
+        items[tail & (Capacity - 1)] = item;
+        this->tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer side, false when empty
+    bool pop(T& item)
+    {
+        const size_t head = this->head.load(std::memory_order_relaxed);
+        if (head == tail.load(std::memory_order_acquire))
+            return false;
+        item = items[head & (Capacity - 1)];
+        this->head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+private:
+    T items[Capacity];
+    std::atomic<size_t> head{ 0 };
+    std::atomic<size_t> tail{ 0 };
+};
+
+// Runs step(stepSeconds) at a fixed rate on its own thread
+class SimulationThread
+{
+public:
+    ~SimulationThread() { stop(); }
+
+    void start(double rate, std::function<void(double)> step);
+    void stop();
+    bool isRunning() const { return running; }
+
+private:
+    std::thread thread;
+    std::atomic<bool> running{ false };
+};
+
+#endif
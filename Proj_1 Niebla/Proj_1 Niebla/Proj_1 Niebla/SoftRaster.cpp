@@ -0,0 +1,620 @@
+#include "SoftRaster.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+#include "GLState.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SOFT_RASTER_SSE2 1
+#include <emmintrin.h>
+#endif
+
+using namespace std;
+
+namespace
+{
+    const int FLOATS_PER_VERTEX = 8;
+    const int MIN_TILE_SIZE = 16;
+    const int MAX_TILE_SIZE = 256;
+
+    // Constants of fragmentShaderSource
+    const float GLOBAL_STRENGTH = 0.5f;
+    const float AMBIENT_STRENGTH = 1.7f;
+    const float SPECULAR_INTENSITY = 0.8f;
+
+    unsigned char ToUnorm8(float value)
+    {
+        value = min(max(value, 0.0f), 1.0f);
+        return (unsigned char)(value * 255.0f + 0.5f);
+    }
+
+    int Wrap(int value, int size)
+    {
+        value %= size;
+        return value < 0 ? value + size : value;
+    }
+}
+
+
+// A transformed vertex: clip position and the vertex shader outputs
+struct SoftRasterizer::ClipVertex
+{
+    glm::vec4 clip;
+    float attributes[FLOATS_PER_VERTEX];
+};
+
+
+bool UParseSoftRasterArgs(int argc, char* argv[], SoftRasterOptions& options)
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        const char* arg = argv[i];
+        if (strcmp(arg, "--soft-raster") == 0)
+            options.enabled = true;
+        else if (strcmp(arg, "--soft-threads") == 0)
+        {
+            char* end = nullptr;
+            if (i + 1 < argc)
+                options.threads = (int)strtol(argv[++i], &end, 10);
+            if (!end || *end != '\0' || options.threads < 0 || options.threads > MAX_SOFT_THREADS)
+            {
+                cout << "Invalid value for " << arg << endl;
+                return false;
+            }
+        }
+        else if (strcmp(arg, "--soft-tile") == 0)
+        {
+            char* end = nullptr;
+            if (i + 1 < argc)
+                options.tileSize = (int)strtol(argv[++i], &end, 10);
+            if (!end || *end != '\0' || options.tileSize < MIN_TILE_SIZE || options.tileSize > MAX_TILE_SIZE
+                || options.tileSize % 4 != 0)
+            {
+                cout << "Invalid value for " << arg << endl;
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+
+bool USoftMeshFromBuffer(GLuint vbo, int vertexCount, SoftMesh& mesh)
+{
+    mesh.vertexCount = vertexCount;
+    mesh.vertices.resize((size_t)vertexCount * FLOATS_PER_VERTEX);
+
+    UGLState().bindBuffer(GL_ARRAY_BUFFER, vbo);
+    glGetBufferSubData(GL_ARRAY_BUFFER, 0, mesh.vertices.size() * sizeof(float), mesh.vertices.data());
+    UGLState().bindBuffer(GL_ARRAY_BUFFER, 0);
+    return glGetError() == GL_NO_ERROR;
+}
+
+
+bool USoftTextureFromGL(GLuint texture, SoftTexture& result)
+{
+    GLStateCache& gl = UGLState();
+    gl.bindTexture(0, texture);
+    glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_WIDTH, &result.width);
+    glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_HEIGHT, &result.height);
+    if (result.width <= 0 || result.height <= 0)
+    {
+        gl.bindTexture(0, 0);
+        return false;
+    }
+
+    // RGBA rows are always 4-byte aligned, so the default pack alignment fits
+    result.texels.resize((size_t)result.width * result.height * 4);
+    glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA, GL_UNSIGNED_BYTE, result.texels.data());
+    gl.bindTexture(0, 0);
+    return glGetError() == GL_NO_ERROR;
+}
+
+
+glm::vec3 SoftTexture::sample(glm::vec2 uv) const
+{
+    // GL_LINEAR: blend the four texels around the sample point, texel centers at +0.5
+    const float u = uv.x * width - 0.5f;
+    const float v = uv.y * height - 0.5f;
+    const float u0 = floor(u);
+    const float v0 = floor(v);
+    const float fu = u - u0;
+    const float fv = v - v0;
+
+    const int x0 = Wrap((int)u0, width);
+    const int y0 = Wrap((int)v0, height);
+    const int x1 = x0 + 1 == width ? 0 : x0 + 1;
+    const int y1 = y0 + 1 == height ? 0 : y0 + 1;
+
+    const unsigned char* t00 = &texels[((size_t)y0 * width + x0) * 4];
+    const unsigned char* t10 = &texels[((size_t)y0 * width + x1) * 4];
+    const unsigned char* t01 = &texels[((size_t)y1 * width + x0) * 4];
+    const unsigned char* t11 = &texels[((size_t)y1 * width + x1) * 4];
+
+    glm::vec3 color;
+    for (int c = 0; c < 3; ++c)
+    {
+        const float bottom = t00[c] + (t10[c] - t00[c]) * fu;
+        const float top = t01[c] + (t11[c] - t01[c]) * fu;
+        color[c] = (bottom + (top - bottom) * fv) * (1.0f / 255.0f);
+    }
+    return color;
+}
+
+
+SoftRasterizer::SoftRasterizer(int threads, int tileSize)
+    : tileSize(tileSize)
+{
+    threadCount = threads > 0 ? threads : max(1, (int)thread::hardware_concurrency());
+    threadCount = min(threadCount, MAX_SOFT_THREADS);
+    bins.resize(threadCount);
+
+    // The calling thread is worker 0
+    for (int i = 1; i < threadCount; ++i)
+        workers.emplace_back(&SoftRasterizer::workerLoop, this, i);
+}
+
+
+SoftRasterizer::~SoftRasterizer()
+{
+    {
+        lock_guard<mutex> lock(poolMutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (thread& worker : workers)
+        worker.join();
+}
+
+
+void SoftRasterizer::render(const vector<SoftDraw>& draws, const glm::mat4& view, const glm::mat4& projection,
+    const SoftLighting& lighting, int width, int height)
+{
+    resize(width, height);
+    this->draws = &draws;
+    this->lighting = lighting;
+
+    // Per draw transforms, and where each draw starts in the frame's triangle list
+    setups.resize(draws.size());
+    triangleCount = 0;
+    const glm::mat4 viewProjection = projection * view;
+    for (size_t i = 0; i < draws.size(); ++i)
+    {
+        DrawSetup& setup = setups[i];
+        setup.model = draws[i].model;
+        setup.modelViewProjection = viewProjection * draws[i].model;
+        setup.normalMatrix = glm::mat3(glm::transpose(glm::inverse(draws[i].model)));
+        setup.firstTriangle = triangleCount;
+        if (draws[i].mesh)
+            triangleCount += draws[i].mesh->vertexCount / 3;
+    }
+
+    runParallel([this](int worker) { setupTriangles(worker); });
+
+    binnedTriangles = 0;
+    for (const WorkerBins& worker : bins)
+        binnedTriangles += (unsigned int)worker.triangles.size();
+
+    nextTile = 0;
+    const int tileCount = tilesX * tilesY;
+    runParallel([this, tileCount](int) {
+        int tile;
+        while ((tile = nextTile++) < tileCount)
+            rasterizeTile(tile);
+    });
+
+    this->draws = nullptr;
+}
+
+
+void SoftRasterizer::resize(int width, int height)
+{
+    if (width == this->width && height == this->height)
+        return;
+
+    this->width = width;
+    this->height = height;
+    depthStride = (width + 3) & ~3;
+    tilesX = (width + tileSize - 1) / tileSize;
+    tilesY = (height + tileSize - 1) / tileSize;
+    pixels.assign((size_t)width * height * 4, 0);
+    depth.assign((size_t)depthStride * height, 1.0f);
+    for (WorkerBins& worker : bins)
+        worker.tiles.assign((size_t)tilesX * tilesY, vector<unsigned int>());
+}
+
+
+void SoftRasterizer::runParallel(const function<void(int)>& task)
+{
+    if (workers.empty())
+    {
+        task(0);
+        return;
+    }
+
+    {
+        lock_guard<mutex> lock(poolMutex);
+        this->task = &task;
+        busy = (int)workers.size();
+        generation++;
+    }
+    wake.notify_all();
+
+    task(0);
+
+    unique_lock<mutex> lock(poolMutex);
+    done.wait(lock, [this]() { return busy == 0; });
+    this->task = nullptr;
+}
+
+
+void SoftRasterizer::workerLoop(int index)
+{
+    unsigned int seen = 0;
+    unique_lock<mutex> lock(poolMutex);
+    for (;;)
+    {
+        wake.wait(lock, [this, seen]() { return stopping || generation != seen; });
+        if (stopping)
+            return;
+        seen = generation;
+        const function<void(int)>* current = task;
+
+        lock.unlock();
+        (*current)(index);
+        lock.lock();
+
+        if (--busy == 0)
+            done.notify_one();
+    }
+}
+
+
+// Transforms, clips and bins this worker's share of the frame's triangles. Shares are
+// contiguous and in worker order, so reading the bins worker by worker keeps draw order.
+void SoftRasterizer::setupTriangles(int worker)
+{
+    WorkerBins& output = bins[worker];
+    output.triangles.clear();
+    for (vector<unsigned int>& tile : output.tiles)
+        tile.clear();
+
+    const unsigned int first = (unsigned int)((unsigned long long)triangleCount * worker / threadCount);
+    const unsigned int last = (unsigned int)((unsigned long long)triangleCount * (worker + 1) / threadCount);
+    if (first >= last)
+        return;
+
+    // Last draw starting at or before the first triangle
+    size_t draw = upper_bound(setups.begin(), setups.end(), first,
+        [](unsigned int triangle, const DrawSetup& setup) { return triangle < setup.firstTriangle; }) - setups.begin() - 1;
+
+    for (unsigned int triangle = first; triangle < last; ++triangle)
+    {
+        while (draw + 1 < setups.size() && triangle >= setups[draw + 1].firstTriangle)
+            draw++;
+
+        const DrawSetup& setup = setups[draw];
+        const SoftDraw& source = (*draws)[draw];
+        const float* vertex = &source.mesh->vertices[(size_t)(triangle - setup.firstTriangle) * 3 * FLOATS_PER_VERTEX];
+
+        // Vertex shader
+        ClipVertex in[3];
+        for (int i = 0; i < 3; ++i, vertex += FLOATS_PER_VERTEX)
+        {
+            const glm::vec4 position(vertex[0], vertex[1], vertex[2], 1.0f);
+            const glm::vec4 world = setup.model * position;
+            const glm::vec3 normal = setup.normalMatrix * glm::vec3(vertex[3], vertex[4], vertex[5]);
+            in[i].clip = setup.modelViewProjection * position;
+            in[i].attributes[0] = world.x;
+            in[i].attributes[1] = world.y;
+            in[i].attributes[2] = world.z;
+            in[i].attributes[3] = normal.x;
+            in[i].attributes[4] = normal.y;
+            in[i].attributes[5] = normal.z;
+            in[i].attributes[6] = vertex[6];
+            in[i].attributes[7] = vertex[7];
+        }
+
+        // Drop triangles entirely outside one of the side or far planes
+        bool outside = false;
+        for (int axis = 0; axis < 3 && !outside; ++axis)
+        {
+            bool below = true, above = true;
+            for (int i = 0; i < 3; ++i)
+            {
+                below = below && in[i].clip[axis] < -in[i].clip.w;
+                above = above && in[i].clip[axis] > in[i].clip.w;
+            }
+            outside = above || below;
+        }
+        if (outside)
+            continue;
+
+        // Clip against the near plane (z >= -w); the other planes are left to the
+        // screen bounds and the depth test
+        float distance[3];
+        int inside = 0;
+        for (int i = 0; i < 3; ++i)
+        {
+            distance[i] = in[i].clip.z + in[i].clip.w;
+            inside += distance[i] >= 0.0f ? 1 : 0;
+        }
+
+        if (inside == 3)
+        {
+            emitTriangle(output, in[0], in[1], in[2], source.texture);
+            continue;
+        }
+        if (inside == 0)
+            continue;
+
+        ClipVertex polygon[4];
+        int count = 0;
+        for (int i = 0; i < 3; ++i)
+        {
+            const int next = (i + 1) % 3;
+            if (distance[i] >= 0.0f)
+                polygon[count++] = in[i];
+            if ((distance[i] >= 0.0f) != (distance[next] >= 0.0f))
+            {
+                const float t = distance[i] / (distance[i] - distance[next]);
+                ClipVertex& split = polygon[count++];
+                split.clip = in[i].clip + (in[next].clip - in[i].clip) * t;
+                for (int a = 0; a < FLOATS_PER_VERTEX; ++a)
+                    split.attributes[a] = in[i].attributes[a] + (in[next].attributes[a] - in[i].attributes[a]) * t;
+            }
+        }
+        for (int i = 2; i < count; ++i)
+            emitTriangle(output, polygon[0], polygon[i - 1], polygon[i], source.texture);
+    }
+}
+
+
+// Projects a clipped triangle to the screen, sets up its edge functions and adds it
+// to the bins of the tiles its bounding box touches
+void SoftRasterizer::emitTriangle(WorkerBins& output, const ClipVertex& a, const ClipVertex& b, const ClipVertex& c,
+    const SoftTexture* texture)
+{
+    const ClipVertex* vertices[3] = { &a, &b, &c };
+    float x[3], y[3], z[3], invW[3];
+    for (int i = 0; i < 3; ++i)
+    {
+        const glm::vec4& clip = vertices[i]->clip;
+        invW[i] = 1.0f / clip.w;
+        x[i] = (clip.x * invW[i] * 0.5f + 0.5f) * width;
+        y[i] = (clip.y * invW[i] * 0.5f + 0.5f) * height;
+        z[i] = clip.z * invW[i] * 0.5f + 0.5f;
+    }
+
+    // Face culling is off in the GL path, so wind both orientations counterclockwise
+    float area = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+    if (!(fabs(area) > 0.0f))
+        return;
+    int order[3] = { 0, 1, 2 };
+    if (area < 0.0f)
+    {
+        swap(order[1], order[2]);
+        area = -area;
+    }
+
+    Triangle triangle;
+    float minX = x[0], maxX = x[0], minY = y[0], maxY = y[0];
+    for (int i = 0; i < 3; ++i)
+    {
+        const int v = order[i];
+        const int j = order[(i + 1) % 3];
+        const int k = order[(i + 2) % 3];
+
+        triangle.edgeA[i] = y[j] - y[k];
+        triangle.edgeB[i] = x[k] - x[j];
+        triangle.edgeC[i] = (float)((double)x[j] * y[k] - (double)x[k] * y[j]);
+        // Top-left style tie break: neighbors see the shared edge negated, so exactly one claims it
+        triangle.inclusive[i] = triangle.edgeA[i] > 0.0f || (triangle.edgeA[i] == 0.0f && triangle.edgeB[i] > 0.0f);
+
+        triangle.z[i] = z[v];
+        triangle.invW[i] = invW[v];
+        for (int attribute = 0; attribute < FLOATS_PER_VERTEX; ++attribute)
+            triangle.attributes[i][attribute] = vertices[v]->attributes[attribute] * invW[v];
+
+        minX = min(minX, x[v]);
+        maxX = max(maxX, x[v]);
+        minY = min(minY, y[v]);
+        maxY = max(maxY, y[v]);
+    }
+    triangle.invArea = 1.0f / area;
+    triangle.texture = texture;
+
+    // Pixels whose centers may be covered
+    triangle.minX = max(0, (int)floor(minX));
+    triangle.minY = max(0, (int)floor(minY));
+    triangle.maxX = min(width - 1, (int)ceil(maxX));
+    triangle.maxY = min(height - 1, (int)ceil(maxY));
+    if (triangle.minX > triangle.maxX || triangle.minY > triangle.maxY)
+        return;
+
+    const unsigned int index = (unsigned int)output.triangles.size();
+    output.triangles.push_back(triangle);
+    for (int tileY = triangle.minY / tileSize; tileY <= triangle.maxY / tileSize; ++tileY)
+    {
+        for (int tileX = triangle.minX / tileSize; tileX <= triangle.maxX / tileSize; ++tileX)
+            output.tiles[(size_t)tileY * tilesX + tileX].push_back(index);
+    }
+}
+
+
+void SoftRasterizer::rasterizeTile(int tile)
+{
+    const int tileX0 = (tile % tilesX) * tileSize;
+    const int tileY0 = (tile / tilesX) * tileSize;
+    const int tileX1 = min(tileX0 + tileSize, width) - 1;
+    const int tileY1 = min(tileY0 + tileSize, height) - 1;
+
+    // Clear the tile; its depth covers the padding columns too
+    const int depthEnd = min(tileX0 + tileSize, depthStride);
+    for (int y = tileY0; y <= tileY1; ++y)
+    {
+        unsigned char* row = &pixels[((size_t)y * width + tileX0) * 4];
+        for (int x = tileX0; x <= tileX1; ++x, row += 4)
+        {
+            row[0] = row[1] = row[2] = 0;
+            row[3] = 255;
+        }
+        fill(depth.begin() + (size_t)y * depthStride + tileX0, depth.begin() + (size_t)y * depthStride + depthEnd, 1.0f);
+    }
+
+    for (const WorkerBins& worker : bins)
+    {
+        for (unsigned int index : worker.tiles[tile])
+        {
+            const Triangle& triangle = worker.triangles[index];
+
+            // Quads of four pixels start on multiples of 4, which tile edges are too
+            const int startX = max(tileX0, triangle.minX) & ~3;
+            const int endX = min(tileX1, triangle.maxX);
+            const int startY = max(tileY0, triangle.minY);
+            const int endY = min(tileY1, triangle.maxY);
+
+#ifdef SOFT_RASTER_SSE2
+            const __m128 zero = _mm_setzero_ps();
+            const __m128 laneOffsets = _mm_set_ps(3.5f, 2.5f, 1.5f, 0.5f);
+            __m128 edgeA[3], inclusive[3];
+            for (int e = 0; e < 3; ++e)
+            {
+                edgeA[e] = _mm_set1_ps(triangle.edgeA[e]);
+                inclusive[e] = _mm_castsi128_ps(_mm_set1_epi32(triangle.inclusive[e] ? -1 : 0));
+            }
+            const __m128 invArea = _mm_set1_ps(triangle.invArea);
+            const __m128 z0 = _mm_set1_ps(triangle.z[0]);
+            const __m128 z1 = _mm_set1_ps(triangle.z[1]);
+            const __m128 z2 = _mm_set1_ps(triangle.z[2]);
+#endif
+
+            for (int y = startY; y <= endY; ++y)
+            {
+                const float centerY = y + 0.5f;
+                float rowConstant[3];
+                for (int e = 0; e < 3; ++e)
+                    rowConstant[e] = triangle.edgeB[e] * centerY + triangle.edgeC[e];
+                float* depthRow = &depth[(size_t)y * depthStride];
+                unsigned char* colorRow = &pixels[(size_t)y * width * 4];
+
+                for (int x = startX; x <= endX; x += 4)
+                {
+                    float b0[4], b1[4], b2[4];
+                    int mask;
+
+#ifdef SOFT_RASTER_SSE2
+                    const __m128 centerX = _mm_add_ps(_mm_set1_ps((float)x), laneOffsets);
+                    __m128 weight[3];
+                    __m128 covered = _mm_castsi128_ps(_mm_set1_epi32(-1));
+                    for (int e = 0; e < 3; ++e)
+                    {
+                        const __m128 value = _mm_add_ps(_mm_mul_ps(edgeA[e], centerX), _mm_set1_ps(rowConstant[e]));
+                        const __m128 inside = _mm_or_ps(_mm_cmpgt_ps(value, zero),
+                            _mm_and_ps(_mm_cmpeq_ps(value, zero), inclusive[e]));
+                        covered = _mm_and_ps(covered, inside);
+                        weight[e] = _mm_mul_ps(value, invArea);
+                    }
+                    if (_mm_movemask_ps(covered) == 0)
+                        continue;
+
+                    // Depth is affine in screen space; GL_LESS against the stored depth
+                    const __m128 z = _mm_add_ps(_mm_add_ps(_mm_mul_ps(weight[0], z0), _mm_mul_ps(weight[1], z1)),
+                        _mm_mul_ps(weight[2], z2));
+                    const __m128 stored = _mm_loadu_ps(depthRow + x);
+                    const __m128 pass = _mm_and_ps(covered, _mm_cmplt_ps(z, stored));
+                    mask = _mm_movemask_ps(pass);
+                    if (mask == 0)
+                        continue;
+                    _mm_storeu_ps(depthRow + x, _mm_or_ps(_mm_and_ps(pass, z), _mm_andnot_ps(pass, stored)));
+                    _mm_storeu_ps(b0, weight[0]);
+                    _mm_storeu_ps(b1, weight[1]);
+                    _mm_storeu_ps(b2, weight[2]);
+#else
+                    mask = 0;
+                    for (int lane = 0; lane < 4; ++lane)
+                    {
+                        const float centerX = x + lane + 0.5f;
+                        float weight[3];
+                        bool covered = true;
+                        for (int e = 0; e < 3; ++e)
+                        {
+                            const float value = triangle.edgeA[e] * centerX + rowConstant[e];
+                            covered = covered && (value > 0.0f || (value == 0.0f && triangle.inclusive[e]));
+                            weight[e] = value * triangle.invArea;
+                        }
+                        if (!covered)
+                            continue;
+                        const float z = weight[0] * triangle.z[0] + weight[1] * triangle.z[1] + weight[2] * triangle.z[2];
+                        if (!(z < depthRow[x + lane]))
+                            continue;
+                        depthRow[x + lane] = z;
+                        b0[lane] = weight[0];
+                        b1[lane] = weight[1];
+                        b2[lane] = weight[2];
+                        mask |= 1 << lane;
+                    }
+#endif
+
+                    // Lanes past the right edge of the image only exist in the depth padding
+                    if (x + 4 > width)
+                        mask &= (1 << (width - x)) - 1;
+                    for (int lane = 0; lane < 4; ++lane)
+                    {
+                        if (mask & (1 << lane))
+                            shade(triangle, b0[lane], b1[lane], b2[lane], colorRow + (size_t)(x + lane) * 4);
+                    }
+                }
+            }
+        }
+    }
+}
+
+
+// Perspective-correct attributes and the Phong model of fragmentShaderSource
+void SoftRasterizer::shade(const Triangle& triangle, float b0, float b1, float b2, unsigned char* pixel) const
+{
+    if (!triangle.texture)
+    {
+        pixel[0] = pixel[1] = pixel[2] = pixel[3] = 255;
+        return;
+    }
+
+    const float w = 1.0f / (b0 * triangle.invW[0] + b1 * triangle.invW[1] + b2 * triangle.invW[2]);
+    float attributes[FLOATS_PER_VERTEX];
+    for (int i = 0; i < FLOATS_PER_VERTEX; ++i)
+        attributes[i] = (b0 * triangle.attributes[0][i] + b1 * triangle.attributes[1][i] + b2 * triangle.attributes[2][i]) * w;
+
+    const glm::vec3 position(attributes[0], attributes[1], attributes[2]);
+    const glm::vec3 norm = glm::normalize(glm::vec3(attributes[3], attributes[4], attributes[5]));
+    const glm::vec2 uv(attributes[6], attributes[7]);
+
+    const glm::vec3 global = GLOBAL_STRENGTH * lighting.lightColor;
+    const glm::vec3 ambient = AMBIENT_STRENGTH * lighting.ambientColor;
+
+    const glm::vec3 lightDirection = glm::normalize(lighting.lightPosition - position);
+    const float impact = max(glm::dot(norm, lightDirection), 0.0f);
+    const glm::vec3 diffuse = impact * lighting.lightColor;
+
+    const glm::vec3 viewDirection = glm::normalize(lighting.viewPosition - position);
+    const glm::vec3 reflectDirection = glm::reflect(-lightDirection, norm);
+    float specularComponent = max(glm::dot(viewDirection, reflectDirection), 0.0f);
+    specularComponent *= specularComponent;     // pow(x, 16)
+    specularComponent *= specularComponent;
+    specularComponent *= specularComponent;
+    specularComponent *= specularComponent;
+    const glm::vec3 specular = SPECULAR_INTENSITY * specularComponent * lighting.lightColor;
+
+    const glm::vec3 textureColor = triangle.texture->sample(uv * lighting.uvScale);
+    const glm::vec3 phong = (global + ambient + diffuse + specular) * textureColor;
+
+    pixel[0] = ToUnorm8(phong.r);
+    pixel[1] = ToUnorm8(phong.g);
+    pixel[2] = ToUnorm8(phong.b);
+    pixel[3] = 255;
+}
@@ -0,0 +1,182 @@
+///////////////////////////////////////////////////////////////////////////////
+// SoftRaster.h
+// ============
+// CPU rasterizer for the scene, used to compare against the GL path (and
+// llvmpipe in particular) in benchmark runs. It draws the same vertex
+// buffers and textures, read back from GL once, with the same matrices and
+// a copy of the Phong fragment shader.
+//
+// A frame runs in two parallel passes over a pool of worker threads:
+//   1. Each worker transforms a contiguous range of the frame's triangles,
+//      clips them against the near plane and bins them into screen tiles.
+//   2. Workers take whole tiles and rasterize the tile's bins in submission
+//      order, evaluating the edge functions for four pixels at a time with
+//      SSE2 (scalar code elsewhere), then depth testing and shading the
+//      covered pixels.
+// Tiles own their pixels, so the second pass needs no locking.
+//
+// With --soft-raster a --bench run also times the software renderer on the
+// same camera path and reports it next to the GL frame times, together with
+// how much its first frame differs from GL's.
+//
+// Usage:
+//   "Proj_1 Niebla" --bench --soft-raster [--soft-threads 8] [--soft-tile 64]
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef SOFT_RASTER_H
+#define SOFT_RASTER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+struct SoftRasterOptions
+{
+    bool enabled = false;       // set by --soft-raster
+    int threads = 0;            // 0: one per hardware thread
+    int tileSize = 64;          // pixels, a multiple of 4
+};
+
+const int MAX_SOFT_THREADS = 64;
+
+bool UParseSoftRasterArgs(int argc, char* argv[], SoftRasterOptions& options);
+
+// Interleaved position, normal and texture coordinate (8 floats per vertex),
+// non-indexed triangles, as in the scene's vertex buffers
+struct SoftMesh
+{
+    std::vector<float> vertices;
+    int vertexCount = 0;
+};
+
+// RGBA8 texels, row 0 at t = 0 as stored by GL. Sampled with GL_LINEAR and GL_REPEAT.
+struct SoftTexture
+{
+    std::vector<unsigned char> texels;
+    int width = 0;
+    int height = 0;
+
+    glm::vec3 sample(glm::vec2 uv) const;
+};
+
+// Copies a vertex buffer / the base level of a texture back from GL
+bool USoftMeshFromBuffer(GLuint vbo, int vertexCount, SoftMesh& mesh);
+bool USoftTextureFromGL(GLuint texture, SoftTexture& result);
+
+struct SoftDraw
+{
+    const SoftMesh* mesh = nullptr;
+    const SoftTexture* texture = nullptr;   // null: unlit white, like the lamp shader
+    glm::mat4 model;
+};
+
+// Uniforms of fragmentShaderSource
+struct SoftLighting
+{
+    glm::vec3 lightColor;
+    glm::vec3 lightPosition;
+    glm::vec3 ambientColor;
+    glm::vec3 viewPosition;
+    glm::vec2 uvScale;
+};
+
+class SoftRasterizer
+{
+public:
+    explicit SoftRasterizer(int threads = 0, int tileSize = 64);
+    ~SoftRasterizer();
+
+    SoftRasterizer(const SoftRasterizer&) = delete;
+    SoftRasterizer& operator=(const SoftRasterizer&) = delete;
+
+    // Clears to black and draws the draws in order with depth testing
+    void render(const std::vector<SoftDraw>& draws, const glm::mat4& view, const glm::mat4& projection,
+        const SoftLighting& lighting, int width, int height);
+
+    // RGBA8 rows of the last frame, bottom row first like glReadPixels
+    const std::vector<unsigned char>& getPixels() const { return pixels; }
+
+    int getThreadCount() const { return threadCount; }
+
+    // Triangles that reached the bins in the last frame, after clipping
+    unsigned int getBinnedTriangles() const { return binnedTriangles; }
+
+private:
+    struct ClipVertex;
+
+    // A clipped triangle set up for rasterization
+    struct Triangle
+    {
+        float edgeA[3];         // edge i (opposite vertex i): A * x + B * y + C, positive inside
+        float edgeB[3];
+        float edgeC[3];
+        bool inclusive[3];      // pixel centers exactly on the edge belong to this triangle
+        float invArea;
+        float z[3];             // window space depth
+        float invW[3];
+        float attributes[3][8]; // world position, normal and texture coordinate, divided by w
+        int minX, minY, maxX, maxY;
+        const SoftTexture* texture;
+    };
+
+    // Per worker output of the binning pass
+    struct WorkerBins
+    {
+        std::vector<Triangle> triangles;
+        std::vector<std::vector<unsigned int>> tiles;  // triangle indices per tile
+    };
+
+    struct DrawSetup
+    {
+        glm::mat4 model;
+        glm::mat4 modelViewProjection;
+        glm::mat3 normalMatrix;
+        unsigned int firstTriangle = 0;
+    };
+
+    void resize(int width, int height);
+    void runParallel(const std::function<void(int)>& task);
+    void workerLoop(int index);
+    void setupTriangles(int worker);
+    void rasterizeTile(int tile);
+    void emitTriangle(WorkerBins& bins, const ClipVertex& a, const ClipVertex& b, const ClipVertex& c,
+        const SoftTexture* texture);
+    void shade(const Triangle& triangle, float b0, float b1, float b2, unsigned char* pixel) const;
+
+    int threadCount = 1;
+    int tileSize = 64;
+
+    // frame state
+    int width = 0;
+    int height = 0;
+    int depthStride = 0;        // width rounded up to 4 floats
+    int tilesX = 0;
+    int tilesY = 0;
+    std::vector<unsigned char> pixels;
+    std::vector<float> depth;
+    std::vector<WorkerBins> bins;
+    std::vector<DrawSetup> setups;
+    const std::vector<SoftDraw>* draws = nullptr;
+    SoftLighting lighting;
+    unsigned int triangleCount = 0;
+    unsigned int binnedTriangles = 0;
+    std::atomic<int> nextTile{ 0 };
+
+    // worker pool
+    std::vector<std::thread> workers;
+    std::mutex poolMutex;
+    std::condition_variable wake;
+    std::condition_variable done;
+    const std::function<void(int)>* task = nullptr;
+    unsigned int generation = 0;
+    int busy = 0;
+    bool stopping = false;
+};
+
+#endif
@@ -1,6 +1,15 @@
 #include <iostream>         // cout, cerr
+#include <atomic>
+#include <thread>
 #include <iomanip>
+#include <fstream>
+#include <chrono>
+#include <random>
+#include <memory>
+#include <vector>
 #include <cstdlib>          // EXIT_FAILURE
+#include <cstring>
+#include <cstdio>
 #include <GL/glew.h>        // GLEW library
 #include <GLFW/glfw3.h>     // GLFW library
 #define STB_IMAGE_IMPLEMENTATION
@@ -13,6 +22,35 @@
 
 #include <learnOpengl/camera.h> // Camera class
 
+#include "Bench.h"          // Headless benchmark mode
+#include "InputTrace.h"     // Input recording and replay
+#include "MicroBench.h"     // CPU kernel microbenchmarks
+#include "Sphere.h"         // Procedural sphere mesh
+#include "RenderTarget.h"   // Offscreen framebuffers
+#include "SceneGen.h"       // Procedural stress scenes
+#include "Entities.h"       // Entity-component scene store
+#include "TransformBatch.h" // SIMD model/normal matrix composition
+#include "JobSystem.h"      // Work-stealing job system
+#include "FramePrep.h"      // Parallel transform, cull and sort stages
+#include "FrameArena.h"     // Per-frame linear allocation
+#include "AllocCounter.h"   // Heap allocation counting
+#include "Resources.h"      // Reference-counted textures and meshes
+#include "GpuStorage.h"     // Immutable storage and direct state access
+#include "GLState.h"        // Redundant GL call elision
+#include "MeshImport.h"     // OBJ and glTF mesh files
+#include "MeshFile.h"       // Memory-mapped binary meshes
+#include "AssetPack.h"      // Asset packs and the file system loaders read through
+#include "Lz4.h"            // LZ4 block compression
+#include "MeshSimplify.h"   // Quadric simplification into LOD chains
+#include "GpuCull.h"        // GPU-driven culling of the stress scene
+#include "HiZ.h"            // Hierarchical-Z occlusion culling
+#include "DynamicRes.h"     // Dynamic resolution scaling
+#include "FrameLoop.h"      // Render loop scheduling
+#include "Simulation.h"     // Fixed-timestep simulation
+#include "Capture.h"        // Frame capture and screenshots
+#include "BatchRender.h"    // Headless batch rendering
+#include "SoftRaster.h"     // CPU rasterizer for comparison runs
+
 using namespace std; // Standard namespace
 
 /*Shader program Macro*/
@@ -32,16 +70,57 @@ namespace
     glm::mat4 projection;
     bool perspective = true;
 
+    // A simplified version of a mesh, drawn instead of it when small on screen
+    struct GLMeshLod
+    {
+        GLuint vao;
+        GLuint nVertices;
+        MeshHandle resource;
+    };
+
     // Stores the GL data relative to a given mesh
     struct GLMesh
     {
         GLuint vao;         // Handle for the vertex array object
         GLuint vbo;         // Handle for the vertex buffer object
         GLuint nVertices;    // Number of indices of the mesh
+        MeshHandle resource;    // Owns vao and vbo
+        glm::vec4 bounds;       // Bounding sphere, when boundsKnown (loaded from a mesh file)
+        bool boundsKnown;
+        std::vector<GLMeshLod> lods;    // Coarsest last (--lod)
+        std::vector<float> lodErrors;   // Of each LOD, in radii of the mesh's bounding sphere
     };
 
+    // What LODs are picked for: the eye and the pixels a world unit covers, at a
+    // distance of 1 under perspective and anywhere under ortho
+    struct LodView
+    {
+        glm::vec3 eye;
+        float pixelsPerUnit;
+        bool perspective;
+    };
+
+    // Size of the framebuffer the frame is presented in (the window, or the bench target)
+    int gFramebufferWidth = WINDOW_WIDTH;
+    int gFramebufferHeight = WINDOW_HEIGHT;
+    // Size the 3D scene is rendered at, smaller than the framebuffer under dynamic resolution
+    int gRenderWidth = WINDOW_WIDTH;
+    int gRenderHeight = WINDOW_HEIGHT;
+
     // Main GLFW window
     GLFWwindow* gWindow = nullptr;
+    // Textures and meshes; declared before the handles below so it outlives them
+    ResourceOptions gResourceOptions;
+    GpuStorageOptions gGpuStorage;
+    ResourceRegistry gResources;
+    // Mesh files replacing built-in meshes (--mesh)
+    MeshImportOptions gMeshImport;
+    // Binary mesh file written or read at startup (--save-meshes, --load-meshes)
+    MeshFileOptions gMeshFile;
+    // Asset packs mounted or built at startup (--pack, --build-pack)
+    AssetPackOptions gAssetPacks;
+    // Simplified prop meshes drawn by screen size (--lod)
+    LodOptions gLod;
     // Triangle mesh data
     GLMesh gBaseMesh;
     GLMesh gBookMesh;
@@ -50,14 +129,22 @@ namespace
     GLMesh gTopperMesh;
     GLMesh gCableMesh;
     // Texture id
-    GLuint gTextureIdGranite;
+    TextureHandle gTextureGranite;
     glm::vec2 gUVScale(2.5f, 2.5f);
     GLint gTexWrapMode = GL_REPEAT;
-    GLuint gTextureIdBook;
-    GLuint gTextureIdBall;
-    GLuint gTextureIdCandle;
-    GLuint gTextureIdTopper;
-    GLuint gTextureIdCable;
+    TextureHandle gTextureBook;
+    TextureHandle gTextureBall;
+    TextureHandle gTextureCandle;
+    TextureHandle gTextureTopper;
+    TextureHandle gTextureCable;
+    // The meshes by the names --mesh and mesh files use, with the texture each is drawn with;
+    // a loaded mesh file may name other textures
+    const int NAMED_MESH_COUNT = 6;
+    const char* const gMeshNames[NAMED_MESH_COUNT] = { "base", "book", "ball", "candle", "topper", "cable" };
+    GLMesh* const gNamedMeshes[NAMED_MESH_COUNT] = { &gBaseMesh, &gBookMesh, &gBallMesh, &gCandleMesh, &gTopperMesh, &gCableMesh };
+    TextureHandle* const gMeshTextures[NAMED_MESH_COUNT] = { &gTextureGranite, &gTextureBook, &gTextureBall, &gTextureCandle, &gTextureTopper, &gTextureCable };
+    string gMeshMaterials[NAMED_MESH_COUNT] = { "../Includes/T_granite.png", "../Includes/T_Book.png", "../Includes/T_Ball.png",
+        "../Includes/T_Candle.png", "../Includes/T_Topper.png", "../Includes/T_Cable.png" };
     // Shader program
     GLuint gProgramId;
     GLuint gLampProgramId;
@@ -71,6 +158,102 @@ namespace
     float gDeltaTime = 0.0f; // time between current frame and last frame
     float gLastFrame = 0.0f;
 
+    // benchmark mode
+    BenchOptions gBench;
+    RenderTarget gBenchTarget;
+    std::vector<glm::vec3> gCopyOffsets;  // one entry per copy of the prop set
+    const float COPY_SPACING = 12.0f;   // distance between prop set copies
+
+    // Prop copies and stress instances; the base and the lamp are drawn on their own
+    EntityStore gEntities;
+
+    // Meshes of the prop set in draw order; the cable is drawn three times
+    const int PROP_DRAW_COUNT = 7;
+    const SceneMesh PROP_DRAW_MESHES[PROP_DRAW_COUNT] = {
+        SCENE_MESH_BOOK, SCENE_MESH_BALL, SCENE_MESH_CANDLE, SCENE_MESH_TOPPER,
+        SCENE_MESH_CABLE, SCENE_MESH_CABLE, SCENE_MESH_CABLE
+    };
+
+    // Per thread, so batch workers drawing the scene don't race on them
+    thread_local unsigned int gDrawCount = 0;       // draw calls issued by the last URender
+    thread_local unsigned int gTriangleCount = 0;   // triangles submitted by the last URender
+
+    // input trace recording / replay
+    TraceOptions gTrace;
+    InputRecorder gRecorder;
+    InputReplayer gReplayer;
+
+    // procedural stress scene
+    SceneGenOptions gSceneGen;
+    std::vector<SceneInstance> gStressInstances;  // sorted by mesh
+    float gFarPlane = 100.0f;                     // grows so a large stress scene is not clipped
+
+    // GPU-driven culling and indirect drawing of the stress scene
+    GpuCullOptions gGpuCull;
+    GpuCuller gGpuCuller;
+    GLuint gGpuCullProgramId = 0;
+
+    // Hi-Z occlusion culling, tested against the previous frame's depth
+    HiZOptions gHiZ;
+    HiZPyramid gHiZPyramid;
+    RenderTarget gSceneTarget;                  // offscreen scene for interactive Hi-Z runs
+    const RenderTarget* gActiveTarget = nullptr;    // target URender draws into, if not the window
+
+    // dynamic resolution
+    DynResOptions gDynRes;
+    ResolutionController gResolution;
+    GpuFrameTimer gFrameTimer;
+    GLuint gUpscaleProgramId = 0;
+    GLuint gUpscaleVao = 0;         // empty, the fullscreen triangle comes from gl_VertexID
+
+    // render loop scheduling
+    FrameLoopOptions gFrameLoop;
+    std::atomic<bool> gRedrawNeeded{ true };    // something changed since the last presented frame
+    FrameLimiter gFrameLimiter;
+    FrameFences gFrameFences;
+    LatencyMeter gLatency;
+    PacingHud gHud;
+
+    // fixed-timestep simulation: gCamera is the simulated camera, gViewCamera the one drawn
+    SimOptions gSim;
+    FixedStepClock gSimClock;
+    SimSnapshot gSimState;                      // last two simulated states, owned by whoever steps
+    SimSnapshot gViewSnapshot;                  // latest snapshot received from the sim thread
+    CameraState gViewState;                     // state gViewCamera was last set to
+    Camera gViewCamera(glm::vec3(0.0f, 0.0f, 3.0f));
+    bool gViewPerspective = true;
+    SimulationThread gSimThread;
+    TripleBuffer<SimSnapshot> gSimSnapshots;    // sim thread -> render thread
+    SpscQueue<InputEvent, 1024> gSimEvents;     // callbacks -> sim thread
+    std::atomic<uint8_t> gSimKeyMask{ 0 };      // movement keys held, sampled on the main thread
+
+    // frame capture
+    CaptureOptions gCaptureOptions;
+    FrameCapture gCapture;
+    bool gScreenshotRequested = false;          // F12 pressed, save the next frame
+
+    // headless batch rendering
+    BatchOptions gBatch;
+
+    // What a batch worker's context needs besides the shared buffers, textures and programs
+    struct BatchContext
+    {
+        GLuint baseVao = 0;
+        GLuint propVaos[SCENE_MESH_COUNT] = {};
+        GLuint programId = 0;
+        GLuint lampProgramId = 0;
+        RenderTarget target;
+    };
+
+    // software rasterizer comparison
+    SoftRasterOptions gSoftRaster;
+
+    // per-frame CPU stages; the jobs run next to the GL thread, which submits the draw list
+    JobOptions gJobOptions;
+    std::unique_ptr<JobSystem> gJobs;
+    FrameArenas gFrameArenas;   // one per job thread, reset at the start of URender
+    FramePrep gFramePrep;
+
     // Subject position and scale
     glm::vec3 gPosition(0.0f, 0.0f, 0.0f);
     glm::vec3 bookPos(0.0f, 0.0f, 4.0f);
@@ -104,7 +287,19 @@ namespace
  */
 bool UInitialize(int, char* [], GLFWwindow** window);
 void UResizeWindow(GLFWwindow* window, int width, int height);
+void URefreshWindow(GLFWwindow* /*window*/);
 void UProcessInput(GLFWwindow* window);
+uint8_t USampleMovementKeys(GLFWwindow* window);
+void UApplyMovementKeys(uint8_t keyMask, float deltaTime);
+void UApplyMouseMove(double xpos, double ypos);
+void UApplyMouseScroll(double yoffset);
+void UApplyKey(int key, int action);
+bool UReplayFrame();
+void UStepSimulation(uint8_t keyMask, float stepSeconds);
+void UStepSimulationThread(double stepSeconds);
+void UStartSimulation();
+void UUpdateViewCamera();
+void UUpdateHud();
 void UMousePositionCallback(GLFWwindow* window, double xpos, double ypos);
 void UMouseScrollCallback(GLFWwindow* window, double xoffset, double yoffset);
 void UMouseButtonCallback(GLFWwindow* window, int button, int action, int mods);
@@ -114,13 +309,45 @@ void UCreateBall(GLMesh& mesh);
 void UCreateCandle(GLMesh& mesh);
 void UCreateTopper(GLMesh& mesh);
 void UCreateCable(GLMesh& mesh);
+bool UImportSceneMeshes();
+bool ULoadSceneMeshes();
+bool USaveSceneMeshes();
+bool UMountAssetPacks();
+bool UBuildAssetPack();
+void UBuildSceneLods();
 void UDestroyMesh(GLMesh& mesh);
-bool UCreateTexture(const char* filename, GLuint& textureId);
-void UDestroyTexture(GLuint textureId);
+void UUploadMesh(GLMesh& mesh, const GLfloat* verts, size_t bytes);
+bool UCreateTexture(const char* filename, TextureHandle& texture);
+void UDestroyTexture(TextureHandle& texture);
 void URender();
+void UPropTransforms(const glm::vec3& offset, EntityTransform transforms[PROP_DRAW_COUNT]);
+void UBuildSceneEntities();
+void UInitSceneBounds();
+void UDrawEntities(GLint modelLoc, const GLuint vaos[SCENE_MESH_COUNT], const uint32_t* drawList, size_t count, const LodView* lodView);
+void UDrawLamp(GLuint programId, GLuint vao, const glm::mat4& view, const glm::mat4& projection);
+void UBuildStressScene();
+void UCreateGpuCulling();
+void URenderFrame();
+bool UBindSceneTarget();
+void UPresentSceneTarget();
+void UBindOutputFramebuffer();
+bool UCreateUpscaler();
+void USetSceneUniforms(GLuint programId, const glm::mat4& view, const glm::mat4& projection, const glm::vec3& cameraPosition);
+glm::mat4 USceneProjection(const Camera& camera, bool perspectiveView, int width, int height);
+int URunBatch();
+void UBatchWorker(int index, GLFWwindow* window, BatchQueue& queue, BatchLog& log);
+void URenderBatchJob(const BatchJob& job, BatchContext& context);
+int URunBenchmark();
+std::string UBenchVariantName();
+void UMeasureBenchRun(BenchResult& result, GLuint timerQuery);
+bool UCheckBenchResult(const std::string& baselinePath, const std::string& goldenPath, const BenchResult& result, BenchCheck& check);
+bool UMeasureSoftRaster(BenchResult& result);
+void UMeasureFrameStages(BenchResult& result);
+int URunMicroBenchmarks(const MicroBenchOptions& options);
 void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods);
 bool UCreateShaderProgram(const char* vtxShaderSource, const char* fragShaderSource, GLuint& programId);
 void UDestroyShaderProgram(GLuint programId);
+void UDestroyScene();
 
 
 /* Vertex Shader Source Code*/
@@ -148,6 +375,34 @@ const GLchar* vertexShaderSource = GLSL(440,
 );
 
 
+/* GPU-driven Vertex Shader Source Code: the model matrix comes from the instance SSBO*/
+const GLchar* gpuCullVertexShaderSource = GLSL(440,
+    layout(location = 0) in vec3 position; // VAP position 0 for vertex position data
+    layout(location = 1) in vec3 normal; // VAP position 1 for normals
+    layout(location = 2) in vec2 textureCoordinate;
+    layout(location = 3) in uint objectIndex; // instanced attribute, selected by the draw's baseInstance
+
+    layout(std430, binding = 0) readonly buffer Models { mat4 models[]; };
+
+    out vec3 vertexNormal; // For outgoing normals to fragment shader
+    out vec3 vertexFragmentPos; // For outgoing color / pixels to fragment shader
+    out vec2 vertexTextureCoordinate;
+
+    //Global variables for the transform matrices
+    uniform mat4 view;
+    uniform mat4 projection;
+
+    void main()
+    {
+        mat4 model = models[objectIndex];
+        gl_Position = projection * view * model * vec4(position, 1.0f); // transforms vertices to clip coordinates
+        vertexFragmentPos = vec3(model * vec4(position, 1.0f)); // Gets fragment / pixel position in world space only (exclude view and projection)
+        vertexNormal = mat3(transpose(inverse(model))) * normal; // get normal vectors in world space only and exclude normal translation properties
+        vertexTextureCoordinate = textureCoordinate;
+    }
+);
+
+
 /* Fragment Shader Source Code*/
 const GLchar* fragmentShaderSource = GLSL(440,
     in vec3 vertexNormal; // For incoming normals
@@ -207,6 +462,53 @@ const GLchar* fragmentShaderSource = GLSL(440,
     }
 );
 
+/* Upscale Shader Source Code: fullscreen triangle sampling the offscreen scene*/
+const GLchar* upscaleVertexShaderSource = GLSL(440,
+    out vec2 outputCoordinate;
+
+    void main()
+    {
+        vec2 corner = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2); // (0,0) (2,0) (0,2)
+        outputCoordinate = corner;
+        gl_Position = vec4(corner * 2.0f - 1.0f, 0.0f, 1.0f);
+    }
+);
+
+
+/* Upscale Fragment Shader Source Code*/
+const GLchar* upscaleFragmentShaderSource = GLSL(440,
+    in vec2 outputCoordinate;
+
+    out vec4 fragmentColor;
+
+    uniform sampler2D sceneTexture;
+    uniform vec2 renderScale;   // rendered region / texture size
+    uniform vec2 texelSize;     // 1 / texture size
+    uniform float sharpness;    // 0 for plain bilinear
+
+    // Bilinear sample that never reads outside the rendered region
+    vec3 sampleScene(vec2 coordinate)
+    {
+        return texture(sceneTexture, clamp(coordinate, 0.5f * texelSize, renderScale - 0.5f * texelSize)).rgb;
+    }
+
+    void main()
+    {
+        vec2 coordinate = outputCoordinate * renderScale;
+        vec3 color = sampleScene(coordinate);
+
+        // Unsharp mask against the four neighbours to restore edges lost to upscaling
+        if (sharpness > 0.0f)
+        {
+            vec3 neighbours = sampleScene(coordinate + vec2(texelSize.x, 0.0f)) + sampleScene(coordinate - vec2(texelSize.x, 0.0f))
+                + sampleScene(coordinate + vec2(0.0f, texelSize.y)) + sampleScene(coordinate - vec2(0.0f, texelSize.y));
+            color = clamp(color + sharpness * (4.0f * color - neighbours), 0.0f, 1.0f);
+        }
+
+        fragmentColor = vec4(color, 1.0f);
+    }
+);
+
 /* Lamp Shader Source Code*/
 const GLchar* lampVertexShaderSource = GLSL(440,
 
@@ -257,9 +559,22 @@ void flipImageVertically(unsigned char* image, int width, int height, int channe
 
 int main(int argc, char* argv[])
 {
+    // Microbenchmarks only exercise CPU code and need no window or GL context
+    MicroBenchOptions microBench;
+    if (!UParseMicroBenchArgs(argc, argv, microBench))
+        return EXIT_FAILURE;
+    if (microBench.enabled)
+        return URunMicroBenchmarks(microBench);
+
     if (!UInitialize(argc, argv, &gWindow))
         return EXIT_FAILURE;
 
+    if (!UMountAssetPacks())
+    {
+        UDestroyScene();
+        return EXIT_FAILURE;
+    }
+
     // Create the mesh
     UCreateMesh(gBaseMesh); // Calls the function to create the Vertex Buffer Object
     UCreateBook(gBookMesh);
@@ -267,64 +582,96 @@ int main(int argc, char* argv[])
     UCreateCandle(gCandleMesh);
     UCreateTopper(gTopperMesh);
     UCreateCable(gCableMesh);
+    if (!ULoadSceneMeshes() || !UImportSceneMeshes())
+    {
+        UDestroyScene();
+        return EXIT_FAILURE;
+    }
+    UInitSceneBounds();
+    UBuildSceneLods();
 
     // Create the shader program
     if (!UCreateShaderProgram(vertexShaderSource, fragmentShaderSource, gProgramId))
-        return EXIT_FAILURE;
-
-    if (!UCreateShaderProgram(lampVertexShaderSource, lampFragmentShaderSource, gLampProgramId))
-        return EXIT_FAILURE;
-
-    // Load multiple textures
-    const char* texFilename = "../Includes/T_granite.png";
-    if (!UCreateTexture(texFilename, gTextureIdGranite))
     {
-        cout << "Failed to load texture " << texFilename << endl;
+        UDestroyScene();
         return EXIT_FAILURE;
     }
-    texFilename = "../Includes/T_Book.png";
-    if (!UCreateTexture(texFilename, gTextureIdBook))
+
+    if (!UCreateShaderProgram(lampVertexShaderSource, lampFragmentShaderSource, gLampProgramId))
     {
-        cout << "Failed to load texture " << texFilename << endl;
+        UDestroyScene();
         return EXIT_FAILURE;
     }
-    texFilename = "../Includes/T_Ball.png";
-    if (!UCreateTexture(texFilename, gTextureIdBall))
+
+    // Load multiple textures
+    for (int i = 0; i < NAMED_MESH_COUNT; ++i)
     {
-        cout << "Failed to load texture " << texFilename << endl;
-        return EXIT_FAILURE;
+        if (!UCreateTexture(gMeshMaterials[i].c_str(), *gMeshTextures[i]))
+        {
+            cout << "Failed to load texture " << gMeshMaterials[i] << endl;
+            UDestroyScene();
+            return EXIT_FAILURE;
+        }
     }
-    texFilename = "../Includes/T_Candle.png";
-    if (!UCreateTexture(texFilename, gTextureIdCandle))
+    if (!USaveSceneMeshes() || !UBuildAssetPack())
     {
-        cout << "Failed to load texture " << texFilename << endl;
+        UDestroyScene();
         return EXIT_FAILURE;
     }
-    texFilename = "../Includes/T_Topper.png";
-    if (!UCreateTexture(texFilename, gTextureIdTopper))
+
+    // tell opengl for each sampler to which texture unit it belongs to (only has to be done once)
+    GLStateCache& gl = UGLState();
+    gl.useProgram(gProgramId);
+    // We set the texture as texture unit 0
+    gl.uniform1i(gl.getUniformLocation(gProgramId, "uTexture"), 0);
+
+    // Sets the background color of the window to black (it will be implicitely used by glClear)
+    gl.clearColor(0.0f, 0.0f, 0.0f, 1.0f);
+
+    // Upload the stress scene for GPU culling when requested
+    if (gGpuCull.enabled)
+        UCreateGpuCulling();
+
+    // Dynamic resolution renders offscreen and needs the upscale pass
+    if (gDynRes.enabled && !UCreateUpscaler())
     {
-        cout << "Failed to load texture " << texFilename << endl;
+        UDestroyScene();
         return EXIT_FAILURE;
     }
-    texFilename = "../Includes/T_Cable.png";
-    if (!UCreateTexture(texFilename, gTextureIdCable))
+
+    // Latency is reported by benchmarks and the title bar HUD
+    if (gBench.enabled || gFrameLoop.hud)
+        gLatency.create();
+
+    // Headless runs render offscreen and skip the render loop
+    const bool interactive = !gBench.enabled && !gBatch.enabled;
+    int exitCode = EXIT_SUCCESS;
+    if (gBench.enabled)
+        exitCode = URunBenchmark();
+    else if (gBatch.enabled)
+        exitCode = URunBatch();
+
+    // Seed the simulation with the starting camera, stepping on its own thread if requested
+    if (interactive)
+        UStartSimulation();
+    if (interactive && !gCapture.start(gCaptureOptions))
     {
-        cout << "Failed to load texture " << texFilename << endl;
+        UDestroyScene();
         return EXIT_FAILURE;
     }
 
-    // tell opengl for each sampler to which texture unit it belongs to (only has to be done once)
-    glUseProgram(gProgramId);
-    // We set the texture as texture unit 0
-    glUniform1i(glGetUniformLocation(gProgramId, "uTexture"), 0);
-
-    // Sets the background color of the window to black (it will be implicitely used by glClear)
-    glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
-
     // render loop
     // -----------
-    while (!glfwWindowShouldClose(gWindow))
+    while (interactive && !glfwWindowShouldClose(gWindow))
     {
+        // Frame pacing: hold the frame back until the GPU queue and the frame rate cap allow it
+        gFrameFences.wait();
+        gFrameLimiter.wait();
+
+        // Late input sampling reads events after the waits, as close to rendering as possible
+        if (gFrameLoop.lateInput)
+            glfwPollEvents();
+
         // per-frame timing
         // --------------------
         float currentFrame = glfwGetTime();
@@ -335,12 +682,79 @@ int main(int argc, char* argv[])
         // -----
         UProcessInput(gWindow);
 
-        // Render this frame
-        URender();
+        // Render this frame, unless on-demand mode has nothing new to show
+        const bool redraw = !gFrameLoop.onDemand || gRedrawNeeded;
+        if (redraw)
+        {
+            gRedrawNeeded = false;
+            if (gFrameLoop.hud)
+                gLatency.markInput();
+            URenderFrame();
+
+            // Start reading the frame back before the swap; it is collected a few frames later
+            if (gCapture.isStreaming() || gScreenshotRequested)
+            {
+                gCapture.readFrame(0, gFramebufferWidth, gFramebufferHeight, gCapture.isStreaming(),
+                    gScreenshotRequested ? UNextScreenshotPath() : string());
+                gScreenshotRequested = false;
+            }
+
+            // glfw: swap buffers
+            glfwSwapBuffers(gWindow);    // Flips the the back buffer with the front buffer every frame.
+            gFrameFences.insert();
+            if (gFrameLoop.hud)
+            {
+                gLatency.markPresented();
+                UUpdateHud();
+            }
+        }
+
+        gCapture.collect();
 
-        glfwPollEvents();
+        // glfw: poll IO events (keys pressed/released, mouse moved etc.), or sleep until one arrives
+        if (redraw || gRedrawNeeded)
+        {
+            if (!gFrameLoop.lateInput)
+                glfwPollEvents();
+        }
+        else
+        {
+            glfwWaitEventsTimeout(gFrameLoop.idleTimeout);
+            // The idle time is not movement time for keys that were pressed meanwhile
+            gLastFrame = glfwGetTime();
+        }
     }
 
+    UDestroyScene();
+
+    exit(exitCode); // Terminates the program
+}
+
+
+// Releases everything main creates; safe to call with any of it not created yet
+void UDestroyScene()
+{
+    gSimThread.stop();
+    gCapture.stop();
+    gRecorder.close();
+    gFrameFences.destroy();
+    gLatency.destroy();
+
+    // Release the GPU culling buffers
+    gGpuCuller.destroy();
+    gHiZPyramid.destroy();
+    if (gSceneTarget.fbo)
+        UDestroyRenderTarget(gSceneTarget);
+
+    // Release the dynamic resolution resources
+    gFrameTimer.destroy();
+    if (gUpscaleVao)
+        UGLState().deleteVertexArrays(1, &gUpscaleVao);
+    if (gUpscaleProgramId)
+        UDestroyShaderProgram(gUpscaleProgramId);
+    if (gGpuCullProgramId)
+        UDestroyShaderProgram(gGpuCullProgramId);
+
     // Release mesh data
     UDestroyMesh(gBaseMesh);
     UDestroyMesh(gBookMesh);
@@ -350,24 +764,67 @@ int main(int argc, char* argv[])
     UDestroyMesh(gCableMesh);
 
     // Release texture
-    UDestroyTexture(gTextureIdGranite);
-    UDestroyTexture(gTextureIdBook);
-    UDestroyTexture(gTextureIdBall);
-    UDestroyTexture(gTextureIdCandle);
-    UDestroyTexture(gTextureIdTopper);
-    UDestroyTexture(gTextureIdCable);
+    UDestroyTexture(gTextureGranite);
+    UDestroyTexture(gTextureBook);
+    UDestroyTexture(gTextureBall);
+    UDestroyTexture(gTextureCandle);
+    UDestroyTexture(gTextureTopper);
+    UDestroyTexture(gTextureCable);
 
     // Release shader program
     UDestroyShaderProgram(gProgramId);
     UDestroyShaderProgram(gLampProgramId);
-
-    exit(EXIT_SUCCESS); // Terminates the program successfully
 }
 
 
 // Initialize GLFW, GLEW, and create a window
 bool UInitialize(int argc, char* argv[], GLFWwindow** window)
 {
+    if (!UParseBenchArgs(argc, argv, gBench) || !UParseTraceArgs(argc, argv, gTrace)
+        || !UParseSceneGenArgs(argc, argv, gSceneGen) || !UParseGpuCullArgs(argc, argv, gGpuCull)
+        || !UParseHiZArgs(argc, argv, gHiZ) || !UParseDynResArgs(argc, argv, gDynRes)
+        || !UParseFrameLoopArgs(argc, argv, gFrameLoop) || !UParseSimArgs(argc, argv, gSim)
+        || !UParseCaptureArgs(argc, argv, gCaptureOptions) || !UParseBatchArgs(argc, argv, gBatch)
+        || !UParseSoftRasterArgs(argc, argv, gSoftRaster) || !UParseJobArgs(argc, argv, gJobOptions)
+        || !UParseResourceArgs(argc, argv, gResourceOptions) || !UParseGpuStorageArgs(argc, argv, gGpuStorage)
+        || !UParseMeshImportArgs(argc, argv, gMeshImport) || !UParseMeshFileArgs(argc, argv, gMeshFile)
+        || !UParseAssetPackArgs(argc, argv, gAssetPacks) || !UParseLodArgs(argc, argv, gLod))
+        return false;
+    if (gSim.thread && (!gTrace.recordPath.empty() || !gTrace.replayPath.empty()))
+    {
+        cout << "--record and --replay need the single-threaded simulation, drop --sim-thread" << endl;
+        return false;
+    }
+    if (gSoftRaster.enabled && (!gBench.enabled || gDynRes.enabled))
+    {
+        cout << "--soft-raster compares full resolution --bench frames, use it with --bench and without --dynres" << endl;
+        return false;
+    }
+    if (gSoftRaster.enabled && gLod.enabled)
+    {
+        cout << "--soft-raster draws the base meshes, use it without --lod" << endl;
+        return false;
+    }
+    gSimClock = FixedStepClock(gSim.rate);
+    gFrameLimiter = FrameLimiter(gFrameLoop.fpsLimit);
+    gFrameFences = FrameFences(gFrameLoop.maxFramesInFlight);
+    gResolution = ResolutionController(gDynRes);
+    if (gHiZ.enabled)
+        gGpuCull.enabled = true;    // the occlusion test runs in the GPU cull shader
+    UApplyBenchEnvironment(gBench);
+    gCopyOffsets = UBuildCopyOffsets(gBench.copies, COPY_SPACING);
+    UBuildStressScene();
+    UBuildSceneEntities();
+    gJobs.reset(new JobSystem(gJobOptions.threads));
+    gFrameArenas.resize(gJobs->getThreadCount());
+    gResources.setBudget(gResourceOptions.budgetMb * 1024 * 1024);
+
+    if (!gTrace.recordPath.empty()
+        && !gRecorder.open(gTrace.recordPath, UCaptureCameraState(gCamera, cameraSpeed, perspective)))
+        return false;
+    if (!gTrace.replayPath.empty() && !gReplayer.open(gTrace.replayPath))
+        return false;
+
     // GLFW: initialize and configure
     // ------------------------------
     glfwInit();
@@ -379,6 +836,11 @@ bool UInitialize(int argc, char* argv[], GLFWwindow** window)
     glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
 #endif
 
+    // Benchmark and batch runs render offscreen, the window only provides the context
+    const bool headless = gBench.enabled || gBatch.enabled;
+    if (headless)
+        glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+
     // GLFW: window creation
     // ---------------------
     * window = glfwCreateWindow(WINDOW_WIDTH, WINDOW_HEIGHT, WINDOW_TITLE, NULL, NULL);
@@ -389,14 +851,18 @@ bool UInitialize(int argc, char* argv[], GLFWwindow** window)
         return false;
     }
     glfwMakeContextCurrent(*window);
+    if (!headless)
+        UApplySwapInterval(gFrameLoop.swap);
     glfwSetFramebufferSizeCallback(*window, UResizeWindow);
+    glfwSetWindowRefreshCallback(*window, URefreshWindow);
     glfwSetCursorPosCallback(*window, UMousePositionCallback);
     glfwSetScrollCallback(*window, UMouseScrollCallback);
     glfwSetMouseButtonCallback(*window, UMouseButtonCallback);
     glfwSetKeyCallback(*window, key_callback);
 
     // tell GLFW to capture our mouse
-    glfwSetInputMode(*window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+    if (!headless)
+        glfwSetInputMode(*window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
 
     // GLEW: initialize
     // ----------------
@@ -412,6 +878,7 @@ bool UInitialize(int argc, char* argv[], GLFWwindow** window)
 
     // Displays GPU OpenGL version
     cout << "INFO: OpenGL Version: " << glGetString(GL_VERSION) << endl;
+    UInitGpuStorage(gGpuStorage);
 
     return true;
 }
@@ -425,256 +892,1714 @@ void UProcessInput(GLFWwindow* window)
     if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
         glfwSetWindowShouldClose(window, true);
 
-    float cameraOffset = cameraSpeed * gDeltaTime;
+    // Replays drive the camera from the trace instead of the keyboard
+    if (gReplayer.isOpen())
+    {
+        if (!UReplayFrame())
+            glfwSetWindowShouldClose(window, true);
+        gRedrawNeeded = true;
+        return;
+    }
+
+    uint8_t keyMask = USampleMovementKeys(window);
+
+    // The sim thread moves the camera itself; pick up its latest state
+    if (gSim.thread)
+    {
+        gSimKeyMask = keyMask;
+        gSimSnapshots.read(gViewSnapshot);
+        if (keyMask || !USameCameraState(gViewSnapshot.current, gViewState))
+            gRedrawNeeded = true;
+        return;
+    }
+
+    // Run the steps that fit into the elapsed time; the remainder carries over to the next frame
+    if (gSim.fixedStep)
+    {
+        const int steps = gSimClock.advance(gDeltaTime);
+        for (int step = 0; step < steps; ++step)
+            UStepSimulation(keyMask, (float)gSimClock.getStep());
+        if (keyMask || !USameCameraState(gSimState.current, gViewState))
+            gRedrawNeeded = true;
+        return;
+    }
+
+    UApplyMovementKeys(keyMask, gDeltaTime);
+    if (keyMask)
+        gRedrawNeeded = true;
 
+    if (gRecorder.isOpen())
+        gRecorder.recordFrame(gLastFrame, gDeltaTime, keyMask, UCaptureCameraState(gCamera, cameraSpeed, perspective));
+}
+
+
+// Reads the movement keys into an InputKeyBits mask
+uint8_t USampleMovementKeys(GLFWwindow* window)
+{
+    uint8_t keyMask = 0;
     if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS)
-        gCamera.ProcessKeyboard(FORWARD, cameraOffset);
+        keyMask |= INPUT_KEY_FORWARD;
     if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS)
-        gCamera.ProcessKeyboard(BACKWARD, cameraOffset);
+        keyMask |= INPUT_KEY_BACKWARD;
     if (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS)
-        gCamera.ProcessKeyboard(LEFT, cameraOffset);
+        keyMask |= INPUT_KEY_LEFT;
     if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS)
-        gCamera.ProcessKeyboard(RIGHT, cameraOffset);
+        keyMask |= INPUT_KEY_RIGHT;
     if (glfwGetKey(window, GLFW_KEY_Q) == GLFW_PRESS)
-        gCamera.Position = glm::vec3(gCamera.Position.x, gCamera.Position.y + 0.01f, gCamera.Position.z);
+        keyMask |= INPUT_KEY_UP;
     if (glfwGetKey(window, GLFW_KEY_E) == GLFW_PRESS)
+        keyMask |= INPUT_KEY_DOWN;
+    return keyMask;
+}
+
+
+// Moves the camera for the pressed keys over deltaTime seconds
+void UApplyMovementKeys(uint8_t keyMask, float deltaTime)
+{
+    float cameraOffset = cameraSpeed * deltaTime;
+
+    if (keyMask & INPUT_KEY_FORWARD)
+        gCamera.ProcessKeyboard(FORWARD, cameraOffset);
+    if (keyMask & INPUT_KEY_BACKWARD)
+        gCamera.ProcessKeyboard(BACKWARD, cameraOffset);
+    if (keyMask & INPUT_KEY_LEFT)
+        gCamera.ProcessKeyboard(LEFT, cameraOffset);
+    if (keyMask & INPUT_KEY_RIGHT)
+        gCamera.ProcessKeyboard(RIGHT, cameraOffset);
+    if (keyMask & INPUT_KEY_UP)
+        gCamera.Position = glm::vec3(gCamera.Position.x, gCamera.Position.y + 0.01f, gCamera.Position.z);
+    if (keyMask & INPUT_KEY_DOWN)
         gCamera.Position = glm::vec3(gCamera.Position.x, gCamera.Position.y - 0.01f, gCamera.Position.z);
 }
 
+
+// Applies the next frame of the input trace with its recorded delta time.
+// Returns false once the trace has been fully replayed.
+bool UReplayFrame()
+{
+    static vector<InputEvent> frameEvents;
+    InputEvent frame;
+
+    // The recording's starting camera, whatever this run started from (or a bench warmup left)
+    CameraState start;
+    if (gReplayer.atStart() && gReplayer.getStartState(start))
+        URestoreCameraState(start, gCamera, cameraSpeed, perspective);
+
+    if (!gReplayer.nextFrame(frameEvents, frame))
+    {
+        cout << "INFO: Replayed " << gReplayer.getFrameCount() << " frames, max camera divergence "
+            << gReplayer.getMaxDivergence() << endl;
+        return false;
+    }
+
+    // Events that arrived between the previous frame and this one
+    for (const InputEvent& event : frameEvents)
+    {
+        if (event.type == INPUT_EVENT_MOUSE_MOVE)
+            UApplyMouseMove(event.x, event.y);
+        else if (event.type == INPUT_EVENT_SCROLL)
+            UApplyMouseScroll(event.y);
+        else if (event.type == INPUT_EVENT_KEY)
+            UApplyKey(event.key, event.action);
+    }
+
+    gDeltaTime = frame.deltaTime;
+    UApplyMovementKeys(frame.keyMask, frame.deltaTime);
+
+    gReplayer.checkDivergence(frame.camera, UCaptureCameraState(gCamera, cameraSpeed, perspective));
+    return true;
+}
+
+
+// Advances the simulated camera by one fixed step, keeping the previous state for interpolation
+void UStepSimulation(uint8_t keyMask, float stepSeconds)
+{
+    gSimState.previous = gSimState.current;
+    UApplyMovementKeys(keyMask, stepSeconds);
+    gSimState.current = UCaptureCameraState(gCamera, cameraSpeed, perspective);
+    gSimState.time = USimulationTime();
+
+    // Each step is a trace frame, so a replay reproduces the same steps
+    if (gRecorder.isOpen())
+        gRecorder.recordFrame(gLastFrame, stepSeconds, keyMask, gSimState.current);
+}
+
+
+// One step on the sim thread: apply the queued events and held keys, then publish the result
+void UStepSimulationThread(double stepSeconds)
+{
+    InputEvent event;
+    while (gSimEvents.pop(event))
+    {
+        if (event.type == INPUT_EVENT_MOUSE_MOVE)
+            UApplyMouseMove(event.x, event.y);
+        else if (event.type == INPUT_EVENT_SCROLL)
+            UApplyMouseScroll(event.y);
+        else if (event.type == INPUT_EVENT_KEY)
+            UApplyKey(event.key, event.action);
+    }
+
+    UStepSimulation(gSimKeyMask, (float)stepSeconds);
+    gSimSnapshots.write(gSimState);
+
+    // Wakes an on-demand loop that is waiting for events
+    if (!USameCameraState(gSimState.previous, gSimState.current))
+        glfwPostEmptyEvent();
+}
+
+
+void UStartSimulation()
+{
+    gSimState.current = gSimState.previous = UCaptureCameraState(gCamera, cameraSpeed, perspective);
+    gSimState.time = USimulationTime();
+    gViewSnapshot = gSimState;
+    gViewState = gSimState.current;
+    gSimSnapshots.write(gSimState);
+
+    if (gSim.thread)
+        gSimThread.start(gSim.rate, UStepSimulationThread);
+}
+
+
+// Sets the camera URender draws: the simulated camera itself, or under a fixed timestep the
+// last two simulated states blended by how far the clock has run into the next step
+void UUpdateViewCamera()
+{
+    if (!gSim.fixedStep || gBench.enabled || gReplayer.isOpen())
+    {
+        gViewCamera = gCamera;
+        gViewPerspective = perspective;
+        return;
+    }
+
+    CameraState state;
+    if (gSim.thread)
+    {
+        const double alpha = (USimulationTime() - gViewSnapshot.time) * gSim.rate;
+        state = UInterpolateCameraState(gViewSnapshot.previous, gViewSnapshot.current, (float)min(alpha, 1.0));
+    }
+    else
+        state = UInterpolateCameraState(gSimState.previous, gSimState.current, gSimClock.getAlpha());
+
+    float speed;
+    URestoreCameraState(state, gViewCamera, speed, gViewPerspective);
+    gViewState = state;
+}
+
+
+// Collects the frame time and finished latencies, showing their averages in the title bar
+void UUpdateHud()
+{
+    gHud.addFrame(gDeltaTime);
+    double latencyMs;
+    while (gLatency.poll(latencyMs))
+        gHud.addLatency(latencyMs);
+
+    string text;
+    if (gHud.update(glfwGetTime(), text))
+    {
+        char vram[64];
+        snprintf(vram, sizeof(vram), ", VRAM %.1f MB", gResources.getTotalBytes() / (1024.0 * 1024.0));
+        glfwSetWindowTitle(gWindow, (string(WINDOW_TITLE) + " | " + text + vram).c_str());
+    }
+}
+
 //toggle perspective mode implemented as above func triggers every frams which caused camera to switch rapidly
 void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods) {
+    if (key == GLFW_KEY_F12 && action == GLFW_PRESS) {
+        gScreenshotRequested = true;
+        gRedrawNeeded = true;
+    }
+    if (gReplayer.isOpen())
+        return;
+    if (gRecorder.isOpen() && key == GLFW_KEY_P)
+        gRecorder.recordKey(key, action);
+    if (gSim.thread)
+    {
+        if (key == GLFW_KEY_P)
+        {
+            InputEvent event;
+            event.type = INPUT_EVENT_KEY;
+            event.key = key;
+            event.action = action;
+            gSimEvents.push(event);
+        }
+        return;
+    }
+    UApplyKey(key, action);
+}
+
+void UApplyKey(int key, int action) {
     if (key == GLFW_KEY_P && action == GLFW_PRESS) {
         perspective = !perspective;
+        gRedrawNeeded = true;
     }
 }
 
 // glfw: whenever the window size changed (by OS or user resize) this callback function executes
 void UResizeWindow(GLFWwindow* window, int width, int height)
 {
+    // Minimized windows report 0x0, keep the last aspect ratio instead
+    if (width > 0 && height > 0)
+    {
+        gFramebufferWidth = width;
+        gFramebufferHeight = height;
+    }
     glViewport(0, 0, width, height);
+    gRedrawNeeded = true;
+}
+
+
+// glfw: the window contents were damaged (e.g. uncovered) and must be drawn again
+void URefreshWindow(GLFWwindow* /*window*/)
+{
+    gRedrawNeeded = true;
+}
+
+
+// glfw: whenever the mouse moves, this callback is called
+// -------------------------------------------------------
+void UMousePositionCallback(GLFWwindow* window, double xpos, double ypos)
+{
+    if (gReplayer.isOpen())
+        return;
+    if (gRecorder.isOpen())
+        gRecorder.recordMouseMove(xpos, ypos);
+    if (gSim.thread)
+    {
+        InputEvent event;
+        event.type = INPUT_EVENT_MOUSE_MOVE;
+        event.x = xpos;
+        event.y = ypos;
+        gSimEvents.push(event);     // dropped if the sim thread is that far behind
+        return;
+    }
+    UApplyMouseMove(xpos, ypos);
+}
+
+void UApplyMouseMove(double xpos, double ypos)
+{
+    if (gFirstMouse)
+    {
+        gLastX = xpos;
+        gLastY = ypos;
+        gFirstMouse = false;
+    }
+
+    float xoffset = xpos - gLastX;
+    float yoffset = gLastY - ypos; // reversed since y-coordinates go from bottom to top
+
+    gLastX = xpos;
+    gLastY = ypos;
+
+    gCamera.ProcessMouseMovement(xoffset, yoffset);
+    if (xoffset != 0.0f || yoffset != 0.0f)
+        gRedrawNeeded = true;
+}
+
+
+// glfw: whenever the mouse scroll wheel scrolls, this callback is called
+// ----------------------------------------------------------------------
+void UMouseScrollCallback(GLFWwindow* window, double xoffset, double yoffset)
+{
+    if (gReplayer.isOpen())
+        return;
+    if (gRecorder.isOpen())
+        gRecorder.recordScroll(xoffset, yoffset);
+    if (gSim.thread)
+    {
+        InputEvent event;
+        event.type = INPUT_EVENT_SCROLL;
+        event.x = xoffset;
+        event.y = yoffset;
+        gSimEvents.push(event);
+        return;
+    }
+    UApplyMouseScroll(yoffset);
+}
+
+void UApplyMouseScroll(double yoffset)
+{
+    if (cameraSpeed < 0.1f) {
+        cameraSpeed = 0.1f;
+    }
+    else {
+        cameraSpeed += yoffset;                     //setting scroll to controll camera speed
+    }
+    //gCamera.ProcessMouseScroll(yoffset);          // commenting our scroll to zoom  
+}
+
+// glfw: handle mouse button events
+// --------------------------------
+void UMouseButtonCallback(GLFWwindow* window, int button, int action, int mods)
+{
+    switch (button)
+    {
+    case GLFW_MOUSE_BUTTON_LEFT:
+    {
+        if (action == GLFW_PRESS)
+            cout << "Left mouse button pressed" << endl;
+        else
+            cout << "Left mouse button released" << endl;
+    }
+    break;
+
+    case GLFW_MOUSE_BUTTON_MIDDLE:
+    {
+        if (action == GLFW_PRESS)
+            cout << "Middle mouse button pressed" << endl;
+        else
+            cout << "Middle mouse button released" << endl;
+    }
+    break;
+
+    case GLFW_MOUSE_BUTTON_RIGHT:
+    {
+        if (action == GLFW_PRESS)
+            cout << "Right mouse button pressed" << endl;
+        else
+            cout << "Right mouse button released" << endl;
+    }
+    break;
+
+    default:
+        cout << "Unhandled mouse button event" << endl;
+        break;
+    }
+}
+
+
+// Functioned called to render a frame
+void URender()
+{
+    ////// Lamp orbits around the origin
+    //const float angularVelocity = glm::radians(45.0f);
+
+    //    glm::vec4 newPosition = glm::rotate(angularVelocity * gDeltaTime, glm::vec3(1.0f, 2.0f, 0.0f)) * glm::vec4(gLightPosition, 1.0f);
+    //    gLightPosition.x = newPosition.x;
+    //    gLightPosition.y = newPosition.y;
+    //    gLightPosition.z = newPosition.z;
+    //
+    // Enable z-depth; state calls go through the cache, which skips the ones already in effect
+    GLStateCache& gl = UGLState();
+    gl.enable(GL_DEPTH_TEST);
+
+    // Clear the frame and z buffers
+    gl.clearColor(0.0f, 0.0f, 0.0f, 1.0f);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    gDrawCount = 0;
+    gTriangleCount = 0;
+    gFrameArenas.reset();   // last frame's draw list is no longer needed
+
+    // CUBE: draw cube
+    //----------------
+
+    // Model matrix: transformations are applied right-to-left order
+    glm::mat4 model = glm::translate(gPosition) * glm::scale(gScale);
+
+    // camera/view transformation
+    glm::mat4 view = gViewCamera.GetViewMatrix();
+
+    // Switches between perspective and ortho views
+    projection = USceneProjection(gViewCamera, gViewPerspective, gRenderWidth, gRenderHeight);
+
+    // Update, cull and sort the entities on the job threads; the generated instances are
+    // left to the GPU culler when it runs
+    gFramePrep.prepare(gEntities, projection * view, gGpuCuller.isCreated() ? ENTITY_LAYER_PROPS : ENTITY_LAYER_ALL,
+        gJobs.get(), gFrameArenas);
+
+    // Cull the stress scene on the GPU before any of it is drawn; the previous frame's
+    // depth pyramid is only trusted while the camera moves slowly
+    if (gGpuCuller.isCreated())
+    {
+        const bool occlusion = gHiZPyramid.isCreated() && gHiZPyramid.canTest(view, projection, gHiZ);
+        gGpuCuller.cull(projection * view, occlusion ? &gHiZPyramid : nullptr);
+    }
+
+    // Set the shader to be used
+    gl.useProgram(gProgramId);
+    USetSceneUniforms(gProgramId, view, projection, gViewCamera.Position);
+
+    // Retrieves and passes the model matrix to the Shader program
+    GLint modelLoc = gl.getUniformLocation(gProgramId, "model");
+    gl.uniformMatrix4(modelLoc, model);
+
+    // Activate the VBOs contained within the mesh's VAO (used by cube and lamp)
+    gl.bindVertexArray(gBaseMesh.vao);
+
+    // bind textures on corresponding texture units
+    gl.bindTexture(0, gTextureGranite.getId());
+    // Draws the triangles
+    glDrawArrays(GL_TRIANGLES, 0, gBaseMesh.nVertices);
+    gDrawCount++;
+    gTriangleCount += gBaseMesh.nVertices / 3;
+    // Book, ball, candle and cables of every prop set copy, and the generated instances unless
+    // they are submitted from the GPU-built draw list
+    const GLuint propVaos[SCENE_MESH_COUNT] = { gBookMesh.vao, gBallMesh.vao, gCandleMesh.vao, gTopperMesh.vao, gCableMesh.vao };
+    const LodView lodView = { gViewCamera.Position, projection[1][1] * gRenderHeight * 0.5f, gViewPerspective };
+    UDrawEntities(modelLoc, propVaos, gFramePrep.getDrawList(), gFramePrep.getDrawCount(), gLod.enabled ? &lodView : nullptr);
+    if (gGpuCuller.isCreated())
+    {
+        const GLuint textures[SCENE_MESH_COUNT] = { gTextureBook.getId(), gTextureBall.getId(), gTextureCandle.getId(), gTextureTopper.getId(), gTextureCable.getId() };
+        gl.useProgram(gGpuCullProgramId);
+        USetSceneUniforms(gGpuCullProgramId, view, projection, gViewCamera.Position);
+        gDrawCount += gGpuCuller.draw(textures);
+    }
+
+    ///////////////////////////////////////////////////////////////////////////////////////////////////////////
+    // LAMP: draw lamp
+    //----------------
+    UDrawLamp(gLampProgramId, gBaseMesh.vao, view, projection);
+
+    // Bindings are left in place: the cache knows them, and the next frame mostly reuses them
+
+    // Keep this frame's depth as the occluders for the next frame
+    if (gHiZPyramid.isCreated() && gActiveTarget)
+        gHiZPyramid.build(gActiveTarget->depthTexture, gRenderWidth, gRenderHeight, view, projection);
+}
+
+
+// Projection of the scene camera: perspective, or the fixed ortho view
+glm::mat4 USceneProjection(const Camera& camera, bool perspectiveView, int width, int height)
+{
+    if (perspectiveView)
+        return glm::perspective(glm::radians(camera.Zoom), (GLfloat)width / (GLfloat)height, 0.1f, gFarPlane);
+    return glm::ortho(-10.0f, 10.0f, -10.0f, 10.0f, 0.1f, 100.0f);
+}
+
+
+// Draws the smaller cube used as a visual cue for the light source
+void UDrawLamp(GLuint programId, GLuint vao, const glm::mat4& view, const glm::mat4& projection)
+{
+    GLStateCache& gl = UGLState();
+    gl.useProgram(programId);
+
+    //Transform the smaller cube used as a visual que for the light source
+    glm::mat4 model = glm::translate(gLightPosition) * glm::scale(gLightScale);
+    gl.bindVertexArray(vao);
+
+    // Reference matrix uniforms from the Lamp Shader program
+    GLint modelLoc = gl.getUniformLocation(programId, "model");
+    GLint viewLoc = gl.getUniformLocation(programId, "view");
+    GLint projLoc = gl.getUniformLocation(programId, "projection");
+
+    // Pass matrix data to the Lamp Shader program's matrix uniforms
+    gl.uniformMatrix4(modelLoc, model);
+    gl.uniformMatrix4(viewLoc, view);
+    gl.uniformMatrix4(projLoc, projection);
+
+    glDrawArrays(GL_TRIANGLES, 0, gBaseMesh.nVertices);
+    gDrawCount++;
+    gTriangleCount += gBaseMesh.nVertices / 3;
+}
+
+
+// Passes the camera, light and texture scale uniforms shared by the scene shaders
+void USetSceneUniforms(GLuint programId, const glm::mat4& view, const glm::mat4& projection, const glm::vec3& cameraPosition)
+{
+    GLStateCache& gl = UGLState();
+    GLint viewLoc = gl.getUniformLocation(programId, "view");
+    GLint projLoc = gl.getUniformLocation(programId, "projection");
+
+    gl.uniformMatrix4(viewLoc, view);
+    gl.uniformMatrix4(projLoc, projection);
+
+    // Reference matrix uniforms from the Cube Shader program for the cub color, light color, light position, and camera position
+    GLint objectColorLoc = gl.getUniformLocation(programId, "objectColor");
+    GLint lightColorLoc = gl.getUniformLocation(programId, "lightColor");
+    GLint lightPositionLoc = gl.getUniformLocation(programId, "lightPos");
+    GLint ambientColorLoc = gl.getUniformLocation(programId, "ambientColor");
+    GLint ambientPositionLoc = gl.getUniformLocation(programId, "ambientPos");
+    GLint viewPositionLoc = gl.getUniformLocation(programId, "viewPosition");
+
+
+    // Pass color, light, and camera data to the Cube Shader program's corresponding uniforms;
+    // unchanged values (most of them, most frames) are not uploaded again
+    gl.uniform3f(objectColorLoc, gObjectColor);
+    gl.uniform3f(lightColorLoc, gLightColor);
+    gl.uniform3f(lightPositionLoc, gLightPosition);
+    gl.uniform3f(ambientColorLoc, gAmbientColor);
+    gl.uniform3f(ambientPositionLoc, gAmbientPosition);
+    gl.uniform3f(viewPositionLoc, cameraPosition);
+
+    GLint UVScaleLoc = gl.getUniformLocation(programId, "uvScale");
+    gl.uniform2f(UVScaleLoc, gUVScale);
+}
+
+
+// Transforms of the props placed on the granite base, moved by offset, in PROP_DRAW_MESHES order
+void UPropTransforms(const glm::vec3& offset, EntityTransform transforms[PROP_DRAW_COUNT])
+{
+    const glm::quat upright = glm::angleAxis(glm::radians(90.0f), glm::vec3(1.0f, 0.0f, 0.0f));
+
+    transforms[0].position = offset + bookPos;
+    transforms[0].scale = gScale;
+    transforms[1].position = offset + ballPos;
+    transforms[1].scale = ballscale;
+    transforms[2].position = offset + candlePos;
+    transforms[2].scale = candleScale;
+    transforms[2].rotation = upright;
+    transforms[3].position = offset + topperPos;
+    transforms[3].scale = candleScale;
+    transforms[3].rotation = upright;
+    transforms[4].position = offset + glm::vec3(-3.7f, -0.2f, 1.3f);
+    transforms[4].scale = glm::vec3(0.85f, 0.85f, 0.85f);
+    transforms[4].rotation = glm::angleAxis(glm::radians(90.0f), glm::normalize(glm::vec3(1.0f, 0.05f, 0.6f)));
+    transforms[5].position = offset + glm::vec3(-3.7f, -0.3f, 1.3f);
+    transforms[5].scale = glm::vec3(0.85f, 0.87f, 0.85f);
+    transforms[5].rotation = glm::angleAxis(glm::radians(90.0f), glm::normalize(glm::vec3(1.0f, 0.06f, 0.3f)));
+    transforms[6].position = offset + glm::vec3(-3.7f, -0.4f, 1.5f);
+    transforms[6].scale = glm::vec3(0.85f, 0.67f, 0.85f);
+    transforms[6].rotation = glm::angleAxis(glm::radians(90.0f), glm::normalize(glm::vec3(1.0f, 0.07f, 0.7f)));
+}
+
+
+// Fills the entity store with a prop set per copy offset followed by the stress instances.
+// The material of a prop is its mesh's texture.
+void UBuildSceneEntities()
+{
+    gEntities.clear();
+    gEntities.reserve(gCopyOffsets.size() * PROP_DRAW_COUNT + gStressInstances.size());
+
+    EntityTransform transforms[PROP_DRAW_COUNT];
+    for (const glm::vec3& offset : gCopyOffsets)
+    {
+        UPropTransforms(offset, transforms);
+        for (int i = 0; i < PROP_DRAW_COUNT; ++i)
+            gEntities.create(transforms[i], PROP_DRAW_MESHES[i], PROP_DRAW_MESHES[i], ENTITY_LAYER_PROPS);
+    }
+
+    for (const SceneInstance& instance : gStressInstances)
+        gEntities.create(UInstanceTransform(instance), instance.mesh, instance.mesh, ENTITY_LAYER_STRESS);
+}
+
+
+// Gives the entity store the meshes' bounding spheres, which needs their vertex buffers
+void UInitSceneBounds()
+{
+    const GpuCullMesh meshes[SCENE_MESH_COUNT] = {
+        { gBookMesh.vbo, gBookMesh.nVertices, gBookMesh.bounds, gBookMesh.boundsKnown },
+        { gBallMesh.vbo, gBallMesh.nVertices, gBallMesh.bounds, gBallMesh.boundsKnown },
+        { gCandleMesh.vbo, gCandleMesh.nVertices, gCandleMesh.bounds, gCandleMesh.boundsKnown },
+        { gTopperMesh.vbo, gTopperMesh.nVertices, gTopperMesh.bounds, gTopperMesh.boundsKnown },
+        { gCableMesh.vbo, gCableMesh.nVertices, gCableMesh.bounds, gCableMesh.boundsKnown },
+    };
+
+    glm::vec4 bounds[SCENE_MESH_COUNT];
+    UComputeMeshBounds(meshes, bounds);
+    for (int mesh = 0; mesh < SCENE_MESH_COUNT; ++mesh)
+        gEntities.setMeshBounds((uint8_t)mesh, bounds[mesh]);
+    gEntities.updateTransforms();
+}
+
+
+// Draws the listed entities in order; the sort keeps meshes and materials together, so the
+// cache skips most VAO and texture binds. With a lodView, each is drawn with the coarsest LOD
+// of its mesh whose error stays within --lod-pixels on screen.
+void UDrawEntities(GLint modelLoc, const GLuint vaos[SCENE_MESH_COUNT], const uint32_t* drawList, size_t count, const LodView* lodView)
+{
+    const GLMesh* meshes[SCENE_MESH_COUNT] = { &gBookMesh, &gBallMesh, &gCandleMesh, &gTopperMesh, &gCableMesh };
+    const GLuint textures[SCENE_MESH_COUNT] = { gTextureBook.getId(), gTextureBall.getId(), gTextureCandle.getId(), gTextureTopper.getId(), gTextureCable.getId() };
+
+    const uint8_t* kinds = gEntities.meshes();
+    const uint16_t* materials = gEntities.materials();
+    const glm::mat4* models = gEntities.models();
+    const glm::vec4* bounds = gEntities.bounds();
+
+    GLStateCache& gl = UGLState();
+    for (size_t d = 0; d < count; ++d)
+    {
+        const uint32_t i = drawList[d];
+        const int kind = kinds[i];
+        const GLMesh& mesh = *meshes[kind];
+        GLuint vao = vaos[kind];
+        GLuint vertexCount = mesh.nVertices;
+        if (lodView && !mesh.lods.empty())
+        {
+            // Under perspective, the nearest point of the bounds sets the scale
+            float pixelsPerUnit = lodView->pixelsPerUnit;
+            if (lodView->perspective)
+                pixelsPerUnit /= max(glm::length(glm::vec3(bounds[i]) - lodView->eye) - bounds[i].w, 0.1f);
+            const int lod = USelectLod(mesh.lodErrors.data(), (int)mesh.lodErrors.size(), bounds[i].w, pixelsPerUnit, gLod.maxPixels);
+            if (lod > 0)
+            {
+                vao = mesh.lods[lod - 1].vao;
+                vertexCount = mesh.lods[lod - 1].nVertices;
+            }
+        }
+        gl.bindVertexArray(vao);
+        gl.bindTexture(0, textures[materials[i]]);
+        gl.uniformMatrix4(modelLoc, models[i]);
+        glDrawArrays(GL_TRIANGLES, 0, vertexCount);
+        gDrawCount++;
+        gTriangleCount += vertexCount / 3;
+    }
+}
+
+
+// Generates the stress scene requested on the command line
+void UBuildStressScene()
+{
+    UGenerateScene(gSceneGen, gStressInstances);
+
+    float extent = 0.0f;
+    for (size_t i = 0; i < gStressInstances.size(); ++i)
+    {
+        const glm::vec3& position = gStressInstances[i].position;
+        extent = max(extent, max(fabs(position.x), fabs(position.z)));
+    }
+
+    // Keep the whole field inside the far plane (diagonal of the square plus some margin)
+    gFarPlane = max(100.0f, extent * 1.5f + 20.0f);
+
+    if (!gStressInstances.empty())
+        cout << "INFO: Generated " << gStressInstances.size() << " stress scene instances" << endl;
+}
+
+
+// Builds the GPU culling buffers and shader for the stress scene, falling back to
+// per-instance draws when the driver lacks compute shaders
+void UCreateGpuCulling()
+{
+    if (gStressInstances.empty())
+    {
+        cout << "--gpu-cull has no effect without --instances" << endl;
+        return;
+    }
+
+    const GpuCullMesh meshes[SCENE_MESH_COUNT] = {
+        { gBookMesh.vbo, gBookMesh.nVertices, gBookMesh.bounds, gBookMesh.boundsKnown },
+        { gBallMesh.vbo, gBallMesh.nVertices, gBallMesh.bounds, gBallMesh.boundsKnown },
+        { gCandleMesh.vbo, gCandleMesh.nVertices, gCandleMesh.bounds, gCandleMesh.boundsKnown },
+        { gTopperMesh.vbo, gTopperMesh.nVertices, gTopperMesh.bounds, gTopperMesh.boundsKnown },
+        { gCableMesh.vbo, gCableMesh.nVertices, gCableMesh.bounds, gCableMesh.boundsKnown },
+    };
+
+    // Stress entities are never removed, so they are still in generation order
+    vector<glm::mat4> models;
+    models.reserve(gStressInstances.size());
+    for (size_t i = 0; i < gEntities.size(); ++i)
+    {
+        if (gEntities.layers()[i] & ENTITY_LAYER_STRESS)
+            models.push_back(gEntities.models()[i]);
+    }
+
+    if (!UCreateShaderProgram(gpuCullVertexShaderSource, fragmentShaderSource, gGpuCullProgramId)
+        || !gGpuCuller.create(meshes, gStressInstances, models))
+    {
+        cout << "GPU culling unavailable, drawing instances individually" << endl;
+        gGpuCuller.destroy();
+        return;
+    }
+
+    UGLState().uniform1i(UGLState().getUniformLocation(gGpuCullProgramId, "uTexture"), 0);
+
+    if (gHiZ.enabled && !gHiZPyramid.create())
+        cout << "Hi-Z occlusion culling unavailable, using frustum culling only" << endl;
+}
+
+
+// Renders one frame into the output framebuffer (the window or the bench target).
+// Hi-Z and dynamic resolution draw the scene offscreen first and present it afterwards.
+void URenderFrame()
+{
+    UUpdateViewCamera();
+
+    const bool offscreen = gDynRes.enabled || (gHiZPyramid.isCreated() && !gBench.enabled);
+    if (!offscreen || !UBindSceneTarget())
+    {
+        gRenderWidth = gFramebufferWidth;
+        gRenderHeight = gFramebufferHeight;
+        URender();
+        return;
+    }
+
+    if (gDynRes.enabled)
+        gFrameTimer.begin();
+    URender();
+    if (gDynRes.enabled)
+        gFrameTimer.end();
+    UPresentSceneTarget();
+
+    // Finished GPU times drive the scale; a new scale applies from the next frame
+    double frameMs;
+    while (gDynRes.enabled && gFrameTimer.poll(frameMs))
+    {
+        if (gResolution.addSample(frameMs))
+            gRedrawNeeded = true;
+    }
+}
+
+
+// Binds the offscreen scene target, (re)creating it to fit the output at the largest
+// render scale, and sets the viewport to the current render size
+bool UBindSceneTarget()
+{
+    const float maxScale = gDynRes.enabled ? gDynRes.maxScale : 1.0f;
+    const int width = max(1, (int)(gFramebufferWidth * maxScale + 0.5f));
+    const int height = max(1, (int)(gFramebufferHeight * maxScale + 0.5f));
+    if (gSceneTarget.width != width || gSceneTarget.height != height)
+    {
+        if (gSceneTarget.fbo)
+            UDestroyRenderTarget(gSceneTarget);
+        if (!UCreateRenderTarget(gSceneTarget, width, height))
+        {
+            cout << "Offscreen scene target unavailable, disabling Hi-Z and dynamic resolution" << endl;
+            gHiZPyramid.destroy();
+            gDynRes.enabled = false;
+            gActiveTarget = gBench.enabled ? &gBenchTarget : nullptr;
+            UBindOutputFramebuffer();
+            return false;
+        }
+    }
+
+    gRenderWidth = gDynRes.enabled ? min(width, gResolution.scaledSize(gFramebufferWidth)) : width;
+    gRenderHeight = gDynRes.enabled ? min(height, gResolution.scaledSize(gFramebufferHeight)) : height;
+    glBindFramebuffer(GL_FRAMEBUFFER, gSceneTarget.fbo);
+    glViewport(0, 0, gRenderWidth, gRenderHeight);
+    gActiveTarget = &gSceneTarget;
+    return true;
+}
+
+
+// Copies the offscreen scene to the output: upscaled under dynamic resolution, else 1:1
+void UPresentSceneTarget()
+{
+    if (!gDynRes.enabled)
+    {
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, gSceneTarget.fbo);
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, gBench.enabled ? gBenchTarget.fbo : 0);
+        glBlitFramebuffer(0, 0, gRenderWidth, gRenderHeight, 0, 0, gFramebufferWidth, gFramebufferHeight,
+            GL_COLOR_BUFFER_BIT, GL_NEAREST);
+        UBindOutputFramebuffer();
+        return;
+    }
+
+    UBindOutputFramebuffer();
+    GLStateCache& gl = UGLState();
+    gl.disable(GL_DEPTH_TEST);
+
+    gl.useProgram(gUpscaleProgramId);
+    gl.uniform2f(gl.getUniformLocation(gUpscaleProgramId, "renderScale"),
+        glm::vec2((float)gRenderWidth / gSceneTarget.width, (float)gRenderHeight / gSceneTarget.height));
+    gl.uniform2f(gl.getUniformLocation(gUpscaleProgramId, "texelSize"), glm::vec2(1.0f / gSceneTarget.width, 1.0f / gSceneTarget.height));
+    gl.uniform1f(gl.getUniformLocation(gUpscaleProgramId, "sharpness"), gDynRes.filter == UPSCALE_SHARPEN ? 0.25f : 0.0f);
+
+    gl.bindTexture(0, gSceneTarget.colorTexture);
+    gl.bindVertexArray(gUpscaleVao);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+}
+
+
+// Binds the framebuffer frames are presented in, covering all of it
+void UBindOutputFramebuffer()
+{
+    glBindFramebuffer(GL_FRAMEBUFFER, gBench.enabled ? gBenchTarget.fbo : 0);
+    glViewport(0, 0, gFramebufferWidth, gFramebufferHeight);
+}
+
+
+// Creates the upscale shader and timers used by dynamic resolution
+bool UCreateUpscaler()
+{
+    if (!UCreateShaderProgram(upscaleVertexShaderSource, upscaleFragmentShaderSource, gUpscaleProgramId))
+        return false;
+    UGLState().uniform1i(UGLState().getUniformLocation(gUpscaleProgramId, "sceneTexture"), 0);
+
+    glGenVertexArrays(1, &gUpscaleVao);
+    gFrameTimer.create();
+    return true;
+}
+
+
+// Renders the scene offscreen along the scripted camera path and prints a JSON report
+int URunBenchmark()
+{
+    if (!UCreateRenderTarget(gBenchTarget, gBench.width, gBench.height))
+        return EXIT_FAILURE;
+
+    UBindRenderTarget(gBenchTarget);
+    gActiveTarget = &gBenchTarget;
+    gFramebufferWidth = gBench.width;
+    gFramebufferHeight = gBench.height;
+
+    GLuint timerQuery;
+    glGenQueries(1, &timerQuery);
+
+    ofstream file;
+    if (!gBench.outputPath.empty())
+    {
+        file.open(gBench.outputPath);
+        if (!file)
+        {
+            cout << "Failed to open benchmark output " << gBench.outputPath << endl;
+            glDeleteQueries(1, &timerQuery);
+            UDestroyRenderTarget(gBenchTarget);
+            return EXIT_FAILURE;
+        }
+    }
+    ostream& out = file.is_open() ? file : cout;
+    const char* renderer = (const char*)glGetString(GL_RENDERER);
+
+    int exitCode = EXIT_SUCCESS;
+    if (gBench.suiteDir.empty())
+    {
+        // Single run, optionally checked against an explicit baseline and golden image
+        BenchResult result;
+        result.variant = UBenchVariantName();
+        UMeasureBenchRun(result, timerQuery);
+        UMeasureFrameStages(result);
+        if (gSoftRaster.enabled && !UMeasureSoftRaster(result))
+            exitCode = EXIT_FAILURE;
+
+        BenchCheck check;
+        const bool checking = !gBench.baselinePath.empty() || !gBench.goldenPath.empty();
+        if (checking && !UCheckBenchResult(gBench.baselinePath, gBench.goldenPath, result, check))
+            exitCode = EXIT_FAILURE;
+
+        UWriteBenchReport(out, gBench, renderer, result, checking ? &check : nullptr);
+    }
+    else
+    {
+        // Regression suite: the base scene plus scaled-up copies of the props
+        const int variants[] = { 1, 10, 100, 1000 };
+
+        out << "[" << endl;
+        for (size_t i = 0; i < sizeof(variants) / sizeof(variants[0]); ++i)
+        {
+            gBench.copies = variants[i];
+            gCopyOffsets = UBuildCopyOffsets(gBench.copies, COPY_SPACING);
+            UBuildSceneEntities();
+            gEntities.updateTransforms();
+
+            BenchResult result;
+            result.variant = UBenchVariantName();
+            UMeasureBenchRun(result, timerQuery);
+            UMeasureFrameStages(result);
+            if (gSoftRaster.enabled && !UMeasureSoftRaster(result))
+                exitCode = EXIT_FAILURE;
+
+            const string prefix = gBench.suiteDir + "/" + result.variant;
+            BenchCheck check;
+            if (!UCheckBenchResult(prefix + ".baseline", prefix + ".ppm", result, check))
+                exitCode = EXIT_FAILURE;
+
+            if (i > 0)
+                out << "," << endl;
+            UWriteBenchReport(out, gBench, renderer, result, &check);
+        }
+        out << "]" << endl;
+    }
+
+    glDeleteQueries(1, &timerQuery);
+    UDestroyRenderTarget(gBenchTarget);
+    return exitCode;
+}
+
+
+// Names a benchmark run after its scene size, e.g. "copies10" or "copies1_instances100000"
+string UBenchVariantName()
+{
+    string name = "copies" + to_string(gBench.copies);
+    if (!gStressInstances.empty())
+        name += "_instances" + to_string(gStressInstances.size());
+    return name;
+}
+
+
+// Renders warmup and measured frames, collecting CPU and GPU frame times
+void UMeasureBenchRun(BenchResult& result, GLuint timerQuery)
+{
+    // A replayed trace replaces the scripted orbit and sets the frame count (single runs only)
+    const bool replaying = gReplayer.isOpen() && gBench.suiteDir.empty();
+    if (replaying)
+        gBench.frames = (int)gReplayer.getFrameCount();
+
+    result.cpuMs.reserve(gBench.frames);
+    result.gpuMs.reserve(gBench.frames);
+    result.heapAllocations.reserve(gBench.frames);
+    result.glIssued.reserve(gBench.frames);
+    result.glElided.reserve(gBench.frames);
+
+    const int totalFrames = gBench.warmup + gBench.frames;
+    for (int frame = 0; frame < totalFrames; ++frame)
+    {
+        const bool measured = frame >= gBench.warmup;
+        if (!replaying)
+            UBenchCameraPose(measured ? frame - gBench.warmup : 0, gBench.frames, gCamera);
+        else if (measured)
+            UReplayFrame();
+
+        auto start = chrono::steady_clock::now();
+        const unsigned long long allocationsBefore = UHeapAllocationCount();
+        UGLState().resetCounters();
+        gLatency.markInput();
+        glBeginQuery(GL_TIME_ELAPSED, timerQuery);
+        URenderFrame();
+        glEndQuery(GL_TIME_ELAPSED);
+        const unsigned long long frameAllocations = UHeapAllocationCount() - allocationsBefore;
+        const unsigned long long glIssued = UGLState().getIssued();
+        const unsigned long long glElided = UGLState().getElided();
+        gLatency.markPresented();
+        glFinish(); // include the GPU (or llvmpipe) work in the frame time
+        auto end = chrono::steady_clock::now();
+        double latencyMs = 0.0;
+        gLatency.poll(latencyMs);   // available after glFinish
+
+        if (measured)
+        {
+            GLuint64 gpuNs = 0;
+            glGetQueryObjectui64v(timerQuery, GL_QUERY_RESULT, &gpuNs); // already available after glFinish
+            result.cpuMs.push_back(chrono::duration<double, milli>(end - start).count());
+            result.gpuMs.push_back(gpuNs / 1.0e6);
+            result.latencyMs.push_back(latencyMs);
+            result.heapAllocations.push_back((double)frameAllocations);
+            result.glIssued.push_back((double)glIssued);
+            result.glElided.push_back((double)glElided);
+            if (gDynRes.enabled)
+                result.resolutionScale.push_back(gResolution.getScale());
+
+            // Culling counters, read after the frame was timed
+            if (gGpuCuller.isCreated())
+            {
+                GpuCullStats stats;
+                gGpuCuller.readStats(stats);
+                result.occludedPerFrame.push_back(stats.occluded);
+                if (stats.occlusionTested)
+                    result.occlusionFrames++;
+            }
+        }
+    }
+
+    if (replaying)
+        cout << "INFO: Replayed " << gReplayer.getFrameCount() << " frames, max camera divergence "
+            << gReplayer.getMaxDivergence() << endl;
+
+    result.drawsPerFrame = gDrawCount;
+    result.trianglesPerFrame = gTriangleCount;
+    result.instances = (unsigned int)gStressInstances.size();
+    result.instancesVisible = result.instances;
+
+    // The GPU-built draw list is only known on the GPU: count what survived the last frame
+    if (gGpuCuller.isCreated())
+    {
+        GpuCullStats stats;
+        gGpuCuller.readStats(stats);
+        result.culling = gHiZPyramid.isCreated() ? "gpu+hiz" : "gpu";
+        result.instancesVisible = stats.visibleTotal;
+        for (int mesh = 0; mesh < SCENE_MESH_COUNT; ++mesh)
+            result.trianglesPerFrame += stats.visible[mesh] * (gGpuCuller.getMeshVertexCount(mesh) / 3);
+    }
+    result.residentMb = UGetResidentMemoryBytes() / (1024.0 * 1024.0);
+    result.arenaThreads = gFrameArenas.getCount();
+    result.arenaHighWaterBytes = gFrameArenas.getHighWater();
+    result.arenaCapacityBytes = gFrameArenas.getCapacity();
+    result.textures = gResources.getCount(RESOURCE_TEXTURE);
+    result.meshes = gResources.getCount(RESOURCE_MESH);
+    result.textureBytes = gResources.getBytes(RESOURCE_TEXTURE);
+    result.meshBytes = gResources.getBytes(RESOURCE_MESH);
+    result.resourcePeakBytes = gResources.getPeakBytes();
+    result.resourceBudgetBytes = gResources.getBudget();
+    result.resourceDedupHits = gResources.getDedupHits();
+}
+
+
+// Compares (or with --update-baselines, stores) the metrics and a reference frame.
+// Empty paths skip that check. Returns false when the run regressed.
+bool UCheckBenchResult(const string& baselinePath, const string& goldenPath, const BenchResult& result, BenchCheck& check)
+{
+    if (!goldenPath.empty())
+    {
+        // The golden frame always uses the first pose of the orbit so it does not depend on --frames
+        UBenchCameraPose(0, gBench.frames, gCamera);
+        URenderFrame();
+
+        vector<unsigned char> pixels((size_t)gBenchTarget.width * gBenchTarget.height * 4);
+        UReadRenderTarget(gBenchTarget, pixels.data());
+        glBindFramebuffer(GL_FRAMEBUFFER, gBenchTarget.fbo);
+
+        if (gBench.updateBaselines)
+        {
+            if (!UWriteGoldenImage(goldenPath, pixels, gBenchTarget.width, gBenchTarget.height))
+            {
+                check.passed = false;
+                check.failures.push_back("could not write golden image " + goldenPath);
+            }
+        }
+        else
+            UCompareGoldenImage(goldenPath, pixels, gBenchTarget.width, gBenchTarget.height, check);
+    }
+
+    if (!baselinePath.empty())
+    {
+        if (gBench.updateBaselines)
+        {
+            if (!UWriteBaseline(baselinePath, result))
+            {
+                check.passed = false;
+                check.failures.push_back("could not write baseline " + baselinePath);
+            }
+        }
+        else
+            UCompareBaseline(baselinePath, result, gBench.tolerance, check);
+    }
+
+    return check.passed;
+}
+
+
+// Times the frame preparation stages on the first camera pose with 1 to 16 job threads.
+// Every entity is marked changed first, so the transform stage does a full update.
+void UMeasureFrameStages(BenchResult& result)
+{
+    Camera camera(glm::vec3(0.0f));
+    UBenchCameraPose(0, gBench.frames, camera);
+    const glm::mat4 viewProjection = USceneProjection(camera, true, gBench.width, gBench.height) * camera.GetViewMatrix();
+
+    const int threadCounts[] = { 1, 2, 4, 8, 16 };
+    const int repeats = 10;
+    result.frameStages.clear();
+    for (int threads : threadCounts)
+    {
+        JobSystem jobs(threads);
+        FrameArenas arenas(threads);
+        FramePrep prep;
+        vector<double> transformMs, cullMs, sortMs;
+        for (int i = 0; i <= repeats; ++i)
+        {
+            gEntities.invalidateTransforms();
+            arenas.reset();
+            FramePrepTimings timings;
+            prep.prepare(gEntities, viewProjection, ENTITY_LAYER_ALL, &jobs, arenas, &timings);
+            if (i == 0)
+                continue;   // warmup: first touch of the buffers and the new threads
+            transformMs.push_back(timings.transformMs);
+            cullMs.push_back(timings.cullMs);
+            sortMs.push_back(timings.sortMs);
+        }
+
+        FrameStageTiming timing;
+        timing.threads = threads;
+        timing.transformMs = UComputeBenchStats(transformMs).p50;
+        timing.cullMs = UComputeBenchStats(cullMs).p50;
+        timing.sortMs = UComputeBenchStats(sortMs).p50;
+        result.frameStages.push_back(timing);
+        result.frameStageVisible = (unsigned int)prep.getDrawCount();
+    }
+    result.frameStageEntities = (unsigned int)gEntities.size();
 }
 
 
-// glfw: whenever the mouse moves, this callback is called
-// -------------------------------------------------------
-void UMousePositionCallback(GLFWwindow* window, double xpos, double ypos)
+// Times the software rasterizer on the benchmark's camera path, then compares its first
+// frame with GL's. Returns false when the scene can't be read back or the images differ.
+bool UMeasureSoftRaster(BenchResult& result)
 {
-    if (gFirstMouse)
+    // CPU copies of the vertex buffers and textures URender draws
+    const GLMesh* glMeshes[SCENE_MESH_COUNT] = { &gBookMesh, &gBallMesh, &gCandleMesh, &gTopperMesh, &gCableMesh };
+    const GLuint glTextures[SCENE_MESH_COUNT] = { gTextureBook.getId(), gTextureBall.getId(), gTextureCandle.getId(), gTextureTopper.getId(), gTextureCable.getId() };
+    SoftMesh baseMesh, meshes[SCENE_MESH_COUNT];
+    SoftTexture granite, textures[SCENE_MESH_COUNT];
+    bool loaded = USoftMeshFromBuffer(gBaseMesh.vbo, gBaseMesh.nVertices, baseMesh)
+        && USoftTextureFromGL(gTextureGranite.getId(), granite);
+    for (int i = 0; i < SCENE_MESH_COUNT && loaded; ++i)
+        loaded = USoftMeshFromBuffer(glMeshes[i]->vbo, glMeshes[i]->nVertices, meshes[i])
+            && USoftTextureFromGL(glTextures[i], textures[i]);
+    if (!loaded)
     {
-        gLastX = xpos;
-        gLastY = ypos;
-        gFirstMouse = false;
+        cout << "Failed to read the scene back for the software rasterizer" << endl;
+        return false;
     }
 
-    float xoffset = xpos - gLastX;
-    float yoffset = gLastY - ypos; // reversed since y-coordinates go from bottom to top
+    // URender's draws, in its order: base, entities, lamp
+    vector<SoftDraw> draws;
+    SoftDraw draw;
+    draw.mesh = &baseMesh;
+    draw.texture = &granite;
+    draw.model = glm::translate(gPosition) * glm::scale(gScale);
+    draws.push_back(draw);
 
-    gLastX = xpos;
-    gLastY = ypos;
+    for (size_t i = 0; i < gEntities.size(); ++i)
+    {
+        draw.mesh = &meshes[gEntities.meshes()[i]];
+        draw.texture = &textures[gEntities.materials()[i]];
+        draw.model = gEntities.models()[i];
+        draws.push_back(draw);
+    }
+    draw.mesh = &baseMesh;
+    draw.texture = nullptr;
+    draw.model = glm::translate(gLightPosition) * glm::scale(gLightScale);
+    draws.push_back(draw);
+
+    SoftLighting lighting;
+    lighting.lightColor = gLightColor;
+    lighting.lightPosition = gLightPosition;
+    lighting.ambientColor = gAmbientColor;
+    lighting.uvScale = gUVScale;
+
+    SoftRasterizer rasterizer(gSoftRaster.threads, gSoftRaster.tileSize);
+    result.softThreads = rasterizer.getThreadCount();
+    result.softMs.reserve(gBench.frames);
+
+    // Same warmup and orbit as the GL run
+    const int totalFrames = gBench.warmup + gBench.frames;
+    for (int frame = 0; frame < totalFrames; ++frame)
+    {
+        const bool measured = frame >= gBench.warmup;
+        UBenchCameraPose(measured ? frame - gBench.warmup : 0, gBench.frames, gCamera);
+        lighting.viewPosition = gCamera.Position;
 
-    gCamera.ProcessMouseMovement(xoffset, yoffset);
+        auto start = chrono::steady_clock::now();
+        rasterizer.render(draws, gCamera.GetViewMatrix(), USceneProjection(gCamera, perspective, gBench.width, gBench.height),
+            lighting, gBench.width, gBench.height);
+        auto end = chrono::steady_clock::now();
+
+        if (measured)
+            result.softMs.push_back(chrono::duration<double, milli>(end - start).count());
+    }
+
+    // The first pose of the orbit in both renderers
+    UBenchCameraPose(0, gBench.frames, gCamera);
+    URenderFrame();
+    vector<unsigned char> pixels((size_t)gBenchTarget.width * gBenchTarget.height * 4);
+    UReadRenderTarget(gBenchTarget, pixels.data());
+    glBindFramebuffer(GL_FRAMEBUFFER, gBenchTarget.fbo);
+
+    lighting.viewPosition = gCamera.Position;
+    rasterizer.render(draws, gCamera.GetViewMatrix(), USceneProjection(gCamera, perspective, gBench.width, gBench.height),
+        lighting, gBench.width, gBench.height);
+    result.softMatches = UCompareFrames(pixels, rasterizer.getPixels(), gBench.width, gBench.height,
+        result.softMismatch, result.softPsnr);
+    if (!result.softMatches)
+        cout << "Software rasterizer differs from GL in " << result.softMismatch * 100.0 << "% of pixels" << endl;
+
+    return result.softMatches;
 }
 
 
-// glfw: whenever the mouse scroll wheel scrolls, this callback is called
-// ----------------------------------------------------------------------
-void UMouseScrollCallback(GLFWwindow* window, double xoffset, double yoffset)
+// Renders the --batch / --batch-socket jobs on worker threads and prints a JSON report
+int URunBatch()
 {
-    if (cameraSpeed < 0.1f) {
-        cameraSpeed = 0.1f;
+    const int hardwareThreads = (int)thread::hardware_concurrency();
+    const int threads = gBatch.threads > 0 ? gBatch.threads : max(1, min(hardwareThreads, MAX_BATCH_THREADS));
+
+    // Contexts can only be created on the main thread; each shares gWindow's buffers, textures and programs
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+    vector<GLFWwindow*> contexts;
+    for (int i = 0; i < threads; ++i)
+    {
+        GLFWwindow* context = glfwCreateWindow(16, 16, WINDOW_TITLE, NULL, gWindow);
+        if (!context)
+        {
+            cout << "Failed to create batch context " << i << endl;
+            break;
+        }
+        contexts.push_back(context);
     }
-    else {
-        cameraSpeed += yoffset;                     //setting scroll to controll camera speed
+
+    BatchQueue queue;
+    BatchSocketServer server;
+    vector<BatchJob> jobs;
+    bool ok = !contexts.empty();
+    if (ok && !gBatch.jobPath.empty())
+        ok = ULoadBatchJobs(gBatch.jobPath, jobs);
+    if (ok && !gBatch.socketPath.empty())
+        ok = server.open(gBatch.socketPath);
+    if (!ok)
+    {
+        for (GLFWwindow* context : contexts)
+            glfwDestroyWindow(context);
+        return EXIT_FAILURE;
     }
-    //gCamera.ProcessMouseScroll(yoffset);          // commenting our scroll to zoom  
+    for (const BatchJob& job : jobs)
+        queue.push(job);
+
+    // The uploads must be complete before other contexts read them
+    glFinish();
+
+    BatchLog log;
+    auto start = chrono::steady_clock::now();
+    vector<thread> workers;
+    for (size_t i = 0; i < contexts.size(); ++i)
+        workers.emplace_back(UBatchWorker, (int)i, contexts[i], ref(queue), ref(log));
+
+    // Socket jobs keep coming until a client sends "quit"
+    if (!gBatch.socketPath.empty())
+        server.serve(queue);
+    else
+        queue.close();
+
+    for (thread& worker : workers)
+        worker.join();
+    const double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    for (GLFWwindow* context : contexts)
+        glfwDestroyWindow(context);
+
+    ofstream file;
+    if (!gBatch.reportPath.empty())
+        file.open(gBatch.reportPath);
+    ostream& out = file.is_open() ? file : cout;
+    log.writeReport(out, (const char*)glGetString(GL_RENDERER), (int)contexts.size(), seconds);
+    return log.getFailedCount() > 0 ? EXIT_FAILURE : EXIT_SUCCESS;
 }
 
-// glfw: handle mouse button events
-// --------------------------------
-void UMouseButtonCallback(GLFWwindow* window, int button, int action, int mods)
+
+// Renders jobs with its own context until the queue is closed and empty
+void UBatchWorker(int index, GLFWwindow* window, BatchQueue& queue, BatchLog& log)
 {
-    switch (button)
+    glfwMakeContextCurrent(window);
+
+    // VAOs and framebuffers can't be shared, and programs hold uniform values, so the
+    // worker makes its own over the shared vertex buffers
+    BatchContext context;
+    context.baseVao = UCreateMeshVertexArray(gBaseMesh.vbo);
+    const GLuint propVbos[SCENE_MESH_COUNT] = { gBookMesh.vbo, gBallMesh.vbo, gCandleMesh.vbo, gTopperMesh.vbo, gCableMesh.vbo };
+    for (int mesh = 0; mesh < SCENE_MESH_COUNT; ++mesh)
+        context.propVaos[mesh] = UCreateMeshVertexArray(propVbos[mesh]);
+    bool ready = UCreateShaderProgram(vertexShaderSource, fragmentShaderSource, context.programId)
+        && UCreateShaderProgram(lampVertexShaderSource, lampFragmentShaderSource, context.lampProgramId);
+    // The thread's state cache starts out empty, matching the new context
+    GLStateCache& gl = UGLState();
+    if (ready)
     {
-    case GLFW_MOUSE_BUTTON_LEFT:
-    {
-        if (action == GLFW_PRESS)
-            cout << "Left mouse button pressed" << endl;
-        else
-            cout << "Left mouse button released" << endl;
+        gl.useProgram(context.programId);
+        gl.uniform1i(gl.getUniformLocation(context.programId, "uTexture"), 0);
     }
-    break;
 
-    case GLFW_MOUSE_BUTTON_MIDDLE:
+    BatchJob job;
+    vector<unsigned char> pixels;
+    vector<unsigned char> rgb;
+    while (queue.pop(job))
     {
-        if (action == GLFW_PRESS)
-            cout << "Middle mouse button pressed" << endl;
-        else
-            cout << "Middle mouse button released" << endl;
-    }
-    break;
+        BatchTiming timing;
+        timing.name = job.name;
+        timing.worker = index;
+        timing.width = job.width;
+        timing.height = job.height;
 
-    case GLFW_MOUSE_BUTTON_RIGHT:
-    {
-        if (action == GLFW_PRESS)
-            cout << "Right mouse button pressed" << endl;
-        else
-            cout << "Right mouse button released" << endl;
-    }
-    break;
+        if (ready && (context.target.width != job.width || context.target.height != job.height))
+        {
+            if (context.target.fbo)
+                UDestroyRenderTarget(context.target);
+            ready = UCreateRenderTarget(context.target, job.width, job.height);
+        }
+        if (!ready)
+        {
+            log.add(timing);
+            continue;
+        }
 
-    default:
-        cout << "Unhandled mouse button event" << endl;
-        break;
+        auto start = chrono::steady_clock::now();
+        URenderBatchJob(job, context);
+        pixels.resize((size_t)job.width * job.height * 4);
+        UReadRenderTarget(context.target, pixels.data());   // waits for the frame
+        auto rendered = chrono::steady_clock::now();
+
+        URgbaToRgbTopDown(pixels, job.width, job.height, rgb);
+        timing.ok = UWritePng(gBatch.outputDir + "/" + job.name + ".png", rgb.data(), job.width, job.height);
+        auto written = chrono::steady_clock::now();
+
+        timing.renderMs = chrono::duration<double, milli>(rendered - start).count();
+        timing.writeMs = chrono::duration<double, milli>(written - rendered).count();
+        log.add(timing);
     }
+
+    if (context.target.fbo)
+        UDestroyRenderTarget(context.target);
+    if (context.programId)
+        UDestroyShaderProgram(context.programId);
+    if (context.lampProgramId)
+        UDestroyShaderProgram(context.lampProgramId);
+    gl.deleteVertexArrays(1, &context.baseVao);
+    gl.deleteVertexArrays(SCENE_MESH_COUNT, context.propVaos);
+    glfwMakeContextCurrent(NULL);
 }
 
 
-// Functioned called to render a frame
-void URender()
+// Draws the base scene from the job's camera into the worker's target
+void URenderBatchJob(const BatchJob& job, BatchContext& context)
 {
-    ////// Lamp orbits around the origin
-    //const float angularVelocity = glm::radians(45.0f);
-
-    //    glm::vec4 newPosition = glm::rotate(angularVelocity * gDeltaTime, glm::vec3(1.0f, 2.0f, 0.0f)) * glm::vec4(gLightPosition, 1.0f);
-    //    gLightPosition.x = newPosition.x;
-    //    gLightPosition.y = newPosition.y;
-    //    gLightPosition.z = newPosition.z;
-    //
-    // Enable z-depth
-    glEnable(GL_DEPTH_TEST);
-
-    // Clear the frame and z buffers
-    glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+    UBindRenderTarget(context.target);
+    GLStateCache& gl = UGLState();
+    gl.enable(GL_DEPTH_TEST);
+    gl.clearColor(0.0f, 0.0f, 0.0f, 1.0f);
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-    
-    // Activate the cube VAO (used by cube and lamp)
-    glBindVertexArray(gBaseMesh.vao);
 
-    // CUBE: draw cube
-    //----------------
+    Camera camera;
+    UCameraLookAt(camera, job.eye, job.target);
+    const glm::mat4 view = camera.GetViewMatrix();
+    const glm::mat4 projection = glm::perspective(glm::radians(job.fov), (GLfloat)job.width / (GLfloat)job.height, 0.1f, 100.0f);
 
-    // Model matrix: transformations are applied right-to-left order
-    glm::mat4 model = glm::translate(gPosition) * glm::scale(gScale);
+    gl.useProgram(context.programId);
+    USetSceneUniforms(context.programId, view, projection, job.eye);
 
-    // camera/view transformation
-    glm::mat4 view = gCamera.GetViewMatrix();
+    const glm::mat4 model = glm::translate(gPosition) * glm::scale(gScale);
+    GLint modelLoc = gl.getUniformLocation(context.programId, "model");
+    gl.uniformMatrix4(modelLoc, model);
+    gl.bindVertexArray(context.baseVao);
+    gl.bindTexture(0, gTextureGranite.getId());
+    glDrawArrays(GL_TRIANGLES, 0, gBaseMesh.nVertices);
 
-    // Switches between perspective and ortho views
-    if (perspective) {
-        projection = glm::perspective(glm::radians(gCamera.Zoom), (GLfloat)WINDOW_WIDTH / (GLfloat)WINDOW_HEIGHT, 0.1f, 100.0f);
+    // Every prop set entity; jobs run concurrently, so the shared frame draw list is not used
+    vector<uint32_t> props;
+    props.reserve(gEntities.size());
+    for (uint32_t i = 0; i < (uint32_t)gEntities.size(); ++i)
+    {
+        if (gEntities.layers()[i] & ENTITY_LAYER_PROPS)
+            props.push_back(i);
     }
-    else {
-        projection = glm::ortho(-10.0f, 10.0f, -10.0f, 10.0f, 0.1f, 100.0f);
+    // Base meshes only: the LODs' VAOs belong to the main context
+    UDrawEntities(modelLoc, context.propVaos, props.data(), props.size(), nullptr);
+    UDrawLamp(context.lampProgramId, context.baseVao, view, projection);
+}
+
+
+// Times the CPU-side kernels used while loading and rendering the scene
+int URunMicroBenchmarks(const MicroBenchOptions& options)
+{
+    MicroBench bench(options);
+    mt19937 random(options.seed);
+
+    // Mesh construction
+    bench.run("sphere_smooth_36x18", []() {
+        Sphere sphere(1.0f, 36, 18, true);
+        MicroBench::keep(sphere.getInterleavedVertexCount());
+    });
+    bench.run("sphere_flat_36x18", []() {
+        Sphere sphere(1.0f, 36, 18, false);
+        MicroBench::keep(sphere.getInterleavedVertexCount());
+    });
+
+    // Image operations on seeded noise (same size as the largest scene texture)
+    const int imageSize = 1024;
+    vector<unsigned char> image((size_t)imageSize * imageSize * 4);
+    for (unsigned char& value : image)
+        value = (unsigned char)(random() & 0xFF);
+    bench.run("flip_image_1024x1024_rgba", [&]() {
+        flipImageVertically(image.data(), imageSize, imageSize, 4);
+        MicroBench::keep(image[0]);
+    }, (double)image.size());
+
+    // Texture decode path used by UCreateTexture (skipped when run outside the project directory)
+    const char* const textures[] = { "../Includes/T_granite.png", "../Includes/T_Cable.png" };
+    for (const char* filename : textures)
+    {
+        int width, height, channels;
+        unsigned char* probe = stbi_load(filename, &width, &height, &channels, 0);
+        if (!probe)
+        {
+            cerr << "Skipping stbi_load benchmark, cannot load " << filename << endl;
+            continue;
+        }
+        stbi_image_free(probe);
+
+        const string name = string("stbi_load_") + (strrchr(filename, '/') + 1);
+        bench.run(name.c_str(), [filename]() {
+            int w, h, c;
+            unsigned char* decoded = stbi_load(filename, &w, &h, &c, 0);
+            MicroBench::keep(decoded);
+            stbi_image_free(decoded);
+        }, (double)width * height * channels);
     }
 
-    // Set the shader to be used
-    glUseProgram(gProgramId);
+    // Camera math, fed a fixed sequence of mouse offsets
+    vector<glm::vec2> mouseOffsets(1024);
+    uniform_real_distribution<float> offsetDistribution(-20.0f, 20.0f);
+    for (glm::vec2& offset : mouseOffsets)
+        offset = glm::vec2(offsetDistribution(random), offsetDistribution(random));
+
+    Camera camera(glm::vec3(0.0f, 0.0f, 3.0f));
+    size_t nextOffset = 0;
+    bench.run("camera_update_vectors", [&]() {
+        const glm::vec2& offset = mouseOffsets[nextOffset++ & 1023];
+        camera.ProcessMouseMovement(offset.x, offset.y); // updateCameraVectors is private, this is its only caller
+        MicroBench::keep(camera.Front.x);
+    });
+    bench.run("camera_view_matrix", [&]() {
+        glm::mat4 view = camera.GetViewMatrix();
+        MicroBench::keep(view[3][2]);
+    });
+
+    // Model matrix composition as done per object in URender. Each call places the objects with the
+    // next of a prepared set of jitters, so nothing folds at compile time, and stores whole matrices,
+    // so no part of the work is dead (the translation column alone does not depend on the rest)
+    const size_t placementCount = 1024;
+    vector<glm::vec3> placementOffsets(placementCount);
+    vector<float> placementScales(placementCount), placementAngles(placementCount);
+    uniform_real_distribution<float> jitterDistribution(-0.1f, 0.1f);
+    for (size_t i = 0; i < placementCount; ++i)
+    {
+        placementOffsets[i] = glm::vec3(jitterDistribution(random), jitterDistribution(random), jitterDistribution(random));
+        placementScales[i] = 1.0f + jitterDistribution(random);
+        placementAngles[i] = 90.0f + 10.0f * jitterDistribution(random);
+    }
+    const int SCENE_MODEL_COUNT = 9;
+    vector<glm::mat4> placedModels(placementCount * SCENE_MODEL_COUNT);
+    size_t nextPlacement = 0;
+
+    bench.run("model_matrix_translate_scale", [&]() {
+        const size_t i = nextPlacement++ & (placementCount - 1);
+        glm::mat4& model = placedModels[i];
+        model = glm::translate(bookPos + placementOffsets[i]) * glm::scale(gScale * placementScales[i]);
+        MicroBench::keep(model[0][0]);
+    });
+    bench.run("model_matrix_translate_scale_rotate", [&]() {
+        const size_t i = nextPlacement++ & (placementCount - 1);
+        glm::mat4& model = placedModels[i];
+        model = glm::translate(candlePos + placementOffsets[i]) * glm::scale(candleScale * placementScales[i])
+            * glm::rotate(glm::radians(placementAngles[i]), glm::vec3(1.0f, 0.0f, 0.0f));
+        MicroBench::keep(model[0][0]);
+    });
+    bench.run("model_matrix_scene", [&]() {
+        // Every model matrix of one URender frame, props included once
+        const size_t i = nextPlacement++ & (placementCount - 1);
+        const glm::vec3& offset = placementOffsets[i];
+        const float scale = placementScales[i];
+        const float angle = glm::radians(placementAngles[i]);
+        glm::mat4* models = &placedModels[i * SCENE_MODEL_COUNT];
+        models[0] = glm::translate(gPosition + offset) * glm::scale(gScale * scale);
+        models[1] = glm::translate(bookPos + offset) * glm::scale(gScale * scale);
+        models[2] = glm::translate(ballPos + offset) * glm::scale(ballscale * scale);
+        models[3] = glm::translate(candlePos + offset) * glm::scale(candleScale * scale) * glm::rotate(angle, glm::vec3(1.0f, 0.0f, 0.0f));
+        models[4] = glm::translate(topperPos + offset) * glm::scale(candleScale * scale) * glm::rotate(angle, glm::vec3(1.0f, 0.0f, 0.0f));
+        models[5] = glm::translate(glm::vec3(-3.7f, -0.2f, 1.3f) + offset) * glm::scale(glm::vec3(0.85, 0.85, 0.85) * scale) * glm::rotate(angle, glm::vec3(1.0f, 0.05f, 0.6f));
+        models[6] = glm::translate(glm::vec3(-3.7f, -0.3f, 1.3f) + offset) * glm::scale(glm::vec3(0.85, 0.87, 0.85) * scale) * glm::rotate(angle, glm::vec3(1.0f, 0.06f, 0.3f));
+        models[7] = glm::translate(glm::vec3(-3.7f, -0.4f, 1.5f) + offset) * glm::scale(glm::vec3(0.85f, 0.67, 0.85f) * scale) * glm::rotate(angle, glm::vec3(1.0f, 0.07f, 0.7f));
+        models[8] = glm::translate(gLightPosition + offset) * glm::scale(gLightScale * scale);
+        float sum = 0.0f;
+        for (int model = 0; model < SCENE_MODEL_COUNT; ++model)
+            sum += models[model][0][0];
+        MicroBench::keep(sum);
+    });
+
+    // Model and normal matrices of a large scene: per object through glm as URender
+    // composed them, then in batches from the entity store's component arrays
+    const size_t transformCount = 10000;
+    vector<glm::vec3> positions(transformCount), scales(transformCount), axes(transformCount);
+    vector<float> angles(transformCount);
+    vector<glm::quat> rotations(transformCount);
+    uniform_real_distribution<float> coordinateDistribution(-50.0f, 50.0f);
+    uniform_real_distribution<float> scaleDistribution(0.25f, 2.0f);
+    uniform_real_distribution<float> unitDistribution(-1.0f, 1.0f);
+    for (size_t i = 0; i < transformCount; ++i)
+    {
+        positions[i] = glm::vec3(coordinateDistribution(random), coordinateDistribution(random), coordinateDistribution(random));
+        scales[i] = glm::vec3(scaleDistribution(random), scaleDistribution(random), scaleDistribution(random));
+        axes[i] = glm::vec3(unitDistribution(random), unitDistribution(random), 1.0f);
+        angles[i] = 180.0f * unitDistribution(random);
+        rotations[i] = glm::angleAxis(glm::radians(angles[i]), glm::normalize(axes[i]));
+    }
+    vector<glm::mat4> models(transformCount);
+    vector<glm::mat3> normals(transformCount);
+    const double transformBytes = (double)transformCount * (sizeof(glm::vec3) * 2 + sizeof(glm::quat) + sizeof(glm::mat4) + sizeof(glm::mat3));
 
-    // Retrieves and passes transform matrices to the Shader program
-    GLint modelLoc = glGetUniformLocation(gProgramId, "model");
-    GLint viewLoc = glGetUniformLocation(gProgramId, "view");
-    GLint projLoc = glGetUniformLocation(gProgramId, "projection");
+    bench.run("transform_10000_glm", [&]() {
+        for (size_t i = 0; i < transformCount; ++i)
+        {
+            models[i] = glm::translate(positions[i]) * glm::scale(scales[i]) * glm::rotate(glm::radians(angles[i]), axes[i]);
+            normals[i] = glm::transpose(glm::inverse(glm::mat3(models[i])));
+        }
+        MicroBench::keep(models[transformCount - 1][3][0]);
+    }, transformBytes);
 
-    glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model));
-    glUniformMatrix4fv(viewLoc, 1, GL_FALSE, glm::value_ptr(view));
-    glUniformMatrix4fv(projLoc, 1, GL_FALSE, glm::value_ptr(projection));
+    const TransformKernel kernels[] = { TRANSFORM_KERNEL_SCALAR, TRANSFORM_KERNEL_SSE2, TRANSFORM_KERNEL_AVX };
+    for (TransformKernel kernel : kernels)
+    {
+        if (!UTransformKernelSupported(kernel))
+            continue;
+        const string name = string("transform_10000_") + UTransformKernelName(kernel);
+        bench.run(name.c_str(), [&]() {
+            UComposeTransforms(positions.data(), rotations.data(), scales.data(), transformCount, models.data(), normals.data(), kernel);
+            MicroBench::keep(models[transformCount - 1][3][0]);
+        }, transformBytes);
+    }
 
-    // Reference matrix uniforms from the Cube Shader program for the cub color, light color, light position, and camera position
-    GLint objectColorLoc = glGetUniformLocation(gProgramId, "objectColor");
-    GLint lightColorLoc = glGetUniformLocation(gProgramId, "lightColor");
-    GLint lightPositionLoc = glGetUniformLocation(gProgramId, "lightPos");
-    GLint ambientColorLoc = glGetUniformLocation(gProgramId, "ambientColor");
-    GLint ambientPositionLoc = glGetUniformLocation(gProgramId, "ambientPos");
-    GLint viewPositionLoc = glGetUniformLocation(gProgramId, "viewPosition");
-
-
-    // Pass color, light, and camera data to the Cube Shader program's corresponding uniforms
-    glUniform3f(objectColorLoc, gObjectColor.r, gObjectColor.g, gObjectColor.b);
-    glUniform3f(lightColorLoc, gLightColor.r, gLightColor.g, gLightColor.b);
-    glUniform3f(lightPositionLoc, gLightPosition.x, gLightPosition.y, gLightPosition.z);
-    glUniform3f(ambientColorLoc, gAmbientColor.r, gAmbientColor.g, gAmbientColor.b);
-    glUniform3f(ambientPositionLoc, gAmbientPosition.x, gAmbientPosition.y, gAmbientPosition.z);
-    const glm::vec3 cameraPosition = gCamera.Position;
-    glUniform3f(viewPositionLoc, cameraPosition.x, cameraPosition.y, cameraPosition.z);
-    
-    GLint UVScaleLoc = glGetUniformLocation(gProgramId, "uvScale");
-    glUniform2fv(UVScaleLoc, 1, glm::value_ptr(gUVScale));
-
-    // Activate the VBOs contained within the mesh's VAOd
-    glBindVertexArray(gBaseMesh.vao);
+    const int transformThreads = max(1, (int)thread::hardware_concurrency());
+    const string threadedName = string("transform_10000_") + UTransformKernelName(UBestTransformKernel()) + "_" + to_string(transformThreads) + "threads";
+    bench.run(threadedName.c_str(), [&]() {
+        UComposeTransforms(positions.data(), rotations.data(), scales.data(), transformCount, models.data(), normals.data(),
+            TRANSFORM_KERNEL_AUTO, transformThreads);
+        MicroBench::keep(models[transformCount - 1][3][0]);
+    }, transformBytes);
+
+    // Number parsing as the mesh importers do it, against strtof on the same text
+    const size_t numberCount = 100000;
+    string numberText;
+    uniform_real_distribution<float> numberDistribution(-100.0f, 100.0f);
+    for (size_t i = 0; i < numberCount; ++i)
+    {
+        char number[32];
+        snprintf(number, sizeof(number), "%.6f ", numberDistribution(random));
+        numberText += number;
+    }
+    bench.run("parse_float_100000_fast", [&]() {
+        float sum = 0.0f, value = 0.0f;
+        const char* end = numberText.data() + numberText.size();
+        for (const char* p = numberText.data(); p < end; p = UParseFloat(p, end, value) + 1)
+            sum += value;
+        MicroBench::keep(sum);
+    }, (double)numberText.size());
+    bench.run("parse_float_100000_strtof", [&]() {
+        float sum = 0.0f;
+        const char* p = numberText.c_str();
+        for (char* end; *p; p = end + 1)
+            sum += strtof(p, &end);
+        MicroBench::keep(sum);
+    }, (double)numberText.size());
+
+    // OBJ import of a generated terrain grid, on one thread and on all of them
+    string objText;
+    const size_t objBytes = (size_t)options.objMb * 1024 * 1024;
+    const int gridSize = 256;
+    for (int copy = 0; objText.size() < objBytes; ++copy)
+    {
+        char line[128];
+        for (int y = 0; y <= gridSize; ++y)
+        {
+            for (int x = 0; x <= gridSize; ++x)
+            {
+                snprintf(line, sizeof(line), "v %.6f %.6f %.6f\nvt %.6f %.6f\nvn %.6f %.6f %.6f\n", x * 0.1f,
+                    numberDistribution(random) * 0.01f, y * 0.1f + copy, x / (float)gridSize, y / (float)gridSize,
+                    unitDistribution(random) * 0.1f, 1.0f, unitDistribution(random) * 0.1f);
+                objText += line;
+            }
+        }
+        // Relative indices, so every copy refers to its own grid
+        const int row = gridSize + 1;
+        for (int y = 0; y < gridSize; ++y)
+        {
+            for (int x = 0; x < gridSize; ++x)
+            {
+                const int corner = (y * row + x) - row * row;
+                snprintf(line, sizeof(line), "f %d/%d/%d %d/%d/%d %d/%d/%d %d/%d/%d\n", corner, corner, corner,
+                    corner + 1, corner + 1, corner + 1, corner + row + 1, corner + row + 1, corner + row + 1,
+                    corner + row, corner + row, corner + row);
+                objText += line;
+            }
+        }
+    }
 
-    // bind textures on corresponding texture units
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, gTextureIdGranite);
-    // Draws the triangles
-    glDrawArrays(GL_TRIANGLES, 0, gBaseMesh.nVertices);
-    ///////BOOK///////////////////////////////////////////////////////////////////////////////////////////////
-    glBindVertexArray(gBookMesh.vao);
-    glBindTexture(GL_TEXTURE_2D, gTextureIdBook);
-    model = glm::translate(bookPos) * glm::scale(gScale);
-    glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model));
-    glDrawArrays(GL_TRIANGLES, 0, gBookMesh.nVertices);
-    
-    ///////BALL///////////////////////////////////////////////////////////////////////////////////////////////
-    glBindVertexArray(gBallMesh.vao);
-    glBindTexture(GL_TEXTURE_2D, gTextureIdBall);
-    model = glm::translate(ballPos) * glm::scale(ballscale);
-    glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model));
-    glDrawArrays(GL_TRIANGLES, 0, gBallMesh.nVertices);
-    ///////CANDLE///////////////////////////////////////////////////////////////////////////////////////////////
-    glBindVertexArray(gCandleMesh.vao);
-    glBindTexture(GL_TEXTURE_2D, gTextureIdCandle);
-    model = glm::translate(candlePos) * glm::scale(candleScale) * glm::rotate(glm::radians(90.0f), glm::vec3(1.0f, 0.0f, 0.0f));
-    glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model));
-    glDrawArrays(GL_TRIANGLES, 0, gCandleMesh.nVertices);
-    ///////TOPPER///////////////////////////////////////////////////////////////////////////////////////////////
-    glBindVertexArray(gTopperMesh.vao);
-    glBindTexture(GL_TEXTURE_2D, gTextureIdTopper);
-    model = glm::translate(topperPos) * glm::scale(candleScale) * glm::rotate(glm::radians(90.0f), glm::vec3(1.0f, 0.0f, 0.0f));
-    glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model));
-    glDrawArrays(GL_TRIANGLES, 0, gTopperMesh.nVertices);
-    ///////CABLE///////////////////////////////////////////////////////////////////////////////////////////////
-    glBindVertexArray(gCableMesh.vao);
-    glBindTexture(GL_TEXTURE_2D, gTextureIdCable);
-    model = glm::translate(glm::vec3(-3.7f, -0.2f, 1.3f)) * glm::scale(glm::vec3(0.85, 0.85, 0.85)) * glm::rotate(glm::radians(90.0f), glm::vec3(1.0f, 0.05f, 0.6f));
-    glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model));
-    glDrawArrays(GL_TRIANGLES, 0, gCableMesh.nVertices);
-    glBindVertexArray(gCableMesh.vao);
-    glBindTexture(GL_TEXTURE_2D, gTextureIdCable);
-    model = glm::translate(glm::vec3(-3.7f, -0.3f, 1.3f)) * glm::scale(glm::vec3(0.85, 0.87, 0.85)) * glm::rotate(glm::radians(90.0f), glm::vec3(1.0f, 0.06f, 0.3f));
-    glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model));
-    glDrawArrays(GL_TRIANGLES, 0, gCableMesh.nVertices);
-    glBindVertexArray(gCableMesh.vao);
-    glBindTexture(GL_TEXTURE_2D, gTextureIdCable);
-    model = glm::translate(glm::vec3(-3.7f, -0.4f, 1.5f)) * glm::scale(glm::vec3(0.85f, 0.67, 0.85f)) * glm::rotate(glm::radians(90.0f), glm::vec3(1.0f, 0.07f, 0.7f));
-    glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model));
-    glDrawArrays(GL_TRIANGLES, 0, gCableMesh.nVertices);
-    ///////////////////////////////////////////////////////////////////////////////////////////////////////////
-    // LAMP: draw lamp
-    //----------------
-    glUseProgram(gLampProgramId);
+    JobSystem importJobs;
+    const string objName = "import_obj_" + to_string(options.objMb) + "mb_";
+    ImportedMesh imported;
+    bench.run((objName + "1thread").c_str(), [&]() {
+        UImportObj(objText.data(), objText.size(), imported);
+        MicroBench::keep(imported.vertices[0]);
+    }, (double)objText.size());
+    bench.run((objName + to_string(importJobs.getThreadCount()) + "threads").c_str(), [&]() {
+        UImportObj(objText.data(), objText.size(), imported, &importJobs);
+        MicroBench::keep(imported.vertices[0]);
+    }, (double)objText.size());
+
+    // The same grid from a mesh file: map, validate and read every cache line as an upload
+    // would; warm runs, so this is the CPU cost left once loading is I/O-bound
+    const char* meshFilePath = "microbench.nmesh";
+    vector<MeshFileSource> meshSources(1);
+    meshSources[0].name = "grid";
+    meshSources[0].vertices = imported.vertices.data();
+    meshSources[0].vertexCount = (uint32_t)imported.getVertexCount();
+    if (UWriteMeshFile(meshFilePath, meshSources))
+    {
+        const double meshFileBytes = (double)(imported.vertices.size() * sizeof(float));
+        bench.run(("load_mesh_file_" + to_string(options.objMb) + "mb").c_str(), [&]() {
+            MeshFile meshFile;
+            float sum = 0.0f;
+            if (meshFile.open(meshFilePath))
+            {
+                const MeshFileMesh& mesh = meshFile.getMesh(0);
+                const size_t floats = mesh.vertexBytes / sizeof(float);
+                for (size_t i = 0; i < floats; i += 16)
+                    sum += mesh.vertices[i];
+            }
+            MicroBench::keep(sum);
+        }, meshFileBytes);
+        remove(meshFilePath);
+    }
 
-    //Transform the smaller cube used as a visual que for the light source
-    model = glm::translate(gLightPosition) * glm::scale(gLightScale);
+    // LZ4 of the OBJ text, as compressed asset pack entries are built and read
+    vector<unsigned char> lz4Block;
+    ULz4Compress(reinterpret_cast<const unsigned char*>(objText.data()), objText.size(), lz4Block);
+    vector<unsigned char> lz4Output(objText.size());
+    bench.run(("lz4_compress_" + to_string(options.objMb) + "mb").c_str(), [&]() {
+        ULz4Compress(reinterpret_cast<const unsigned char*>(objText.data()), objText.size(), lz4Block);
+        MicroBench::keep(lz4Block.size());
+    }, (double)objText.size());
+    bench.run(("lz4_decompress_" + to_string(options.objMb) + "mb").c_str(), [&]() {
+        MicroBench::keep(ULz4Decompress(lz4Block.data(), lz4Block.size(), lz4Output.data(), lz4Output.size()));
+    }, (double)objText.size());
+
+    // Simplification to a quarter of the triangles: a smooth sphere, whose UV seam and poles
+    // are welded, and a bumpy grid with open borders; per input vertex byte
+    vector<SimplifiedMesh> lods;
+    Sphere lodSphere(1.0f, 64, 32, true);
+    vector<float> sphereVertices;
+    for (unsigned int i = 0; i < lodSphere.getIndexCount(); ++i)
+    {
+        const float* vertex = lodSphere.getInterleavedVertices() + (size_t)lodSphere.getIndices()[i] * 8;
+        sphereVertices.insert(sphereVertices.end(), vertex, vertex + 8);
+    }
+    bench.run("simplify_sphere_64x32_to_25pct", [&]() {
+        USimplifyMesh(sphereVertices.data(), sphereVertices.size() / 8, { 0.25f }, SimplifyOptions(), lods);
+        MicroBench::keep(lods[0].vertices.size());
+    }, (double)(sphereVertices.size() * sizeof(float)));
+
+    const int lodGrid = 128;
+    vector<float> gridVertices;
+    for (int z = 0; z < lodGrid; ++z)
+    {
+        for (int x = 0; x < lodGrid; ++x)
+        {
+            const int corners[6][2] = { { x, z }, { x, z + 1 }, { x + 1, z + 1 }, { x, z }, { x + 1, z + 1 }, { x + 1, z } };
+            for (const int* corner : corners)
+            {
+                const float u = corner[0] / (float)lodGrid, v = corner[1] / (float)lodGrid;
+                const float vertex[8] = { u, 0.1f * sinf(u * 6.0f) * cosf(v * 4.0f), v, 0.0f, 1.0f, 0.0f, u, v };
+                gridVertices.insert(gridVertices.end(), vertex, vertex + 8);
+            }
+        }
+    }
+    bench.run(("simplify_grid_" + to_string(lodGrid) + "x" + to_string(lodGrid) + "_to_25pct").c_str(), [&]() {
+        USimplifyMesh(gridVertices.data(), gridVertices.size() / 8, { 0.25f }, SimplifyOptions(), lods);
+        MicroBench::keep(lods[0].vertices.size());
+    }, (double)(gridVertices.size() * sizeof(float)));
 
-    // Reference matrix uniforms from the Lamp Shader program
-    modelLoc = glGetUniformLocation(gLampProgramId, "model");
-    viewLoc = glGetUniformLocation(gLampProgramId, "view");
-    projLoc = glGetUniformLocation(gLampProgramId, "projection");
-    
-    // Pass matrix data to the Lamp Shader program's matrix uniforms
-    glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model));
-    glUniformMatrix4fv(viewLoc, 1, GL_FALSE, glm::value_ptr(view));
-    glUniformMatrix4fv(projLoc, 1, GL_FALSE, glm::value_ptr(projection));
+    // A real asset, read from disk every time (--mb-import)
+    if (!options.importPath.empty())
+    {
+        vector<char> file;
+        if (UReadFileBytes(options.importPath, file) && UImportMesh(options.importPath, imported, &importJobs))
+        {
+            const size_t slash = options.importPath.find_last_of("/\\");
+            const string fileName = "import_" + options.importPath.substr(slash == string::npos ? 0 : slash + 1) + "_";
+            bench.run((fileName + "1thread").c_str(), [&]() {
+                MicroBench::keep(UImportMesh(options.importPath, imported));
+            }, (double)file.size());
+            bench.run((fileName + to_string(importJobs.getThreadCount()) + "threads").c_str(), [&]() {
+                MicroBench::keep(UImportMesh(options.importPath, imported, &importJobs));
+            }, (double)file.size());
+        }
+        else
+        {
+            cerr << "Skipping import benchmark, cannot import " << options.importPath << endl;
+        }
+    }
 
-    glDrawArrays(GL_TRIANGLES, 0, gBaseMesh.nVertices);
+    if (options.outputPath.empty())
+    {
+        bench.writeReport(cout);
+    }
+    else
+    {
+        ofstream out(options.outputPath);
+        if (!out)
+        {
+            cout << "Failed to open microbenchmark output " << options.outputPath << endl;
+            return EXIT_FAILURE;
+        }
+        bench.writeReport(out);
+    }
 
-    // Deactivate the Vertex Array Object
-    glBindVertexArray(0);
-    glUseProgram(0);
-    float lineColor[] = { 0.2f, 0.2f, 0.2f, 1 };
-    // glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
-    glfwSwapBuffers(gWindow);    // Flips the the back buffer with the front buffer every frame.
+    return EXIT_SUCCESS;
 }
 
 
@@ -701,71 +2626,289 @@ void UCreateMesh(GLMesh& mesh)
 
     mesh.nVertices = sizeof(verts) / (sizeof(verts[0]) * (floatsPerVertex + floatsPerNormal + floatsPerUV));
 
-    glGenVertexArrays(1, &mesh.vao); // we can also generate multiple VAOs or buffers at the same time
-    glBindVertexArray(mesh.vao);
+    UUploadMesh(mesh, verts, sizeof(verts));
+}
+
+
+// Creates the mesh's VAO and VBO from interleaved position, normal and texture
+// coordinate vertices, sharing them with any mesh of the same data
+void UUploadMesh(GLMesh& mesh, const GLfloat* verts, size_t bytes)
+{
+    mesh.resource = gResources.createMesh(verts, bytes);
+    mesh.vao = mesh.resource.getVao();
+    mesh.vbo = mesh.resource.getVbo();
+    mesh.boundsKnown = false;
+}
 
-    // Create VBO
-    glGenBuffers(1, &mesh.vbo);
-    glBindBuffer(GL_ARRAY_BUFFER, mesh.vbo); // Activates the buffer
-    glBufferData(GL_ARRAY_BUFFER, sizeof(verts), verts, GL_STATIC_DRAW); // Sends vertex or coordinate data to the GPU
 
-    // Strides between vertex coordinates
-    GLint stride = sizeof(float) * (floatsPerVertex + floatsPerNormal + floatsPerUV);
+void UDestroyMesh(GLMesh& mesh)
+{
+    mesh.lods.clear();
+    mesh.lodErrors.clear();
+    mesh.resource.reset();
+    mesh.vao = 0;
+    mesh.vbo = 0;
+    mesh.boundsKnown = false;
+}
+
 
-    // Create Vertex Attribute Pointers
-    glVertexAttribPointer(0, floatsPerVertex, GL_FLOAT, GL_FALSE, stride, 0);
-    glEnableVertexAttribArray(0);
+// Replaces the built-in meshes named with --mesh by the files given for them
+bool UImportSceneMeshes()
+{
+    for (const pair<string, string>& file : gMeshImport.files)
+    {
+        int index = 0;
+        while (index < NAMED_MESH_COUNT && file.first != gMeshNames[index])
+            ++index;
+        if (index == NAMED_MESH_COUNT)
+        {
+            cout << "Unknown mesh " << file.first << " (base, book, ball, candle, topper or cable)" << endl;
+            return false;
+        }
 
-    glVertexAttribPointer(1, floatsPerNormal, GL_FLOAT, GL_FALSE, stride, (void*)(sizeof(float) * floatsPerVertex));
-    glEnableVertexAttribArray(1);
+        auto start = chrono::steady_clock::now();
+        ImportedMesh imported;
+        if (!UImportMesh(file.second, imported, gJobs.get()))
+            return false;
+        if (imported.vertices.empty())
+        {
+            cout << "Mesh " << file.second << " has no triangles" << endl;
+            return false;
+        }
 
-    glVertexAttribPointer(2, floatsPerUV, GL_FLOAT, GL_FALSE, stride, (void*)(sizeof(float) * (floatsPerVertex + floatsPerNormal)));
-    glEnableVertexAttribArray(2);
+        GLMesh& mesh = *gNamedMeshes[index];
+        mesh.nVertices = (GLuint)imported.getVertexCount();
+        UUploadMesh(mesh, imported.vertices.data(), imported.vertices.size() * sizeof(float));
+        cout << "INFO: Imported " << file.second << " as the " << file.first << " mesh, " << mesh.nVertices
+            << " vertices in " << chrono::duration<double, milli>(chrono::steady_clock::now() - start).count()
+            << " ms" << endl;
+    }
+    return true;
 }
 
 
-void UDestroyMesh(GLMesh& mesh)
+// Replaces the built-in meshes by those of the same name in the --load-meshes file, uploaded
+// straight from the file mapping with the content hash it stores
+bool ULoadSceneMeshes()
 {
-    glDeleteVertexArrays(1, &mesh.vao);
-    glDeleteBuffers(1, &mesh.vbo);
+    if (gMeshFile.loadPath.empty())
+        return true;
+
+    auto start = chrono::steady_clock::now();
+    MeshFile file;
+    if (!file.open(gMeshFile.loadPath))
+        return false;
+
+    int loaded = 0;
+    size_t bytes = 0;
+    for (int i = 0; i < NAMED_MESH_COUNT; ++i)
+    {
+        const MeshFileMesh* stored = file.find(gMeshNames[i]);
+        if (!stored)
+            continue;
+        if (stored->indexSize != 0 || stored->vertexCount == 0)
+        {
+            cout << "Mesh " << gMeshNames[i] << " in " << gMeshFile.loadPath << " is indexed or empty" << endl;
+            return false;
+        }
+
+        GLMesh& mesh = *gNamedMeshes[i];
+        mesh.nVertices = stored->vertexCount;
+        mesh.resource = gResources.createMesh(stored->vertices, stored->vertexBytes, stored->contentHash);
+        mesh.vao = mesh.resource.getVao();
+        mesh.vbo = mesh.resource.getVbo();
+        mesh.bounds = stored->sphere;
+        mesh.boundsKnown = true;
+        if (stored->material[0] != '\0')
+            gMeshMaterials[i] = stored->material;
+        loaded++;
+        bytes += stored->vertexBytes;
+    }
+
+    cout << "INFO: Loaded " << loaded << " meshes (" << bytes / 1024 << " KB) from " << gMeshFile.loadPath
+        << " in " << chrono::duration<double, milli>(chrono::steady_clock::now() - start).count() << " ms"
+        << endl;
+    return true;
 }
 
 
-/*Generate and load the texture*/
-bool UCreateTexture(const char* filename, GLuint& textureId)
+// Writes the scene meshes as created, built-in or imported, with their textures to the
+// --save-meshes file
+bool USaveSceneMeshes()
 {
-    int width, height, channels;
-    unsigned char* image = stbi_load(filename, &width, &height, &channels, 0);
-    if (image)
+    if (gMeshFile.savePath.empty())
+        return true;
+
+    // Vertex data only lives in buffer storage, so it is read back
+    vector<vector<GLfloat>> vertices(NAMED_MESH_COUNT);
+    vector<MeshFileSource> sources(NAMED_MESH_COUNT);
+    for (int i = 0; i < NAMED_MESH_COUNT; ++i)
     {
-        flipImageVertically(image, width, height, channels);
+        const GLMesh& mesh = *gNamedMeshes[i];
+        vertices[i].resize((size_t)mesh.nVertices * MESH_FILE_FLOATS_PER_VERTEX);
+        UGLState().bindBuffer(GL_COPY_READ_BUFFER, mesh.vbo);
+        glGetBufferSubData(GL_COPY_READ_BUFFER, 0, vertices[i].size() * sizeof(GLfloat), vertices[i].data());
+
+        sources[i].name = gMeshNames[i];
+        sources[i].material = gMeshMaterials[i];
+        sources[i].vertices = vertices[i].data();
+        sources[i].vertexCount = mesh.nVertices;
+    }
+
+    if (!UWriteMeshFile(gMeshFile.savePath, sources))
+        return false;
+    cout << "INFO: Saved " << NAMED_MESH_COUNT << " meshes to " << gMeshFile.savePath << endl;
+    return true;
+}
 
-        glGenTextures(1, &textureId);
-        glBindTexture(GL_TEXTURE_2D, textureId);
 
-        // set the texture wrapping parameters
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-        // set texture filtering parameters
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+// Mounts the --pack files and has the assets the scene loads first read ahead while
+// the built-in meshes are created
+bool UMountAssetPacks()
+{
+    for (const string& pack : gAssetPacks.mounts)
+    {
+        if (!UAssets().mount(pack))
+            return false;
+    }
 
-        if (channels == 3)
-            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB8, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, image);
-        else if (channels == 4)
-            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, image);
-        else
+    // In the order they are loaded in
+    if (!gMeshFile.loadPath.empty())
+        UAssets().prefetch(gMeshFile.loadPath);
+    for (const pair<string, string>& file : gMeshImport.files)
+        UAssets().prefetch(file.second);
+    for (const string& material : gMeshMaterials)
+        UAssets().prefetch(material);
+    return true;
+}
+
+
+// Packs every file the scene loaded, textures, mesh files and imported meshes, and the
+// --pack-add files into the --build-pack file
+bool UBuildAssetPack()
+{
+    if (gAssetPacks.buildPath.empty())
+        return true;
+
+    vector<string> files(begin(gMeshMaterials), end(gMeshMaterials));
+    if (!gMeshFile.loadPath.empty())
+        files.push_back(gMeshFile.loadPath);
+    if (!gMeshFile.savePath.empty())
+        files.push_back(gMeshFile.savePath);
+    for (const pair<string, string>& file : gMeshImport.files)
+        files.push_back(file.second);
+    files.insert(files.end(), gAssetPacks.extraFiles.begin(), gAssetPacks.extraFiles.end());
+    return UWriteAssetPack(gAssetPacks.buildPath, files, gAssetPacks.compress);
+}
+
+
+// Builds the LOD chains of the prop meshes (--lod) from their vertex buffers, so built-in,
+// imported and loaded meshes all get them; the meshes are simplified on the job threads
+void UBuildSceneLods()
+{
+    if (!gLod.enabled)
+        return;
+
+    // Props only: the base plane is two triangles drawn once
+    const int first = 1;
+    const int count = NAMED_MESH_COUNT - first;
+    vector<vector<GLfloat>> vertices(count);
+    for (int i = 0; i < count; ++i)
+    {
+        const GLMesh& mesh = *gNamedMeshes[first + i];
+        vertices[i].resize((size_t)mesh.nVertices * ImportedMesh::FLOATS_PER_VERTEX);
+        UGLState().bindBuffer(GL_COPY_READ_BUFFER, mesh.vbo);
+        glGetBufferSubData(GL_COPY_READ_BUFFER, 0, vertices[i].size() * sizeof(GLfloat), vertices[i].data());
+    }
+
+    auto start = chrono::steady_clock::now();
+    vector<vector<SimplifiedMesh>> chains(count);
+    vector<double> milliseconds(count);
+    gJobs->parallelFor(count, 1, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i)
         {
-            cout << "Not implemented to handle image with " << channels << " channels" << endl;
-            return false;
+            auto meshStart = chrono::steady_clock::now();
+            USimplifyMesh(vertices[i].data(), vertices[i].size() / ImportedMesh::FLOATS_PER_VERTEX, gLod.ratios,
+                SimplifyOptions(), chains[i]);
+            milliseconds[i] = chrono::duration<double, milli>(chrono::steady_clock::now() - meshStart).count();
+        }
+    });
+    const double totalMs = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+
+    size_t totalTriangles = 0;
+    for (int i = 0; i < count; ++i)
+    {
+        GLMesh& mesh = *gNamedMeshes[first + i];
+        mesh.lods.clear();
+        mesh.lodErrors.clear();
+        const size_t triangles = vertices[i].size() / (3 * ImportedMesh::FLOATS_PER_VERTEX);
+        totalTriangles += triangles;
+
+        // Triangles of each LOD, with its error in percent of the mesh's radius
+        cout << "INFO: " << gMeshNames[first + i] << " LODs from " << triangles << " triangles:";
+        size_t previous = triangles;
+        vector<size_t> kept;
+        for (size_t index = 0; index < chains[i].size(); ++index)
+        {
+            // A LOD no smaller than the one before it would never pay for its draw
+            const SimplifiedMesh& lod = chains[i][index];
+            if (lod.getTriangleCount() == 0 || lod.getTriangleCount() >= previous)
+                continue;
+            previous = lod.getTriangleCount();
+            kept.push_back(index);
+
+            GLMeshLod level;
+            level.nVertices = (GLuint)(lod.vertices.size() / ImportedMesh::FLOATS_PER_VERTEX);
+            level.resource = gResources.createMesh(lod.vertices.data(), lod.vertices.size() * sizeof(float));
+            level.vao = level.resource.getVao();
+            mesh.lods.push_back(level);
+            mesh.lodErrors.push_back(lod.error);
+            cout << " " << lod.getTriangleCount() << " (" << round(lod.error * 1000.0f) / 10.0f << "%)";
         }
+        cout << " in " << milliseconds[i] << " ms" << endl;
 
-        glGenerateMipmap(GL_TEXTURE_2D);
+        // How far each kept LOD is from the base mesh, sampled both ways
+        if (!gLod.report)
+            continue;
+        const size_t baseVertices = vertices[i].size() / ImportedMesh::FLOATS_PER_VERTEX;
+        for (size_t index : kept)
+        {
+            const SimplifiedMesh& lod = chains[i][index];
+            const size_t lodVertices = lod.vertices.size() / ImportedMesh::FLOATS_PER_VERTEX;
+            const MeshDistance toBase = UMeasureMeshDistance(lod.vertices.data(), lodVertices, vertices[i].data(), baseVertices);
+            const MeshDistance fromBase = UMeasureMeshDistance(vertices[i].data(), baseVertices, lod.vertices.data(), lodVertices);
+            cout << "INFO:   " << lod.getTriangleCount() << " triangles: mean distance "
+                << round(max(toBase.mean, fromBase.mean) * 1000.0f) / 10.0f << "%, Hausdorff "
+                << round(max(toBase.max, fromBase.max) * 1000.0f) / 10.0f << "% of the radius (estimated "
+                << round(lod.error * 1000.0f) / 10.0f << "%)" << endl;
+        }
+    }
+    cout << "INFO: Simplified " << totalTriangles << " triangles in " << totalMs << " ms ("
+        << (totalMs > 0.0 ? totalTriangles / totalMs / 1000.0 : 0.0) << " M triangles/s)" << endl;
+}
 
-        stbi_image_free(image);
-        glBindTexture(GL_TEXTURE_2D, 0); // Unbind the texture
 
+/*Generate and load the texture*/
+bool UCreateTexture(const char* filename, TextureHandle& texture)
+{
+    // Loaded before under this name
+    texture = gResources.findTexture(filename);
+    if (texture.isValid())
         return true;
+
+    // Decoded in place, from an asset pack or the file's mapping
+    AssetData file;
+    if (!UAssets().read(filename, file))
+        return false;
+
+    int width, height, channels;
+    unsigned char* image = stbi_load_from_memory(file.getData(), (int)file.getSize(), &width, &height, &channels, 0);
+    if (image)
+    {
+        flipImageVertically(image, width, height, channels);
+        texture = gResources.createTexture(filename, image, width, height, channels);
+        stbi_image_free(image);
+        return texture.isValid();
     }
 
     // Error loading the image
@@ -773,9 +2916,10 @@ bool UCreateTexture(const char* filename, GLuint& textureId)
 }
 
 
-void UDestroyTexture(GLuint textureId)
+// Drops the reference; the registry deletes the texture with the last one
+void UDestroyTexture(TextureHandle& texture)
 {
-    glGenTextures(1, &textureId);
+    texture.reset();
 }
 
 
@@ -835,7 +2979,7 @@ bool UCreateShaderProgram(const char* vtxShaderSource, const char* fragShaderSou
         return false;
     }
 
-    glUseProgram(programId);    // Uses the shader program
+    UGLState().useProgram(programId);    // Uses the shader program
 
     return true;
 }
@@ -843,7 +2987,7 @@ bool UCreateShaderProgram(const char* vtxShaderSource, const char* fragShaderSou
 
 void UDestroyShaderProgram(GLuint programId)
 {
-    glDeleteProgram(programId);
+    UGLState().deleteProgram(programId);
 }
 
 
@@ -898,26 +3042,7 @@ void UCreateBook(GLMesh& mesh)
 
     mesh.nVertices = sizeof(verts) / (sizeof(verts[0]) * (floatsPerVertex + floatsPerNormal + floatsPerUV));
 
-    glGenVertexArrays(1, &mesh.vao); // we can also generate multiple VAOs or buffers at the same time
-    glBindVertexArray(mesh.vao);
-
-    // Create VBO
-    glGenBuffers(1, &mesh.vbo);
-    glBindBuffer(GL_ARRAY_BUFFER, mesh.vbo); // Activates the buffer
-    glBufferData(GL_ARRAY_BUFFER, sizeof(verts), verts, GL_STATIC_DRAW); // Sends vertex or coordinate data to the GPU
-
-    // Strides between vertex coordinates
-    GLint stride = sizeof(float) * (floatsPerVertex + floatsPerNormal + floatsPerUV);
-
-    // Create Vertex Attribute Pointers
-    glVertexAttribPointer(0, floatsPerVertex, GL_FLOAT, GL_FALSE, stride, 0);
-    glEnableVertexAttribArray(0);
-
-    glVertexAttribPointer(1, floatsPerNormal, GL_FLOAT, GL_FALSE, stride, (void*)(sizeof(float) * floatsPerVertex));
-    glEnableVertexAttribArray(1);
-
-    glVertexAttribPointer(2, floatsPerUV, GL_FLOAT, GL_FALSE, stride, (void*)(sizeof(float) * (floatsPerVertex + floatsPerNormal)));
-    glEnableVertexAttribArray(2);
+    UUploadMesh(mesh, verts, sizeof(verts));
 }
 
 void UCreateBall(GLMesh& mesh)
@@ -1003,26 +3128,7 @@ void UCreateBall(GLMesh& mesh)
 
     //mesh.nVertices = sizeof(vertArray) / (sizeof(vertArray[0]) * (floatsPerVertex + floatsPerNormal + floatsPerUV));
     mesh.nVertices = sizeof(verts) / (sizeof(verts[0]) * (floatsPerVertex + floatsPerNormal + floatsPerUV));
-    glGenVertexArrays(1, &mesh.vao); // we can also generate multiple VAOs or buffers at the same time
-    glBindVertexArray(mesh.vao);
-
-    ////// Create VBO
-    glGenBuffers(1, &mesh.vbo);
-    glBindBuffer(GL_ARRAY_BUFFER, mesh.vbo); // Activates the buffer
-    //glBufferData(GL_ARRAY_BUFFER, vertArray.size() * sizeof(GLfloat), &vertArray[0], GL_STATIC_DRAW); // Sends vertex or coordinate data to the GPU
-    glBufferData(GL_ARRAY_BUFFER, sizeof(verts), verts, GL_STATIC_DRAW);
-    ////// Strides between vertex coordinates
-    GLint stride = sizeof(float) * (floatsPerVertex + floatsPerNormal + floatsPerUV);
-
-    ////// Create Vertex Attribute Pointers
-    glVertexAttribPointer(0, floatsPerVertex, GL_FLOAT, GL_FALSE, stride, 0);
-    glEnableVertexAttribArray(0);
-
-    glVertexAttribPointer(1, floatsPerNormal, GL_FLOAT, GL_FALSE, stride, (void*)(sizeof(float) * floatsPerVertex));
-    glEnableVertexAttribArray(1);
-
-    glVertexAttribPointer(2, floatsPerUV, GL_FLOAT, GL_FALSE, stride, (void*)(sizeof(float) * (floatsPerVertex + floatsPerNormal)));
-    glEnableVertexAttribArray(2);
+    UUploadMesh(mesh, verts, sizeof(verts));
 }
 void UCreateCandle(GLMesh& mesh)
 {
@@ -1092,26 +3198,7 @@ void UCreateCandle(GLMesh& mesh)
 
     mesh.nVertices = sizeof(verts) / (sizeof(verts[0]) * (floatsPerVertex + floatsPerNormal + floatsPerUV));
 
-    glGenVertexArrays(1, &mesh.vao); // we can also generate multiple VAOs or buffers at the same time
-    glBindVertexArray(mesh.vao);
-
-    // Create VBO
-    glGenBuffers(1, &mesh.vbo);
-    glBindBuffer(GL_ARRAY_BUFFER, mesh.vbo); // Activates the buffer
-    glBufferData(GL_ARRAY_BUFFER, sizeof(verts), verts, GL_STATIC_DRAW); // Sends vertex or coordinate data to the GPU
-
-    // Strides between vertex coordinates
-    GLint stride = sizeof(float) * (floatsPerVertex + floatsPerNormal + floatsPerUV);
-
-    // Create Vertex Attribute Pointers
-    glVertexAttribPointer(0, floatsPerVertex, GL_FLOAT, GL_FALSE, stride, 0);
-    glEnableVertexAttribArray(0);
-
-    glVertexAttribPointer(1, floatsPerNormal, GL_FLOAT, GL_FALSE, stride, (void*)(sizeof(float) * floatsPerVertex));
-    glEnableVertexAttribArray(1);
-
-    glVertexAttribPointer(2, floatsPerUV, GL_FLOAT, GL_FALSE, stride, (void*)(sizeof(float) * (floatsPerVertex + floatsPerNormal)));
-    glEnableVertexAttribArray(2);
+    UUploadMesh(mesh, verts, sizeof(verts));
 }
 
 void UCreateTopper(GLMesh& mesh)
@@ -1207,26 +3294,7 @@ void UCreateTopper(GLMesh& mesh)
 
     mesh.nVertices = sizeof(verts) / (sizeof(verts[0]) * (floatsPerVertex + floatsPerNormal + floatsPerUV));
 
-    glGenVertexArrays(1, &mesh.vao); // we can also generate multiple VAOs or buffers at the same time
-    glBindVertexArray(mesh.vao);
-
-    // Create VBO
-    glGenBuffers(1, &mesh.vbo);
-    glBindBuffer(GL_ARRAY_BUFFER, mesh.vbo); // Activates the buffer
-    glBufferData(GL_ARRAY_BUFFER, sizeof(verts), verts, GL_STATIC_DRAW); // Sends vertex or coordinate data to the GPU
-
-    // Strides between vertex coordinates
-    GLint stride = sizeof(float) * (floatsPerVertex + floatsPerNormal + floatsPerUV);
-
-    // Create Vertex Attribute Pointers
-    glVertexAttribPointer(0, floatsPerVertex, GL_FLOAT, GL_FALSE, stride, 0);
-    glEnableVertexAttribArray(0);
-
-    glVertexAttribPointer(1, floatsPerNormal, GL_FLOAT, GL_FALSE, stride, (void*)(sizeof(float) * floatsPerVertex));
-    glEnableVertexAttribArray(1);
-
-    glVertexAttribPointer(2, floatsPerUV, GL_FLOAT, GL_FALSE, stride, (void*)(sizeof(float) * (floatsPerVertex + floatsPerNormal)));
-    glEnableVertexAttribArray(2);
+    UUploadMesh(mesh, verts, sizeof(verts));
 }
 
 void UCreateCable(GLMesh& mesh)
@@ -1470,24 +3538,5 @@ void UCreateCable(GLMesh& mesh)
 
     mesh.nVertices = sizeof(verts) / (sizeof(verts[0]) * (floatsPerVertex + floatsPerNormal + floatsPerUV));
 
-    glGenVertexArrays(1, &mesh.vao); // we can also generate multiple VAOs or buffers at the same time
-    glBindVertexArray(mesh.vao);
-
-    // Create VBO
-    glGenBuffers(1, &mesh.vbo);
-    glBindBuffer(GL_ARRAY_BUFFER, mesh.vbo); // Activates the buffer
-    glBufferData(GL_ARRAY_BUFFER, sizeof(verts), verts, GL_STATIC_DRAW); // Sends vertex or coordinate data to the GPU
-
-    // Strides between vertex coordinates
-    GLint stride = sizeof(float) * (floatsPerVertex + floatsPerNormal + floatsPerUV);
-
-    // Create Vertex Attribute Pointers
-    glVertexAttribPointer(0, floatsPerVertex, GL_FLOAT, GL_FALSE, stride, 0);
-    glEnableVertexAttribArray(0);
-
-    glVertexAttribPointer(1, floatsPerNormal, GL_FLOAT, GL_FALSE, stride, (void*)(sizeof(float) * floatsPerVertex));
-    glEnableVertexAttribArray(1);
-
-    glVertexAttribPointer(2, floatsPerUV, GL_FLOAT, GL_FALSE, stride, (void*)(sizeof(float) * (floatsPerVertex + floatsPerNormal)));
-    glEnableVertexAttribArray(2);
+    UUploadMesh(mesh, verts, sizeof(verts));
 }
\ No newline at end of file
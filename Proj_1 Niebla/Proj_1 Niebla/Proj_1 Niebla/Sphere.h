@@ -56,11 +56,6 @@ public:
     int getInterleavedStride() const { return interleavedStride; }   // should be 32 bytes
     const float* getInterleavedVertices() const { return interleavedVertices.data(); }
 
-    // draw in VertexArray mode
-    void draw() const;                                  // draw surface
-    void drawLines(const float lineColor[4]) const;     // draw lines only
-    void drawWithLines(const float lineColor[4]) const; // draw surface and lines
-
     // debug
     void printSelf() const;
 
@@ -0,0 +1,407 @@
+#include "TransformBatch.h"
+
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define TRANSFORM_BATCH_SSE2 1
+#include <emmintrin.h>
+#if defined(_MSC_VER) || defined(__GNUC__)
+#define TRANSFORM_BATCH_AVX 1
+#include <immintrin.h>
+#endif
+#endif
+
+#ifdef TRANSFORM_BATCH_AVX
+#ifdef _MSC_VER
+#include <intrin.h>
+#define TRANSFORM_TARGET_AVX
+#else
+#define TRANSFORM_TARGET_AVX __attribute__((target("avx")))
+#endif
+#endif
+
+using namespace std;
+
+static_assert(sizeof(glm::vec3) == 3 * sizeof(float), "glm::vec3 must be three packed floats");
+static_assert(sizeof(glm::quat) == 4 * sizeof(float), "glm::quat must be four packed floats");
+static_assert(sizeof(glm::mat3) == 9 * sizeof(float), "glm::mat3 must be nine packed floats");
+static_assert(sizeof(glm::mat4) == 16 * sizeof(float), "glm::mat4 must be sixteen packed floats");
+
+namespace
+{
+    typedef void (*ComposeFunction)(const glm::vec3*, const glm::quat*, const glm::vec3*, size_t, glm::mat4*, glm::mat3*);
+
+
+    // One object, written out so the SIMD kernels can repeat the exact operations
+    void UComposeScalar(const glm::vec3* positions, const glm::quat* rotations, const glm::vec3* scales,
+        size_t count, glm::mat4* models, glm::mat3* normals)
+    {
+        for (size_t i = 0; i < count; ++i)
+        {
+            const glm::quat& q = rotations[i];
+            const float xx = q.x * q.x, yy = q.y * q.y, zz = q.z * q.z;
+            const float xy = q.x * q.y, xz = q.x * q.z, yz = q.y * q.z;
+            const float wx = q.w * q.x, wy = q.w * q.y, wz = q.w * q.z;
+
+            const float r[3][3] = {
+                { 1.0f - 2.0f * (yy + zz), 2.0f * (xy + wz), 2.0f * (xz - wy) },
+                { 2.0f * (xy - wz), 1.0f - 2.0f * (xx + zz), 2.0f * (yz + wx) },
+                { 2.0f * (xz + wy), 2.0f * (yz - wx), 1.0f - 2.0f * (xx + yy) },
+            };
+
+            const glm::vec3& s = scales[i];
+            glm::mat4& m = models[i];
+            for (int c = 0; c < 3; ++c)
+                m[c] = glm::vec4(r[c][0] * s.x, r[c][1] * s.y, r[c][2] * s.z, 0.0f);
+            m[3] = glm::vec4(positions[i], 1.0f);
+
+            if (normals)
+            {
+                const glm::vec3 inverse(1.0f / s.x, 1.0f / s.y, 1.0f / s.z);
+                glm::mat3& n = normals[i];
+                for (int c = 0; c < 3; ++c)
+                    n[c] = glm::vec3(r[c][0] * inverse.x, r[c][1] * inverse.y, r[c][2] * inverse.z);
+            }
+        }
+    }
+
+
+#ifdef TRANSFORM_BATCH_SSE2
+    // Splits four packed vec3s (three registers) into their x, y and z lanes
+    inline void UDeinterleave3(__m128 a, __m128 b, __m128 c, __m128& x, __m128& y, __m128& z)
+    {
+        // a = x0 y0 z0 x1, b = y1 z1 x2 y2, c = z2 x3 y3 z3
+        x = _mm_shuffle_ps(_mm_shuffle_ps(a, a, _MM_SHUFFLE(3, 3, 0, 0)), _mm_shuffle_ps(b, c, _MM_SHUFFLE(1, 1, 2, 2)), _MM_SHUFFLE(2, 0, 2, 0));
+        y = _mm_shuffle_ps(_mm_shuffle_ps(a, b, _MM_SHUFFLE(0, 0, 1, 1)), _mm_shuffle_ps(b, c, _MM_SHUFFLE(2, 2, 3, 3)), _MM_SHUFFLE(2, 0, 2, 0));
+        z = _mm_shuffle_ps(_mm_shuffle_ps(a, b, _MM_SHUFFLE(1, 1, 2, 2)), _mm_shuffle_ps(c, c, _MM_SHUFFLE(3, 3, 0, 0)), _MM_SHUFFLE(2, 0, 2, 0));
+    }
+
+
+    // Writes a normal matrix from three column registers (w lanes ignored) without touching the next one
+    inline void UStoreNormal(float* n, __m128 c0, __m128 c1, __m128 c2)
+    {
+        _mm_storeu_ps(n, c0);
+        _mm_storeu_ps(n + 3, c1);
+        _mm_storel_pi(reinterpret_cast<__m64*>(n + 6), c2);
+        _mm_store_ss(n + 8, _mm_shuffle_ps(c2, c2, _MM_SHUFFLE(2, 2, 2, 2)));
+    }
+
+
+    void UComposeSse2(const glm::vec3* positions, const glm::quat* rotations, const glm::vec3* scales,
+        size_t count, glm::mat4* models, glm::mat3* normals)
+    {
+        const __m128 one = _mm_set1_ps(1.0f);
+        const __m128 two = _mm_set1_ps(2.0f);
+        const __m128 zero = _mm_setzero_ps();
+
+        const size_t blocks = count / 4 * 4;
+        for (size_t i = 0; i < blocks; i += 4)
+        {
+            __m128 qx = _mm_loadu_ps(&rotations[i].x);
+            __m128 qy = _mm_loadu_ps(&rotations[i + 1].x);
+            __m128 qz = _mm_loadu_ps(&rotations[i + 2].x);
+            __m128 qw = _mm_loadu_ps(&rotations[i + 3].x);
+            _MM_TRANSPOSE4_PS(qx, qy, qz, qw);
+
+            const float* p = &positions[i].x;
+            __m128 px, py, pz;
+            UDeinterleave3(_mm_loadu_ps(p), _mm_loadu_ps(p + 4), _mm_loadu_ps(p + 8), px, py, pz);
+
+            const float* s = &scales[i].x;
+            __m128 scale[3];
+            UDeinterleave3(_mm_loadu_ps(s), _mm_loadu_ps(s + 4), _mm_loadu_ps(s + 8), scale[0], scale[1], scale[2]);
+
+            const __m128 xx = _mm_mul_ps(qx, qx), yy = _mm_mul_ps(qy, qy), zz = _mm_mul_ps(qz, qz);
+            const __m128 xy = _mm_mul_ps(qx, qy), xz = _mm_mul_ps(qx, qz), yz = _mm_mul_ps(qy, qz);
+            const __m128 wx = _mm_mul_ps(qw, qx), wy = _mm_mul_ps(qw, qy), wz = _mm_mul_ps(qw, qz);
+
+            const __m128 r[3][3] = {
+                { _mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(yy, zz))), _mm_mul_ps(two, _mm_add_ps(xy, wz)), _mm_mul_ps(two, _mm_sub_ps(xz, wy)) },
+                { _mm_mul_ps(two, _mm_sub_ps(xy, wz)), _mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, zz))), _mm_mul_ps(two, _mm_add_ps(yz, wx)) },
+                { _mm_mul_ps(two, _mm_add_ps(xz, wy)), _mm_mul_ps(two, _mm_sub_ps(yz, wx)), _mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, yy))) },
+            };
+
+            // Transpose each column across the four objects, then write whole matrices
+            __m128 columns[4][4];
+            for (int c = 0; c < 3; ++c)
+            {
+                columns[c][0] = _mm_mul_ps(r[c][0], scale[0]);
+                columns[c][1] = _mm_mul_ps(r[c][1], scale[1]);
+                columns[c][2] = _mm_mul_ps(r[c][2], scale[2]);
+                columns[c][3] = zero;
+                _MM_TRANSPOSE4_PS(columns[c][0], columns[c][1], columns[c][2], columns[c][3]);
+            }
+            columns[3][0] = px;
+            columns[3][1] = py;
+            columns[3][2] = pz;
+            columns[3][3] = one;
+            _MM_TRANSPOSE4_PS(columns[3][0], columns[3][1], columns[3][2], columns[3][3]);
+
+            for (int k = 0; k < 4; ++k)
+            {
+                float* m = &models[i + k][0][0];
+                for (int c = 0; c < 4; ++c)
+                    _mm_storeu_ps(m + 4 * c, columns[c][k]);
+            }
+
+            if (normals)
+            {
+                const __m128 reciprocal[3] = { _mm_div_ps(one, scale[0]), _mm_div_ps(one, scale[1]), _mm_div_ps(one, scale[2]) };
+                __m128 inverse[3][4];
+                for (int c = 0; c < 3; ++c)
+                {
+                    inverse[c][0] = _mm_mul_ps(r[c][0], reciprocal[0]);
+                    inverse[c][1] = _mm_mul_ps(r[c][1], reciprocal[1]);
+                    inverse[c][2] = _mm_mul_ps(r[c][2], reciprocal[2]);
+                    inverse[c][3] = zero;
+                    _MM_TRANSPOSE4_PS(inverse[c][0], inverse[c][1], inverse[c][2], inverse[c][3]);
+                }
+                for (int k = 0; k < 4; ++k)
+                    UStoreNormal(&normals[i + k][0][0], inverse[0][k], inverse[1][k], inverse[2][k]);
+            }
+        }
+
+        UComposeScalar(positions + blocks, rotations + blocks, scales + blocks, count - blocks,
+            models + blocks, normals ? normals + blocks : nullptr);
+    }
+#endif
+
+
+#ifdef TRANSFORM_BATCH_AVX
+    // _MM_TRANSPOSE4_PS within each 128-bit half
+    #define TRANSFORM_TRANSPOSE4_256(r0, r1, r2, r3) \
+    { \
+        const __m256 t0 = _mm256_unpacklo_ps(r0, r1); \
+        const __m256 t1 = _mm256_unpacklo_ps(r2, r3); \
+        const __m256 t2 = _mm256_unpackhi_ps(r0, r1); \
+        const __m256 t3 = _mm256_unpackhi_ps(r2, r3); \
+        r0 = _mm256_shuffle_ps(t0, t1, _MM_SHUFFLE(1, 0, 1, 0)); \
+        r1 = _mm256_shuffle_ps(t0, t1, _MM_SHUFFLE(3, 2, 3, 2)); \
+        r2 = _mm256_shuffle_ps(t2, t3, _MM_SHUFFLE(1, 0, 1, 0)); \
+        r3 = _mm256_shuffle_ps(t2, t3, _MM_SHUFFLE(3, 2, 3, 2)); \
+    }
+
+
+    // Splits eight packed vec3s into their x, y and z lanes; UDeinterleave3 per 128-bit half
+    TRANSFORM_TARGET_AVX inline void UDeinterleave3x8(const float* v, __m256& x, __m256& y, __m256& z)
+    {
+        const __m256 a = _mm256_loadu_ps(v);
+        const __m256 b = _mm256_loadu_ps(v + 8);
+        const __m256 c = _mm256_loadu_ps(v + 16);
+
+        // Objects 0-3 in the low halves, 4-7 in the high halves
+        const __m256 m03 = _mm256_permute2f128_ps(a, b, 0x30);
+        const __m256 m14 = _mm256_permute2f128_ps(a, c, 0x21);
+        const __m256 m25 = _mm256_permute2f128_ps(b, c, 0x30);
+
+        x = _mm256_shuffle_ps(_mm256_shuffle_ps(m03, m03, _MM_SHUFFLE(3, 3, 0, 0)), _mm256_shuffle_ps(m14, m25, _MM_SHUFFLE(1, 1, 2, 2)), _MM_SHUFFLE(2, 0, 2, 0));
+        y = _mm256_shuffle_ps(_mm256_shuffle_ps(m03, m14, _MM_SHUFFLE(0, 0, 1, 1)), _mm256_shuffle_ps(m14, m25, _MM_SHUFFLE(2, 2, 3, 3)), _MM_SHUFFLE(2, 0, 2, 0));
+        z = _mm256_shuffle_ps(_mm256_shuffle_ps(m03, m14, _MM_SHUFFLE(1, 1, 2, 2)), _mm256_shuffle_ps(m25, m25, _MM_SHUFFLE(3, 3, 0, 0)), _MM_SHUFFLE(2, 0, 2, 0));
+    }
+
+
+    TRANSFORM_TARGET_AVX void UComposeAvx(const glm::vec3* positions, const glm::quat* rotations, const glm::vec3* scales,
+        size_t count, glm::mat4* models, glm::mat3* normals)
+    {
+        const __m256 one = _mm256_set1_ps(1.0f);
+        const __m256 two = _mm256_set1_ps(2.0f);
+        const __m256 zero = _mm256_setzero_ps();
+
+        const size_t blocks = count / 8 * 8;
+        for (size_t i = 0; i < blocks; i += 8)
+        {
+            // Two quaternions per load, regrouped so objects k and k + 4 share a register
+            const float* q = &rotations[i].x;
+            const __m256 q01 = _mm256_loadu_ps(q);
+            const __m256 q23 = _mm256_loadu_ps(q + 8);
+            const __m256 q45 = _mm256_loadu_ps(q + 16);
+            const __m256 q67 = _mm256_loadu_ps(q + 24);
+            __m256 qx = _mm256_permute2f128_ps(q01, q45, 0x20);
+            __m256 qy = _mm256_permute2f128_ps(q01, q45, 0x31);
+            __m256 qz = _mm256_permute2f128_ps(q23, q67, 0x20);
+            __m256 qw = _mm256_permute2f128_ps(q23, q67, 0x31);
+            TRANSFORM_TRANSPOSE4_256(qx, qy, qz, qw);
+
+            __m256 px, py, pz;
+            UDeinterleave3x8(&positions[i].x, px, py, pz);
+            __m256 scale[3];
+            UDeinterleave3x8(&scales[i].x, scale[0], scale[1], scale[2]);
+
+            const __m256 xx = _mm256_mul_ps(qx, qx), yy = _mm256_mul_ps(qy, qy), zz = _mm256_mul_ps(qz, qz);
+            const __m256 xy = _mm256_mul_ps(qx, qy), xz = _mm256_mul_ps(qx, qz), yz = _mm256_mul_ps(qy, qz);
+            const __m256 wx = _mm256_mul_ps(qw, qx), wy = _mm256_mul_ps(qw, qy), wz = _mm256_mul_ps(qw, qz);
+
+            const __m256 r[3][3] = {
+                { _mm256_sub_ps(one, _mm256_mul_ps(two, _mm256_add_ps(yy, zz))), _mm256_mul_ps(two, _mm256_add_ps(xy, wz)), _mm256_mul_ps(two, _mm256_sub_ps(xz, wy)) },
+                { _mm256_mul_ps(two, _mm256_sub_ps(xy, wz)), _mm256_sub_ps(one, _mm256_mul_ps(two, _mm256_add_ps(xx, zz))), _mm256_mul_ps(two, _mm256_add_ps(yz, wx)) },
+                { _mm256_mul_ps(two, _mm256_add_ps(xz, wy)), _mm256_mul_ps(two, _mm256_sub_ps(yz, wx)), _mm256_sub_ps(one, _mm256_mul_ps(two, _mm256_add_ps(xx, yy))) },
+            };
+
+            // columns[c][k] holds column c of objects k (low half) and k + 4 (high half)
+            __m256 columns[4][4];
+            for (int c = 0; c < 3; ++c)
+            {
+                columns[c][0] = _mm256_mul_ps(r[c][0], scale[0]);
+                columns[c][1] = _mm256_mul_ps(r[c][1], scale[1]);
+                columns[c][2] = _mm256_mul_ps(r[c][2], scale[2]);
+                columns[c][3] = zero;
+                TRANSFORM_TRANSPOSE4_256(columns[c][0], columns[c][1], columns[c][2], columns[c][3]);
+            }
+            columns[3][0] = px;
+            columns[3][1] = py;
+            columns[3][2] = pz;
+            columns[3][3] = one;
+            TRANSFORM_TRANSPOSE4_256(columns[3][0], columns[3][1], columns[3][2], columns[3][3]);
+
+            for (int k = 0; k < 4; ++k)
+            {
+                float* low = &models[i + k][0][0];
+                float* high = &models[i + k + 4][0][0];
+                _mm256_storeu_ps(low, _mm256_permute2f128_ps(columns[0][k], columns[1][k], 0x20));
+                _mm256_storeu_ps(low + 8, _mm256_permute2f128_ps(columns[2][k], columns[3][k], 0x20));
+                _mm256_storeu_ps(high, _mm256_permute2f128_ps(columns[0][k], columns[1][k], 0x31));
+                _mm256_storeu_ps(high + 8, _mm256_permute2f128_ps(columns[2][k], columns[3][k], 0x31));
+            }
+
+            if (normals)
+            {
+                const __m256 reciprocal[3] = { _mm256_div_ps(one, scale[0]), _mm256_div_ps(one, scale[1]), _mm256_div_ps(one, scale[2]) };
+                __m256 inverse[3][4];
+                for (int c = 0; c < 3; ++c)
+                {
+                    inverse[c][0] = _mm256_mul_ps(r[c][0], reciprocal[0]);
+                    inverse[c][1] = _mm256_mul_ps(r[c][1], reciprocal[1]);
+                    inverse[c][2] = _mm256_mul_ps(r[c][2], reciprocal[2]);
+                    inverse[c][3] = zero;
+                    TRANSFORM_TRANSPOSE4_256(inverse[c][0], inverse[c][1], inverse[c][2], inverse[c][3]);
+                }
+                for (int k = 0; k < 4; ++k)
+                {
+                    UStoreNormal(&normals[i + k][0][0], _mm256_castps256_ps128(inverse[0][k]),
+                        _mm256_castps256_ps128(inverse[1][k]), _mm256_castps256_ps128(inverse[2][k]));
+                    UStoreNormal(&normals[i + k + 4][0][0], _mm256_extractf128_ps(inverse[0][k], 1),
+                        _mm256_extractf128_ps(inverse[1][k], 1), _mm256_extractf128_ps(inverse[2][k], 1));
+                }
+            }
+        }
+        _mm256_zeroupper();
+
+        UComposeSse2(positions + blocks, rotations + blocks, scales + blocks, count - blocks,
+            models + blocks, normals ? normals + blocks : nullptr);
+    }
+
+    #undef TRANSFORM_TRANSPOSE4_256
+
+
+    bool UCpuHasAvx()
+    {
+#ifdef _MSC_VER
+        int info[4];
+        __cpuid(info, 1);
+        const bool osSaves = (info[2] & (1 << 27)) != 0;
+        const bool avx = (info[2] & (1 << 28)) != 0;
+        return osSaves && avx && (_xgetbv(0) & 0x6) == 0x6;
+#else
+        return __builtin_cpu_supports("avx");
+#endif
+    }
+#endif
+
+
+    ComposeFunction UComposeFunction(TransformKernel kernel)
+    {
+        switch (kernel)
+        {
+#ifdef TRANSFORM_BATCH_AVX
+        case TRANSFORM_KERNEL_AVX:
+            return UComposeAvx;
+#endif
+#ifdef TRANSFORM_BATCH_SSE2
+        case TRANSFORM_KERNEL_SSE2:
+            return UComposeSse2;
+#endif
+        default:
+            return UComposeScalar;
+        }
+    }
+}
+
+
+bool UTransformKernelSupported(TransformKernel kernel)
+{
+    switch (kernel)
+    {
+    case TRANSFORM_KERNEL_AUTO:
+    case TRANSFORM_KERNEL_SCALAR:
+        return true;
+#ifdef TRANSFORM_BATCH_SSE2
+    case TRANSFORM_KERNEL_SSE2:
+        return true;
+#endif
+#ifdef TRANSFORM_BATCH_AVX
+    case TRANSFORM_KERNEL_AVX:
+    {
+        static const bool hasAvx = UCpuHasAvx();
+        return hasAvx;
+    }
+#endif
+    default:
+        return false;
+    }
+}
+
+
+TransformKernel UBestTransformKernel()
+{
+    if (UTransformKernelSupported(TRANSFORM_KERNEL_AVX))
+        return TRANSFORM_KERNEL_AVX;
+    if (UTransformKernelSupported(TRANSFORM_KERNEL_SSE2))
+        return TRANSFORM_KERNEL_SSE2;
+    return TRANSFORM_KERNEL_SCALAR;
+}
+
+
+const char* UTransformKernelName(TransformKernel kernel)
+{
+    switch (kernel)
+    {
+    case TRANSFORM_KERNEL_SCALAR: return "scalar";
+    case TRANSFORM_KERNEL_SSE2: return "sse2";
+    case TRANSFORM_KERNEL_AVX: return "avx";
+    default: return "auto";
+    }
+}
+
+
+void UComposeTransforms(const glm::vec3* positions, const glm::quat* rotations, const glm::vec3* scales,
+    size_t count, glm::mat4* models, glm::mat3* normals, TransformKernel kernel, int threads)
+{
+    if (kernel == TRANSFORM_KERNEL_AUTO || !UTransformKernelSupported(kernel))
+        kernel = UBestTransformKernel();
+    const ComposeFunction compose = UComposeFunction(kernel);
+
+    // Ranges are multiples of 8 objects so only the last one has a scalar tail
+    const size_t maxThreads = max<size_t>(1, count / TRANSFORM_MIN_OBJECTS_PER_THREAD);
+    const size_t rangeCount = min<size_t>(max(threads, 1), maxThreads);
+    if (rangeCount == 1)
+    {
+        compose(positions, rotations, scales, count, models, normals);
+        return;
+    }
+
+    const size_t range = (count / rangeCount + 7) / 8 * 8;
+    vector<thread> workers;
+    workers.reserve(rangeCount - 1);
+    for (size_t begin = range; begin < count; begin += range)
+    {
+        const size_t size = min(range, count - begin);
+        workers.emplace_back(compose, positions + begin, rotations + begin, scales + begin, size,
+            models + begin, normals ? normals + begin : nullptr);
+    }
+    compose(positions, rotations, scales, min(range, count), models, normals);
+
+    for (thread& worker : workers)
+        worker.join();
+}
@@ -0,0 +1,58 @@
+///////////////////////////////////////////////////////////////////////////////
+// TransformBatch.h
+// ================
+// Batch composition of model and normal matrices from structure-of-arrays
+// transform components (the layout EntityStore keeps them in), instead of
+// one glm::translate * glm::scale * glm::rotate chain per object.
+//
+// For each object i:
+//   model[i]  = translate(position[i]) * scale(scale[i]) * mat4_cast(rotation[i])
+//   normal[i] = transpose(inverse(mat3(model[i]))) = scale(1 / scale[i]) * mat3_cast(rotation[i])
+//
+// Kernels process 1 (scalar), 4 (SSE2) or 8 (AVX) objects per step. All of
+// them evaluate the same expressions in the same order without fused
+// multiply-adds, so they produce identical results; AUTO picks the widest
+// one the CPU supports. Large batches can also be split across threads.
+//
+// glm::quat is expected in its default x, y, z, w member order.
+//
+// Usage:
+//   UComposeTransforms(store.positions(), store.rotations(), store.scales(),
+//                      store.size(), models, normals);
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef TRANSFORM_BATCH_H
+#define TRANSFORM_BATCH_H
+
+#include <cstddef>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+enum TransformKernel
+{
+    TRANSFORM_KERNEL_AUTO,
+    TRANSFORM_KERNEL_SCALAR,
+    TRANSFORM_KERNEL_SSE2,
+    TRANSFORM_KERNEL_AVX
+};
+
+// Objects below which a batch is not split across threads
+const size_t TRANSFORM_MIN_OBJECTS_PER_THREAD = 2048;
+
+// Whether this build and CPU can run a kernel; AUTO and SCALAR always can
+bool UTransformKernelSupported(TransformKernel kernel);
+
+// Widest supported kernel
+TransformKernel UBestTransformKernel();
+
+const char* UTransformKernelName(TransformKernel kernel);
+
+// Writes count model matrices and, unless normals is null, count normal matrices.
+// An unsupported kernel falls back to AUTO. threads > 1 splits the batch into
+// contiguous ranges of at least TRANSFORM_MIN_OBJECTS_PER_THREAD objects.
+void UComposeTransforms(const glm::vec3* positions, const glm::quat* rotations, const glm::vec3* scales,
+    size_t count, glm::mat4* models, glm::mat3* normals,
+    TransformKernel kernel = TRANSFORM_KERNEL_AUTO, int threads = 1);
+
+#endif